@@ -0,0 +1,72 @@
+/* Helpers shared by the benchmarks: a monotonic clock and, where the C
+   library makes it possible, a count of heap allocations. */
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "bench.h"
+
+#if defined(__GLIBC__)
+extern void	*__libc_calloc(size_t, size_t);
+extern void	*__libc_malloc(size_t);
+extern void	*__libc_realloc(void *, size_t);
+extern void	 __libc_free(void *);
+
+const bool bench_allocs_counted = true;
+
+/* Some benchmarks allocate on several threads */
+static atomic_uint_fast64_t allocs = 0;
+
+void *
+malloc(size_t size)
+{
+	(void) atomic_fetch_add_explicit(&allocs, 1, memory_order_relaxed);
+	return __libc_malloc(size);
+}
+
+void *
+calloc(size_t elt_count, size_t elt_size)
+{
+	(void) atomic_fetch_add_explicit(&allocs, 1, memory_order_relaxed);
+	return __libc_calloc(elt_count, elt_size);
+}
+
+void *
+realloc(void *ptr, size_t size)
+{
+	(void) atomic_fetch_add_explicit(&allocs, 1, memory_order_relaxed);
+	return __libc_realloc(ptr, size);
+}
+
+void
+free(void *ptr)
+{
+	__libc_free(ptr);
+}
+#else
+const bool bench_allocs_counted = false;
+static atomic_uint_fast64_t allocs = 0;
+#endif
+
+/**
+ * Number of malloc(), calloc() and realloc() calls made so far. Always
+ * zero unless 'bench_allocs_counted' is true.
+ */
+uint64_t
+bench_allocs(void)
+{
+	return atomic_load_explicit(&allocs, memory_order_relaxed);
+}
+
+/**
+ * Monotonic time in nanoseconds
+ */
+uint64_t
+bench_now_ns(void)
+{
+	struct timespec ts;
+
+	(void) clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec);
+}
@@ -0,0 +1,12 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+extern const bool bench_allocs_counted;
+
+uint64_t	bench_allocs(void);
+uint64_t	bench_now_ns(void);
+
+#endif
@@ -0,0 +1,7 @@
+BENCHMARKS = confcache.bench\
+	include.bench\
+	interpreter.bench\
+	log.bench\
+	logfile.bench\
+	micro.bench\
+	parsers.bench
@@ -0,0 +1,135 @@
+#include <sys/stat.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "confcache.h"
+#include "settings.h"
+
+#define INCLUDE_FILES	1000
+#define LINES_PER_FILE	100
+#define ROUNDS		5
+
+static char dir[] = "/tmp/educ-bench.XXXXXX";
+
+static void
+write_file(const char *path, const char *contents)
+{
+	FILE *fp;
+
+	if ((fp = fopen(path, "w")) == NULL || fputs(contents, fp) < 0) {
+		perror(path);
+		exit(1);
+	}
+	fclose(fp);
+}
+
+static void
+generate_files(void)
+{
+	FILE	*fp;
+	char	 path[200];
+
+	if (mkdtemp(dir) == NULL) {
+		perror("mkdtemp");
+		exit(1);
+	}
+	(void) snprintf(path, sizeof path, "%s/conf.d", dir);
+	if (mkdir(path, 0700) != 0) {
+		perror(path);
+		exit(1);
+	}
+	(void) snprintf(path, sizeof path, "%s/main.conf", dir);
+	write_file(path, "username = \"bench\";\n"
+	    "password = \"bench\";\n"
+	    "hostname = \"host1.example.com|host2.example.com\";\n"
+	    "port = \"443\";\n"
+	    "force_update = \"NO\";\n"
+	    "include \"conf.d/*.conf\";\n");
+
+	for (int i = 0; i < INCLUDE_FILES; i++) {
+		(void) snprintf(path, sizeof path, "%s/conf.d/site%04d.conf",
+		    dir, i);
+		if ((fp = fopen(path, "w")) == NULL) {
+			perror(path);
+			exit(1);
+		}
+		fprintf(fp, "# site %d\n", i);
+		for (int j = 0; j < LINES_PER_FILE; j++) {
+			fprintf(fp, "site_host_%d = \"host%d.site%d.example.com\";"
+			    " # unused\n", j, j, i);
+		}
+		fclose(fp);
+	}
+}
+
+static void
+remove_files(void)
+{
+	char path[200];
+
+	for (int i = 0; i < INCLUDE_FILES; i++) {
+		(void) snprintf(path, sizeof path, "%s/conf.d/site%04d.conf",
+		    dir, i);
+		(void) unlink(path);
+	}
+	(void) snprintf(path, sizeof path, "%s/main.conf%s", dir,
+	    CONFCACHE_SUFFIX);
+	(void) unlink(path);
+	(void) snprintf(path, sizeof path, "%s/main.conf", dir);
+	(void) unlink(path);
+	(void) snprintf(path, sizeof path, "%s/conf.d", dir);
+	(void) rmdir(path);
+	(void) rmdir(dir);
+}
+
+static uint64_t
+run(const char *path, bool cached)
+{
+	uint64_t best_ns = UINT64_MAX;
+
+	for (int round = 0; round < ROUNDS; round++) {
+		destroy_config_custom_values();
+		g_conf_read = false;
+
+		const uint64_t start = bench_now_ns();
+
+		if (cached) {
+			read_config_cache(path);
+		} else {
+			read_config_file(path);
+			check_some_settings_strictly();
+		}
+
+		const uint64_t elapsed = bench_now_ns() - start;
+
+		if (elapsed < best_ns)
+			best_ns = elapsed;
+	}
+
+	return best_ns;
+}
+
+int
+main(void)
+{
+	char path[200];
+
+	generate_files();
+	(void) snprintf(path, sizeof path, "%s/main.conf", dir);
+
+	const uint64_t text_ns = run(path, false);
+	const uint64_t image_ns = run(path, true);
+
+	remove_files();
+	destroy_config_custom_values();
+
+	printf("confcache: %d files of %d lines, best of %d: "
+	    "%.2f ms parsing text, %.2f ms using the image\n",
+	    INCLUDE_FILES, LINES_PER_FILE + 1, ROUNDS, text_ns / 1e6,
+	    image_ns / 1e6);
+	return 0;
+}
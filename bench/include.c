@@ -0,0 +1,134 @@
+#include <sys/stat.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "interpreter.h"
+
+#define INCLUDE_FILES	10000
+#define ROUNDS		5
+
+static char dir[] = "/tmp/educ-bench.XXXXXX";
+static long int installed = 0;
+
+static bool
+validator(const char *id)
+{
+	return (strcmp(id, "hostname") == 0);
+}
+
+static int
+installer(const char *id, const char *arg)
+{
+	(void) id;
+	(void) arg;
+	installed++;
+	return 0;
+}
+
+static void
+write_file(const char *path, const char *contents)
+{
+	FILE *fp;
+
+	if ((fp = fopen(path, "w")) == NULL || fputs(contents, fp) < 0) {
+		perror(path);
+		exit(1);
+	}
+	fclose(fp);
+}
+
+static void
+generate_files(void)
+{
+	char path[200];
+	char contents[200];
+
+	if (mkdtemp(dir) == NULL) {
+		perror("mkdtemp");
+		exit(1);
+	}
+	(void) snprintf(path, sizeof path, "%s/conf.d", dir);
+	if (mkdir(path, 0700) != 0) {
+		perror(path);
+		exit(1);
+	}
+	(void) snprintf(path, sizeof path, "%s/main.conf", dir);
+	write_file(path, "# generated\ninclude \"conf.d/*.conf\";\n");
+
+	for (int i = 0; i < INCLUDE_FILES; i++) {
+		(void) snprintf(path, sizeof path, "%s/conf.d/customer%05d.conf",
+		    dir, i);
+		(void) snprintf(contents, sizeof contents,
+		    "# customer %d\n"
+		    "hostname = \"customer%05d.example.com\";\n"
+		    "customer_id = \"%d\"; # ignored\n", i, i, i);
+		write_file(path, contents);
+	}
+}
+
+static void
+remove_files(void)
+{
+	char path[200];
+
+	for (int i = 0; i < INCLUDE_FILES; i++) {
+		(void) snprintf(path, sizeof path, "%s/conf.d/customer%05d.conf",
+		    dir, i);
+		(void) unlink(path);
+	}
+	(void) snprintf(path, sizeof path, "%s/main.conf", dir);
+	(void) unlink(path);
+	(void) snprintf(path, sizeof path, "%s/conf.d", dir);
+	(void) rmdir(path);
+	(void) rmdir(dir);
+}
+
+static uint64_t
+run(const char *path, unsigned int threads)
+{
+	uint64_t best_ns = UINT64_MAX;
+
+	Interpreter_setMaxThreads(threads);
+
+	for (int round = 0; round < ROUNDS; round++) {
+		const uint64_t start = bench_now_ns();
+
+		installed = 0;
+		if (Interpreter_processAllLines(path, validator, installer,
+		    NULL) != INTERP_OK || installed != INCLUDE_FILES) {
+			fprintf(stderr, "include: parse failed\n");
+			remove_files();
+			exit(1);
+		}
+
+		const uint64_t elapsed = bench_now_ns() - start;
+
+		if (elapsed < best_ns)
+			best_ns = elapsed;
+	}
+
+	return best_ns;
+}
+
+int
+main(void)
+{
+	char path[200];
+
+	generate_files();
+	(void) snprintf(path, sizeof path, "%s/main.conf", dir);
+
+	const uint64_t serial_ns = run(path, 1);
+	const uint64_t parallel_ns = run(path, 0);
+
+	remove_files();
+
+	printf("include: %d files, best of %d: %.2f ms with 1 thread, "
+	    "%.2f ms with one thread per CPU (%ld)\n", INCLUDE_FILES, ROUNDS,
+	    serial_ns / 1e6, parallel_ns / 1e6, sysconf(_SC_NPROCESSORS_ONLN));
+	return 0;
+}
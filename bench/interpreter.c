@@ -0,0 +1,96 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "interpreter.h"
+
+#define HOST_ENTRIES	100000
+#define ROUNDS		5
+
+static long int installed = 0;
+
+static bool
+validator(const char *id)
+{
+	return (strcmp(id, "hostname") == 0);
+}
+
+static int
+installer(const char *id, const char *arg)
+{
+	(void) id;
+	(void) arg;
+	installed++;
+	return 0;
+}
+
+static long int
+generate_config(char *path)
+{
+	FILE		*fp;
+	int		 fd;
+	long int	 lines = 0;
+
+	if ((fd = mkstemp(path)) == -1 || (fp = fdopen(fd, "w")) == NULL) {
+		perror("generate_config");
+		exit(1);
+	}
+
+	for (long int i = 0; i < HOST_ENTRIES; i++) {
+		if (i % 100 == 0) {
+			fprintf(fp, "\n# hosts %ld-%ld\n", i, i + 99);
+			lines += 2;
+		}
+		fprintf(fp, "hostname = \"host%06ld.example.com\"; # entry\n",
+		    i);
+		lines++;
+	}
+
+	fclose(fp);
+	return lines;
+}
+
+int
+main(void)
+{
+	char		path[] = "/tmp/educ-bench.XXXXXX";
+	const long int	lines = generate_config(path);
+	uint64_t	best_ns = UINT64_MAX;
+	uint64_t	allocs = 0;
+
+	for (int round = 0; round < ROUNDS; round++) {
+		const uint64_t allocs_before = bench_allocs();
+		const uint64_t start = bench_now_ns();
+
+		installed = 0;
+		if (Interpreter_processAllLines(path, validator, installer,
+		    NULL) != INTERP_OK || installed != HOST_ENTRIES) {
+			fprintf(stderr, "interpreter: parse failed\n");
+			(void) unlink(path);
+			return 1;
+		}
+
+		const uint64_t elapsed = bench_now_ns() - start;
+
+		if (elapsed < best_ns)
+			best_ns = elapsed;
+		allocs = bench_allocs() - allocs_before;
+	}
+
+	(void) unlink(path);
+
+	printf("interpreter: %ld lines (%d host entries), best of %d: "
+	    "%.2f ms, %.0f lines/s\n", lines, HOST_ENTRIES, ROUNDS,
+	    best_ns / 1e6, lines / (best_ns / 1e9));
+	if (bench_allocs_counted) {
+		printf("interpreter: %llu allocations per parse "
+		    "(%.4f per line)\n", (unsigned long long) allocs,
+		    (double) allocs / lines);
+	} else {
+		printf("interpreter: allocations not counted on this "
+		    "platform\n");
+	}
+	return 0;
+}
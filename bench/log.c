@@ -0,0 +1,108 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "log.h"
+
+#define MESSAGES	5000
+#define READ_SIZE	4096
+#define READ_DELAY_MS	5
+
+/*
+ * The log sink is stdout redirected to a pipe with a slow reader, i.e.
+ * a stalled syslogd as far as the caller is concerned.
+ */
+static int pipe_fd[2];
+
+static void *
+slow_reader(void *arg)
+{
+	char			buf[READ_SIZE];
+	struct timespec		ts = { 0, READ_DELAY_MS * 1000000L };
+
+	(void) arg;
+
+	while (read(pipe_fd[0], buf, sizeof buf) > 0)
+		(void) nanosleep(&ts, NULL);
+	return NULL;
+}
+
+static int
+compare_u64(const void *a, const void *b)
+{
+	const uint64_t x = *(const uint64_t *) a;
+	const uint64_t y = *(const uint64_t *) b;
+
+	return (x > y) - (x < y);
+}
+
+/*
+ * Log 'MESSAGES' messages, i.e. what the update path does, and sort
+ * the time each call took.
+ */
+static void
+run(uint64_t *lat)
+{
+	for (int i = 0; i < MESSAGES; i++) {
+		const uint64_t start = bench_now_ns();
+
+		log_msg("trying to update host%06d.example.com", i);
+		lat[i] = bench_now_ns() - start;
+	}
+
+	qsort(lat, MESSAGES, sizeof *lat, compare_u64);
+}
+
+static void
+report(FILE *out, const char *mode, const uint64_t *lat, uint64_t total_ns)
+{
+	fprintf(out, "log: %-5s %d messages in %8.2f ms, per call: "
+	    "p50 %8.2f us, p99 %8.2f us, max %8.2f us\n", mode, MESSAGES,
+	    total_ns / 1e6, lat[MESSAGES / 2] / 1e3,
+	    lat[MESSAGES * 99 / 100] / 1e3, lat[MESSAGES - 1] / 1e3);
+}
+
+int
+main(void)
+{
+	FILE		*out;
+	pthread_t	 reader;
+	uint64_t	*lat;
+	uint64_t	 start, sync_ns, async_ns;
+
+	if ((out = fdopen(dup(STDOUT_FILENO), "w")) == NULL ||
+	    (lat = calloc(MESSAGES, sizeof *lat)) == NULL ||
+	    pipe(pipe_fd) == -1 ||
+	    dup2(pipe_fd[1], STDOUT_FILENO) == -1 ||
+	    pthread_create(&reader, NULL, slow_reader, NULL) != 0) {
+		perror("log");
+		return 1;
+	}
+
+	(void) setvbuf(stdout, NULL, _IOLBF, 0);
+
+	start = bench_now_ns();
+	run(lat);
+	sync_ns = bench_now_ns() - start;
+	report(out, "sync", lat, sync_ns);
+
+	log_async_start();
+	start = bench_now_ns();
+	run(lat);
+	async_ns = bench_now_ns() - start;
+	log_async_stop();
+	report(out, "async", lat, async_ns);
+	fprintf(out, "log: async: %lu of %d messages dropped while the sink "
+	    "was stalled\n", log_dropped(), MESSAGES);
+
+	(void) fclose(stdout);
+	(void) close(pipe_fd[1]);
+	(void) close(STDOUT_FILENO);
+	(void) pthread_join(reader, NULL);
+	(void) fclose(out);
+	free(lat);
+	return 0;
+}
@@ -0,0 +1,121 @@
+#include <sys/stat.h>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "log.h"
+#include "logfile.h"
+
+#define RECORDS 100000
+
+static char tmpdir[] = "/tmp/educ-bench.XXXXXX";
+static char log_path[100];
+
+static void
+report(const char *mode, uint64_t ns, off_t bytes)
+{
+	printf("logfile: %-13s %d records in %8.2f ms, %9.0f records/s",
+	    mode, RECORDS, ns / 1e6, RECORDS / (ns / 1e9));
+	if (bytes > 0)
+		printf(", %6.1f MB/s", bytes / (ns / 1e3));
+	putchar('\n');
+}
+
+static off_t
+file_size(const char *path)
+{
+	struct stat sb;
+
+	return (stat(path, &sb) == 0 ? sb.st_size : 0);
+}
+
+/*
+ * The file sink: the records are buffered and written in batches
+ */
+static void
+run_file_sink(void)
+{
+	uint64_t start;
+
+	if (logfile_open(log_path) == -1) {
+		perror(log_path);
+		exit(1);
+	}
+	logfile_set_rotation(0, 0);
+
+	start = bench_now_ns();
+	for (int i = 0; i < RECORDS; i++)
+		log_msg("trying to update host%06d.example.com", i);
+	logfile_close();
+	report("file sink", bench_now_ns() - start, file_size(log_path));
+	(void) unlink(log_path);
+}
+
+/*
+ * One write(2) per record, i.e. what the file sink would cost without
+ * buffering
+ */
+static void
+run_write_per_record(void)
+{
+	char		buf[100];
+	int		fd, len;
+	uint64_t	start;
+
+	if ((fd = open(log_path, O_WRONLY | O_APPEND | O_CREAT, 0600)) == -1) {
+		perror(log_path);
+		exit(1);
+	}
+
+	start = bench_now_ns();
+	for (int i = 0; i < RECORDS; i++) {
+		len = snprintf(buf, sizeof buf, "trying to update "
+		    "host%06d.example.com\n", i);
+		if (write(fd, buf, len) != len) {
+			perror("write");
+			exit(1);
+		}
+	}
+	(void) fsync(fd);
+	(void) close(fd);
+	report("write/record", bench_now_ns() - start, file_size(log_path));
+	(void) unlink(log_path);
+}
+
+static void
+run_syslog(void)
+{
+	uint64_t start;
+
+	log_init();
+
+	start = bench_now_ns();
+	for (int i = 0; i < RECORDS; i++)
+		log_msg("trying to update host%06d.example.com", i);
+	report("syslog", bench_now_ns() - start, 0);
+
+	if (access("/dev/log", F_OK) != 0)
+		printf("logfile: note: /dev/log is missing, so syslog(3) "
+		    "didn't deliver anything\n");
+}
+
+int
+main(void)
+{
+	if (mkdtemp(tmpdir) == NULL) {
+		perror("mkdtemp");
+		return 1;
+	}
+	(void) snprintf(log_path, sizeof log_path, "%s/duc.log", tmpdir);
+
+	run_file_sink();
+	run_write_per_record();
+	run_syslog();
+
+	(void) rmdir(tmpdir);
+	return 0;
+}
@@ -0,0 +1,536 @@
+/* Micro-benchmarks of the functions on the update path. Every function
+   is run in rounds of a calibrated number of calls, and the median
+   time per call over the rounds is reported with the allocations per
+   call.
+
+   Environment:
+     BENCH_JSON      Write the results to a file, one JSON object per
+                     line, e.g. to compare builds
+     BENCH_BASELINE  Compare with the results of an earlier run, i.e. a
+                     file written with BENCH_JSON
+     BENCH_FILTER    Only run the benchmarks whose names contain it */
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "b64_simd.h"
+#include "base64.h"
+#include "bench.h"
+#include "format.h"
+#include "interpreter.h"
+#include "json.h"
+#include "protocol.h"
+#include "settings.h"
+#include "various.h"
+#include "wrapper.h"
+
+#define ROUNDS		9
+#define ROUND_NS	20000000	/* 20 ms */
+#define BASELINE_MAX	100
+
+struct micro {
+	const char	*name;
+	void		(*run)(void);
+};
+
+struct result {
+	uint64_t	calls;		/* Per round */
+	double		ns_per_op;	/* Median */
+	double		ns_per_op_min;
+	double		allocs_per_op;
+};
+
+struct baseline {
+	char	name[64];
+	double	ns_per_op;
+};
+
+static volatile uintptr_t sink;
+
+static const char credentials[] = "joe.example:Aq9$kd8e!Lm2vP0s";
+static char encoded[100];
+
+/* The longest allowed: a username of 50 and a password of 120 */
+static char credentials_max[50 + 1 + 120 + 1];
+static char encoded_max[240];
+
+/* A body of many lines that fills the response buffer (2000 bytes) */
+static char large_response[2000];
+
+static const char *responses[] = {
+	"HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\n\r\ngood 1.2.3.4\r\n",
+	"HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\n\r\nnochg 1.2.3.4\r\n",
+	"HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\n\r\nbadauth\r\n",
+	"HTTP/1.1 500 Internal Server Error\r\n\r\n911\r\n",
+};
+
+static const char config_line[] = "hostname = \"host000001.example.com\"; "
+    "# comment";
+static const char trim_input[] = "  \t host000001.example.com \r\n";
+static const char lower_input[] = "Host000001.EXAMPLE.com";
+
+static bool
+validator(const char *id)
+{
+	return (strcmp(id, "hostname") == 0);
+}
+
+static int
+installer(const char *id, const char *arg)
+{
+	sink += (uintptr_t) id ^ (uintptr_t) arg;
+	return 0;
+}
+
+static void
+run_b64_encode(void)
+{
+	char out[100];
+
+	sink += b64_encode((const uint8_t *) credentials,
+	    sizeof credentials - 1, out, sizeof out);
+}
+
+static void
+run_b64_decode(void)
+{
+	uint8_t out[100];
+
+	sink += b64_decode(encoded, out, sizeof out);
+}
+
+static void
+run_b64_encode_max(void)
+{
+	char out[240];
+
+	sink += b64_encode((const uint8_t *) credentials_max,
+	    sizeof credentials_max - 1, out, sizeof out);
+}
+
+static void
+run_b64_encode_max_scalar(void)
+{
+	char out[240];
+
+	sink += b64_encode_isa(B64_ISA_SCALAR,
+	    (const uint8_t *) credentials_max, sizeof credentials_max - 1,
+	    out, sizeof out);
+}
+
+static void
+run_b64_decode_max(void)
+{
+	uint8_t out[240];
+
+	sink += b64_decode(encoded_max, out, sizeof out);
+}
+
+static void
+run_b64_decode_max_scalar(void)
+{
+	uint8_t out[240];
+
+	sink += b64_decode_isa(B64_ISA_SCALAR, encoded_max, out, sizeof out);
+}
+
+/*
+ * The responses take turns
+ */
+static void
+run_server_response(void)
+{
+	static size_t i = 0;
+
+	sink += server_response(responses[i++ % nitems(responses)]);
+}
+
+static void
+run_server_response_large(void)
+{
+	sink += server_response(large_response);
+}
+
+static void
+run_server_replies_large(void)
+{
+	struct server_reply replies[200];
+
+	sink += server_replies(large_response, replies, nitems(replies));
+	sink += replies[0].addr_len;
+}
+
+static void
+run_interpreter(void)
+{
+	const struct Interpreter_in in = {
+		.path           = "bench",
+		.line           = config_line,
+		.line_len       = sizeof config_line - 1,
+		.line_num       = 1,
+		.validator_func = validator,
+		.install_func   = installer,
+	};
+
+	sink += Interpreter(&in);
+}
+
+static void
+run_setting(void)
+{
+	sink += (uintptr_t) setting("log_repeat_window_seconds");
+}
+
+static void
+run_setting_integer(void)
+{
+	struct integer_context ctx = {
+		.setting_name = "update_interval_seconds",
+		.lo_limit     = 600,
+		.hi_limit     = 172800,
+		.fallback_val = 1800,
+	};
+
+	sink += setting_integer(&ctx);
+}
+
+static void
+run_strdup_printf(void)
+{
+	char *str = strdup_printf("%s:%s", "joe.example", "Aq9$kd8e!Lm2vP0s");
+
+	sink += (uintptr_t) str[0];
+	free(str);
+}
+
+static void
+run_arena_printf(void)
+{
+	static struct arena	 a;
+	char			*str;
+
+	str = arena_printf(&a, "%s:%s", "joe.example", "Aq9$kd8e!Lm2vP0s");
+	sink += (uintptr_t) str[0];
+	arena_reset(&a);
+}
+
+static int
+vasprintf_wrapper(char **ret, const char *fmt, ...)
+{
+	int	n;
+	va_list	ap;
+
+	va_start(ap, fmt);
+	n = my_vasprintf(ret, fmt, ap);
+	va_end(ap);
+	return n;
+}
+
+static void
+run_my_vasprintf(void)
+{
+	char *str = NULL;
+
+	sink += vasprintf_wrapper(&str, "GET %s?hostname=%s HTTP/1.0",
+	    "/nic/update", "host000001.example.com");
+	free(str);
+}
+
+/*
+ * my_vasprintf() as it was before the formatter: the length with
+ * vsnprintf(), then malloc() and vsnprintf() again
+ */
+static int
+twopass_vasprintf(char **ret, const char *fmt, ...)
+{
+	int	sz;
+	va_list	ap, ap_copy;
+
+	va_start(ap, fmt);
+	va_copy(ap_copy, ap);
+	sz = vsnprintf(NULL, 0, fmt, ap_copy);
+	va_end(ap_copy);
+	if (sz < 0 || (*ret = malloc(sz + 1)) == NULL) {
+		va_end(ap);
+		return -1;
+	}
+	sz = vsnprintf(*ret, sz + 1, fmt, ap);
+	va_end(ap);
+	return sz;
+}
+
+static void
+run_my_vasprintf_twopass(void)
+{
+	char *str = NULL;
+
+	sink += twopass_vasprintf(&str, "GET %s?hostname=%s HTTP/1.0",
+	    "/nic/update", "host000001.example.com");
+	free(str);
+}
+
+static void
+run_fmt_printf(void)
+{
+	char		buf[128];
+	struct fmt_buf	f;
+
+	fmt_init(&f, buf, sizeof buf, FMT_FIXED, NULL);
+	sink += fmt_printf(&f, "%s: %zu update(s), %d failed, took %llu us",
+	    "host000001.example.com", (size_t) 1234, -1, 56789ULL);
+}
+
+static void
+run_fmt_printf_fallback(void)
+{
+	char		buf[128];
+	struct fmt_buf	f;
+
+	fmt_init(&f, buf, sizeof buf, FMT_FIXED, NULL);
+	sink += fmt_printf(&f, "%s: %5zu update(s), %d failed, took %llu us",
+	    "host000001.example.com", (size_t) 1234, -1, 56789ULL);
+}
+
+static void
+run_snprintf(void)
+{
+	char buf[128];
+
+	sink += snprintf(buf, sizeof buf, "%s: %zu update(s), %d failed, "
+	    "took %llu us", "host000001.example.com", (size_t) 1234, -1,
+	    56789ULL);
+}
+
+static void
+run_trim(void)
+{
+	char buf[sizeof trim_input];
+
+	(void) memcpy(buf, trim_input, sizeof buf);
+	sink += (uintptr_t) trim(buf)[0];
+}
+
+static void
+run_strToLower(void)
+{
+	char buf[sizeof lower_input];
+
+	(void) memcpy(buf, lower_input, sizeof buf);
+	sink += (uintptr_t) strToLower(buf)[0];
+}
+
+static void
+run_update_request(void)
+{
+	static struct arena	 a;
+	char			*req;
+
+	req = update_request(&a, "host000001.example.com", "WAN_address");
+	sink += (uintptr_t) req[0];
+	arena_reset(&a);
+}
+
+static const struct micro benchmarks[] = {
+	{ "b64_encode",            run_b64_encode            },
+	{ "b64_decode",            run_b64_decode            },
+	{ "b64_encode_max",        run_b64_encode_max        },
+	{ "b64_encode_max_scalar", run_b64_encode_max_scalar },
+	{ "b64_decode_max",        run_b64_decode_max        },
+	{ "b64_decode_max_scalar", run_b64_decode_max_scalar },
+	{ "server_response",       run_server_response       },
+	{ "server_response_large", run_server_response_large },
+	{ "server_replies_large",  run_server_replies_large  },
+	{ "interpreter_line",      run_interpreter           },
+	{ "setting",               run_setting               },
+	{ "setting_integer",       run_setting_integer       },
+	{ "strdup_printf",         run_strdup_printf         },
+	{ "arena_printf",          run_arena_printf          },
+	{ "my_vasprintf",          run_my_vasprintf          },
+	{ "my_vasprintf_twopass",  run_my_vasprintf_twopass  },
+	{ "fmt_printf",            run_fmt_printf            },
+	{ "fmt_printf_fallback",   run_fmt_printf_fallback   },
+	{ "snprintf",              run_snprintf              },
+	{ "trim",                  run_trim                  },
+	{ "strToLower",            run_strToLower            },
+	{ "update_request",        run_update_request        },
+};
+
+static uint64_t
+time_calls(const struct micro *m, uint64_t calls)
+{
+	const uint64_t start = bench_now_ns();
+
+	for (uint64_t i = 0; i < calls; i++)
+		m->run();
+	return bench_now_ns() - start;
+}
+
+static int
+compare_double(const void *a, const void *b)
+{
+	const double x = *(const double *) a;
+	const double y = *(const double *) b;
+
+	return (x > y) - (x < y);
+}
+
+static void
+measure(const struct micro *m, struct result *r)
+{
+	double		ns[ROUNDS];
+	uint64_t	allocs;
+	uint64_t	calls = 1;
+	uint64_t	elapsed;
+
+	/* Warm up and find the number of calls that fill a round */
+	while ((elapsed = time_calls(m, calls)) < ROUND_NS / 10)
+		calls *= 2;
+	calls = calls * ROUND_NS / (elapsed ? elapsed : 1);
+	if (calls == 0)
+		calls = 1;
+
+	allocs = bench_allocs();
+	for (int i = 0; i < ROUNDS; i++)
+		ns[i] = (double) time_calls(m, calls) / calls;
+	allocs = bench_allocs() - allocs;
+
+	qsort(ns, ROUNDS, sizeof *ns, compare_double);
+	r->calls = calls;
+	r->ns_per_op = ns[ROUNDS / 2];
+	r->ns_per_op_min = ns[0];
+	r->allocs_per_op = (double) allocs / ((double) calls * ROUNDS);
+}
+
+static size_t
+read_baseline(const char *path, struct baseline *b, size_t max)
+{
+	FILE	*fp;
+	char	 line[1024];
+	size_t	 n = 0;
+
+	if ((fp = fopen(path, "r")) == NULL) {
+		perror(path);
+		return 0;
+	}
+	while (n < max && fgets(line, sizeof line, fp) != NULL) {
+		const char *name = strstr(line, "\"name\":\"");
+		const char *ns = strstr(line, "\"ns_per_op\":");
+
+		if (name == NULL || ns == NULL ||
+		    sscanf(name + 8, "%63[^\"]", b[n].name) != 1 ||
+		    sscanf(ns + 12, "%lf", &b[n].ns_per_op) != 1)
+			continue;
+		n++;
+	}
+	fclose(fp);
+	return n;
+}
+
+static const struct baseline *
+find_baseline(const char *name, const struct baseline *b, size_t n)
+{
+	for (size_t i = 0; i < n; i++) {
+		if (strcmp(b[i].name, name) == 0)
+			return &b[i];
+	}
+	return NULL;
+}
+
+static void
+write_json(FILE *fp, const char *name, const struct result *r)
+{
+	char			record[512];
+	struct json_writer	w;
+
+	json_init(&w, record, sizeof record);
+	json_add_string(&w, "name", name);
+	json_add_uint(&w, "calls", r->calls);
+	json_add_uint(&w, "rounds", ROUNDS);
+	json_add_double(&w, "ns_per_op", r->ns_per_op, 2);
+	json_add_double(&w, "ns_per_op_min", r->ns_per_op_min, 2);
+	if (bench_allocs_counted)
+		json_add_double(&w, "allocs_per_op", r->allocs_per_op, 2);
+	(void) json_finish(&w);
+	fprintf(fp, "%s\n", record);
+}
+
+int
+main(void)
+{
+	FILE			*json = NULL;
+	const char		*filter = getenv("BENCH_FILTER");
+	const char		*json_path = getenv("BENCH_JSON");
+	const char		*baseline_path = getenv("BENCH_BASELINE");
+	size_t			 n_baseline = 0;
+	static struct baseline	 baseline[BASELINE_MAX];
+	static const char	*lines[] = {
+		"good 192.0.2.1\r\n", "NOCHG 192.0.2.2\r\n", "nohost\r\n",
+		"badauth\r\n", "!donator\r\n", "911\r\n",
+	};
+
+	(void) strlcpy(large_response, "HTTP/1.1 200 OK\r\n"
+	    "Content-Type: text/plain\r\n\r\n", sizeof large_response);
+	for (size_t i = 0, len = strlen(large_response); len +
+	    strlen(lines[i % nitems(lines)]) < sizeof large_response; i++) {
+		len = strlcat(large_response, lines[i % nitems(lines)],
+		    sizeof large_response);
+	}
+	for (size_t i = 0; i < sizeof credentials_max - 1; i++)
+		credentials_max[i] = (i == 50 ? ':' : 'a' + i % 26);
+	if (b64_encode((const uint8_t *) credentials_max,
+	    sizeof credentials_max - 1, encoded_max, sizeof encoded_max) < 0 ||
+	    install_setting("username", "joe.example") != 0 ||
+	    install_setting("password", "Aq9$kd8e!Lm2vP0s") != 0 ||
+	    install_setting("update_interval_seconds", "3600") != 0 ||
+	    b64_encode((const uint8_t *) credentials, sizeof credentials - 1,
+	    encoded, sizeof encoded) < 0) {
+		fprintf(stderr, "micro: setup failed\n");
+		return 1;
+	}
+	if (json_path && (json = fopen(json_path, "w")) == NULL) {
+		perror(json_path);
+		return 1;
+	}
+	if (baseline_path) {
+		n_baseline = read_baseline(baseline_path, baseline,
+		    nitems(baseline));
+	}
+
+	printf("micro: %-22s %12s %12s %10s%s\n", "benchmark", "ns/op",
+	    "min ns/op", "allocs/op", (n_baseline ? "   vs. baseline" : ""));
+
+	for (const struct micro *m = &benchmarks[0];
+	     m < &benchmarks[nitems(benchmarks)]; m++) {
+		const struct baseline	*b;
+		struct result		 r;
+
+		if (filter && strstr(m->name, filter) == NULL)
+			continue;
+
+		measure(m, &r);
+		printf("micro: %-22s %12.2f %12.2f", m->name, r.ns_per_op,
+		    r.ns_per_op_min);
+		if (bench_allocs_counted)
+			printf(" %10.2f", r.allocs_per_op);
+		else
+			printf(" %10s", "n/a");
+		if ((b = find_baseline(m->name, baseline, n_baseline)) != NULL &&
+		    b->ns_per_op > 0) {
+			printf("   %+8.1f%%", (r.ns_per_op - b->ns_per_op) /
+			    b->ns_per_op * 100);
+		}
+		printf("\n");
+
+		if (json)
+			write_json(json, m->name, &r);
+	}
+
+	if (json)
+		fclose(json);
+	destroy_config_custom_values();
+	return 0;
+}
@@ -0,0 +1,412 @@
+/* Pathological inputs for the parsers of untrusted input: the
+   responses of the service provider and the IP lookup servers, config
+   files and base64. Every input is grown from 8 KiB to 1 MiB, and the
+   time per byte must stay about the same, i.e. the time must be linear
+   in the size of the input. Every call must also finish within a
+   budget.
+
+   The inputs are generated, e.g. very long lines, thousands of
+   carriage returns, huge headers and deep whitespace, and read from a
+   corpus: a directory of files that each holds one input, as for
+   libFuzzer. The content of a corpus file is repeated up to the size.
+   A config file input is written to a temporary file and read by
+   Interpreter_processAllLines(), and only the corpus files whose names
+   begin with "config-" are config files.
+
+   Environment:
+     BENCH_CORPUS     The corpus directory. Default: corpus
+     BENCH_BUDGET_MS  The time budget of a call. Default: 250
+     BENCH_FILTER     Only run the parsers whose names contain it */
+
+#include <sys/time.h>
+
+#include <dirent.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "base64.h"
+#include "bench.h"
+#include "interpreter.h"
+#include "protocol.h"
+#include "various.h"
+
+#define SIZE_MIN	(8 * 1024)
+#define SIZE_MAX_	(1024 * 1024)
+#define REPS		3
+#define SLACK		8.0	/* Allowed growth of the time per byte */
+#define CORPUS_MAX	100
+
+struct input {
+	char		 name[300];
+	const char	*file;		/* The name of a corpus file */
+	const char	*prefix;
+	const char	*unit;		/* Repeated up to the size */
+	size_t		 unit_len;
+	const char	*suffix;
+};
+
+struct parser {
+	const char		*name;
+	void			(*parse)(char *, size_t);
+	void			(*prepare)(const char *, size_t); /* Untimed */
+	const struct input	*inputs;
+	size_t			 n_inputs;
+	const char		*corpus_prefix;
+};
+
+static volatile uintptr_t sink;
+static uint8_t *b64_target;
+
+static char	config_dir[] = "/tmp/parsers.XXXXXX";
+static char	config_path[sizeof config_dir + 20];
+static int	stderr_fd = STDERR_FILENO;
+
+static bool
+validator(const char *id)
+{
+	(void) id;
+	return true;
+}
+
+static int
+installer(const char *id, const char *arg)
+{
+	sink += (uintptr_t) id ^ (uintptr_t) arg;
+	return 0;
+}
+
+static void
+parse_server_response(char *buf, size_t len)
+{
+	(void) len;
+	sink += server_response(buf);
+}
+
+static void
+parse_server_replies(char *buf, size_t len)
+{
+	struct server_reply replies[16];
+
+	(void) len;
+	sink += server_replies(buf, replies, nitems(replies));
+}
+
+static void
+parse_lookup_response(char *buf, size_t len)
+{
+	const char *reason = "";
+
+	(void) len;
+	sink += (uintptr_t) lookup_response(buf, &reason);
+}
+
+static void
+write_config(const char *buf, size_t len)
+{
+	FILE *fp;
+
+	if ((fp = fopen(config_path, "w")) == NULL ||
+	    fwrite(buf, 1, len, fp) != len || fclose(fp) != 0) {
+		perror(config_path);
+		_exit(1);
+	}
+}
+
+/*
+ * The errors are reported on stderr, together with the statement,
+ * which is silenced
+ */
+static void
+parse_config_file(char *buf, size_t len)
+{
+	(void) buf;
+	(void) len;
+	sink += Interpreter_processAllLines(config_path, validator, installer,
+	    NULL);
+}
+
+static void
+parse_b64_decode(char *buf, size_t len)
+{
+	sink += b64_decode(buf, b64_target, len);
+}
+
+#define GENERATED(name, prefix, unit, suffix)\
+	{ name, NULL, prefix, unit, sizeof unit - 1, suffix }
+
+static const struct input inputs[] = {
+	GENERATED("long_line", "HTTP/1.0 200 OK\r\n\r\ngood ", "x", ""),
+	GENERATED("carriage_returns", "", "\r", "good 1.2.3.4"),
+	GENERATED("newlines", "", "\n", ""),
+	GENERATED("many_headers", "HTTP/1.0 200 OK\r\n", "X-Mock: value\r\n",
+	    "\r\ngood 1.2.3.4\r\n"),
+	GENERATED("many_replies", "HTTP/1.0 200 OK\r\n\r\n",
+	    "good 192.0.2.1\r\nNOHOST\r\n", ""),
+	GENERATED("huge_header", "HTTP/1.0 200 OK\r\nX-Mock: ", "a",
+	    "\r\n\r\ngood 1.2.3.4\r\n"),
+	GENERATED("trailing_whitespace", "good 1.2.3.4", " \t", ""),
+	GENERATED("base64", "", "QUJD", "=="),
+	GENERATED("base64_whitespace", "", "QU JD\r\n", ""),
+};
+
+static const struct input config_inputs[] = {
+	GENERATED("huge_identifier", "", "a", " = \"x\";\n"),
+	GENERATED("long_argument", "hostname = \"", "a.example.com|",
+	    "\";\n"),
+	GENERATED("continued_argument", "hostname = \"",
+	    "a.example.com|\\\n", "b\";\n"),
+	GENERATED("continued_whitespace", "hostname = \"a", " \t\\\n\t",
+	    "b\";\n"),
+	GENERATED("whitespace_before_eq", "hostname", " \t",
+	    "= \"a.example.com\";\n"),
+	GENERATED("leading_whitespace", "", " \t",
+	    "hostname = \"a.example.com\";\n"),
+	GENERATED("backslashes", "password = \"", "\\\\", "\";\n"),
+	GENERATED("unterminated_quote", "password = \"", "abc", "\n"),
+	GENERATED("unterminated_continued", "password = \"", "abc \\\n",
+	    "\n"),
+	GENERATED("comments_continued", "", "# C:\\\n",
+	    "username = \"a\";\n"),
+	GENERATED("many_statements", "", "username = \"a\"; # comment\n",
+	    ""),
+	GENERATED("many_includes", "", "include \"conf.d/*.conf\";\n", ""),
+};
+
+#define INPUTS(table) table, nitems(table)
+
+static const struct parser parsers[] = {
+	{ "server_response", parse_server_response, NULL, INPUTS(inputs),
+	  "" },
+	{ "server_replies", parse_server_replies, NULL, INPUTS(inputs), "" },
+	{ "lookup_response", parse_lookup_response, NULL, INPUTS(inputs),
+	  "" },
+	{ "processAllLines", parse_config_file, write_config,
+	  INPUTS(config_inputs), "config-" },
+	{ "b64_decode", parse_b64_decode, NULL, INPUTS(inputs), "" },
+};
+
+static struct input	corpus[CORPUS_MAX];
+static size_t		corpus_count = 0;
+
+static const char	*current = "";
+static unsigned int	 budget_ms = 250;
+
+static void
+over_budget(int signum)
+{
+	static const char msg[] = "parsers: a call took longer than "
+	    "BENCH_BUDGET_MS: ";
+
+	(void) signum;
+	(void) write(stderr_fd, msg, sizeof msg - 1);
+	(void) write(stderr_fd, current, strlen(current));
+	(void) write(stderr_fd, "\n", 1);
+	_exit(1);
+}
+
+static void
+arm(unsigned int ms)
+{
+	struct itimerval it = { { 0, 0 }, { 0, 0 } };
+
+	it.it_value.tv_sec = ms / 1000;
+	it.it_value.tv_usec = (ms % 1000) * 1000;
+	(void) setitimer(ITIMER_REAL, &it, NULL);
+}
+
+/*
+ * Read the files of the corpus directory, sorted by name
+ */
+static void
+read_corpus(const char *dir)
+{
+	FILE		 *fp;
+	char		  path[512];
+	char		 *data;
+	int		  n;
+	long		  size;
+	struct dirent	**names;
+
+	if ((n = scandir(dir, &names, NULL, alphasort)) < 0)
+		return;
+	for (int i = 0; i < n; i++) {
+		struct input *in = &corpus[corpus_count];
+
+		if (names[i]->d_name[0] == '.' || corpus_count >= CORPUS_MAX)
+			goto next;
+		(void) snprintf(path, sizeof path, "%s/%s", dir,
+		    names[i]->d_name);
+		if ((fp = fopen(path, "rb")) == NULL)
+			goto next;
+		if (fseek(fp, 0, SEEK_END) != 0 || (size = ftell(fp)) <= 0 ||
+		    size > SIZE_MIN || fseek(fp, 0, SEEK_SET) != 0 ||
+		    (data = malloc(size)) == NULL) {
+			(void) fclose(fp);
+			goto next;
+		}
+		if (fread(data, 1, size, fp) == (size_t) size) {
+			(void) snprintf(in->name, sizeof in->name, "corpus/%s",
+			    names[i]->d_name);
+			in->file = &in->name[strlen("corpus/")];
+			in->prefix = in->suffix = "";
+			in->unit = data;
+			in->unit_len = size;
+			corpus_count++;
+		} else {
+			free(data);
+		}
+		(void) fclose(fp);
+	  next:
+		free(names[i]);
+	}
+	free(names);
+}
+
+/*
+ * Build an input of about 'size' bytes. It is null-terminated.
+ */
+static size_t
+build(const struct input *in, char *buf, size_t size)
+{
+	const size_t	prefix_len = strlen(in->prefix);
+	const size_t	suffix_len = strlen(in->suffix);
+	size_t		len = prefix_len;
+
+	(void) memcpy(buf, in->prefix, prefix_len);
+	while (len + in->unit_len + suffix_len <= size) {
+		(void) memcpy(&buf[len], in->unit, in->unit_len);
+		len += in->unit_len;
+	}
+	(void) memcpy(&buf[len], in->suffix, suffix_len);
+	len += suffix_len;
+	buf[len] = '\0';
+	return len;
+}
+
+/*
+ * The shortest time of 'REPS' calls on a fresh copy of the input. The
+ * input is prepared, if the parser needs it, before the timing.
+ */
+static uint64_t
+time_parse(const struct parser *p, const char *input, char *work,
+	   size_t len)
+{
+	uint64_t best = UINT64_MAX;
+
+	for (int rep = 0; rep < REPS; rep++) {
+		uint64_t start, ns;
+
+		(void) memcpy(work, input, len + 1);
+		if (p->prepare != NULL)
+			p->prepare(work, len);
+		arm(budget_ms);
+		start = bench_now_ns();
+		p->parse(work, len);
+		ns = bench_now_ns() - start;
+		arm(0);
+		if (ns < best)
+			best = ns;
+	}
+	return (best > 0 ? best : 1);
+}
+
+/*
+ * Grow an input and check that the time per byte stays about the same
+ */
+static bool
+run(const struct parser *p, const struct input *in, char *input,
+    char *work)
+{
+	char		name[400];
+	double		first_ns_per_byte = 0.0;
+	double		ns_per_byte = 0.0;
+	uint64_t	max_ns = 0;
+
+	(void) snprintf(name, sizeof name, "%s %s", p->name, in->name);
+	current = name;
+
+	for (size_t size = SIZE_MIN; size <= SIZE_MAX_; size *= 2) {
+		const size_t	len = build(in, input, size);
+		const uint64_t	ns = time_parse(p, input, work, len);
+
+		ns_per_byte = (double) ns / len;
+		if (size == SIZE_MIN)
+			first_ns_per_byte = ns_per_byte;
+		if (ns > max_ns)
+			max_ns = ns;
+	}
+
+	const double growth = ns_per_byte / first_ns_per_byte;
+	const bool ok = (growth <= SLACK);
+
+	printf("parsers: %-15s %-26s %6.2f -> %6.2f ns/B  x%-5.1f "
+	    "max %7.3f ms  %s\n", p->name, in->name, first_ns_per_byte,
+	    ns_per_byte, growth, max_ns / 1e6, (ok ? "ok" : "NOT LINEAR"));
+	return ok;
+}
+
+int
+main(void)
+{
+	char		*input, *work;
+	const char	*corpus_dir = getenv("BENCH_CORPUS");
+	const char	*filter = getenv("BENCH_FILTER");
+	const char	*cp;
+	size_t		 failed = 0, runs = 0;
+
+	if ((cp = getenv("BENCH_BUDGET_MS")) != NULL && atoi(cp) > 0)
+		budget_ms = (unsigned int) atoi(cp);
+	read_corpus(corpus_dir ? corpus_dir : "corpus");
+
+	if ((input = malloc(SIZE_MAX_ + 1)) == NULL ||
+	    (work = malloc(SIZE_MAX_ + 1)) == NULL ||
+	    (b64_target = malloc(SIZE_MAX_ + 1)) == NULL) {
+		perror("parsers");
+		return 1;
+	}
+	if (mkdtemp(config_dir) == NULL) {
+		perror("parsers: mkdtemp");
+		return 1;
+	}
+	(void) snprintf(config_path, sizeof config_path, "%s/bench.conf",
+	    config_dir);
+	(void) signal(SIGALRM, over_budget);
+
+	/* Silence the errors of the parsers */
+	if ((stderr_fd = dup(STDERR_FILENO)) == -1 ||
+	    freopen("/dev/null", "w", stderr) == NULL) {
+		perror("parsers: /dev/null");
+		return 1;
+	}
+
+	for (const struct parser *p = &parsers[0];
+	     p < &parsers[nitems(parsers)]; p++) {
+		if (filter && strstr(p->name, filter) == NULL)
+			continue;
+		for (size_t i = 0; i < p->n_inputs; i++, runs++) {
+			if (!run(p, &p->inputs[i], input, work))
+				failed++;
+		}
+		for (size_t i = 0; i < corpus_count; i++) {
+			if (strncmp(corpus[i].file, p->corpus_prefix,
+			    strlen(p->corpus_prefix)) != 0)
+				continue;
+			if (!run(p, &corpus[i], input, work))
+				failed++;
+			runs++;
+		}
+	}
+
+	printf("parsers: %zu input(s), %zu not linear, budget %u ms per "
+	    "call\n", runs, failed, budget_ms);
+	(void) unlink(config_path);
+	(void) rmdir(config_dir);
+	free(input);
+	free(work);
+	free(b64_target);
+	return (failed > 0 ? 1 : 0);
+}
@@ -28,8 +28,10 @@
 
 #ifdef __unix__
 #define PRINTFLIKE(arg_no) __attribute__((format(printf, arg_no, arg_no + 1)))
+#define VPRINTFLIKE(arg_no) __attribute__((format(printf, arg_no, 0)))
 #else
 #define PRINTFLIKE(arg_no)
+#define VPRINTFLIKE(arg_no)
 #endif
 
 #ifdef __unix__
@@ -0,0 +1,3 @@
+#define HAVE_STRLCPY 0
+#define HAVE_STRLCAT 0
+#define HAVE_X509_CHECK_HOST 1
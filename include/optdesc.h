@@ -39,6 +39,9 @@ static const char UPDATE_INTERVAL_SECONDS_DESC[] =
   "Update interval in seconds. If a value less than 600 is entered, the\n"
   "program will fallback to 1800 in order to avoid flooding the server with\n"
   "requests.";
+static const char UPDATE_WORKERS_DESC[] =
+  "The number of hosts that are updated at the same time, each over a\n"
+  "connection of its own. (1-32.)";
 
 static const char PRIMARY_IP_LOOKUP_SRV_DESC[] =
   "Server used to determine your external IP.";
@@ -51,4 +54,22 @@ static const char FORCE_UPDATE_DESC[] =
   "force update. This setting should be set to YES if 'ip_addr' not equals\n"
   "to 'WAN_address'.";
 
+static const char LOG_REPEAT_WINDOW_SECONDS_DESC[] =
+  "A warning that is repeated within this number of seconds is only logged\n"
+  "once, followed by a summary of how many times it was repeated. 0 logs\n"
+  "every repeat.";
+
+static const char TLS_CA_FILE_DESC[] =
+  "A file of trusted CA certificates in PEM format. If it or 'tls_ca_dir' is\n"
+  "set, the service provider is verified against them instead of the trust\n"
+  "store of the system. (Empty = not set.)";
+static const char TLS_CA_DIR_DESC[] =
+  "A directory of trusted CA certificates named by the hash of their subject,\n"
+  "as created by 'openssl rehash'. (Empty = not set.)";
+static const char TLS_SPKI_PINS_DESC[] =
+  "The base64 encoded SHA-256 hashes of the public keys (SPKI) that are\n"
+  "trusted. A certificate of the chain of the service provider must match\n"
+  "one of them. (Multiple pins are separated with a vertical bar. Empty = no\n"
+  "pinning.)";
+
 #endif
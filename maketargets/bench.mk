@@ -0,0 +1,4 @@
+# The 'bench' target
+
+bench: $(INCLUDE_DIR)funcs-yesno.h $(OBJS)
+	$(MAKE) -Cbench
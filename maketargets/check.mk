@@ -2,7 +2,12 @@
 
 include tests/recompile.mk
 
-check: $(INCLUDE_DIR)funcs-yesno.h $(OBJS)
+# The probes are checked in the executable before main.o is stripped.
+# USDT_PROBES tells probetest whether they're compiled in.
+check: $(INCLUDE_DIR)funcs-yesno.h $(OBJS) enhanced-duc
+	$(Q) probes=`$(CC) $(CFLAGS) -I $(INCLUDE_DIR) $(CPPFLAGS) -dM -E \
+	    $(SRC_DIR)probes.h | awk '$$2 == "USDT_PROBES" { print $$3 }'` &&\
+	    cd tests && USDT_PROBES=$$probes ./probetest
 	$(RM) $(RECOMPILE)
 	$(Q) strip --strip-symbol=main $(SRC_DIR)main.o
 	$(MAKE) -Ctests
@@ -4,4 +4,6 @@ clean:
 	$(E) "  CLEAN"
 	$(RM) $(OBJS)
 	$(RM) $(TGTS)
+	$(MAKE) -Cbench clean
+	$(MAKE) -Cmock clean
 	$(MAKE) -Ctests clean
@@ -0,0 +1,4 @@
+# The 'mock' target
+
+mock: enhanced-duc
+	$(MAKE) -Cmock
@@ -0,0 +1,558 @@
+/* Copyright (c) 2026 Markus Uhlin <markus.uhlin@icloud.com>
+   All rights reserved.
+
+   Permission to use, copy, modify, and distribute this software for any
+   purpose with or without fee is hereby granted, provided that the above
+   copyright notice and this permission notice appear in all copies.
+
+   THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+   WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+   AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+   DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR
+   PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+   TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+   PERFORMANCE OF THIS SOFTWARE. */
+
+/*
+ * A load harness. It generates the config files of a fleet of hosts
+ * spread over a number of accounts, runs one enhanced duc process per
+ * account against the mock server, and reports the throughput, the
+ * latency percentiles and the resources used as a JSON object.
+ */
+
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "json.h"
+#include "logfile.h"
+
+#define DUC	"../enhanced-duc"
+#define MOCK	"./mockserver"
+
+static struct {
+	long		 hosts;
+	long		 accounts;
+	long		 cycles;
+	const char	*delay;
+	const char	*port;
+	const char	*out;
+	const char	*certs;
+	const char	*include;
+} opts = {
+	.hosts		= 10000,
+	.accounts	= 1,
+	.cycles		= 1,
+	.delay		= "0",
+	.port		= "8245",
+	.out		= NULL,
+	.certs		= NULL,
+	.include	= NULL,
+};
+
+/*
+ * A growing array of samples in microseconds
+ */
+struct samples {
+	uint64_t	*v;
+	size_t		 count;
+	size_t		 size;
+};
+
+static struct {
+	struct samples	update_us;
+	struct samples	cycle_us;
+	unsigned long	updates_ok;
+	unsigned long	failed_runs;
+	struct timeval	utime;
+	struct timeval	stime;
+	long		maxrss_kb;
+	unsigned long	vcsw;
+	unsigned long	ivcsw;
+	unsigned long	syscr;
+	unsigned long	syscw;
+	bool		have_io;
+	uint64_t	wall_us;
+} res;
+
+static char tmpdir[] = "/tmp/fleet.XXXXXX";
+
+static void
+die(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	(void) fputs("fleet: ", stderr);
+	(void) vfprintf(stderr, fmt, ap);
+	(void) fputc('\n', stderr);
+	va_end(ap);
+	exit(1);
+}
+
+static void
+usage(void)
+{
+	(void) fputs("usage: fleet [-H hosts] [-A accounts] [-c cycles] "
+	    "[-d delay] [-p port]\n"
+	    "             [-o output] [-T certdir] [-i include]\n", stderr);
+	exit(1);
+}
+
+static long
+number(const char *str, long lo, long hi)
+{
+	char	*ep;
+	long	 val;
+
+	errno = 0;
+	val = strtol(str, &ep, 10);
+	if (ep == str || *ep != '\0' || errno || val < lo || val > hi)
+		die("bogus number: \"%s\"", str);
+	return val;
+}
+
+static uint64_t
+now_us(void)
+{
+	struct timespec ts;
+
+	(void) clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void
+samples_add(struct samples *s, uint64_t value)
+{
+	if (s->count == s->size) {
+		s->size = (s->size ? s->size * 2 : 1024);
+		if ((s->v = realloc(s->v, s->size * sizeof *s->v)) == NULL)
+			die("out of memory");
+	}
+	s->v[s->count++] = value;
+}
+
+static int
+compare_u64(const void *a, const void *b)
+{
+	const uint64_t x = *(const uint64_t *) a;
+	const uint64_t y = *(const uint64_t *) b;
+
+	return (x > y) - (x < y);
+}
+
+/*
+ * The nearest-rank percentile of sorted samples
+ */
+static uint64_t
+percentile(const struct samples *s, double q)
+{
+	size_t rank;
+
+	if (s->count == 0)
+		return 0;
+	rank = (size_t) (q * s->count + 0.999999);
+	return s->v[(rank > 0 ? rank - 1 : 0)];
+}
+
+static char *
+path(const char *fmt, ...)
+{
+	static char	buf[4][256];
+	static int	next = 0;
+	char		*p = buf[next++ % 4];
+	int		 len;
+	va_list		 ap;
+
+	len = snprintf(p, sizeof buf[0], "%s/", tmpdir);
+	va_start(ap, fmt);
+	(void) vsnprintf(&p[len], sizeof buf[0] - len, fmt, ap);
+	va_end(ap);
+	return p;
+}
+
+/*
+ * Write the config file of an account. The hosts are spread over the
+ * accounts as evenly as possible.
+ */
+static void
+write_config(long account)
+{
+	FILE		*fp;
+	const long	 first = opts.hosts * account / opts.accounts;
+	const long	 last = opts.hosts * (account + 1) / opts.accounts;
+
+	if ((fp = fopen(path("account%ld.conf", account), "w")) == NULL)
+		die("%s: %s", path("account%ld.conf", account),
+		    strerror(errno));
+
+	(void) fprintf(fp, "username = \"user%ld\";\n", account);
+	(void) fprintf(fp, "password = \"pass%ld\";\n", account);
+	(void) fputs("hostname = \"", fp);
+	for (long i = first; i < last; i++) {
+		(void) fprintf(fp, "%sh%ld.a%ld.example.com",
+		    (i > first ? "|" : ""), i, account);
+	}
+	(void) fputs("\";\n", fp);
+	(void) fprintf(fp, "ip_addr = \"WAN_address\";\n"
+	    "sp_hostname = \"localhost\";\n"
+	    "port = \"%s\";\n"
+	    "update_interval_seconds = \"3600\";\n"
+	    "primary_ip_lookup_srv = \"localhost\";\n"
+	    "backup_ip_lookup_srv = \"localhost\";\n"
+	    "force_update = \"YES\";\n"
+	    "log_repeat_window_seconds = \"0\";\n", opts.port);
+	if (opts.include)
+		(void) fprintf(fp, "include \"%s\";\n", opts.include);
+
+	if (fclose(fp) != 0)
+		die("write error");
+}
+
+static pid_t
+spawn(char *const argv[])
+{
+	int	fd;
+	pid_t	pid;
+
+	if ((pid = fork()) == -1)
+		die("fork: %s", strerror(errno));
+	if (pid == 0) {
+		if ((fd = open("/dev/null", O_RDWR)) != -1) {
+			(void) dup2(fd, STDOUT_FILENO);
+			(void) dup2(fd, STDERR_FILENO);
+		}
+		(void) execv(argv[0], argv);
+		_exit(127);
+	}
+	return pid;
+}
+
+static pid_t
+start_mock(void)
+{
+	FILE		*fp;
+	char		 cert[300], key[300];
+	char		*argv[] = { MOCK, "-p", (char *) opts.port, "-d",
+			    (char *) opts.delay, "-l", path("mock.log"), "-w",
+			    path("mock.pid"), "-c", cert, "-k", key, NULL };
+	int		 status;
+	long		 pid = -1;
+
+	/* Over TLS with the certificate of a test CA */
+	if (opts.certs) {
+		argv[1] = "-t";
+		(void) snprintf(cert, sizeof cert, "%s/server.crt", opts.certs);
+		(void) snprintf(key, sizeof key, "%s/server.key", opts.certs);
+	} else {
+		argv[9] = NULL;
+	}
+
+	if (waitpid(spawn(argv), &status, 0) == -1 || !WIFEXITED(status) ||
+	    WEXITSTATUS(status) != 0)
+		die("cannot start %s", MOCK);
+	if ((fp = fopen(path("mock.pid"), "r")) == NULL ||
+	    fscanf(fp, "%ld", &pid) != 1)
+		die("no mock.pid");
+	(void) fclose(fp);
+	return (pid_t) pid;
+}
+
+/*
+ * Read the number of read and write system calls of a process that
+ * has exited but hasn't been waited for. Linux only.
+ */
+static void
+add_io_counts(pid_t pid)
+{
+	FILE		*fp;
+	char		 line[100];
+	char		 proc[64];
+	unsigned long	 n;
+
+	(void) snprintf(proc, sizeof proc, "/proc/%ld/io", (long) pid);
+	if ((fp = fopen(proc, "r")) == NULL)
+		return;
+	while (fgets(line, sizeof line, fp)) {
+		if (sscanf(line, "syscr: %lu", &n) == 1)
+			res.syscr += n;
+		else if (sscanf(line, "syscw: %lu", &n) == 1)
+			res.syscw += n;
+	}
+	res.have_io = true;
+	(void) fclose(fp);
+}
+
+static void
+add_rusage(const struct rusage *ru)
+{
+	timeradd(&res.utime, &ru->ru_utime, &res.utime);
+	timeradd(&res.stime, &ru->ru_stime, &res.stime);
+	if (ru->ru_maxrss > res.maxrss_kb)
+		res.maxrss_kb = ru->ru_maxrss;
+	res.vcsw += ru->ru_nvcsw;
+	res.ivcsw += ru->ru_nivcsw;
+}
+
+static uint64_t
+json_number(const char *line, const char *key)
+{
+	const char *cp;
+
+	if ((cp = strstr(line, key)) == NULL)
+		return 0;
+	return strtoull(cp + strlen(key), NULL, 10);
+}
+
+static void
+read_log(const char *log, uint64_t *first, uint64_t *last)
+{
+	FILE	*fp;
+	char	*line = NULL;
+	size_t	 size = 0;
+
+	if ((fp = fopen(log, "r")) == NULL)
+		return;
+	while (getline(&line, &size, fp) > 0) {
+		uint64_t time_us, total_us;
+
+		if (strstr(line, "\"event\":\"update\"") == NULL)
+			continue;
+		time_us = json_number(line, "\"time_us\":");
+		total_us = json_number(line, "\"total_us\":");
+		samples_add(&res.update_us, total_us);
+		if (strstr(line, "\"ok\":true"))
+			res.updates_ok++;
+		if (*first == 0)
+			*first = time_us - total_us;
+		*last = time_us;
+	}
+	free(line);
+	(void) fclose(fp);
+}
+
+/*
+ * Collect the update records of a run, from the oldest rotated log
+ * file to the log file. Its cycle lasted from the start of the first
+ * update to the end of the last.
+ */
+static void
+read_logs(const char *log)
+{
+	char		rotated[300];
+	uint64_t	first = 0, last = 0;
+
+	for (int i = LOGFILE_KEEP; i > 0; i--) {
+		(void) snprintf(rotated, sizeof rotated, "%s.%d", log, i);
+		read_log(rotated, &first, &last);
+	}
+	read_log(log, &first, &last);
+	if (first != 0)
+		samples_add(&res.cycle_us, last - first);
+}
+
+static void
+run_cycle(long cycle)
+{
+	pid_t			*pids;
+	const uint64_t		 start = now_us();
+
+	if ((pids = calloc(opts.accounts, sizeof *pids)) == NULL)
+		die("out of memory");
+
+	for (long i = 0; i < opts.accounts; i++) {
+		char *argv[] = { DUC, "-o", "-j", "-l",
+			path("account%ld.cycle%ld.log", i, cycle), "-x",
+			path("account%ld.conf", i), NULL };
+
+		pids[i] = spawn(argv);
+	}
+
+	for (long i = 0; i < opts.accounts; i++) {
+		int		status;
+		siginfo_t	si;
+		struct rusage	ru;
+
+		if (waitid(P_PID, pids[i], &si, WEXITED | WNOWAIT) == 0)
+			add_io_counts(pids[i]);
+		if (wait4(pids[i], &status, 0, &ru) == -1)
+			die("wait4: %s", strerror(errno));
+		add_rusage(&ru);
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+			res.failed_runs++;
+	}
+
+	res.wall_us += now_us() - start;
+	for (long i = 0; i < opts.accounts; i++)
+		read_logs(path("account%ld.cycle%ld.log", i, cycle));
+	free(pids);
+}
+
+static unsigned long
+count_requests(void)
+{
+	FILE		*fp;
+	char		 line[1024];
+	unsigned long	 n = 0;
+
+	if ((fp = fopen(path("mock.log"), "r")) == NULL)
+		return 0;
+	while (fgets(line, sizeof line, fp)) {
+		if (strstr(line, " update "))
+			n++;
+	}
+	(void) fclose(fp);
+	return n;
+}
+
+static void
+remove_tmpdir(void)
+{
+	char *argv[] = { "/bin/rm", "-rf", tmpdir, NULL };
+
+	(void) waitpid(spawn(argv), NULL, 0);
+}
+
+static double
+seconds(const struct timeval *tv)
+{
+	return tv->tv_sec + tv->tv_usec / 1e6;
+}
+
+static void
+add_percentiles(struct json_writer *w, const char *name,
+		struct samples *s)
+{
+	char key[64];
+	static const struct {
+		const char	*suffix;
+		double		 q;
+	} ps[] = {
+		{ "p50",  0.5   },
+		{ "p99",  0.99  },
+		{ "p999", 0.999 },
+		{ "max",  1.0   },
+	};
+
+	qsort(s->v, s->count, sizeof *s->v, compare_u64);
+	for (size_t i = 0; i < sizeof ps / sizeof ps[0]; i++) {
+		(void) snprintf(key, sizeof key, "%s_%s_us", name,
+		    ps[i].suffix);
+		json_add_uint(w, key, percentile(s, ps[i].q));
+	}
+}
+
+static void
+report(unsigned long requests)
+{
+	FILE			*fp = stdout;
+	static char		 buf[4096];
+	struct json_writer	 w;
+
+	json_init(&w, buf, sizeof buf);
+	json_add_uint(&w, "hosts", opts.hosts);
+	json_add_uint(&w, "accounts", opts.accounts);
+	json_add_uint(&w, "cycles", opts.cycles);
+	json_add_string(&w, "delay", opts.delay);
+	json_add_uint(&w, "requests", requests);
+	json_add_uint(&w, "updates", res.update_us.count);
+	json_add_uint(&w, "updates_ok", res.updates_ok);
+	json_add_uint(&w, "failed_runs", res.failed_runs);
+	json_add_double(&w, "wall_s", res.wall_us / 1e6, 3);
+	json_add_double(&w, "updates_per_s", (res.wall_us ?
+	    res.update_us.count / (res.wall_us / 1e6) : 0), 1);
+	add_percentiles(&w, "update", &res.update_us);
+	add_percentiles(&w, "cycle", &res.cycle_us);
+	json_add_double(&w, "cpu_user_s", seconds(&res.utime), 3);
+	json_add_double(&w, "cpu_sys_s", seconds(&res.stime), 3);
+	json_add_uint(&w, "peak_rss_kb", res.maxrss_kb);
+	json_add_uint(&w, "voluntary_ctxsw", res.vcsw);
+	json_add_uint(&w, "involuntary_ctxsw", res.ivcsw);
+	if (res.have_io) {
+		json_add_uint(&w, "read_syscalls", res.syscr);
+		json_add_uint(&w, "write_syscalls", res.syscw);
+	}
+	if (!json_finish(&w))
+		die("report truncated");
+
+	if (opts.out && (fp = fopen(opts.out, "a")) == NULL)
+		die("%s: %s", opts.out, strerror(errno));
+	(void) fprintf(fp, "%s\n", buf);
+	if (fp != stdout)
+		(void) fclose(fp);
+}
+
+int
+main(int argc, char *argv[])
+{
+	int		opt;
+	pid_t		mock;
+	unsigned long	requests;
+
+	while ((opt = getopt(argc, argv, "A:H:T:c:d:i:o:p:")) != -1) {
+		switch (opt) {
+		case 'A':
+			opts.accounts = number(optarg, 1, 10000);
+			break;
+		case 'H':
+			opts.hosts = number(optarg, 1, 10000000L);
+			break;
+		case 'T':
+			opts.certs = optarg;
+			break;
+		case 'c':
+			opts.cycles = number(optarg, 1, 1000);
+			break;
+		case 'd':
+			opts.delay = optarg;
+			break;
+		case 'i':
+			opts.include = optarg;
+			break;
+		case 'o':
+			opts.out = optarg;
+			break;
+		case 'p':
+			opts.port = optarg;
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind != argc || opts.accounts > opts.hosts)
+		usage();
+	if (access(DUC, X_OK) != 0 || access(MOCK, X_OK) != 0)
+		die("run from the mock directory after building");
+
+	if (mkdtemp(tmpdir) == NULL)
+		die("mkdtemp: %s", strerror(errno));
+	/* The daemon drops root privileges before it writes its log */
+	(void) chmod(tmpdir, 0755);
+
+	for (long i = 0; i < opts.accounts; i++)
+		write_config(i);
+
+	mock = start_mock();
+	for (long cycle = 0; cycle < opts.cycles; cycle++)
+		run_cycle(cycle);
+	(void) kill(mock, SIGTERM);
+
+	requests = count_requests();
+	report(requests);
+	remove_tmpdir();
+	return (res.failed_runs > 0 ? 1 : 0);
+}
@@ -0,0 +1,110 @@
+/* Copyright (c) 2026 Markus Uhlin <markus.uhlin@icloud.com>
+   All rights reserved.
+
+   Permission to use, copy, modify, and distribute this software for any
+   purpose with or without fee is hereby granted, provided that the above
+   copyright notice and this permission notice appear in all copies.
+
+   THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+   WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+   AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+   DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR
+   PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+   TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+   PERFORMANCE OF THIS SOFTWARE. */
+
+/*
+ * Counts the malloc(), calloc(), realloc() and free() calls of a
+ * process, for the soak test, and keeps the statistics of the heap
+ * after the last call. It's preloaded with LD_PRELOAD and the counts
+ * are kept in the file named by MALLOC_COUNT_FILE, which is mapped
+ * shared, so that they can be read while the process runs. GNU C
+ * library 2.33 or later only.
+ */
+
+#include <sys/mman.h>
+
+#include <fcntl.h>
+#include <malloc.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "malloc-count.h"
+
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+extern void	*__libc_calloc(size_t, size_t);
+extern void	*__libc_malloc(size_t);
+extern void	*__libc_realloc(void *, size_t);
+extern void	 __libc_free(void *);
+
+static struct malloc_counts	  unmapped;
+static struct malloc_counts	 *counts = &unmapped;
+
+__attribute__((constructor)) static void
+map_counts(void)
+{
+	const char	*path = getenv("MALLOC_COUNT_FILE");
+	int		 fd;
+	void		*p;
+
+	if (path == NULL || (fd = open(path, O_RDWR)) == -1)
+		return;
+	p = mmap(NULL, sizeof *counts, PROT_READ | PROT_WRITE, MAP_SHARED,
+	    fd, 0);
+	(void) close(fd);
+	if (p != MAP_FAILED)
+		counts = p;
+}
+
+static void
+count(volatile uint64_t *n)
+{
+	struct mallinfo2 mi;
+
+	(void) __atomic_fetch_add(n, 1, __ATOMIC_RELAXED);
+	if (counts == &unmapped)
+		return;
+	mi = mallinfo2();
+	counts->heap_size = mi.arena;
+	counts->heap_in_use = mi.uordblks;
+	counts->heap_free = mi.fordblks;
+	counts->heap_free_chunks = mi.ordblks;
+}
+
+void *
+malloc(size_t size)
+{
+	void *p = __libc_malloc(size);
+
+	count(&counts->allocs);
+	return p;
+}
+
+void *
+calloc(size_t n, size_t size)
+{
+	void *p = __libc_calloc(n, size);
+
+	count(&counts->allocs);
+	return p;
+}
+
+void *
+realloc(void *ptr, size_t size)
+{
+	void *p = __libc_realloc(ptr, size);
+
+	count(&counts->allocs);
+	return p;
+}
+
+void
+free(void *ptr)
+{
+	__libc_free(ptr);
+	if (ptr != NULL)
+		count(&counts->frees);
+}
+#endif
@@ -0,0 +1,20 @@
+#ifndef MALLOC_COUNT_H
+#define MALLOC_COUNT_H
+
+#include <stdint.h>
+
+/*
+ * The layout of the file of malloc-count.so
+ */
+struct malloc_counts {
+	volatile uint64_t	allocs;	/* malloc(), calloc() and realloc() */
+	volatile uint64_t	frees;
+
+	/* mallinfo2() after the last call */
+	volatile uint64_t	heap_size;
+	volatile uint64_t	heap_in_use;
+	volatile uint64_t	heap_free;
+	volatile uint64_t	heap_free_chunks;
+};
+
+#endif
@@ -0,0 +1,616 @@
+/* Copyright (c) 2026 Markus Uhlin <markus.uhlin@icloud.com>
+   All rights reserved.
+
+   Permission to use, copy, modify, and distribute this software for any
+   purpose with or without fee is hereby granted, provided that the above
+   copyright notice and this permission notice appear in all copies.
+
+   THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+   WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+   AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+   DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR
+   PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+   TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+   PERFORMANCE OF THIS SOFTWARE. */
+
+/*
+ * A mock service provider and IP lookup server. It speaks the dyndns2
+ * protocol, i.e. "GET /nic/update?hostname=...", and the plain-text
+ * lookup protocol, i.e. any other request which is answered with an
+ * IP address. Both over plain HTTP and over TLS.
+ */
+
+#include <sys/socket.h>
+#include <sys/types.h>
+
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+
+#include <errno.h>
+#include <math.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define REQUEST_MAX	4096
+#define TIMEOUT_SECONDS	5
+#define UPDATE_PATH	"/nic/update"
+
+/*
+ * The answers that can be scripted. The dyndns2 codes are sent as
+ * they are, "good" and "nochg" followed by the address.
+ */
+static const char *const answers[] = {
+	"good",
+	"nochg",
+	"nohost",
+	"badauth",
+	"badagent",
+	"!donator",
+	"abuse",
+	"911",
+	"malformed",	/* Not a dyndns2 reply */
+	"reset",	/* The connection is reset instead */
+};
+
+/*
+ * The delay before answering: fixed, uniformly distributed between
+ * 'lo' and 'hi', or exponentially distributed with the mean 'lo'
+ */
+struct delay {
+	enum { DELAY_FIXED, DELAY_UNIFORM, DELAY_EXP } kind;
+	long lo;
+	long hi;
+};
+
+struct list {
+	char	**items;
+	size_t	  count;
+	size_t	  next;
+};
+
+static struct {
+	const char	*log_path;
+	struct delay	 delay;		/**< Milliseconds */
+	long		 rate;		/**< Bytes per second, 0 = unlimited */
+	unsigned long	 max_requests;	/**< 0 = unlimited */
+	struct list	 script;	/**< Answers to update requests */
+	struct list	 addrs;		/**< Answers to lookups */
+} opts;
+
+static FILE		*log_fp = NULL;
+static SSL_CTX		*ssl_ctx = NULL;
+static pthread_mutex_t	 mutex = PTHREAD_MUTEX_INITIALIZER;
+static unsigned long	 served = 0;
+
+struct conn {
+	int			fd;
+	bool			tls;
+	struct sockaddr_in	peer;
+};
+
+static void
+die(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	(void) fputs("mockserver: ", stderr);
+	(void) vfprintf(stderr, fmt, ap);
+	(void) fputc('\n', stderr);
+	va_end(ap);
+	exit(1);
+}
+
+static void
+usage(void)
+{
+	(void) fputs("usage: mockserver [-p port] [-t port -c cert -k key] "
+	    "[-r answer,...]\n"
+	    "                  [-a address,...] [-d delay] "
+	    "[-b bytes_per_second]\n"
+	    "                  [-l logfile] [-n requests] [-w pidfile]\n",
+	    stderr);
+	exit(1);
+}
+
+/*
+ * Split a comma separated list
+ */
+static void
+list_parse(struct list *list, const char *str)
+{
+	char *copy, *cp, *last;
+
+	if ((copy = strdup(str)) == NULL)
+		die("out of memory");
+	list->count = list->next = 0;
+	for (cp = strtok_r(copy, ",", &last); cp;
+	     cp = strtok_r(NULL, ",", &last)) {
+		list->items = realloc(list->items, (list->count + 1) *
+		    sizeof *list->items);
+		if (list->items == NULL)
+			die("out of memory");
+		list->items[list->count++] = cp;
+	}
+	if (list->count == 0)
+		die("empty list: \"%s\"", str);
+}
+
+/*
+ * The next item of a list. The list is repeated when it runs out.
+ */
+static const char *
+list_next(struct list *list)
+{
+	const char *item;
+
+	(void) pthread_mutex_lock(&mutex);
+	item = list->items[list->next++ % list->count];
+	(void) pthread_mutex_unlock(&mutex);
+	return item;
+}
+
+static bool
+is_answer(const char *str)
+{
+	for (size_t i = 0; i < sizeof answers / sizeof answers[0]; i++) {
+		if (strcmp(str, answers[i]) == 0)
+			return true;
+	}
+	return false;
+}
+
+static long
+number(const char *str, long lo, long hi)
+{
+	char	*ep;
+	long	 val;
+
+	errno = 0;
+	val = strtol(str, &ep, 10);
+	if (ep == str || *ep != '\0' || errno || val < lo || val > hi)
+		die("bogus number: \"%s\"", str);
+	return val;
+}
+
+/*
+ * Parse a delay: "ms", "lo-hi" or "exp:mean"
+ */
+static void
+delay_parse(struct delay *d, const char *str)
+{
+	char		 buf[64];
+	char		*cp;
+	const long	 max = 3600000L;
+
+	if (strlen(str) >= sizeof buf)
+		die("bogus delay: \"%s\"", str);
+	(void) strcpy(buf, str);
+
+	if (strncmp(buf, "exp:", 4) == 0) {
+		d->kind = DELAY_EXP;
+		d->lo = d->hi = number(&buf[4], 0, max);
+	} else if ((cp = strchr(buf, '-')) != NULL) {
+		*cp++ = '\0';
+		d->kind = DELAY_UNIFORM;
+		d->lo = number(buf, 0, max);
+		d->hi = number(cp, d->lo, max);
+	} else {
+		d->kind = DELAY_FIXED;
+		d->lo = d->hi = number(buf, 0, max);
+	}
+}
+
+static long
+delay_next(const struct delay *d)
+{
+	double r;
+
+	if (d->kind == DELAY_FIXED)
+		return d->lo;
+
+	(void) pthread_mutex_lock(&mutex);
+	r = (random() + 0.5) / 2147483648.0;
+	(void) pthread_mutex_unlock(&mutex);
+
+	if (d->kind == DELAY_UNIFORM)
+		return d->lo + (long) (r * (d->hi - d->lo + 1));
+	return (long) (-log(r) * d->lo);
+}
+
+static void
+sleep_ms(long ms)
+{
+	struct timespec ts;
+
+	ts.tv_sec = ms / 1000;
+	ts.tv_nsec = (ms % 1000) * 1000000L;
+	while (nanosleep(&ts, &ts) == -1 && errno == EINTR)
+		continue;
+}
+
+static int
+conn_read(struct conn *c, SSL *ssl, char *buf, int size)
+{
+	if (c->tls)
+		return SSL_read(ssl, buf, size);
+	return (int) read(c->fd, buf, size);
+}
+
+/*
+ * Write everything, no faster than the configured rate
+ */
+static bool
+conn_write(struct conn *c, SSL *ssl, const char *buf, size_t len)
+{
+	const size_t	chunk = (opts.rate > 0 ? (size_t) (opts.rate + 9) / 10 :
+	    len);
+	int		n;
+
+	while (len > 0) {
+		const size_t todo = (len < chunk ? len : chunk);
+
+		if (c->tls)
+			n = SSL_write(ssl, buf, (int) todo);
+		else
+			n = (int) send(c->fd, buf, todo, MSG_NOSIGNAL);
+		if (n <= 0)
+			return false;
+		buf += n;
+		len -= n;
+		if (opts.rate > 0 && len > 0)
+			sleep_ms(100);
+	}
+	return true;
+}
+
+/*
+ * Read a request, i.e. up to and including the empty line
+ */
+static bool
+read_request(struct conn *c, SSL *ssl, char *buf, size_t size)
+{
+	size_t	len = 0;
+	int	n;
+
+	buf[0] = '\0';
+	while (len < size - 1) {
+		if ((n = conn_read(c, ssl, &buf[len], (int) (size - 1 - len)))
+		    <= 0)
+			return false;
+		len += n;
+		buf[len] = '\0';
+		if (strstr(buf, "\r\n\r\n"))
+			return true;
+	}
+	return false;
+}
+
+/*
+ * Get the value of a query parameter into 'dest'
+ */
+static bool
+query_param(const char *request, const char *name, char *dest,
+	    size_t size)
+{
+	const size_t	 namelen = strlen(name);
+	const char	*cp = strchr(request, '?');
+	const char	*end = strpbrk(request, " \r\n");
+
+	while (cp && (end == NULL || cp < end)) {
+		cp++;
+		if (strncmp(cp, name, namelen) == 0 && cp[namelen] == '=') {
+			const size_t len = strcspn(&cp[namelen + 1], "& \r\n");
+
+			if (len >= size)
+				return false;
+			(void) memcpy(dest, &cp[namelen + 1], len);
+			dest[len] = '\0';
+			return true;
+		}
+		cp = strchr(cp, '&');
+	}
+	return false;
+}
+
+static void
+log_request(const struct conn *c, const char *kind, const char *request,
+	    const char *answer)
+{
+	char		peer[INET_ADDRSTRLEN] = "?";
+	const int	linelen = (int) strcspn(request, "\r\n");
+
+	(void) inet_ntop(AF_INET, &c->peer.sin_addr, peer, sizeof peer);
+
+	(void) pthread_mutex_lock(&mutex);
+	(void) fprintf(log_fp, "%lu %s %s %s \"%.*s\" %s%s\n", ++served,
+	    peer, (c->tls ? "tls" : "http"), kind, linelen, request, answer,
+	    (strstr(request, "\r\nAuthorization: Basic ") ? "" : " noauth"));
+	(void) fflush(log_fp);
+	(void) pthread_mutex_unlock(&mutex);
+}
+
+static void
+reset(int fd)
+{
+	struct linger l = { .l_onoff = 1, .l_linger = 0 };
+
+	(void) setsockopt(fd, SOL_SOCKET, SO_LINGER, &l, sizeof l);
+}
+
+/*
+ * Serve a request. Returns false if the connection was reset.
+ */
+static bool
+serve(struct conn *c, SSL *ssl)
+{
+	char		 body[128] = { '\0' };
+	char		 myip[INET_ADDRSTRLEN] = { '\0' };
+	char		 reply[512] = { '\0' };
+	char		 request[REQUEST_MAX] = { '\0' };
+	const char	*answer;
+	int		 len;
+	long		 delay_ms;
+
+	if (!read_request(c, ssl, request, sizeof request)) {
+		log_request(c, "-", request, "incomplete");
+		return true;
+	}
+
+	if (strncmp(request, "GET " UPDATE_PATH, 4 + strlen(UPDATE_PATH))
+	    == 0) {
+		answer = list_next(&opts.script);
+		log_request(c, "update", request, answer);
+
+		if (!query_param(request, "myip", myip, sizeof myip))
+			(void) inet_ntop(AF_INET, &c->peer.sin_addr, myip,
+			    sizeof myip);
+		if (strcmp(answer, "good") == 0 ||
+		    strcmp(answer, "nochg") == 0) {
+			(void) snprintf(body, sizeof body, "%s %s", answer,
+			    myip);
+		} else if (strcmp(answer, "malformed") == 0) {
+			(void) strcpy(body, "<html>\x01\x7f mock reply</html>");
+		} else {
+			(void) snprintf(body, sizeof body, "%s", answer);
+		}
+	} else {
+		answer = list_next(&opts.addrs);
+		log_request(c, "lookup", request, answer);
+		(void) snprintf(body, sizeof body, "%s", answer);
+	}
+
+	if ((delay_ms = delay_next(&opts.delay)) > 0)
+		sleep_ms(delay_ms);
+	if (strcmp(answer, "reset") == 0) {
+		reset(c->fd);
+		return false;
+	}
+
+	len = snprintf(reply, sizeof reply, "HTTP/1.0 200 OK\r\n"
+	    "Content-Type: text/plain\r\n"
+	    "Content-Length: %zu\r\n"
+	    "Connection: close\r\n"
+	    "\r\n"
+	    "%s\n", strlen(body) + 1, body);
+	(void) conn_write(c, ssl, reply, (size_t) len);
+	return true;
+}
+
+static void *
+conn_thread(void *arg)
+{
+	SSL		*ssl = NULL;
+	struct conn	*c = arg;
+	struct timeval	 tv = { .tv_sec = TIMEOUT_SECONDS };
+
+	(void) setsockopt(c->fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof tv);
+	(void) setsockopt(c->fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof tv);
+
+	if (c->tls) {
+		if ((ssl = SSL_new(ssl_ctx)) == NULL ||
+		    !SSL_set_fd(ssl, c->fd) || SSL_accept(ssl) != 1) {
+			log_request(c, "-", "", "handshake-failed");
+			goto out;
+		}
+	}
+
+	if (serve(c, ssl) && ssl)
+		(void) SSL_shutdown(ssl);
+  out:
+	if (ssl)
+		SSL_free(ssl);
+	(void) close(c->fd);
+	free(c);
+	return NULL;
+}
+
+static int
+listen_on(const char *port)
+{
+	const int		on = 1;
+	int			fd;
+	struct sockaddr_in	sin;
+
+	(void) memset(&sin, 0, sizeof sin);
+	sin.sin_family = AF_INET;
+	sin.sin_port = htons((unsigned short) number(port, 1, 65535));
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	if ((fd = socket(AF_INET, SOCK_STREAM, 0)) == -1)
+		die("socket: %s", strerror(errno));
+	(void) setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof on);
+	if (bind(fd, (struct sockaddr *) &sin, sizeof sin) == -1)
+		die("bind: port %s: %s", port, strerror(errno));
+	if (listen(fd, 128) == -1)
+		die("listen: %s", strerror(errno));
+	return fd;
+}
+
+static void
+tls_init(const char *cert, const char *key)
+{
+	if (cert == NULL || key == NULL)
+		die("TLS needs a certificate (-c) and a key (-k)");
+	if ((ssl_ctx = SSL_CTX_new(TLS_server_method())) == NULL)
+		die("SSL_CTX_new failed");
+	if (SSL_CTX_use_certificate_chain_file(ssl_ctx, cert) != 1)
+		die("%s: cannot load the certificate", cert);
+	if (SSL_CTX_use_PrivateKey_file(ssl_ctx, key, SSL_FILETYPE_PEM) != 1)
+		die("%s: cannot load the key", key);
+}
+
+/*
+ * Detach once the ports are open, so that a script can start the
+ * clients as soon as this returns
+ */
+static void
+detach(const char *pidfile)
+{
+	FILE	*fp;
+	pid_t	 pid;
+
+	if ((pid = fork()) == -1)
+		die("fork: %s", strerror(errno));
+	if (pid > 0) {
+		if ((fp = fopen(pidfile, "w")) == NULL)
+			die("%s: %s", pidfile, strerror(errno));
+		(void) fprintf(fp, "%ld\n", (long) pid);
+		(void) fclose(fp);
+		_exit(0);
+	}
+	(void) setsid();
+}
+
+int
+main(int argc, char *argv[])
+{
+	const char	*cert = NULL, *key = NULL, *pidfile = NULL;
+	const char	*plain_port = NULL, *tls_port = NULL;
+	int		 opt;
+	nfds_t		 nfds = 0;
+	pthread_attr_t	 attr;
+	struct pollfd	 pfd[2];
+
+	list_parse(&opts.script, "good");
+	list_parse(&opts.addrs, "203.0.113.1");
+
+	while ((opt = getopt(argc, argv, "a:b:c:d:k:l:n:p:r:t:w:")) != -1) {
+		switch (opt) {
+		case 'a':
+			list_parse(&opts.addrs, optarg);
+			break;
+		case 'b':
+			opts.rate = number(optarg, 1, 1000000000L);
+			break;
+		case 'c':
+			cert = optarg;
+			break;
+		case 'd':
+			delay_parse(&opts.delay, optarg);
+			break;
+		case 'k':
+			key = optarg;
+			break;
+		case 'l':
+			opts.log_path = optarg;
+			break;
+		case 'n':
+			opts.max_requests = number(optarg, 1, 1000000000L);
+			break;
+		case 'p':
+			plain_port = optarg;
+			break;
+		case 'r':
+			list_parse(&opts.script, optarg);
+			for (size_t i = 0; i < opts.script.count; i++) {
+				if (!is_answer(opts.script.items[i]))
+					die("unknown answer: \"%s\"",
+					    opts.script.items[i]);
+			}
+			break;
+		case 't':
+			tls_port = optarg;
+			break;
+		case 'w':
+			pidfile = optarg;
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind != argc || (plain_port == NULL && tls_port == NULL))
+		usage();
+
+	if (opts.log_path == NULL)
+		log_fp = stdout;
+	else if ((log_fp = fopen(opts.log_path, "a")) == NULL)
+		die("%s: %s", opts.log_path, strerror(errno));
+
+	(void) signal(SIGPIPE, SIG_IGN);
+
+	if (plain_port) {
+		pfd[nfds].fd = listen_on(plain_port);
+		pfd[nfds++].events = POLLIN;
+	}
+	if (tls_port) {
+		tls_init(cert, key);
+		pfd[nfds].fd = listen_on(tls_port);
+		pfd[nfds++].events = POLLIN;
+	}
+	if (pidfile)
+		detach(pidfile);
+
+	(void) pthread_attr_init(&attr);
+	(void) pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+	for (;;) {
+		(void) pthread_mutex_lock(&mutex);
+		const bool done = (opts.max_requests > 0 &&
+		    served >= opts.max_requests);
+		(void) pthread_mutex_unlock(&mutex);
+
+		if (done)
+			break;
+		if (poll(pfd, nfds, 100) <= 0)
+			continue;
+
+		for (nfds_t i = 0; i < nfds; i++) {
+			pthread_t	 thr;
+			socklen_t	 len;
+			struct conn	*c;
+
+			if (!(pfd[i].revents & POLLIN))
+				continue;
+			if ((c = calloc(1, sizeof *c)) == NULL)
+				die("out of memory");
+			len = sizeof c->peer;
+			if ((c->fd = accept(pfd[i].fd, (struct sockaddr *)
+			    &c->peer, &len)) == -1) {
+				free(c);
+				continue;
+			}
+			c->tls = (tls_port && pfd[i].fd == pfd[nfds - 1].fd);
+			if (pthread_create(&thr, &attr, conn_thread, c) != 0) {
+				(void) close(c->fd);
+				free(c);
+			}
+		}
+	}
+
+	/* Let the last replies finish */
+	sleep_ms(200 + opts.delay.hi);
+	return 0;
+}
@@ -0,0 +1,437 @@
+/* Copyright (c) 2026 Markus Uhlin <markus.uhlin@icloud.com>
+   All rights reserved.
+
+   Permission to use, copy, modify, and distribute this software for any
+   purpose with or without fee is hereby granted, provided that the above
+   copyright notice and this permission notice appear in all copies.
+
+   THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+   WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+   AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+   DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR
+   PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+   TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+   PERFORMANCE OF THIS SOFTWARE. */
+
+/*
+ * A soak test. It runs one enhanced duc process against the mock
+ * server for many update cycles, which are requested through the
+ * control socket, and reports the allocations per cycle, the RSS and
+ * the fragmentation of the heap as a JSON object. The allocations and
+ * the heap are measured by malloc-count.so. Linux and the GNU C
+ * library.
+ */
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "json.h"
+#include "malloc-count.h"
+
+#define MOCK		"./mockserver"
+#define PRELOAD		"./malloc-count.so"
+
+static struct {
+	long		 hosts;
+	long		 cycles;
+	long		 warmup;
+	const char	*duc;
+	const char	*out;
+} opts = {
+	.hosts		= 10,
+	.cycles		= 1000,
+	.warmup		= 10,
+	.duc		= "../enhanced-duc",
+	.out		= NULL,
+};
+
+/*
+ * The state of the process at a point of the run
+ */
+struct snapshot {
+	uint64_t	allocs;
+	uint64_t	frees;
+	long		rss_kb;
+	long		hwm_kb;
+	size_t		arena_peak;
+	size_t		arena_size;
+	uint64_t	heap_size;
+	uint64_t	heap_in_use;
+	uint64_t	heap_free;
+	uint64_t	heap_free_chunks;
+};
+
+static char tmpdir[] = "/tmp/soak.XXXXXX";
+static struct malloc_counts *counts;
+
+static void
+die(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	(void) fputs("soak: ", stderr);
+	(void) vfprintf(stderr, fmt, ap);
+	(void) fputc('\n', stderr);
+	va_end(ap);
+	exit(1);
+}
+
+static void
+usage(void)
+{
+	(void) fputs("usage: soak [-H hosts] [-c cycles] [-w warmup] "
+	    "[-b binary] [-o output]\n", stderr);
+	exit(1);
+}
+
+static long
+number(const char *str, long lo, long hi)
+{
+	char	*ep;
+	long	 val;
+
+	errno = 0;
+	val = strtol(str, &ep, 10);
+	if (ep == str || *ep != '\0' || errno || val < lo || val > hi)
+		die("bogus number: \"%s\"", str);
+	return val;
+}
+
+static char *
+path(const char *name)
+{
+	static char	buf[4][256];
+	static int	next = 0;
+	char		*p = buf[next++ % 4];
+
+	(void) snprintf(p, sizeof buf[0], "%s/%s", tmpdir, name);
+	return p;
+}
+
+static void
+write_config(void)
+{
+	FILE *fp;
+
+	if ((fp = fopen(path("duc.conf"), "w")) == NULL)
+		die("%s: %s", path("duc.conf"), strerror(errno));
+	(void) fputs("username = \"user\";\n"
+	    "password = \"pass\";\n"
+	    "hostname = \"", fp);
+	for (long i = 0; i < opts.hosts; i++)
+		(void) fprintf(fp, "%sh%ld.example.com", (i ? "|" : ""), i);
+	(void) fputs("\";\n"
+	    "ip_addr = \"WAN_address\";\n"
+	    "sp_hostname = \"localhost\";\n"
+	    "port = \"8245\";\n"
+	    "update_interval_seconds = \"3600\";\n"
+	    "primary_ip_lookup_srv = \"localhost\";\n"
+	    "backup_ip_lookup_srv = \"localhost\";\n"
+	    "force_update = \"YES\";\n", fp);
+	if (fclose(fp) != 0)
+		die("write error");
+}
+
+static pid_t
+spawn(char *const argv[], bool preload)
+{
+	int	fd;
+	pid_t	pid;
+
+	if ((pid = fork()) == -1)
+		die("fork: %s", strerror(errno));
+	if (pid == 0) {
+		if ((fd = open("/dev/null", O_RDWR)) != -1) {
+			(void) dup2(fd, STDOUT_FILENO);
+			(void) dup2(fd, STDERR_FILENO);
+		}
+		if (preload) {
+			(void) setenv("LD_PRELOAD", PRELOAD, 1);
+			(void) setenv("MALLOC_COUNT_FILE", path("counts"), 1);
+		}
+		(void) execv(argv[0], argv);
+		_exit(127);
+	}
+	return pid;
+}
+
+static pid_t
+start_mock(void)
+{
+	FILE	*fp;
+	char	*argv[] = { MOCK, "-p", "8245", "-l", path("mock.log"), "-w",
+		    path("mock.pid"), NULL };
+	int	 status;
+	long	 pid = -1;
+
+	if (waitpid(spawn(argv, false), &status, 0) == -1 ||
+	    !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+		die("cannot start %s", MOCK);
+	if ((fp = fopen(path("mock.pid"), "r")) == NULL ||
+	    fscanf(fp, "%ld", &pid) != 1)
+		die("no mock.pid");
+	(void) fclose(fp);
+	return (pid_t) pid;
+}
+
+static void
+map_counts(void)
+{
+	int	 fd;
+	void	*p;
+
+	if ((fd = open(path("counts"), O_RDWR | O_CREAT, 0644)) == -1 ||
+	    ftruncate(fd, sizeof *counts) == -1)
+		die("%s: %s", path("counts"), strerror(errno));
+	p = mmap(NULL, sizeof *counts, PROT_READ | PROT_WRITE, MAP_SHARED,
+	    fd, 0);
+	if (p == MAP_FAILED)
+		die("mmap: %s", strerror(errno));
+	(void) close(fd);
+	counts = p;
+}
+
+/*
+ * Send a command to the control socket and read the reply. The reply
+ * comes once the process is idle, i.e. after an update it requested.
+ */
+static bool
+command(const char *cmd, char *reply, size_t size)
+{
+	int			fd;
+	size_t			len = 0;
+	ssize_t			n;
+	struct sockaddr_un	sun;
+
+	(void) memset(&sun, 0, sizeof sun);
+	sun.sun_family = AF_UNIX;
+	(void) snprintf(sun.sun_path, sizeof sun.sun_path, "%s",
+	    path("control.sock"));
+
+	if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1)
+		die("socket: %s", strerror(errno));
+	if (connect(fd, (struct sockaddr *) &sun, sizeof sun) == -1) {
+		(void) close(fd);
+		return false;
+	}
+	if (write(fd, cmd, strlen(cmd)) != (ssize_t) strlen(cmd))
+		die("write: %s", strerror(errno));
+	while (len < size - 1 && (n = read(fd, &reply[len],
+	    size - 1 - len)) > 0)
+		len += n;
+	reply[len] = '\0';
+	(void) close(fd);
+	return true;
+}
+
+/*
+ * Read a "Name:  1234 kB" line of /proc/<pid>/status
+ */
+static long
+proc_status_kb(pid_t pid, const char *name)
+{
+	FILE	*fp;
+	char	 line[128];
+	char	 file[64];
+	long	 kb = -1;
+
+	(void) snprintf(file, sizeof file, "/proc/%ld/status", (long) pid);
+	if ((fp = fopen(file, "r")) == NULL)
+		return -1;
+	while (fgets(line, sizeof line, fp)) {
+		if (strncmp(line, name, strlen(name)) == 0 &&
+		    line[strlen(name)] == ':') {
+			kb = strtol(&line[strlen(name) + 1], NULL, 10);
+			break;
+		}
+	}
+	(void) fclose(fp);
+	return kb;
+}
+
+static void
+take_snapshot(pid_t pid, struct snapshot *s)
+{
+	char		 stats[8192];
+	const char	*cp;
+
+	(void) memset(s, 0, sizeof *s);
+	if (!command("stats\n", stats, sizeof stats))
+		die("the control socket is gone");
+	if ((cp = strstr(stats, "\narena: ")) != NULL)
+		(void) sscanf(cp, "\narena: used=%*u peak=%zu size=%zu",
+		    &s->arena_peak, &s->arena_size);
+	s->allocs = counts->allocs;
+	s->frees = counts->frees;
+	s->heap_size = counts->heap_size;
+	s->heap_in_use = counts->heap_in_use;
+	s->heap_free = counts->heap_free;
+	s->heap_free_chunks = counts->heap_free_chunks;
+	s->rss_kb = proc_status_kb(pid, "VmRSS");
+	s->hwm_kb = proc_status_kb(pid, "VmHWM");
+}
+
+static void
+run_cycles(long n)
+{
+	char reply[1024];
+
+	for (long i = 0; i < n; i++) {
+		if (!command("update\n", reply, sizeof reply) ||
+		    !command("state\n", reply, sizeof reply))
+			die("the control socket is gone");
+	}
+}
+
+static unsigned long
+count_requests(void)
+{
+	FILE		*fp;
+	char		 line[1024];
+	unsigned long	 n = 0;
+
+	if ((fp = fopen(path("mock.log"), "r")) == NULL)
+		return 0;
+	while (fgets(line, sizeof line, fp)) {
+		if (strstr(line, " update "))
+			n++;
+	}
+	(void) fclose(fp);
+	return n;
+}
+
+static void
+report(const struct snapshot *a, const struct snapshot *b,
+       unsigned long requests)
+{
+	FILE			*fp = stdout;
+	static char		 buf[4096];
+	struct json_writer	 w;
+	const double		 cycles = (double) opts.cycles;
+
+	json_init(&w, buf, sizeof buf);
+	json_add_uint(&w, "hosts", opts.hosts);
+	json_add_uint(&w, "cycles", opts.cycles);
+	json_add_uint(&w, "requests", requests);
+	json_add_double(&w, "allocs_per_cycle", (b->allocs - a->allocs) /
+	    cycles, 1);
+	json_add_double(&w, "allocs_per_update", (b->allocs - a->allocs) /
+	    cycles / opts.hosts, 1);
+	json_add_double(&w, "frees_per_cycle", (b->frees - a->frees) /
+	    cycles, 1);
+	json_add_uint(&w, "rss_kb_start", a->rss_kb);
+	json_add_uint(&w, "rss_kb_end", b->rss_kb);
+	json_add_uint(&w, "peak_rss_kb", b->hwm_kb);
+	json_add_uint(&w, "arena_peak", b->arena_peak);
+	json_add_uint(&w, "arena_size", b->arena_size);
+	json_add_uint(&w, "heap_size_start", a->heap_size);
+	json_add_uint(&w, "heap_size", b->heap_size);
+	json_add_uint(&w, "heap_in_use", b->heap_in_use);
+	json_add_uint(&w, "heap_free", b->heap_free);
+	json_add_uint(&w, "heap_free_chunks", b->heap_free_chunks);
+	json_add_double(&w, "fragmentation", (b->heap_size ?
+	    (double) b->heap_free / b->heap_size : 0.0), 3);
+	if (!json_finish(&w))
+		die("report truncated");
+
+	if (opts.out && (fp = fopen(opts.out, "a")) == NULL)
+		die("%s: %s", opts.out, strerror(errno));
+	(void) fprintf(fp, "%s\n", buf);
+	if (fp != stdout)
+		(void) fclose(fp);
+}
+
+static void
+remove_tmpdir(void)
+{
+	char *argv[] = { "/bin/rm", "-rf", tmpdir, NULL };
+
+	(void) waitpid(spawn(argv, false), NULL, 0);
+}
+
+int
+main(int argc, char *argv[])
+{
+	char		 reply[1024];
+	int		 opt;
+	pid_t		 duc, mock;
+	struct snapshot	 start, end;
+
+	while ((opt = getopt(argc, argv, "H:b:c:o:w:")) != -1) {
+		switch (opt) {
+		case 'H':
+			opts.hosts = number(optarg, 1, 1000);
+			break;
+		case 'b':
+			opts.duc = optarg;
+			break;
+		case 'c':
+			opts.cycles = number(optarg, 1, 10000000L);
+			break;
+		case 'o':
+			opts.out = optarg;
+			break;
+		case 'w':
+			opts.warmup = number(optarg, 0, 1000000L);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind != argc)
+		usage();
+	if (access(opts.duc, X_OK) != 0 || access(MOCK, X_OK) != 0 ||
+	    access(PRELOAD, R_OK) != 0)
+		die("run from the mock directory after building");
+
+	if (mkdtemp(tmpdir) == NULL)
+		die("mkdtemp: %s", strerror(errno));
+	/* The daemon drops root privileges before it writes its log */
+	(void) chmod(tmpdir, 0755);
+	(void) signal(SIGPIPE, SIG_IGN);
+	write_config();
+	map_counts();
+	mock = start_mock();
+
+	char *duc_argv[] = { (char *) opts.duc, "-x", path("duc.conf"), "-l",
+		path("duc.log"), "-s", path("control.sock"), NULL };
+
+	duc = spawn(duc_argv, true);
+	for (int i = 0; !command("state\n", reply, sizeof reply); i++) {
+		if (i == 500 || waitpid(duc, NULL, WNOHANG) != 0)
+			die("%s did not start", opts.duc);
+		(void) poll(NULL, 0, 10);
+	}
+
+	run_cycles(opts.warmup);
+	take_snapshot(duc, &start);
+	run_cycles(opts.cycles);
+	take_snapshot(duc, &end);
+
+	(void) kill(duc, SIGTERM);
+	(void) waitpid(duc, NULL, 0);
+	(void) kill(mock, SIGTERM);
+
+	report(&start, &end, count_requests());
+	remove_tmpdir();
+	return 0;
+}
@@ -0,0 +1,321 @@
+/* Copyright (c) 2026 Markus Uhlin <markus.uhlin@icloud.com>
+   All rights reserved.
+
+   Permission to use, copy, modify, and distribute this software for any
+   purpose with or without fee is hereby granted, provided that the above
+   copyright notice and this permission notice appear in all copies.
+
+   THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+   WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+   AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+   DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR
+   PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+   TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+   PERFORMANCE OF THIS SOFTWARE. */
+
+/*
+ * A startup benchmark. It acts as the service provider itself, execs
+ * the enhanced duc and measures the time from the exec to the first
+ * byte of the update request, and the resident set size of the
+ * process once it is idle, i.e. sleeping until the next cycle. Over
+ * plain HTTP and, as root, over TLS.
+ */
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <openssl/ssl.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DUC		"../enhanced-duc"
+#define RUNS		15
+#define IDLE_MS		300	/* Time to settle before the RSS is read */
+#define TIMEOUT_MS	5000
+
+/*
+ * A way of running the program. The program connects to 'listen_port'
+ * first: the service provider, or the IP lookup server on port 80 if
+ * 'force_update' is NO.
+ */
+struct mode {
+	const char	*name;
+	int		 listen_port;
+	int		 port;		/* The setting */
+	const char	*force_update;
+	const char	*reply;
+	bool		 tls;
+};
+
+static const struct mode modes[] = {
+	{ "http", 8245, 8245, "YES",
+	  "HTTP/1.0 200 OK\r\n\r\ngood 127.0.0.1\n", false },
+	{ "tls", 443, 443, "YES",
+	  "HTTP/1.0 200 OK\r\n\r\ngood 127.0.0.1\n", true },
+	/* The lookup fails, so the program never connects with TLS */
+	{ "tls-lookup-only", 80, 443, "NO",
+	  "HTTP/1.0 200 OK\r\n\r\nno address\n", false },
+};
+
+static char tmpdir[] = "/tmp/startup.XXXXXX";
+
+static void
+die(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	(void) fputs("startup: ", stderr);
+	(void) vfprintf(stderr, fmt, ap);
+	(void) fputc('\n', stderr);
+	va_end(ap);
+	exit(1);
+}
+
+static uint64_t
+now_us(void)
+{
+	struct timespec ts;
+
+	(void) clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int
+compare_u64(const void *a, const void *b)
+{
+	const uint64_t x = *(const uint64_t *) a;
+	const uint64_t y = *(const uint64_t *) b;
+
+	return (x > y) - (x < y);
+}
+
+static int
+compare_long(const void *a, const void *b)
+{
+	const long x = *(const long *) a;
+	const long y = *(const long *) b;
+
+	return (x > y) - (x < y);
+}
+
+static int
+listen_on(int port)
+{
+	const int		on = 1;
+	int			fd;
+	struct sockaddr_in	sin;
+
+	(void) memset(&sin, 0, sizeof sin);
+	sin.sin_family = AF_INET;
+	sin.sin_port = htons(port);
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	if ((fd = socket(AF_INET, SOCK_STREAM, 0)) == -1)
+		die("socket: %s", strerror(errno));
+	(void) setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof on);
+	if (bind(fd, (struct sockaddr *) &sin, sizeof sin) == -1 ||
+	    listen(fd, 8) == -1)
+		die("port %d: %s", port, strerror(errno));
+	return fd;
+}
+
+static void
+write_config(const char *path, const struct mode *m)
+{
+	FILE *fp;
+
+	if ((fp = fopen(path, "w")) == NULL)
+		die("%s: %s", path, strerror(errno));
+	(void) fprintf(fp, "username = \"user\";\n"
+	    "password = \"pass\";\n"
+	    "hostname = \"a.example.com\";\n"
+	    "ip_addr = \"WAN_address\";\n"
+	    "sp_hostname = \"localhost\";\n"
+	    "port = \"%d\";\n"
+	    "update_interval_seconds = \"3600\";\n"
+	    "primary_ip_lookup_srv = \"localhost\";\n"
+	    "backup_ip_lookup_srv = \"localhost\";\n"
+	    "force_update = \"%s\";\n", m->port, m->force_update);
+	if (fclose(fp) != 0)
+		die("write error");
+}
+
+/*
+ * Read a "Name:  1234 kB" line of /proc/<pid>/status. Linux only.
+ */
+static long
+proc_status_kb(pid_t pid, const char *name)
+{
+	FILE	*fp;
+	char	 line[128];
+	char	 path[64];
+	long	 kb = -1;
+
+	(void) snprintf(path, sizeof path, "/proc/%ld/status", (long) pid);
+	if ((fp = fopen(path, "r")) == NULL)
+		return -1;
+	while (fgets(line, sizeof line, fp)) {
+		if (strncmp(line, name, strlen(name)) == 0 &&
+		    line[strlen(name)] == ':') {
+			kb = strtol(&line[strlen(name) + 1], NULL, 10);
+			break;
+		}
+	}
+	(void) fclose(fp);
+	return kb;
+}
+
+static bool
+wait_readable(int fd)
+{
+	struct pollfd pfd = { .fd = fd, .events = POLLIN };
+
+	return (poll(&pfd, 1, TIMEOUT_MS) == 1);
+}
+
+/*
+ * Exec the program, accept its connection and wait for the first byte
+ * of the request, which over TLS comes after the handshake
+ */
+static uint64_t
+run_once(const struct mode *m, int lfd, SSL_CTX *ctx, const char *conf,
+	 long *rss, long *hwm)
+{
+	SSL		*ssl = NULL;
+	char		 buf[1024];
+	int		 fd, null;
+	pid_t		 pid;
+	uint64_t	 start, first_byte;
+
+	start = now_us();
+	if ((pid = fork()) == -1)
+		die("fork: %s", strerror(errno));
+	if (pid == 0) {
+		if ((null = open("/dev/null", O_RDWR)) != -1) {
+			(void) dup2(null, STDOUT_FILENO);
+			(void) dup2(null, STDERR_FILENO);
+		}
+		(void) execl(DUC, DUC, "-x", conf, (char *) NULL);
+		_exit(127);
+	}
+
+	if (!wait_readable(lfd) || (fd = accept(lfd, NULL, NULL)) == -1)
+		die("no connection from %s", DUC);
+	if (m->tls) {
+		if ((ssl = SSL_new(ctx)) == NULL || !SSL_set_fd(ssl, fd) ||
+		    SSL_accept(ssl) != 1 || SSL_read(ssl, buf, 1) != 1)
+			die("TLS handshake failed");
+	} else if (!wait_readable(fd) || read(fd, buf, 1) != 1) {
+		die("no request");
+	}
+	first_byte = now_us() - start;
+
+	/* The rest of the request, then the reply */
+	if (ssl) {
+		(void) SSL_read(ssl, buf, sizeof buf);
+		(void) SSL_write(ssl, m->reply, (int) strlen(m->reply));
+		(void) SSL_shutdown(ssl);
+		SSL_free(ssl);
+	} else {
+		(void) read(fd, buf, sizeof buf);
+		(void) write(fd, m->reply, strlen(m->reply));
+	}
+	(void) close(fd);
+
+	(void) poll(NULL, 0, IDLE_MS);
+	*rss = proc_status_kb(pid, "VmRSS");
+	*hwm = proc_status_kb(pid, "VmHWM");
+	(void) kill(pid, SIGKILL);
+	(void) waitpid(pid, NULL, 0);
+	return first_byte;
+}
+
+static void
+run(const struct mode *m, SSL_CTX *ctx)
+{
+	char		conf[300];
+	int		lfd;
+	long		rss[RUNS], hwm[RUNS];
+	uint64_t	us[RUNS];
+
+	(void) snprintf(conf, sizeof conf, "%s/%s.conf", tmpdir, m->name);
+	write_config(conf, m);
+	lfd = listen_on(m->listen_port);
+
+	for (int i = 0; i < RUNS; i++)
+		us[i] = run_once(m, lfd, ctx, conf, &rss[i], &hwm[i]);
+	(void) close(lfd);
+
+	qsort(us, RUNS, sizeof *us, compare_u64);
+	qsort(rss, RUNS, sizeof *rss, compare_long);
+	qsort(hwm, RUNS, sizeof *hwm, compare_long);
+	printf("startup: %-15s exec to first request byte: median %7.2f ms, "
+	    "min %7.2f ms; idle RSS %5ld kB, peak %5ld kB\n", m->name,
+	    us[RUNS / 2] / 1e3, us[0] / 1e3, rss[RUNS / 2], hwm[RUNS / 2]);
+}
+
+int
+main(void)
+{
+	SSL_CTX	*ctx = NULL;
+	char	 cert[300], key[300], ca[300], cmd[400];
+
+	if (access(DUC, X_OK) != 0)
+		die("run from the mock directory after building");
+	if (mkdtemp(tmpdir) == NULL)
+		die("mkdtemp: %s", strerror(errno));
+	(void) chmod(tmpdir, 0755);
+	(void) signal(SIGPIPE, SIG_IGN);
+
+	(void) snprintf(cmd, sizeof cmd, "./mkcerts %s/certs >/dev/null",
+	    tmpdir);
+	(void) snprintf(cert, sizeof cert, "%s/certs/server.crt", tmpdir);
+	(void) snprintf(key, sizeof key, "%s/certs/server.key", tmpdir);
+	(void) snprintf(ca, sizeof ca, "%s/certs/ca.crt", tmpdir);
+
+	if (geteuid() == 0 && system(cmd) == 0) {
+		if ((ctx = SSL_CTX_new(TLS_server_method())) == NULL ||
+		    SSL_CTX_use_certificate_chain_file(ctx, cert) != 1 ||
+		    SSL_CTX_use_PrivateKey_file(ctx, key, SSL_FILETYPE_PEM)
+		    != 1)
+			die("cannot load the test certificate");
+		(void) setenv("SSL_CERT_FILE", ca, 1);
+	}
+
+	for (size_t i = 0; i < sizeof modes / sizeof modes[0]; i++) {
+		const struct mode *m = &modes[i];
+
+		if (m->listen_port < 1024 && geteuid() != 0)
+			printf("startup: %-15s skipped: port %d needs root\n",
+			    m->name, m->listen_port);
+		else if (m->port == 443 && ctx == NULL)
+			printf("startup: %-15s skipped: no test CA\n",
+			    m->name);
+		else
+			run(m, ctx);
+	}
+
+	if (ctx)
+		SSL_CTX_free(ctx);
+	(void) snprintf(cmd, sizeof cmd, "rm -rf %s", tmpdir);
+	(void) system(cmd);
+	return 0;
+}
@@ -14,7 +14,11 @@ CFLAGS = -D_BSD_SOURCE=1\
 	-std=c11
 
 CXX ?= c++
-CXXFLAGS = -std=c++17
+CXXFLAGS = -O2\
+	-Wall\
+	-pipe\
+	-pthread\
+	-std=c++17
 
 # C preprocessor flags
 CPPFLAGS =
@@ -0,0 +1,288 @@
+/* Copyright (c) 2026 Markus Uhlin <markus.uhlin@icloud.com>
+   All rights reserved.
+
+   Permission to use, copy, modify, and distribute this software for any
+   purpose with or without fee is hereby granted, provided that the above
+   copyright notice and this permission notice appear in all copies.
+
+   THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+   WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+   AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+   DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR
+   PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+   TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+   PERFORMANCE OF THIS SOFTWARE. */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "format.h"
+#include "log.h"
+
+#define ALIGNMENT	_Alignof(max_align_t)
+#define ALIGN_UP(n)	(((n) + ALIGNMENT - 1) & ~(ALIGNMENT - 1))
+
+struct arena_chunk {
+	struct arena_chunk		*next;
+	size_t				 size;
+	size_t				 used;
+	_Alignas(max_align_t) unsigned char
+					 data[];
+};
+
+/**
+ * The arena of the update cycle. Every update worker has its own.
+ */
+_Thread_local struct arena g_arena;
+
+static void
+account(struct arena *a, size_t bytes)
+{
+	a->used += bytes;
+	if (a->used > a->peak)
+		a->peak = a->used;
+}
+
+/*
+ * Make the next chunk with room for 'size' bytes current. The chunks
+ * after the current one are free and reused before a new one is
+ * allocated.
+ */
+static struct arena_chunk *
+next_chunk(struct arena *a, size_t size)
+{
+	struct arena_chunk	*c = a->cur;
+	struct arena_chunk	*chunk;
+	size_t			 data_size;
+
+	while (c != NULL && c->next != NULL) {
+		c = c->next;
+		c->used = 0;
+		if (c->size >= size)
+			return (a->cur = c);
+	}
+
+	data_size = (size > ARENA_CHUNK_SIZE ? size : ARENA_CHUNK_SIZE);
+	if (data_size > SIZE_MAX - sizeof *chunk)
+		fatal(0, "arena: integer overflow");
+	if ((chunk = malloc(sizeof *chunk + data_size)) == NULL) {
+		fatal(ENOMEM, "arena: error allocating %zu bytes",
+		    sizeof *chunk + data_size);
+	}
+	chunk->next = NULL;
+	chunk->size = data_size;
+	chunk->used = 0;
+
+	if (c == NULL)
+		a->first = chunk;
+	else
+		c->next = chunk;
+	a->size += data_size;
+	a->chunks++;
+	return (a->cur = chunk);
+}
+
+/**
+ * Allocate memory that lasts until the arena is reset or restored to
+ * an earlier mark. It's aligned for any type. The routine never
+ * returns NULL.
+ *
+ * @param a	The arena
+ * @param size	Size in bytes
+ * @return The memory
+ */
+void *
+arena_alloc(struct arena *a, size_t size)
+{
+	struct arena_chunk	*c = a->cur;
+	size_t			 offset;
+
+	if (size > SIZE_MAX - ALIGNMENT)
+		fatal(0, "arena_alloc: integer overflow");
+	if (c == NULL || (offset = ALIGN_UP(c->used)) > c->size ||
+	    c->size - offset < size) {
+		c = next_chunk(a, size);
+		offset = 0;
+	}
+
+	account(a, offset - c->used + size);
+	c->used = offset + size;
+	return &c->data[offset];
+}
+
+/**
+ * Like arena_alloc() but the memory is set to zero
+ */
+void *
+arena_calloc(struct arena *a, size_t elt_count, size_t elt_size)
+{
+	void *vp;
+
+	if (elt_size != 0 && SIZE_MAX / elt_size < elt_count)
+		fatal(0, "arena_calloc: integer overflow");
+	vp = arena_alloc(a, elt_count * elt_size);
+	return memset(vp, 0, elt_count * elt_size);
+}
+
+/**
+ * Change the size of an allocation. The last allocation grows in
+ * place if there's room for it, otherwise it's copied.
+ *
+ * @param a		The arena
+ * @param ptr		The allocation, or NULL
+ * @param oldSize	Its size
+ * @param newSize	The new size
+ * @return The allocation
+ */
+void *
+arena_realloc(struct arena *a, void *ptr, size_t oldSize, size_t newSize)
+{
+	struct arena_chunk	*c = a->cur;
+	unsigned char		*p = ptr;
+	void			*newPtr;
+
+	if (ptr == NULL)
+		return arena_alloc(a, newSize);
+
+	if (c != NULL && p + oldSize == &c->data[c->used] &&
+	    newSize <= c->size &&
+	    (size_t) (p - c->data) <= c->size - newSize) {
+		if (newSize > oldSize)
+			account(a, newSize - oldSize);
+		else
+			a->used -= oldSize - newSize;
+		c->used = (p - c->data) + newSize;
+		return ptr;
+	}
+
+	newPtr = arena_alloc(a, newSize);
+	(void) memcpy(newPtr, ptr, (oldSize < newSize ? oldSize : newSize));
+	return newPtr;
+}
+
+/**
+ * Make an exact copy of a string in the arena
+ */
+char *
+arena_strdup(struct arena *a, const char *s)
+{
+	const size_t size = strlen(s) + 1;
+
+	return memcpy(arena_alloc(a, size), s, size);
+}
+
+/**
+ * Format a string in the arena. It's written in one pass if it fits in
+ * the current chunk, which is the common case.
+ *
+ * @return The result of the conversion
+ */
+char *
+arena_vprintf(struct arena *a, const char *format, va_list ap)
+{
+	struct arena_chunk	*c = a->cur;
+	char			*str;
+	int			 len;
+	struct fmt_buf		 f;
+	va_list			 ap_copy;
+
+	if (c == NULL || c->used >= c->size)
+		c = next_chunk(a, 1);
+	str = (char *) &c->data[c->used];
+
+	fmt_init(&f, str, c->size - c->used, FMT_FIXED, NULL);
+	va_copy(ap_copy, ap);
+	len = fmt_vprintf(&f, format, ap_copy);
+	va_end(ap_copy);
+	if (len < 0)
+		fatal(errno, "arena_vprintf");
+
+	if (!f.truncated) {
+		c->used += len + 1;
+		account(a, len + 1);
+		return str;
+	}
+
+	str = arena_alloc(a, (size_t) len + 1);
+	fmt_init(&f, str, (size_t) len + 1, FMT_FIXED, NULL);
+	(void) fmt_vprintf(&f, format, ap);
+	return str;
+}
+
+/**
+ * Format a string in the arena
+ */
+char *
+arena_printf(struct arena *a, const char *format, ...)
+{
+	char	*str;
+	va_list	 ap;
+
+	va_start(ap, format);
+	str = arena_vprintf(a, format, ap);
+	va_end(ap);
+	return str;
+}
+
+/**
+ * Mark the allocations so far. Restoring the mark frees everything
+ * that's allocated after it.
+ */
+struct arena_mark
+arena_save(const struct arena *a)
+{
+	struct arena_mark m = {
+		.chunk      = a->cur,
+		.chunk_used = (a->cur ? a->cur->used : 0),
+		.used       = a->used,
+	};
+
+	return m;
+}
+
+/**
+ * Free everything allocated after a mark. O(1).
+ */
+void
+arena_restore(struct arena *a, struct arena_mark m)
+{
+	if (m.chunk == NULL) {
+		arena_reset(a);
+		return;
+	}
+	a->cur = m.chunk;
+	a->cur->used = m.chunk_used;
+	a->used = m.used;
+}
+
+/**
+ * Free every allocation. The chunks are kept. O(1).
+ */
+void
+arena_reset(struct arena *a)
+{
+	a->cur = a->first;
+	if (a->cur)
+		a->cur->used = 0;
+	a->used = 0;
+}
+
+/**
+ * Free the chunks
+ */
+void
+arena_destroy(struct arena *a)
+{
+	struct arena_chunk *c, *next;
+
+	for (c = a->first; c != NULL; c = next) {
+		next = c->next;
+		free(c);
+	}
+	(void) memset(a, 0, sizeof *a);
+}
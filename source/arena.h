@@ -0,0 +1,52 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdarg.h>
+#include <stddef.h>
+
+#include "ducdef.h"
+
+#define ARENA_CHUNK_SIZE	8192
+
+/*
+ * A bump allocator for the memory of an update cycle. Allocations are
+ * carved out of chunks and never freed one by one. Instead the arena
+ * is reset at the end of a cycle, or restored to a mark at the end of
+ * an update, in constant time. The chunks are kept, so that the cycles
+ * after the first don't call malloc().
+ */
+struct arena_chunk;
+
+struct arena {
+	struct arena_chunk	*first;
+	struct arena_chunk	*cur;
+	size_t			 used;	 /**< Bytes allocated */
+	size_t			 peak;	 /**< The most bytes ever allocated */
+	size_t			 size;	 /**< Bytes in chunks */
+	size_t			 chunks;
+};
+
+struct arena_mark {
+	struct arena_chunk	*chunk;
+	size_t			 chunk_used;
+	size_t			 used;
+};
+
+__DUC_BEGIN_DECLS
+extern _Thread_local struct arena g_arena;
+
+char	*arena_printf(struct arena *, const char *, ...) PRINTFLIKE(2);
+char	*arena_strdup(struct arena *, const char *);
+char	*arena_vprintf(struct arena *, const char *, va_list)
+	    VPRINTFLIKE(2);
+struct arena_mark
+	 arena_save(const struct arena *);
+void	*arena_alloc(struct arena *, size_t);
+void	*arena_calloc(struct arena *, size_t, size_t);
+void	*arena_realloc(struct arena *, void *, size_t, size_t);
+void	 arena_destroy(struct arena *);
+void	 arena_reset(struct arena *);
+void	 arena_restore(struct arena *, struct arena_mark);
+__DUC_END_DECLS
+
+#endif
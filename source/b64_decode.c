@@ -40,15 +40,15 @@
  * IF IBM IS APPRISED OF THE POSSIBILITY OF SUCH DAMAGES.
  */
 
-#include <ctype.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+
+#include "b64_simd.h"
 
 #define Assert(Cond) ((void) 0)
 
-static const char Base64[] =
-	"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
 static const char Pad64 = '=';
 
 /* (From RFC1521 and draft-ietf-dnssec-secext-03.txt)
@@ -120,53 +120,64 @@ static const char Pad64 = '=';
    it returns the number of data bytes stored at the target, or -1 on error.
  */
 
-static int b64rmap_initialized = 0;
-static uint8_t b64rmap[256];
+/*
+ * The reverse mapping: the value of a base64 character, or a special
+ * value. The whitespace is that of isspace() in the C locale.
+ */
+static const uint8_t b64rmap[256] = {
+	0xfd, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xfe, 0xfe, 0xfe, 0xfe, 0xfe, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xfe, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0x3e, 0xff, 0xff, 0xff, 0x3f,
+	0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x3b,
+	0x3c, 0x3d, 0xff, 0xff, 0xff, 0xfd, 0xff, 0xff,
+	0xff, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06,
+	0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e,
+	0x0f, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16,
+	0x17, 0x18, 0x19, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f, 0x20,
+	0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28,
+	0x29, 0x2a, 0x2b, 0x2c, 0x2d, 0x2e, 0x2f, 0x30,
+	0x31, 0x32, 0x33, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+};
 
 static const uint8_t b64rmap_special = 0xf0;
 static const uint8_t b64rmap_end = 0xfd;
 static const uint8_t b64rmap_space = 0xfe;
-static const uint8_t b64rmap_invalid = 0xff;
-
-/**
- * Initializing the reverse map is not thread safe.
- * Which is fine for NSD. For now...
- **/
-static void
-b64_initialize_rmap (void)
-{
-	int i;
-
-	/* Null: end of string, stop parsing */
-	b64rmap[0] = b64rmap_end;
-
-	for (i = 1; i < 256; ++i) {
-		/* Whitespaces */
-		if (isspace(i))
-			b64rmap[i] = b64rmap_space;
-		/* Padding: stop parsing */
-		else if (i == (unsigned char)Pad64)
-			b64rmap[i] = b64rmap_end;
-		/* Non-base64 char */
-		else
-			b64rmap[i] = b64rmap_invalid;
-	}
-
-	/* Fill reverse mapping for base64 chars */
-	for (i = 0; Base64[i] != '\0'; ++i)
-		b64rmap[(uint8_t)Base64[i]] = i;
-
-	b64rmap_initialized = 1;
-}
 
 static int
-b64_decode_do(unsigned char const *src, uint8_t *target, size_t targsize)
+b64_decode_do(enum b64_isa isa, unsigned char const *src, uint8_t *target,
+    size_t targsize)
 {
 	int tarindex, state, ch;
 	uint8_t ofs;
+	size_t n;
+
+	/* The whole blocks up to the first non-base64 character */
+	n = b64_decode_blocks(isa, src, (isa != B64_ISA_SCALAR ?
+	    strlen((const char *) src) : 0), target, targsize);
+	src += n;
 
 	state = 0;
-	tarindex = 0;
+	tarindex = (int) (n / 4 * 3);
 
 	while (1)
 	{
@@ -370,13 +381,18 @@ b64_decode_len(unsigned char const *src)
 
 
 int
-b64_decode(char const *src, uint8_t *target, size_t targsize)
+b64_decode_isa(enum b64_isa isa, char const *src, uint8_t *target,
+    size_t targsize)
 {
-	if (!b64rmap_initialized)
-		b64_initialize_rmap ();
-
 	if (target)
-		return b64_decode_do ((unsigned char*)src, target, targsize);
+		return b64_decode_do (isa, (unsigned char*)src, target,
+		    targsize);
 	else
 		return b64_decode_len ((unsigned char*)src);
 }
+
+int
+b64_decode(char const *src, uint8_t *target, size_t targsize)
+{
+	return b64_decode_isa(b64_isa_supported(), src, target, targsize);
+}
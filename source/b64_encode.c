@@ -43,6 +43,8 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "b64_simd.h"
+
 #define Assert(Cond) ((void) 0)
 
 static const char Base64[] =
@@ -117,13 +119,20 @@ static const char Pad64 = '=';
  */
 
 int
-b64_encode(uint8_t const *src, size_t srclength, char *target, size_t targsize)
+b64_encode_isa(enum b64_isa isa, uint8_t const *src, size_t srclength,
+    char *target, size_t targsize)
 {
 	size_t datalength = 0;
 	uint8_t input[3];
 	uint8_t output[4];
 	size_t i;
 
+	/* The whole blocks */
+	i = b64_encode_blocks(isa, src, srclength, target, targsize);
+	src += i;
+	srclength -= i;
+	datalength = i / 3 * 4;
+
 	while (2 < srclength) {
 		input[0] = *src++;
 		input[1] = *src++;
@@ -176,3 +185,10 @@ b64_encode(uint8_t const *src, size_t srclength, char *target, size_t targsize)
 	target[datalength] = '\0';	/* Returned value doesn't count \0. */
 	return (datalength);
 }
+
+int
+b64_encode(uint8_t const *src, size_t srclength, char *target, size_t targsize)
+{
+	return b64_encode_isa(b64_isa_supported(), src, srclength, target,
+	    targsize);
+}
@@ -0,0 +1,361 @@
+/* Copyright (c) 2026 Markus Uhlin <markus.uhlin@icloud.com>
+   All rights reserved.
+
+   Permission to use, copy, modify, and distribute this software for any
+   purpose with or without fee is hereby granted, provided that the above
+   copyright notice and this permission notice appear in all copies.
+
+   THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+   WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+   AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+   DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR
+   PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+   TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+   PERFORMANCE OF THIS SOFTWARE. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "b64_simd.h"
+
+#if B64_SIMD
+#include <immintrin.h>
+
+#define SSSE3	__attribute__((target("ssse3")))
+#define AVX2	__attribute__((target("avx2")))
+
+/*
+ * Map 16 6-bit values, one per byte, to the base64 alphabet. A value
+ * is turned into an index of a table of offsets to add: 0-25 'A',
+ * 26-51 'a', 52-61 '0', 62 '+' and 63 '/'.
+ */
+static inline SSSE3 __m128i
+enc_translate(const __m128i in)
+{
+	const __m128i lut = _mm_setr_epi8(
+	    'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+	    '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+	    '/' - 63, 'A', 0, 0);
+	__m128i idx = _mm_subs_epu8(in, _mm_set1_epi8(51));
+	const __m128i lt26 = _mm_cmpgt_epi8(_mm_set1_epi8(26), in);
+
+	idx = _mm_or_si128(idx, _mm_and_si128(lt26, _mm_set1_epi8(13)));
+	return _mm_add_epi8(in, _mm_shuffle_epi8(lut, idx));
+}
+
+/*
+ * Split 12 bytes, in the first 12 bytes of 'in', into 16 6-bit values.
+ * Every 3 bytes are spread over 4 bytes, and the 4 values are shifted
+ * into place with multiplications.
+ */
+static inline SSSE3 __m128i
+enc_reshuffle(__m128i in)
+{
+	__m128i t0, t1, t2, t3;
+
+	in = _mm_shuffle_epi8(in, _mm_set_epi8(
+	    10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+	t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+	t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+	t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+	t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+	return _mm_or_si128(t1, t3);
+}
+
+static SSSE3 size_t
+encode_ssse3(const uint8_t *src, size_t srclen, char *dst, size_t dstsize)
+{
+	size_t i = 0, o = 0;
+
+	/* A block reads 16 bytes, of which 12 are encoded */
+	while (srclen - i >= 16 && dstsize - o >= 16) {
+		const __m128i in = _mm_loadu_si128((const __m128i *) &src[i]);
+
+		_mm_storeu_si128((__m128i *) &dst[o],
+		    enc_translate(enc_reshuffle(in)));
+		i += 12;
+		o += 16;
+	}
+	return i;
+}
+
+static inline AVX2 __m256i
+enc_translate_avx2(const __m256i in)
+{
+	const __m256i lut = _mm256_setr_epi8(
+	    'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+	    '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+	    '/' - 63, 'A', 0, 0,
+	    'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+	    '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+	    '/' - 63, 'A', 0, 0);
+	__m256i idx = _mm256_subs_epu8(in, _mm256_set1_epi8(51));
+	const __m256i lt26 = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), in);
+
+	idx = _mm256_or_si256(idx, _mm256_and_si256(lt26,
+	    _mm256_set1_epi8(13)));
+	return _mm256_add_epi8(in, _mm256_shuffle_epi8(lut, idx));
+}
+
+static inline AVX2 __m256i
+enc_reshuffle_avx2(__m256i in)
+{
+	__m256i t0, t1, t2, t3;
+
+	in = _mm256_shuffle_epi8(in, _mm256_set_epi8(
+	    10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1,
+	    10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+	t0 = _mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00));
+	t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+	t2 = _mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0));
+	t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+	return _mm256_or_si256(t1, t3);
+}
+
+static AVX2 size_t
+encode_avx2(const uint8_t *src, size_t srclen, char *dst, size_t dstsize)
+{
+	size_t i = 0, o = 0;
+
+	/* A block reads 28 bytes, of which 24 are encoded: 12 per lane */
+	while (srclen - i >= 28 && dstsize - o >= 32) {
+		const __m128i lo = _mm_loadu_si128((const __m128i *) &src[i]);
+		const __m128i hi = _mm_loadu_si128((const __m128i *)
+		    &src[i + 12]);
+		const __m256i in = _mm256_inserti128_si256(
+		    _mm256_castsi128_si256(lo), hi, 1);
+
+		_mm256_storeu_si256((__m256i *) &dst[o],
+		    enc_translate_avx2(enc_reshuffle_avx2(in)));
+		i += 24;
+		o += 32;
+	}
+
+	/*
+	 * Clear the upper halves of the registers, or the SSE code of the
+	 * rest is slowed down by transitions
+	 */
+	_mm256_zeroupper();
+	return i + encode_ssse3(&src[i], srclen - i, &dst[o], dstsize - o);
+}
+
+/*
+ * Decode 16 characters. Returns false if one of them isn't in the
+ * alphabet, i.e. if it's whitespace, padding, the terminating null or
+ * invalid, which are left to the scalar code. The nibbles of every
+ * character index two tables of bit flags, which only have a flag in
+ * common for characters outside the alphabet. The high nibble then
+ * selects the offset that maps the character to its value, with '/'
+ * as a special case.
+ */
+static inline SSSE3 bool
+dec_block(const unsigned char *src, uint8_t *dst)
+{
+	const __m128i lut_lo = _mm_setr_epi8(
+	    0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+	    0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+	const __m128i lut_hi = _mm_setr_epi8(
+	    0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+	    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+	const __m128i lut_roll = _mm_setr_epi8(
+	    0, 16, 19, 4, -65, -65, -71, -71,
+	    0, 0, 0, 0, 0, 0, 0, 0);
+	const __m128i mask_2f = _mm_set1_epi8(0x2f);
+	__m128i in = _mm_loadu_si128((const __m128i *) src);
+	__m128i hi_nibbles, lo_nibbles, hi, lo, eq_2f, out;
+
+	hi_nibbles = _mm_and_si128(_mm_srli_epi32(in, 4), mask_2f);
+	lo_nibbles = _mm_and_si128(in, mask_2f);
+	hi = _mm_shuffle_epi8(lut_hi, hi_nibbles);
+	lo = _mm_shuffle_epi8(lut_lo, lo_nibbles);
+	if (_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_and_si128(lo, hi),
+	    _mm_setzero_si128())) != 0)
+		return false;
+
+	eq_2f = _mm_cmpeq_epi8(in, mask_2f);
+	in = _mm_add_epi8(in, _mm_shuffle_epi8(lut_roll,
+	    _mm_add_epi8(eq_2f, hi_nibbles)));
+
+	/* Pack 4 6-bit values into 3 bytes, in big-endian order */
+	out = _mm_maddubs_epi16(in, _mm_set1_epi32(0x01400140));
+	out = _mm_madd_epi16(out, _mm_set1_epi32(0x00011000));
+	out = _mm_shuffle_epi8(out, _mm_setr_epi8(
+	    2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+	_mm_storeu_si128((__m128i *) dst, out);
+	return true;
+}
+
+static SSSE3 size_t
+decode_ssse3(const unsigned char *src, size_t srclen, uint8_t *dst,
+    size_t dstsize)
+{
+	size_t i = 0, o = 0;
+
+	/* A block writes 16 bytes, of which 12 are decoded */
+	while (srclen - i >= 16 && dstsize - o >= 16 &&
+	    dec_block(&src[i], &dst[o])) {
+		i += 16;
+		o += 12;
+	}
+	return i;
+}
+
+static AVX2 size_t
+decode_avx2(const unsigned char *src, size_t srclen, uint8_t *dst,
+    size_t dstsize)
+{
+	const __m256i lut_lo = _mm256_setr_epi8(
+	    0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+	    0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a,
+	    0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+	    0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+	const __m256i lut_hi = _mm256_setr_epi8(
+	    0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+	    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+	    0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+	    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+	const __m256i lut_roll = _mm256_setr_epi8(
+	    0, 16, 19, 4, -65, -65, -71, -71,
+	    0, 0, 0, 0, 0, 0, 0, 0,
+	    0, 16, 19, 4, -65, -65, -71, -71,
+	    0, 0, 0, 0, 0, 0, 0, 0);
+	const __m256i mask_2f = _mm256_set1_epi8(0x2f);
+	size_t i = 0, o = 0;
+
+	/* A block writes 32 bytes, of which 24 are decoded */
+	while (srclen - i >= 32 && dstsize - o >= 32) {
+		__m256i in = _mm256_loadu_si256((const __m256i *) &src[i]);
+		__m256i hi_nibbles, lo_nibbles, hi, lo, eq_2f, out;
+
+		hi_nibbles = _mm256_and_si256(_mm256_srli_epi32(in, 4),
+		    mask_2f);
+		lo_nibbles = _mm256_and_si256(in, mask_2f);
+		hi = _mm256_shuffle_epi8(lut_hi, hi_nibbles);
+		lo = _mm256_shuffle_epi8(lut_lo, lo_nibbles);
+		if (!_mm256_testz_si256(lo, hi))
+			break;
+
+		eq_2f = _mm256_cmpeq_epi8(in, mask_2f);
+		in = _mm256_add_epi8(in, _mm256_shuffle_epi8(lut_roll,
+		    _mm256_add_epi8(eq_2f, hi_nibbles)));
+
+		out = _mm256_maddubs_epi16(in, _mm256_set1_epi32(0x01400140));
+		out = _mm256_madd_epi16(out, _mm256_set1_epi32(0x00011000));
+		out = _mm256_shuffle_epi8(out, _mm256_setr_epi8(
+		    2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+		    2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+		/* Move the 12 bytes of the high lane next to the low */
+		out = _mm256_permutevar8x32_epi32(out,
+		    _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7));
+		_mm256_storeu_si256((__m256i *) &dst[o], out);
+		i += 32;
+		o += 24;
+	}
+
+	_mm256_zeroupper();
+	return i + decode_ssse3(&src[i], srclen - i, &dst[o], dstsize - o);
+}
+#endif /* B64_SIMD */
+
+/**
+ * Get the best instruction set that the CPU supports
+ */
+enum b64_isa
+b64_isa_supported(void)
+{
+#if B64_SIMD
+	if (__builtin_cpu_supports("avx2"))
+		return B64_ISA_AVX2;
+	else if (__builtin_cpu_supports("ssse3"))
+		return B64_ISA_SSSE3;
+#endif
+	return B64_ISA_SCALAR;
+}
+
+const char *
+b64_isa_name(enum b64_isa isa)
+{
+	switch (isa) {
+	case B64_ISA_AVX2:
+		return "avx2";
+	case B64_ISA_SSSE3:
+		return "ssse3";
+	case B64_ISA_SCALAR:
+	default:
+		break;
+	}
+	return "scalar";
+}
+
+/**
+ * Encode the whole blocks at the beginning of the input. A block is
+ * only encoded if its input and output fit, with room for the extra
+ * bytes that are read and written.
+ *
+ * @param isa		Instruction set
+ * @param src		Input
+ * @param srclen	Input length
+ * @param dst		Receives 4 characters per 3 bytes encoded
+ * @param dstsize	Size of the output buffer
+ * @return The number of bytes encoded, a multiple of 3
+ */
+size_t
+b64_encode_blocks(enum b64_isa isa, const uint8_t *src, size_t srclen,
+    char *dst, size_t dstsize)
+{
+#if B64_SIMD
+	switch (isa) {
+	case B64_ISA_AVX2:
+		return encode_avx2(src, srclen, dst, dstsize);
+	case B64_ISA_SSSE3:
+		return encode_ssse3(src, srclen, dst, dstsize);
+	case B64_ISA_SCALAR:
+	default:
+		break;
+	}
+#else
+	(void) isa;
+	(void) src;
+	(void) srclen;
+	(void) dst;
+	(void) dstsize;
+#endif
+	return 0;
+}
+
+/**
+ * Decode the whole blocks at the beginning of the input. It stops at
+ * the first block with a character outside the alphabet.
+ *
+ * @param isa		Instruction set
+ * @param src		Input
+ * @param srclen	Input length
+ * @param dst		Receives 3 bytes per 4 characters decoded
+ * @param dstsize	Size of the output buffer
+ * @return The number of characters decoded, a multiple of 4
+ */
+size_t
+b64_decode_blocks(enum b64_isa isa, const unsigned char *src, size_t srclen,
+    uint8_t *dst, size_t dstsize)
+{
+#if B64_SIMD
+	switch (isa) {
+	case B64_ISA_AVX2:
+		return decode_avx2(src, srclen, dst, dstsize);
+	case B64_ISA_SSSE3:
+		return decode_ssse3(src, srclen, dst, dstsize);
+	case B64_ISA_SCALAR:
+	default:
+		break;
+	}
+#else
+	(void) isa;
+	(void) src;
+	(void) srclen;
+	(void) dst;
+	(void) dstsize;
+#endif
+	return 0;
+}
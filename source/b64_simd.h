@@ -0,0 +1,44 @@
+#ifndef B64_SIMD_H
+#define B64_SIMD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ducdef.h"
+
+/*
+ * Vectorized base64 on x86 with GCC or Clang: whole blocks are encoded
+ * and decoded with SSSE3 or AVX2, selected at runtime, and the rest
+ * is left to the scalar code of b64_encode() and b64_decode(). The
+ * build option B64_SIMD set to 0 compiles it out.
+ */
+#ifndef B64_SIMD
+#if (defined(__x86_64__) || defined(__i386__)) &&\
+    (defined(__GNUC__) || defined(__clang__))
+#define B64_SIMD 1
+#else
+#define B64_SIMD 0
+#endif
+#endif
+
+enum b64_isa {
+	B64_ISA_SCALAR,
+	B64_ISA_SSSE3,
+	B64_ISA_AVX2
+};
+
+__DUC_BEGIN_DECLS
+enum b64_isa	b64_isa_supported(void);
+const char	*b64_isa_name(enum b64_isa);
+
+size_t	b64_decode_blocks(enum b64_isa, const unsigned char *, size_t,
+	    uint8_t *, size_t);
+size_t	b64_encode_blocks(enum b64_isa, const uint8_t *, size_t, char *,
+	    size_t);
+
+int	b64_decode_isa(enum b64_isa, char const *, uint8_t *, size_t);
+int	b64_encode_isa(enum b64_isa, uint8_t const *, size_t, char *,
+	    size_t);
+__DUC_END_DECLS
+
+#endif
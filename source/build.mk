@@ -1,14 +1,27 @@
 SRC_DIR := source/
 
-OBJS = $(SRC_DIR)b64_decode.o\
+OBJS = $(SRC_DIR)arena.o\
+	$(SRC_DIR)b64_decode.o\
 	$(SRC_DIR)b64_encode.o\
+	$(SRC_DIR)b64_simd.o\
+	$(SRC_DIR)confcache.o\
+	$(SRC_DIR)control.o\
 	$(SRC_DIR)daemonize.o\
+	$(SRC_DIR)format.o\
+	$(SRC_DIR)histogram.o\
 	$(SRC_DIR)interpreter.o\
+	$(SRC_DIR)json.o\
+	$(SRC_DIR)listener.o\
 	$(SRC_DIR)log.o\
+	$(SRC_DIR)logfile.o\
 	$(SRC_DIR)main.o\
+	$(SRC_DIR)metrics.o\
 	$(SRC_DIR)my_vasprintf.o\
+	$(SRC_DIR)netstats.o\
 	$(SRC_DIR)network-openssl.o\
 	$(SRC_DIR)network.o\
+	$(SRC_DIR)pool.o\
+	$(SRC_DIR)protocol.o\
 	$(SRC_DIR)settings.o\
 	$(SRC_DIR)sig.o\
 	$(SRC_DIR)strlcat.o\
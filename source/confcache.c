@@ -0,0 +1,451 @@
+/* Copyright (c) 2026 Markus Uhlin <markus.uhlin@icloud.com>
+   All rights reserved.
+
+   Permission to use, copy, modify, and distribute this software for any
+   purpose with or without fee is hereby granted, provided that the above
+   copyright notice and this permission notice appear in all copies.
+
+   THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+   WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+   AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+   DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR
+   PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+   TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+   PERFORMANCE OF THIS SOFTWARE. */
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "confcache.h"
+#include "interpreter.h"
+#include "log.h"
+#include "settings.h"
+#include "various.h"
+#include "wrapper.h"
+
+#define FNV_OFFSET_BASIS	0xcbf29ce484222325ULL
+#define FNV_PRIME		0x100000001b3ULL
+
+struct source_tag {
+	char		*path;
+	uint64_t	 size;
+	int64_t		 mtime;
+	uint64_t	 hash;
+	uint32_t	 exists;
+};
+
+struct buffer_tag {
+	char	*data;
+	size_t	 len;
+	size_t	 cap;
+};
+
+struct cursor_tag {
+	const char	*ptr;
+	const char	*end;
+};
+
+static struct source_tag	*sources = NULL;
+static size_t			 sources_count = 0;
+
+/**
+ * Hash some bytes. This is FNV-1a applied to 64-bit words instead of
+ * single bytes (the tail is hashed byte by byte). It's used to detect
+ * changes, not tampering.
+ *
+ * @param data	Bytes to hash
+ * @param len	Number of bytes
+ * @param hash	Initial value (FNV offset basis if zero)
+ * @return The hash
+ */
+uint64_t
+confcache_hash(const void *data, size_t len, uint64_t hash)
+{
+	const unsigned char	*p = data;
+	uint64_t		 word;
+
+	if (hash == 0)
+		hash = FNV_OFFSET_BASIS;
+	for (; len >= sizeof word; p += sizeof word, len -= sizeof word) {
+		memcpy(&word, p, sizeof word);
+		hash = (hash ^ word) * FNV_PRIME;
+	}
+	for (; len > 0; p++, len--)
+		hash = (hash ^ *p) * FNV_PRIME;
+	return hash;
+}
+
+static bool
+hash_file(const char *path, uint64_t *hash)
+{
+	int		 fd;
+	struct stat	 sb;
+	void		*map;
+
+	if ((fd = open(path, O_RDONLY)) == -1)
+		return false;
+	if (fstat(fd, &sb) == -1 || !S_ISREG(sb.st_mode)) {
+		(void) close(fd);
+		return false;
+	}
+	if (sb.st_size == 0) {
+		(void) close(fd);
+		*hash = confcache_hash(NULL, 0, 0);
+		return true;
+	}
+	map = mmap(NULL, (size_t) sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	(void) close(fd);
+	if (map == MAP_FAILED)
+		return false;
+	*hash = confcache_hash(map, (size_t) sb.st_size, 0);
+	(void) munmap(map, (size_t) sb.st_size);
+	return true;
+}
+
+/*
+ * Record the state of a source. Files are hashed right when the
+ * interpreter has opened them.
+ */
+static bool
+stat_source(const char *path, struct source_tag *src)
+{
+	struct stat sb;
+
+	src->size = 0;
+	src->mtime = 0;
+	src->hash = 0;
+	src->exists = 0;
+
+	if (stat(path, &sb) != 0)
+		return true;
+	src->size = (uint64_t) sb.st_size;
+	src->mtime = (int64_t) sb.st_mtime;
+	src->exists = 1;
+	return (!S_ISREG(sb.st_mode) || hash_file(path, &src->hash));
+}
+
+static void
+add_source(const char *path)
+{
+	struct source_tag *src;
+
+	if (sources == NULL) {
+		sources = xcalloc(1, sizeof *sources);
+	} else {
+		sources = xrealloc(sources, size_product(sources_count + 1,
+		    sizeof *sources));
+	}
+	src = &sources[sources_count++];
+	src->path = xstrdup(path);
+	if (!stat_source(path, src))
+		src->exists = 0;
+}
+
+static void
+free_sources(void)
+{
+	for (size_t i = 0; i < sources_count; i++)
+		free(sources[i].path);
+	free_not_null(sources);
+	sources = NULL;
+	sources_count = 0;
+}
+
+static bool
+is_source_current(const char *path, const struct source_tag *rec)
+{
+	struct source_tag now;
+
+	if (!stat_source(path, &now))
+		return false;
+	return (now.exists == rec->exists &&
+	    now.size == rec->size &&
+	    now.mtime == rec->mtime &&
+	    now.hash == rec->hash);
+}
+
+/* ----------------------------------------------------------------- */
+
+static void
+buffer_append(struct buffer_tag *buf, const void *data, size_t len)
+{
+	if (buf->len + len > buf->cap) {
+		while (buf->len + len > buf->cap)
+			buf->cap = (buf->cap ? buf->cap * 2 : 4096);
+		buf->data = (buf->data ? xrealloc(buf->data, buf->cap) :
+		    xmalloc(buf->cap));
+	}
+	memcpy(&buf->data[buf->len], data, len);
+	buf->len += len;
+}
+
+static void
+buffer_append_u32(struct buffer_tag *buf, uint32_t val)
+{
+	buffer_append(buf, &val, sizeof val);
+}
+
+static void
+buffer_append_u64(struct buffer_tag *buf, uint64_t val)
+{
+	buffer_append(buf, &val, sizeof val);
+}
+
+static void
+buffer_append_str(struct buffer_tag *buf, const char *str)
+{
+	buffer_append(buf, str, strlen(str) + 1);
+}
+
+static const void *
+cursor_take(struct cursor_tag *cur, size_t len)
+{
+	const void *p = cur->ptr;
+
+	if ((size_t) (cur->end - cur->ptr) < len)
+		return NULL;
+	cur->ptr += len;
+	return p;
+}
+
+static bool
+cursor_u32(struct cursor_tag *cur, uint32_t *val)
+{
+	const void *p;
+
+	if ((p = cursor_take(cur, sizeof *val)) == NULL)
+		return false;
+	memcpy(val, p, sizeof *val);
+	return true;
+}
+
+static bool
+cursor_u64(struct cursor_tag *cur, uint64_t *val)
+{
+	const void *p;
+
+	if ((p = cursor_take(cur, sizeof *val)) == NULL)
+		return false;
+	memcpy(val, p, sizeof *val);
+	return true;
+}
+
+/*
+ * Take a null-terminated string of the given length
+ */
+static const char *
+cursor_str(struct cursor_tag *cur, uint32_t len)
+{
+	const char *str;
+
+	if ((size_t) len + 1 < len ||
+	    (str = cursor_take(cur, (size_t) len + 1)) == NULL ||
+	    str[len] != '\0' || strlen(str) != len)
+		return NULL;
+	return str;
+}
+
+/* ----------------------------------------------------------------- */
+
+static bool
+check_sources(struct cursor_tag *cur, uint32_t n_sources)
+{
+	for (uint32_t i = 0; i < n_sources; i++) {
+		const char		*path;
+		struct source_tag	 rec;
+		uint32_t		 path_len;
+
+		if (!cursor_u64(cur, &rec.size) ||
+		    !cursor_u64(cur, (uint64_t *) &rec.mtime) ||
+		    !cursor_u64(cur, &rec.hash) ||
+		    !cursor_u32(cur, &rec.exists) ||
+		    !cursor_u32(cur, &path_len) ||
+		    (path = cursor_str(cur, path_len)) == NULL)
+			return false;
+		if (!is_source_current(path, &rec)) {
+			log_debug("%s: %s has changed", __func__, path);
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool
+install_settings(struct cursor_tag cur, uint32_t n_settings)
+{
+	/* The first pass validates the records, and the second installs. */
+	for (int pass = 0; pass < 2; pass++) {
+		struct cursor_tag c = cur;
+
+		for (uint32_t i = 0; i < n_settings; i++) {
+			const char	*name, *value;
+			uint32_t	 name_len, value_len;
+
+			if (!cursor_u32(&c, &name_len) ||
+			    !cursor_u32(&c, &value_len) ||
+			    (name = cursor_str(&c, name_len)) == NULL ||
+			    (value = cursor_str(&c, value_len)) == NULL)
+				return false;
+			if (pass == 1 && install_setting(name, value) != 0) {
+				destroy_config_custom_values();
+				return false;
+			}
+		}
+		if (c.ptr != c.end)
+			return false;
+	}
+	return true;
+}
+
+static bool
+load_image(const char *image_path)
+{
+	bool			 ok = false;
+	int			 fd;
+	size_t			 size;
+	struct confcache_header	 hdr;
+	struct cursor_tag	 cur;
+	struct stat		 sb;
+	void			*map;
+
+	if ((fd = open(image_path, O_RDONLY)) == -1)
+		return false;
+	if (fstat(fd, &sb) == -1 || !S_ISREG(sb.st_mode) ||
+	    (size = (size_t) sb.st_size) < sizeof hdr ||
+	    (map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0)) ==
+	    MAP_FAILED) {
+		(void) close(fd);
+		return false;
+	}
+
+	(void) close(fd);
+	memcpy(&hdr, map, sizeof hdr);
+	cur.ptr = (const char *) map + sizeof hdr;
+	cur.end = (const char *) map + size;
+
+	if (memcmp(hdr.magic, CONFCACHE_MAGIC, sizeof hdr.magic) != 0 ||
+	    hdr.version != CONFCACHE_VERSION) {
+		log_debug("%s: %s: bad magic or version", __func__,
+		    image_path);
+	} else if (hdr.payload_size != size - sizeof hdr ||
+	    hdr.payload_hash != confcache_hash(cur.ptr, (size_t)
+	    hdr.payload_size, 0)) {
+		log_warn(0, "%s: %s: checksum mismatch", __func__, image_path);
+	} else if (check_sources(&cur, hdr.n_sources)) {
+		ok = install_settings(cur, hdr.n_settings);
+	}
+
+	(void) munmap(map, size);
+	return ok;
+}
+
+static void
+store_image(const char *image_path)
+{
+	char			*tmp_path;
+	int			 fd;
+	struct buffer_tag	 buf = { NULL, 0, 0 };
+	struct confcache_header	 hdr = { { 0 } };
+	const char		*name, *value;
+
+	buffer_append(&buf, &hdr, sizeof hdr);
+
+	for (size_t i = 0; i < sources_count; i++) {
+		const struct source_tag *src = &sources[i];
+
+		buffer_append_u64(&buf, src->size);
+		buffer_append_u64(&buf, (uint64_t) src->mtime);
+		buffer_append_u64(&buf, src->hash);
+		buffer_append_u32(&buf, src->exists);
+		buffer_append_u32(&buf, (uint32_t) strlen(src->path));
+		buffer_append_str(&buf, src->path);
+		hdr.n_sources++;
+	}
+	for (size_t i = 0; setting_by_index(i, &name, &value); i++) {
+		if (value == NULL)
+			continue;
+		buffer_append_u32(&buf, (uint32_t) strlen(name));
+		buffer_append_u32(&buf, (uint32_t) strlen(value));
+		buffer_append_str(&buf, name);
+		buffer_append_str(&buf, value);
+		hdr.n_settings++;
+	}
+
+	memcpy(hdr.magic, CONFCACHE_MAGIC, sizeof hdr.magic);
+	hdr.version = CONFCACHE_VERSION;
+	hdr.payload_size = buf.len - sizeof hdr;
+	hdr.payload_hash = confcache_hash(&buf.data[sizeof hdr],
+	    buf.len - sizeof hdr, 0);
+	memcpy(buf.data, &hdr, sizeof hdr);
+
+	/*
+	 * Write a temporary file (mode 0600 by mkstemp) and rename it,
+	 * so that a crash never leaves a partially written image behind.
+	 */
+	tmp_path = strdup_printf("%s.XXXXXX", image_path);
+
+	if ((fd = mkstemp(tmp_path)) == -1) {
+		log_warn(errno, "%s: mkstemp", __func__);
+	} else if (write(fd, buf.data, buf.len) != (ssize_t) buf.len) {
+		log_warn(errno, "%s: write", __func__);
+		(void) close(fd);
+		(void) unlink(tmp_path);
+	} else if (close(fd) != 0) {
+		/* The descriptor is released even if close() fails */
+		log_warn(errno, "%s: close", __func__);
+		(void) unlink(tmp_path);
+	} else if (rename(tmp_path, image_path) != 0) {
+		log_warn(errno, "%s: rename", __func__);
+		(void) unlink(tmp_path);
+	} else {
+		log_debug("%s: %s written", __func__, image_path);
+	}
+
+	free(tmp_path);
+	free(buf.data);
+}
+
+/**
+ * Read the config file by way of a precompiled binary image of it,
+ * stored next to the file. If the image is missing, damaged, or if
+ * any of the files it was compiled from have changed (by mtime, size
+ * or hash) the config file is read as usual and the image is rebuilt.
+ * In either case the settings are checked strictly.
+ *
+ * @param path Path to the config file
+ * @return Void
+ */
+void
+read_config_cache(const char *path)
+{
+	char *image_path;
+
+	log_assert_arg_nonnull("read_config_cache", "path", path);
+
+	if (g_conf_read)
+		return;
+
+	image_path = strdup_printf("%s%s", path, CONFCACHE_SUFFIX);
+
+	if (load_image(image_path)) {
+		log_debug("%s: using %s", __func__, image_path);
+		g_conf_read = true;
+		check_some_settings_strictly();
+	} else {
+		Interpreter_setSourceFunc(add_source);
+		read_config_file(path);
+		Interpreter_setSourceFunc(NULL);
+		check_some_settings_strictly();
+		store_image(image_path);
+		free_sources();
+	}
+
+	free(image_path);
+}
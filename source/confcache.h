@@ -0,0 +1,38 @@
+#ifndef CONFCACHE_H
+#define CONFCACHE_H
+
+#include <stdint.h>
+
+#include "ducdef.h"
+
+#define CONFCACHE_MAGIC		"EDUCCFG"
+#define CONFCACHE_VERSION	1
+#define CONFCACHE_SUFFIX	".cache"
+
+/*
+ * The image starts with this header. It's followed by the payload:
+ * first 'n_sources' source records and then 'n_settings' setting
+ * records. Integers are stored in host byte order.
+ *
+ * Source record: size (uint64), mtime (int64), content hash (uint64),
+ * exists (uint32), path length (uint32), path + '\0'.
+ *
+ * Setting record: name length (uint32), value length (uint32),
+ * name + '\0', value + '\0'.
+ */
+struct confcache_header {
+	char		magic[8];
+	uint32_t	version;
+	uint32_t	n_sources;
+	uint32_t	n_settings;
+	uint32_t	reserved;
+	uint64_t	payload_size;
+	uint64_t	payload_hash;
+};
+
+__DUC_BEGIN_DECLS
+uint64_t	confcache_hash(const void *, size_t, uint64_t);
+void		read_config_cache(const char *);
+__DUC_END_DECLS
+
+#endif
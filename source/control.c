@@ -0,0 +1,174 @@
+/* Copyright (c) 2026 Markus Uhlin <markus.uhlin@icloud.com>
+   All rights reserved.
+
+   Permission to use, copy, modify, and distribute this software for any
+   purpose with or without fee is hereby granted, provided that the above
+   copyright notice and this permission notice appear in all copies.
+
+   THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+   WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+   AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+   DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR
+   PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+   TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+   PERFORMANCE OF THIS SOFTWARE. */
+
+#include <string.h>
+
+#include "control.h"
+#include "log.h"
+#include "metrics.h"
+#include "various.h"
+
+static const struct control_hooks *hooks = NULL;
+
+static const char help_text[] =
+    "update [host ...]  update all hosts, or the hosts given, now\n"
+    "state              print the state of the update cycle and hosts\n"
+    "debug [on|off]     toggle debug mode, or turn it on or off\n"
+    "reload             reread the config file\n"
+    "stats              print update counters and request latencies\n"
+    "help               print this text\n";
+
+static void
+cmd_debug(int argc, char *argv[], struct listener_reply *reply)
+{
+	if (argc == 0)
+		g_debug_mode = !g_debug_mode;
+	else if (argc == 1 && strings_match(argv[0], "on"))
+		g_debug_mode = true;
+	else if (argc == 1 && strings_match(argv[0], "off"))
+		g_debug_mode = false;
+	else {
+		reply_printf(reply, "error: usage: debug [on|off]\n");
+		return;
+	}
+
+	log_msg("control: debug mode %s", (g_debug_mode ? "on" : "off"));
+	reply_printf(reply, "debug mode %s\n", (g_debug_mode ? "on" : "off"));
+}
+
+static void
+cmd_help(int argc, char *argv[], struct listener_reply *reply)
+{
+	(void) argc;
+	(void) argv;
+	reply_write(reply, help_text, sizeof help_text - 1);
+}
+
+static void
+cmd_reload(int argc, char *argv[], struct listener_reply *reply)
+{
+	(void) argv;
+	if (argc != 0)
+		reply_printf(reply, "error: usage: reload\n");
+	else if (hooks && hooks->reload)
+		hooks->reload(reply);
+	else
+		reply_printf(reply, "error: not available\n");
+}
+
+static void
+cmd_state(int argc, char *argv[], struct listener_reply *reply)
+{
+	(void) argv;
+	if (argc != 0)
+		reply_printf(reply, "error: usage: state\n");
+	else if (hooks && hooks->state)
+		hooks->state(reply);
+	else
+		reply_printf(reply, "error: not available\n");
+}
+
+static void
+cmd_stats(int argc, char *argv[], struct listener_reply *reply)
+{
+	(void) argv;
+	if (argc != 0)
+		reply_printf(reply, "error: usage: stats\n");
+	else
+		metrics_render_summary(reply);
+}
+
+static void
+cmd_update(int argc, char *argv[], struct listener_reply *reply)
+{
+	if (hooks && hooks->update)
+		hooks->update(argc, argv, reply);
+	else
+		reply_printf(reply, "error: not available\n");
+}
+
+static const struct {
+	const char	*name;
+	void		(*run)(int, char *[], struct listener_reply *);
+} commands[] = {
+	{ "debug",  cmd_debug  },
+	{ "help",   cmd_help   },
+	{ "reload", cmd_reload },
+	{ "state",  cmd_state  },
+	{ "stats",  cmd_stats  },
+	{ "update", cmd_update },
+};
+
+/*
+ * A command is a line
+ */
+static bool
+control_complete(const char *req, size_t len)
+{
+	return (memchr(req, '\n', len) != NULL);
+}
+
+static void
+control_respond(const char *req, size_t len, struct listener_reply *reply)
+{
+	char	 line[LISTENER_REQUEST_MAX];
+	char	*argv[CONTROL_ARGS_MAX];
+	char	*last = NULL;
+	int	 argc = 0;
+
+	(void) strlcpy(line, req, sizeof line);
+	line[strcspn(line, "\r\n")] = '\0';
+	(void) len;
+
+	for (char *cp = strtok_r(line, " \t", &last); cp != NULL;
+	    cp = strtok_r(NULL, " \t", &last)) {
+		if (argc == CONTROL_ARGS_MAX) {
+			reply_printf(reply, "error: too many arguments\n");
+			return;
+		}
+		argv[argc++] = cp;
+	}
+
+	if (argc == 0) {
+		reply_printf(reply, "error: no command. try \"help\"\n");
+		return;
+	}
+	for (size_t i = 0; i < nitems(commands); i++) {
+		if (strings_match(commands[i].name, argv[0])) {
+			log_debug("control: %s", argv[0]);
+			commands[i].run(argc - 1, &argv[1], reply);
+			return;
+		}
+	}
+	reply_printf(reply, "error: unknown command \"%.64s\". try "
+	    "\"help\"\n", argv[0]);
+}
+
+const struct listener_ops g_control_ops = {
+	.name     = "control",
+	.complete = control_complete,
+	.respond  = control_respond,
+};
+
+/**
+ * Set the functions that carry out the commands that act on the update
+ * cycle
+ */
+void
+control_set_hooks(const struct control_hooks *h)
+{
+	hooks = h;
+}
@@ -0,0 +1,26 @@
+#ifndef CONTROL_H
+#define CONTROL_H
+
+#include "ducdef.h"
+#include "listener.h"
+
+#define CONTROL_ARGS_MAX 64
+
+/*
+ * The commands that act on the state of the update cycle are handed
+ * to the cycle. The arguments are the words of the command line
+ * following the command.
+ */
+struct control_hooks {
+	void (*update)(int argc, char *argv[], struct listener_reply *);
+	void (*state)(struct listener_reply *);
+	void (*reload)(struct listener_reply *);
+};
+
+__DUC_BEGIN_DECLS
+extern const struct listener_ops g_control_ops;
+
+void	control_set_hooks(const struct control_hooks *);
+__DUC_END_DECLS
+
+#endif
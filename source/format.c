@@ -0,0 +1,306 @@
+/* Copyright (c) 2026 Markus Uhlin <markus.uhlin@icloud.com>
+   All rights reserved.
+
+   Permission to use, copy, modify, and distribute this software for any
+   purpose with or without fee is hereby granted, provided that the above
+   copyright notice and this permission notice appear in all copies.
+
+   THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+   WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+   AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+   DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR
+   PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+   TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+   PERFORMANCE OF THIS SOFTWARE. */
+
+#include <sys/types.h>
+
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "arena.h"
+#include "format.h"
+#include "log.h"
+#include "wrapper.h"
+
+#define FMT_INITIAL_SIZE 256
+
+/*
+ * Make room for 'need' bytes, the terminating null included
+ */
+static bool
+grow(struct fmt_buf *f, size_t need)
+{
+	size_t size;
+
+	if (f->grow == FMT_FIXED)
+		return false;
+	if (need > (size_t) INT_MAX + 1)
+		fatal(EOVERFLOW, "fmt: output too long");
+
+	size = (f->size > 0 ? f->size : FMT_INITIAL_SIZE);
+	while (size < need)
+		size = (size > SIZE_MAX / 2 ? need : size * 2);
+
+	if (f->grow == FMT_ARENA) {
+		f->data = (f->allocated ?
+		    arena_realloc(f->arena, f->data, f->size, size) :
+		    memcpy(arena_alloc(f->arena, size), (f->data ? f->data :
+		    ""), (f->data ? f->len + 1 : 1)));
+	} else if (f->allocated) {
+		f->data = xrealloc(f->data, size);
+	} else {
+		f->data = memcpy(xmalloc(size), (f->data ? f->data : ""),
+		    (f->data ? f->len + 1 : 1));
+	}
+	f->size = size;
+	f->allocated = true;
+	return true;
+}
+
+/**
+ * Set up a formatter
+ *
+ * @param f	The formatter
+ * @param buf	The buffer of the caller, or NULL
+ * @param size	Its size
+ * @param mode	What to do if the buffer overflows
+ * @param a	The arena to grow in if 'mode' is FMT_ARENA
+ */
+void
+fmt_init(struct fmt_buf *f, char *buf, size_t size, fmt_grow_t mode,
+	 struct arena *a)
+{
+	f->data = (size > 0 ? buf : NULL);
+	f->size = (size > 0 ? size : 0);
+	f->len = 0;
+	f->grow = mode;
+	f->arena = a;
+	f->allocated = false;
+	f->truncated = false;
+	if (f->data)
+		f->data[0] = '\0';
+	if (mode == FMT_FIXED && f->data == NULL)
+		fatal(EINVAL, "fmt_init: no buffer");
+	if (mode == FMT_ARENA && a == NULL)
+		fatal(EINVAL, "fmt_init: no arena");
+}
+
+/*
+ * Append bytes. Returns the number of bytes that didn't fit.
+ */
+static size_t
+put(struct fmt_buf *f, const char *src, size_t len)
+{
+	size_t dropped = 0;
+
+	if (len >= f->size - f->len && !grow(f, f->len + len + 1)) {
+		dropped = len - (f->size - 1 - f->len);
+		len -= dropped;
+		f->truncated = true;
+	}
+	(void) memcpy(&f->data[f->len], src, len);
+	f->len += len;
+	f->data[f->len] = '\0';
+	return dropped;
+}
+
+/**
+ * Append bytes
+ */
+void
+fmt_write(struct fmt_buf *f, const char *src, size_t len)
+{
+	(void) put(f, src, len);
+}
+
+static size_t
+put_integer(struct fmt_buf *f, uintmax_t val, unsigned int base, bool neg)
+{
+	char	 digits[sizeof val * CHAR_BIT / 3 + 2];
+	char	*cp = &digits[sizeof digits];
+
+	do {
+		*--cp = "0123456789abcdef"[val % base];
+		val /= base;
+	} while (val != 0);
+	if (neg)
+		*--cp = '-';
+	return put(f, cp, &digits[sizeof digits] - cp);
+}
+
+/*
+ * Format without printf(). Returns false at the first conversion that
+ * it doesn't do, and the output must then be discarded. '*dropped' is
+ * the number of bytes that didn't fit.
+ */
+static bool
+fast_vprintf(struct fmt_buf *f, const char *format, va_list *ap,
+	     size_t *dropped)
+{
+	const char *cp = format;
+
+	for (;;) {
+		const char	*spec;
+		int		 prec = -1;
+		enum { NONE, LONG, LONG_LONG, SIZE } length = NONE;
+
+		if ((spec = strchr(cp, '%')) == NULL) {
+			*dropped += put(f, cp, strlen(cp));
+			return true;
+		}
+		*dropped += put(f, cp, spec - cp);
+		cp = spec + 1;
+
+		if (cp[0] == '.' && cp[1] == '*' && cp[2] == 's') {
+			prec = va_arg(*ap, int);
+			cp += 2;
+		} else if (cp[0] == 'l' && cp[1] == 'l') {
+			length = LONG_LONG;
+			cp += 2;
+		} else if (cp[0] == 'l') {
+			length = LONG;
+			cp++;
+		} else if (cp[0] == 'z') {
+			length = SIZE;
+			cp++;
+		}
+
+		switch (*cp++) {
+		case '%':
+			if (length != NONE)
+				return false;
+			*dropped += put(f, "%", 1);
+			break;
+		case 'c': {
+			const char c = (char) va_arg(*ap, int);
+
+			if (length != NONE)
+				return false;
+			*dropped += put(f, &c, 1);
+			break;
+		}
+		case 's': {
+			const char	*s;
+			size_t		 len;
+
+			if (length != NONE)
+				return false;
+			if ((s = va_arg(*ap, const char *)) == NULL)
+				s = "(null)";
+			if (prec < 0)
+				len = strlen(s);
+			else
+				len = strnlen(s, prec);
+			*dropped += put(f, s, len);
+			break;
+		}
+		case 'd':
+		case 'i': {
+			intmax_t val;
+
+			if (length == LONG_LONG)
+				val = va_arg(*ap, long long int);
+			else if (length == LONG)
+				val = va_arg(*ap, long int);
+			else if (length == SIZE)
+				val = va_arg(*ap, ssize_t);
+			else
+				val = va_arg(*ap, int);
+			*dropped += put_integer(f, (val < 0 ? (uintmax_t) 0 - val :
+			    (uintmax_t) val), 10, val < 0);
+			break;
+		}
+		case 'u':
+		case 'x': {
+			uintmax_t val;
+
+			if (length == LONG_LONG)
+				val = va_arg(*ap, unsigned long long int);
+			else if (length == LONG)
+				val = va_arg(*ap, unsigned long int);
+			else if (length == SIZE)
+				val = va_arg(*ap, size_t);
+			else
+				val = va_arg(*ap, unsigned int);
+			*dropped += put_integer(f, val, (cp[-1] == 'x' ? 16 : 10), false);
+			break;
+		}
+		default:
+			return false;
+		}
+	}
+}
+
+/**
+ * Append formatted text. A null pointer for %s is written as "(null)".
+ *
+ * @return The length of the text before any truncation, like
+ *         snprintf(), or -1 on error
+ */
+int
+fmt_vprintf(struct fmt_buf *f, const char *format, va_list ap)
+{
+	const size_t	 start = f->len;
+	const bool	 truncated = f->truncated;
+	char		*dest;
+	int		 len;
+	size_t		 avail, dropped = 0;
+	va_list		 ap_copy;
+
+	va_copy(ap_copy, ap);
+	if (fast_vprintf(f, format, &ap_copy, &dropped)) {
+		va_end(ap_copy);
+		if (f->len - start > INT_MAX - dropped) {
+			errno = EOVERFLOW;
+			return -1;
+		}
+		return (int) (f->len - start + dropped);
+	}
+	va_end(ap_copy);
+
+	/* Start over with printf() */
+	f->len = start;
+	f->truncated = truncated;
+	if (f->data)
+		f->data[f->len] = '\0';
+
+	avail = f->size - f->len;
+	dest = (avail > 0 ? &f->data[f->len] : NULL);
+	va_copy(ap_copy, ap);
+	len = vsnprintf(dest, avail, format, ap_copy);
+	va_end(ap_copy);
+
+	if (len < 0) {
+		errno = EINVAL;
+		return -1;
+	} else if ((size_t) len < avail) {
+		f->len += len;
+	} else if (grow(f, f->len + len + 1)) {
+		(void) vsnprintf(&f->data[f->len], len + 1, format, ap);
+		f->len += len;
+	} else {
+		f->len = f->size - 1;
+		f->truncated = true;
+	}
+	return len;
+}
+
+/**
+ * Append formatted text
+ */
+int
+fmt_printf(struct fmt_buf *f, const char *format, ...)
+{
+	int	len;
+	va_list	ap;
+
+	va_start(ap, format);
+	len = fmt_vprintf(f, format, ap);
+	va_end(ap);
+	return len;
+}
@@ -0,0 +1,47 @@
+#ifndef FORMAT_H
+#define FORMAT_H
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "ducdef.h"
+
+struct arena;
+
+typedef enum {
+	FMT_FIXED,	/**< Truncate the output to fit the buffer */
+	FMT_ARENA,	/**< Grow in an arena */
+	FMT_HEAP	/**< Grow on the heap */
+} fmt_grow_t;
+
+/*
+ * A string formatter. The output is written in one pass into the
+ * buffer of the caller, and only if it overflows is the buffer grown,
+ * in an arena or on the heap. With FMT_FIXED the output is bounded
+ * instead: it's truncated to fit. The output is always
+ * null-terminated.
+ *
+ * Conversions of integers, strings and characters without flags or a
+ * field width are formatted here. A format with any other conversion
+ * is handed to vsnprintf().
+ */
+struct fmt_buf {
+	char		*data;
+	size_t		 size;
+	size_t		 len;
+	fmt_grow_t	 grow;
+	struct arena	*arena;
+	bool		 allocated;	/**< 'data' isn't the caller's buffer */
+	bool		 truncated;
+};
+
+__DUC_BEGIN_DECLS
+int	fmt_printf(struct fmt_buf *, const char *, ...) PRINTFLIKE(2);
+int	fmt_vprintf(struct fmt_buf *, const char *, va_list) VPRINTFLIKE(2);
+void	fmt_init(struct fmt_buf *, char *, size_t, fmt_grow_t,
+	    struct arena *);
+void	fmt_write(struct fmt_buf *, const char *, size_t);
+__DUC_END_DECLS
+
+#endif
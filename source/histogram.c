@@ -0,0 +1,111 @@
+/* Copyright (c) 2026 Markus Uhlin <markus.uhlin@icloud.com>
+   All rights reserved.
+
+   Permission to use, copy, modify, and distribute this software for any
+   purpose with or without fee is hereby granted, provided that the above
+   copyright notice and this permission notice appear in all copies.
+
+   THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+   WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+   AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+   DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR
+   PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+   TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+   PERFORMANCE OF THIS SOFTWARE. */
+
+#include "histogram.h"
+
+/**
+ * Get the bucket of a value
+ *
+ * @param value Value
+ * @return The bucket index
+ */
+size_t
+hist_bucket(uint64_t value)
+{
+	unsigned int msb;
+
+	if (value < HIST_SUB_BUCKETS)
+		return (size_t) value;
+
+	msb = 63 - (unsigned int) __builtin_clzll(value);
+	if (msb >= HIST_MAX_BITS)
+		return HIST_BUCKETS - 1;
+	return ((msb - HIST_SUB_BITS + 1) * HIST_SUB_BUCKETS +
+	    ((value >> (msb - HIST_SUB_BITS)) & (HIST_SUB_BUCKETS - 1)));
+}
+
+/**
+ * Get the smallest value of a bucket
+ */
+uint64_t
+hist_bucket_lower(size_t i)
+{
+	const size_t octave = i / HIST_SUB_BUCKETS;
+
+	if (octave == 0)
+		return i;
+	return ((uint64_t) (HIST_SUB_BUCKETS + i % HIST_SUB_BUCKETS) <<
+	    (octave - 1));
+}
+
+/**
+ * Get the largest value of a bucket. The last bucket has no upper
+ * bound and UINT64_MAX is returned.
+ */
+uint64_t
+hist_bucket_upper(size_t i)
+{
+	if (i >= HIST_BUCKETS - 1)
+		return UINT64_MAX;
+	return hist_bucket_lower(i + 1) - 1;
+}
+
+/**
+ * Estimate a quantile. The estimate is the largest value of the bucket
+ * that the quantile falls in, but never more than the largest value
+ * recorded.
+ *
+ * @param h	Histogram
+ * @param q	Quantile, between 0 and 1
+ * @return The estimate, or 0 if nothing has been recorded
+ */
+uint64_t
+hist_quantile(const struct histogram *h, double q)
+{
+	uint64_t	rank, seen = 0;
+	uint64_t	upper;
+
+	if (h->count == 0)
+		return 0;
+	if (q < 0.0)
+		q = 0.0;
+	else if (q > 1.0)
+		q = 1.0;
+
+	if ((rank = (uint64_t) (q * h->count + 0.5)) == 0)
+		rank = 1;
+
+	for (size_t i = 0; i < HIST_BUCKETS; i++) {
+		if ((seen += h->buckets[i]) >= rank) {
+			upper = hist_bucket_upper(i);
+			return (upper < h->max ? upper : h->max);
+		}
+	}
+	return h->max;
+}
+
+/**
+ * Record a value. Nothing is allocated.
+ */
+void
+hist_record(struct histogram *h, uint64_t value)
+{
+	h->buckets[hist_bucket(value)]++;
+	h->count++;
+	h->sum += value;
+	if (value > h->max)
+		h->max = value;
+}
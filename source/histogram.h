@@ -0,0 +1,37 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ducdef.h"
+
+/*
+ * A log-linear histogram: every power of 2 is split into
+ * HIST_SUB_BUCKETS buckets of equal width, so the relative error of a
+ * bucket is at most 1 / HIST_SUB_BUCKETS. Values up to 2^HIST_MAX_BITS
+ * get a bucket of their own, and larger values are put in the last
+ * bucket. With microseconds that's about 71 minutes.
+ */
+#define HIST_SUB_BITS		2
+#define HIST_SUB_BUCKETS	(1 << HIST_SUB_BITS)
+#define HIST_MAX_BITS		32
+#define HIST_BUCKETS		((HIST_MAX_BITS - HIST_SUB_BITS + 1) *\
+				 HIST_SUB_BUCKETS)
+
+struct histogram {
+	uint64_t	count;
+	uint64_t	sum;
+	uint64_t	max;
+	uint64_t	buckets[HIST_BUCKETS];
+};
+
+__DUC_BEGIN_DECLS
+size_t		hist_bucket(uint64_t);
+uint64_t	hist_bucket_lower(size_t);
+uint64_t	hist_bucket_upper(size_t);
+uint64_t	hist_quantile(const struct histogram *, double);
+void		hist_record(struct histogram *, uint64_t);
+__DUC_END_DECLS
+
+#endif
@@ -14,195 +14,704 @@
    TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
    PERFORMANCE OF THIS SOFTWARE. */
 
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <glob.h>
 #include <iostream>
-#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unistd.h>
+#include <vector>
 
 #include "interpreter.h"
 #include "log.h"
 #include "various.h"
-#include "wrapper.h"
-
-const char g_fgets_nullret_err1[70] = "error: fgets() returned null and the "
-    "error indicator is set";
-const char g_fgets_nullret_err2[70] = "error: fgets() returned null for an "
-    "unknown reason";
 
 static const char ArgBegin = '"';
 static const char ArgEnd = '"';
 static const char CommentChar = '#';
+static const char ContinuationChar = '\\';
+
+static const char IncludeKeyword[] = "include";
+
+static const size_t identifier_maxSize = 64;
+
+static unsigned int max_threads = 0;
+static Interpreter_srcFunc source_func = nullptr;
+static bool keep_going = false;
+static size_t error_count = 0;
+
+/*
+ * A tokenized line. The identifier and the argument refer to the
+ * memory the line was read from. A line that is continued spans
+ * several lines of the file.
+ */
+struct statement {
+	std::string_view	line;
+	long int		line_num;
+	std::string_view	id;
+	std::string_view	arg;
+	bool			is_include;
+	interp_res_t		res;
+};
+
+/*
+ * A mapped file. Included files are parsed into a list of statements,
+ * together with the result of tokenizing them, before any of them is
+ * installed.
+ */
+struct mapped_file {
+	std::string		path;
+	void			*map;
+	size_t			size;
+	int			errnum;
+	interp_res_t		res;
+	std::vector<struct statement> statements;
+};
+
+static inline bool
+is_space(const char c)
+{
+	return isspace(static_cast<unsigned char>(c));
+}
+
+static inline bool
+is_identifier_char(const char c)
+{
+	return (isalnum(static_cast<unsigned char>(c)) || c == '_');
+}
 
-static const size_t	identifier_maxSize = 64;
-static const size_t	argument_maxSize = 512;
+static void
+skip_white(std::string_view &sv)
+{
+	while (!sv.empty() && is_space(sv.front()))
+		sv.remove_prefix(1);
+}
+
+static std::string_view
+trim_view(std::string_view sv)
+{
+	while (!sv.empty() && is_space(sv.back()))
+		sv.remove_suffix(1);
+	return sv;
+}
+
+static bool
+consume(std::string_view &sv, const char c)
+{
+	if (sv.empty() || sv.front() != c)
+		return false;
+	sv.remove_prefix(1);
+	return true;
+}
+
+static interp_res_t
+scan_identifier(std::string_view &sv, std::string_view &id)
+{
+	size_t len = 0;
+
+	while (len < sv.size() && is_identifier_char(sv[len]))
+		len++;
+	if (len >= identifier_maxSize)
+		return INTERP_ERR_ID_TOO_LONG;
+
+	id = sv.substr(0, len);
+	sv.remove_prefix(len);
+	return INTERP_OK;
+}
+
+static interp_res_t
+scan_argument(std::string_view &sv, std::string_view &arg)
+{
+	const size_t len = sv.find(ArgEnd);
+
+	if (len == std::string_view::npos)
+		return INTERP_ERR_UNTERMINATED_ARG;
+
+	arg = sv.substr(0, len);
+	sv.remove_prefix(len + 1);
+	return INTERP_OK;
+}
+
+/**
+ * Tokenize a line. Either an assignment: identifier = "argument"; or
+ * an include directive: include "pattern";
+ */
+static interp_res_t
+tokenize(struct statement *st)
+{
+	interp_res_t		res;
+	std::string_view	sv(st->line);
+
+	st->is_include = false;
+
+	if (sv.empty() || !is_identifier_char(sv.front()))
+		return INTERP_ERR_LEADING_CHAR;
+	else if ((res = scan_identifier(sv, st->id)) != INTERP_OK)
+		return res;
+
+	skip_white(sv);
+	if (st->id == IncludeKeyword && !sv.empty() &&
+	    sv.front() == ArgBegin)
+		st->is_include = true;
+	else if (!consume(sv, '='))
+		return INTERP_ERR_NO_ASSIGNMENT;
+
+	skip_white(sv);
+	if (!consume(sv, ArgBegin))
+		return INTERP_ERR_NO_ARG_BEGIN;
+	else if ((res = scan_argument(sv, st->arg)) != INTERP_OK)
+		return res;
+
+	skip_white(sv);
+	if (!consume(sv, ';'))
+		return INTERP_ERR_NO_TERMINATOR;
+
+	skip_white(sv);
+	if (!sv.empty() && sv.front() != CommentChar)
+		return INTERP_ERR_IMPLICIT_DATA;
+	return INTERP_OK;
+}
 
 /**
- * Copy identifier
+ * Append an argument to a string with its line continuations removed,
+ * i.e. the backslash, the line break and the whitespace around them.
  */
-static char *
-copy_identifier(const char *&id)
+static void
+append_argument(std::string &str, std::string_view arg)
 {
-	size_t	 count = identifier_maxSize;
-	char	*dest_buf = new char[count + 1];
-	char	*dest = addrof(dest_buf[0]);
+	size_t nl;
 
-	while ((isalnum(*id) || *id == '_') && count > 1)
-		*dest++ = *id++, count--;
+	while ((nl = arg.find('\n')) != std::string_view::npos) {
+		std::string_view part(trim_view(arg.substr(0, nl)));
 
-	*dest = '\0';
+		if (!part.empty() && part.back() == ContinuationChar)
+			part = trim_view(part.substr(0, part.size() - 1));
+		str.append(part);
+		arg.remove_prefix(nl + 1);
+		skip_white(arg);
+	}
 
-	if (count == 1)
-		fatal(EOVERFLOW, "%s: fatal: string was truncated", __func__);
-	return dest_buf;
+	str.append(arg);
 }
 
 /**
- * Copy argument
+ * Install a tokenized assignment. The identifier and the argument are
+ * copied to 'buf' in order to null-terminate them. The buffer is
+ * reused between calls and grows to the size of the longest
+ * statement.
  */
-//lint -sem(copy_argument, r_null)
-static char *
-copy_argument(const char *&arg)
+static interp_res_t
+install(const struct statement *st, Interpreter_vFunc validator_func,
+    Interpreter_instFunc install_func, std::string &buf)
 {
-	bool	 inside_arg = true;
-	size_t	 count = argument_maxSize;
-	char	*dest_buf = new char[count + 1];
-	char	*dest = addrof(dest_buf[0]);
+	buf.assign(st->id);
+	buf.push_back('\0');
+	append_argument(buf, st->arg);
 
-	while (*arg && count > 1) {
-		if (*arg == ArgEnd) {
-			inside_arg = false;
-			arg++;
-			break;
+	const char *id = buf.c_str();
+	const char *arg = id + st->id.size() + 1;
+
+	if (!validator_func(id)) {
+#if IGNORE_UNRECOGNIZED_IDENTIFIERS
+		return INTERP_OK;
+#else
+		return INTERP_ERR_NO_SUCH_ID;
+#endif
+	} else if ((errno = install_func(id, arg)) != 0) {
+		return INTERP_ERR_INSTALL;
+	}
+
+	return INTERP_OK;
+}
+
+/**
+ * Report an error in a statement and count it. If non-null, 'err_line'
+ * receives the line number of the first error.
+ */
+static void
+report_error(const char *path, const struct statement *st, interp_res_t res,
+    long int *err_line)
+{
+	const int errno_save = errno;
+
+	std::cerr << '\t' << st->line << '\n';
+
+	if (res == INTERP_ERR_INSTALL) {
+		log_warn(errno_save, "%s:%ld: error: install_func returned %d",
+		    path, st->line_num, errno_save);
+	} else {
+		log_warn(0, "%s:%ld: error: %s", path, st->line_num,
+		    Interpreter_strerror(res));
+	}
+
+	error_count++;
+	if (err_line != nullptr && *err_line == 0)
+		*err_line = st->line_num;
+}
+
+static interp_res_t
+map_file(const char *path, void **map, size_t *size)
+{
+	int		fd;
+	struct stat	sb;
+
+	*map = nullptr;
+	*size = 0;
+
+	if ((fd = open(path, O_RDONLY)) == -1) {
+		return INTERP_ERR_OPEN;
+	} else if (fstat(fd, &sb) == -1) {
+		const int errno_save = errno;
+
+		(void) close(fd);
+		errno = errno_save;
+		return INTERP_ERR_OPEN;
+	} else if (!S_ISREG(sb.st_mode)) {
+		(void) close(fd);
+		errno = EINVAL;
+		return INTERP_ERR_OPEN;
+	} else if ((*size = static_cast<size_t>(sb.st_size)) > 0 &&
+	    (*map = mmap(nullptr, *size, PROT_READ, MAP_PRIVATE, fd, 0)) ==
+	    MAP_FAILED) {
+		const int errno_save = errno;
+
+		*map = nullptr;
+		(void) close(fd);
+		errno = errno_save;
+		return INTERP_ERR_OPEN;
+	}
+
+	(void) close(fd);
+	return INTERP_OK;
+}
+
+static std::string_view
+next_physical_line(std::string_view &buf, long int &line_num)
+{
+	const size_t		nl = buf.find('\n');
+	const std::string_view	line(buf.substr(0, nl));
+
+	buf.remove_prefix(nl == std::string_view::npos ? buf.size() : nl + 1);
+	line_num++;
+	return line;
+}
+
+/**
+ * Check whether a trimmed physical line ends with a continuation, i.e.
+ * a backslash that isn't part of a trailing comment. 'in_arg' tells
+ * whether the line starts inside a quoted argument and is updated to
+ * tell whether it ends inside one.
+ */
+static bool
+is_continued(std::string_view line, bool &in_arg)
+{
+	for (const char c : line) {
+		if (c == ArgBegin)
+			in_arg = !in_arg;
+		else if (c == CommentChar && !in_arg)
+			return false;
+	}
+	return (!line.empty() && line.back() == ContinuationChar);
+}
+
+/**
+ * Get the next line that isn't blank or a comment into 'st'. Leading
+ * and trailing whitespace is removed. A line that ends with a
+ * backslash, outside of a comment, continues on the next line, and
+ * the statement then spans both of them. Its line number is the
+ * number of the first line.
+ */
+static bool
+next_line(std::string_view &buf, long int &line_num, struct statement *st)
+{
+	while (!buf.empty()) {
+		std::string_view line(next_physical_line(buf, line_num));
+
+		skip_white(line);
+		line = trim_view(line);
+		if (line.empty() || line.front() == CommentChar)
+			continue;
+
+		st->line_num = line_num;
+
+		bool in_arg = false;
+		bool continued = is_continued(line, in_arg);
+
+		while (continued && !buf.empty()) {
+			const std::string_view next(next_physical_line(buf,
+			    line_num));
+			const std::string_view next_trimmed(trim_view(next));
+
+			line = trim_view(std::string_view(line.data(),
+			    next.data() + next.size() - line.data()));
+			if (!next_trimmed.empty())
+				continued = is_continued(next_trimmed, in_arg);
 		}
 
-		*dest++ = *arg++, count--;
+		st->line = line;
+		return true;
+	}
+	return false;
+}
+
+/**
+ * Parse an included file into a list of statements without installing
+ * them. Unless errors are to be skipped, parsing stops at the first
+ * statement that can't be tokenized. This runs on a worker thread and
+ * must therefore not log.
+ */
+static void
+parse_file(struct mapped_file *file)
+{
+	long int		line_num = 0;
+	struct statement	st;
+
+	if ((file->res = map_file(file->path.c_str(), &file->map,
+	    &file->size)) != INTERP_OK) {
+		file->errnum = errno;
+		return;
 	}
 
-	*dest = '\0';
+	std::string_view buf(static_cast<const char *>(file->map), file->size);
 
-	if (inside_arg && count == 1)
-		fatal(EOVERFLOW, "%s: fatal: string was truncated", __func__);
-	if (inside_arg) {
-		delete[] dest_buf;
-		return nullptr;
+	while (next_line(buf, line_num, &st)) {
+		if ((st.res = tokenize(&st)) == INTERP_OK && st.is_include)
+			st.res = INTERP_ERR_NESTED_INCLUDE;
+		file->statements.push_back(st);
+		if (st.res != INTERP_OK && !keep_going)
+			break;
 	}
-	return dest_buf;
 }
 
 static void
-clean_up(char *id, char *arg)
+parse_files_in_parallel(std::vector<struct mapped_file> &files)
 {
-	delete[] id;
-	delete[] arg;
+	std::atomic<size_t>		next(0);
+	std::vector<std::thread>	workers;
+	unsigned int			n_threads = max_threads;
+
+	if (n_threads == 0)
+		n_threads = std::thread::hardware_concurrency();
+	if (n_threads == 0)
+		n_threads = 1;
+	if (n_threads > files.size())
+		n_threads = static_cast<unsigned int>(files.size());
+
+	auto worker = [&files, &next]() {
+		size_t i;
+
+		while ((i = next++) < files.size())
+			parse_file(&files[i]);
+	};
+
+	for (unsigned int i = 1; i < n_threads; i++)
+		workers.emplace_back(worker);
+	worker();
+	for (std::thread &thr : workers)
+		thr.join();
 }
 
 /**
- * Interpreter
- *
- * @param in Context structure
- * @return Void
+ * Process an include directive. The files matching the pattern are
+ * parsed in parallel, and then installed one after another in the
+ * sorted order of glob(3), i.e. the same order as if they had been
+ * concatenated into the including file. A pattern that matches
+ * nothing is fine, unless it's the name of a single file, i.e. has no
+ * metacharacters.
  *
- * An interpreter for configuration files. The context structure
- * contains the data to be passed to the interpreter.
+ * @return INTERP_OK or the first error
  */
-void
-Interpreter(const struct Interpreter_in *in)
+static interp_res_t
+process_include(const char *path, const struct statement *st,
+    Interpreter_vFunc validator_func, Interpreter_instFunc install_func,
+    long int *err_line, std::string &buf)
 {
-	char	*id = nullptr;
-	char	*arg = nullptr;
+	glob_t		gl;
+	interp_res_t	res = INTERP_OK;
+	int		ret;
+	std::string	pattern;
 
-	if (in == nullptr)
-		fatal(EINVAL, "%s", __func__);
+	append_argument(pattern, st->arg);
 
-	try {
-		const char *cp = addrof(in->line[0]);
-
-		if (!isalnum(*cp) && *cp != '_')
-			throw std::runtime_error("unexpected leading "
-			    "character");
-		id = copy_identifier(cp);
-		eatwhite(&cp);
-		if (*cp++ != '=') {
-			throw std::runtime_error("expected assignment "
-			    "operator");
-		}
+	if (pattern.empty() || pattern.front() != '/') {
+		const char *slash = strrchr(path, '/');
 
-		eatwhite(&cp);
-		if (*cp++ != ArgBegin)
-			throw std::runtime_error("expected arg begin");
-		else if ((arg = copy_argument(cp)) == nullptr)
-			throw std::runtime_error("unterminated argument");
-
-		eatwhite(&cp);
-		if (*cp++ != ';')
-			throw std::runtime_error("no line terminator!");
-
-		eatwhite(&cp);
-		if (*cp && *cp != CommentChar) {
-			throw std::runtime_error("implicit data after "
-			    "line terminator!");
-		} else if (!(in->validator_func(id))) {
-#if IGNORE_UNRECOGNIZED_IDENTIFIERS
-			/* ignore */;
-#else
-			throw std::runtime_error("no such identifier");
-#endif
-		} else if ((errno = in->install_func(id, arg)) != 0) {
-			throw std::runtime_error("install error");
+		if (slash != nullptr)
+			pattern.insert(0, path, slash - path + 1);
+	}
+
+	if (source_func != nullptr) {
+		const size_t slash = pattern.rfind('/');
+
+		source_func(slash == std::string::npos ? "." :
+		    pattern.substr(0, slash + 1).c_str());
+	}
+
+	if ((ret = glob(pattern.c_str(), 0, nullptr, &gl)) == GLOB_NOMATCH &&
+	    pattern.find_first_of("*?[") != std::string::npos) {
+		globfree(&gl);
+		return INTERP_OK;
+	} else if (ret != 0) {
+		/* The results may be partial */
+		globfree(&gl);
+		report_error(path, st, INTERP_ERR_INCLUDE, err_line);
+		return INTERP_ERR_INCLUDE;
+	}
+
+	std::vector<struct mapped_file> files(gl.gl_pathc);
+
+	for (size_t i = 0; i < gl.gl_pathc; i++) {
+		files[i].path	= gl.gl_pathv[i];
+		files[i].map	= nullptr;
+		files[i].size	= 0;
+		files[i].errnum	= 0;
+		files[i].res	= INTERP_OK;
+	}
+
+	globfree(&gl);
+	parse_files_in_parallel(files);
+
+	for (struct mapped_file &file : files) {
+		if (file.res != INTERP_OK) {
+			log_warn(file.errnum, "%s: %s", __func__,
+			    file.path.c_str());
+			error_count++;
+			if (res == INTERP_OK)
+				res = file.res;
+			if (!keep_going)
+				break;
+			continue;
 		}
-	} catch (const std::bad_alloc &e) {
-		std::cerr << "out of memory: " << e.what() << '\n';
-		clean_up(id, arg);
-		abort();
-	} catch (const std::runtime_error &e) {
-		std::cerr << '\t' << in->line << '\n';
-
-		if (strings_match(e.what(), "install error")) {
-			log_warn(errno, "%s:%ld: error: "
-			    "install_func returned %d", in->path, in->line_num,
-			    errno);
-		} else {
-			log_warn(0, "%s:%ld: error: %s", in->path, in->line_num,
-			    e.what());
+
+		if (source_func != nullptr)
+			source_func(file.path.c_str());
+
+		for (const struct statement &inc_st : file.statements) {
+			interp_res_t st_res = inc_st.res;
+
+			if (st_res == INTERP_OK) {
+				st_res = install(&inc_st, validator_func,
+				    install_func, buf);
+			}
+			if (st_res != INTERP_OK) {
+				report_error(file.path.c_str(), &inc_st, st_res,
+				    err_line);
+				if (res == INTERP_OK)
+					res = st_res;
+				if (!keep_going)
+					break;
+			}
 		}
+		if (res != INTERP_OK && !keep_going)
+			break;
+	}
 
-		clean_up(id, arg);
-		abort();
-	} catch (...) {
-		std::cerr << "unknown exception  --  should not be reached\n";
-		clean_up(id, arg);
-		abort();
+	for (struct mapped_file &file : files) {
+		if (file.map != nullptr)
+			(void) munmap(file.map, file.size);
 	}
 
-	clean_up(id, arg);
+	return res;
+}
+
+/**
+ * Get a description of an interpreter result code
+ *
+ * @param res Result code
+ * @return The description
+ */
+const char *
+Interpreter_strerror(interp_res_t res)
+{
+	switch (res) {
+	case INTERP_OK:
+		return "success";
+	case INTERP_ERR_OPEN:
+		return "unable to open file";
+	case INTERP_ERR_LEADING_CHAR:
+		return "unexpected leading character";
+	case INTERP_ERR_ID_TOO_LONG:
+		return "identifier too long";
+	case INTERP_ERR_NO_ASSIGNMENT:
+		return "expected assignment operator";
+	case INTERP_ERR_NO_ARG_BEGIN:
+		return "expected arg begin";
+	case INTERP_ERR_UNTERMINATED_ARG:
+		return "unterminated argument";
+	case INTERP_ERR_NO_TERMINATOR:
+		return "no line terminator!";
+	case INTERP_ERR_IMPLICIT_DATA:
+		return "implicit data after line terminator!";
+	case INTERP_ERR_NO_SUCH_ID:
+		return "no such identifier";
+	case INTERP_ERR_INSTALL:
+		return "install error";
+	case INTERP_ERR_INCLUDE:
+		return "include pattern error or no such file";
+	case INTERP_ERR_NESTED_INCLUDE:
+		return "include not allowed here";
+	}
+	return "unknown error";
 }
 
+/**
+ * Set the maximum number of threads used to parse included files
+ *
+ * @param n Thread count. 0 means one per hardware thread.
+ * @return Void
+ */
 void
-Interpreter_processAllLines(FILE *fp, const char *path, Interpreter_vFunc func1,
-    Interpreter_instFunc func2)
+Interpreter_setMaxThreads(unsigned int n)
 {
-	char		buf[MAXLINE] = { '\0' };
-	long int	line_num = 0;
+	max_threads = n;
+}
 
-	while (fgets(buf, sizeof buf, fp) != nullptr) {
-		char			*line;
-		const char		*cp;
-		struct Interpreter_in	 in;
+/**
+ * Set a function to be called with the path of every file that is
+ * read, and of every directory that is searched for included files.
+ *
+ * @param func The function, or null
+ * @return Void
+ */
+void
+Interpreter_setSourceFunc(Interpreter_srcFunc func)
+{
+	source_func = func;
+}
 
-		cp = &buf[0];
-		eatwhite(&cp);
-		if (strings_match(cp, "") || *cp == CommentChar) {
-			line_num++;
-			continue;
-		}
+/**
+ * Set whether Interpreter_processAllLines() should continue after an
+ * error, in order to report all errors in one go
+ *
+ * @param on True to continue after errors
+ * @return Void
+ */
+void
+Interpreter_setKeepGoing(bool on)
+{
+	keep_going = on;
+}
+
+/**
+ * Get the number of errors reported by the last call to
+ * Interpreter_processAllLines()
+ *
+ * @return The error count
+ */
+size_t
+Interpreter_errorCount(void)
+{
+	return error_count;
+}
+
+/**
+ * Interpreter
+ *
+ * @param in Context structure
+ * @return INTERP_OK or an error code
+ *
+ * An interpreter for configuration files. The context structure
+ * contains the data to be passed to the interpreter. The line may
+ * be continued, i.e. contain backslash-newline sequences inside the
+ * argument. If the install function fails the error number it
+ * returned is stored in errno. Include directives are only recognized
+ * by Interpreter_processAllLines().
+ */
+interp_res_t
+Interpreter(const struct Interpreter_in *in)
+{
+	interp_res_t		res;
+	struct statement	st;
+
+	/* Reused between the calls on a thread, see install() */
+	thread_local std::string buf;
+
+	if (in == nullptr || in->line == nullptr)
+		fatal(EINVAL, "%s", __func__);
+
+	st.line = std::string_view(in->line, in->line_len);
+	st.line_num = in->line_num;
+
+	if ((res = tokenize(&st)) != INTERP_OK)
+		return res;
+	else if (st.is_include)
+		return INTERP_ERR_NESTED_INCLUDE;
+	return install(&st, in->validator_func, in->install_func, buf);
+}
 
-		line = trim(xstrdup(cp));
+/**
+ * Process all lines of a configuration file. The file is mapped into
+ * memory and each line is tokenized without being copied. There's no
+ * limit on the length of a line: an argument can be continued on the
+ * next line by ending the line with a backslash. Processing stops at
+ * the first error, which is reported, unless Interpreter_setKeepGoing()
+ * was called to report all errors.
+ *
+ * The file may include other files with: include "pattern"; where a
+ * relative pattern is relative to the directory of the including
+ * file. Included files cannot themselves include files.
+ *
+ * @param path     Path to the file
+ * @param func1    Validator function
+ * @param func2    Install function
+ * @param err_line If non-null: receives the line number of the first
+ *                 error
+ * @return INTERP_OK or the first error
+ */
+interp_res_t
+Interpreter_processAllLines(const char *path, Interpreter_vFunc func1,
+    Interpreter_instFunc func2, long int *err_line)
+{
+	interp_res_t		 res = INTERP_OK;
+	long int		 line_num = 0;
+	size_t			 size = 0;
+	std::string		 install_buf;
+	struct statement	 st;
+	void			*map = nullptr;
+
+	if (path == nullptr || func1 == nullptr || func2 == nullptr)
+		fatal(EINVAL, "%s", __func__);
+	if (err_line)
+		*err_line = 0;
+	error_count = 0;
+
+	if ((res = map_file(path, &map, &size)) != INTERP_OK) {
+		log_warn(errno, "%s: %s", __func__, path);
+		error_count++;
+		return res;
+	} else if (source_func != nullptr) {
+		source_func(path);
+	}
 
-		in.path			= const_cast<char *>(path);
-		in.line			= line;
-		in.line_num		= ++line_num;
-		in.validator_func	= func1;
-		in.install_func		= func2;
-		Interpreter(&in);
+	std::string_view buf(static_cast<const char *>(map), size);
 
-		free(line);
+	while (next_line(buf, line_num, &st)) {
+		if ((st.res = tokenize(&st)) == INTERP_OK && st.is_include) {
+			st.res = process_include(path, &st, func1, func2,
+			    err_line, install_buf);
+		} else {
+			if (st.res == INTERP_OK)
+				st.res = install(&st, func1, func2, install_buf);
+			if (st.res != INTERP_OK)
+				report_error(path, &st, st.res, err_line);
+		}
+		if (st.res != INTERP_OK) {
+			if (res == INTERP_OK)
+				res = st.res;
+			if (!keep_going)
+				break;
+		}
 	}
+
+	if (map != nullptr)
+		(void) munmap(map, size);
+	return res;
 }
@@ -1,9 +1,8 @@
 #ifndef INTERPRETER_H
 #define INTERPRETER_H
 
-#include <ctype.h> /* isspace */
 #include <stdbool.h>
-#include <stdio.h> /* FILE */
+#include <stddef.h>
 
 #include "ducdef.h"
 
@@ -12,39 +11,50 @@
  */
 #define IGNORE_UNRECOGNIZED_IDENTIFIERS 1
 
-#define MAXLINE 3200
-
 enum setting_type {
 	TYPE_BOOLEAN,
 	TYPE_INTEGER,
 	TYPE_STRING
 };
 
+typedef enum {
+	INTERP_OK,
+	INTERP_ERR_OPEN,
+	INTERP_ERR_LEADING_CHAR,
+	INTERP_ERR_ID_TOO_LONG,
+	INTERP_ERR_NO_ASSIGNMENT,
+	INTERP_ERR_NO_ARG_BEGIN,
+	INTERP_ERR_UNTERMINATED_ARG,
+	INTERP_ERR_NO_TERMINATOR,
+	INTERP_ERR_IMPLICIT_DATA,
+	INTERP_ERR_NO_SUCH_ID,
+	INTERP_ERR_INSTALL,
+	INTERP_ERR_INCLUDE,
+	INTERP_ERR_NESTED_INCLUDE
+} interp_res_t;
+
 typedef bool (*Interpreter_vFunc)(const char *);
 typedef int (*Interpreter_instFunc)(const char *, const char *);
+typedef void (*Interpreter_srcFunc)(const char *);
 
 struct Interpreter_in {
-	char *path;
-	char *line;
+	const char *path;
+	const char *line;	/**< Not necessarily null-terminated */
+	size_t line_len;
 	long int line_num;
 	Interpreter_vFunc validator_func;
 	Interpreter_instFunc install_func;
 };
 
 __DUC_BEGIN_DECLS
-extern const char g_fgets_nullret_err1[70];
-extern const char g_fgets_nullret_err2[70];
-
-void	Interpreter(const struct Interpreter_in *);
-void	Interpreter_processAllLines(FILE *, const char *, Interpreter_vFunc,
-	    Interpreter_instFunc);
+const char	*Interpreter_strerror(interp_res_t);
+interp_res_t	 Interpreter(const struct Interpreter_in *);
+interp_res_t	 Interpreter_processAllLines(const char *, Interpreter_vFunc,
+		     Interpreter_instFunc, long int *);
+void		 Interpreter_setMaxThreads(unsigned int);
+void		 Interpreter_setSourceFunc(Interpreter_srcFunc);
+void		 Interpreter_setKeepGoing(bool);
+size_t		 Interpreter_errorCount(void);
 __DUC_END_DECLS
 
-static inline void
-eatwhite(const char **ptr)
-{
-	while (isspace(**ptr))
-		(*ptr)++;
-}
-
 #endif
@@ -0,0 +1,233 @@
+/* Copyright (c) 2026 Markus Uhlin <markus.uhlin@icloud.com>
+   All rights reserved.
+
+   Permission to use, copy, modify, and distribute this software for any
+   purpose with or without fee is hereby granted, provided that the above
+   copyright notice and this permission notice appear in all copies.
+
+   THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+   WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+   AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+   DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR
+   PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+   TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+   PERFORMANCE OF THIS SOFTWARE. */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "json.h"
+
+static const char hexdigits[] = "0123456789abcdef";
+
+/*
+ * Append 'len' bytes. One byte is always kept for the closing brace
+ * and one for the terminating null.
+ */
+static void
+put(struct json_writer *w, const char *src, size_t len)
+{
+	if (w->truncated)
+		return;
+	if (w->len + len + 2 > w->size) {
+		w->truncated = true;
+		return;
+	}
+	(void) memcpy(&w->buf[w->len], src, len);
+	w->len += len;
+	w->buf[w->len] = '\0';
+}
+
+static void
+put_char(struct json_writer *w, const char c)
+{
+	put(w, &c, 1);
+}
+
+static void
+put_escaped(struct json_writer *w, const char *str)
+{
+	const char *run = str;
+
+	put_char(w, '"');
+
+	for (const char *cp = str; *cp; cp++) {
+		const unsigned char c = (unsigned char) *cp;
+		char esc[6] = { '\\', 'u', '0', '0', '\0', '\0' };
+
+		if (c >= 0x20 && c != '"' && c != '\\')
+			continue;
+
+		put(w, run, cp - run);
+		run = cp + 1;
+
+		switch (c) {
+		case '"':
+		case '\\':
+			esc[1] = c;
+			put(w, esc, 2);
+			break;
+		case '\n':
+			put(w, "\\n", 2);
+			break;
+		case '\r':
+			put(w, "\\r", 2);
+			break;
+		case '\t':
+			put(w, "\\t", 2);
+			break;
+		default:
+			esc[4] = hexdigits[c >> 4];
+			esc[5] = hexdigits[c & 0xf];
+			put(w, esc, sizeof esc);
+			break;
+		}
+	}
+
+	put(w, run, strlen(run));
+	put_char(w, '"');
+}
+
+static void
+end_member(struct json_writer *w)
+{
+	if (!w->truncated)
+		w->complete = w->len;
+}
+
+static void
+put_key(struct json_writer *w, const char *key)
+{
+	if (!w->empty)
+		put_char(w, ',');
+	w->empty = false;
+	put_escaped(w, key);
+	put_char(w, ':');
+}
+
+/**
+ * Begin writing a JSON object into a buffer
+ *
+ * @param w	Writer
+ * @param buf	Buffer
+ * @param size	Buffer size. At least 3 bytes.
+ * @return Void
+ */
+void
+json_init(struct json_writer *w, char *buf, size_t size)
+{
+	w->buf = buf;
+	w->size = size;
+	w->len = 0;
+	w->complete = 0;
+	w->empty = true;
+	w->truncated = (size < 3);
+	put_char(w, '{');
+	end_member(w);
+}
+
+/**
+ * Add a member whose value is a string. The string is escaped.
+ */
+void
+json_add_string(struct json_writer *w, const char *key, const char *value)
+{
+	put_key(w, key);
+	put_escaped(w, (value ? value : ""));
+	end_member(w);
+}
+
+/**
+ * Add a member whose value is an unsigned integer
+ */
+void
+json_add_uint(struct json_writer *w, const char *key, uint64_t value)
+{
+	char	digits[20];
+	size_t	n = 0;
+
+	do {
+		digits[sizeof digits - ++n] = (char) ('0' + value % 10);
+		value /= 10;
+	} while (value > 0);
+
+	put_key(w, key);
+	put(w, &digits[sizeof digits - n], n);
+	end_member(w);
+}
+
+/**
+ * Add a member whose value is a number with a fixed number of
+ * decimals. Values that aren't finite are written as null.
+ */
+void
+json_add_double(struct json_writer *w, const char *key, double value,
+		int decimals)
+{
+	char	digits[64];
+	char	*cp;
+	int	len;
+
+	put_key(w, key);
+	if (!isfinite(value) || (len = snprintf(digits, sizeof digits, "%.*f",
+	    decimals, value)) < 0 || (size_t) len >= sizeof digits) {
+		put(w, "null", 4);
+	} else {
+		/* The decimal point of the locale */
+		if ((cp = strchr(digits, ',')) != NULL)
+			*cp = '.';
+		put(w, digits, len);
+	}
+	end_member(w);
+}
+
+/**
+ * Add a member whose value is a boolean
+ */
+void
+json_add_bool(struct json_writer *w, const char *key, bool value)
+{
+	put_key(w, key);
+	if (value)
+		put(w, "true", 4);
+	else
+		put(w, "false", 5);
+	end_member(w);
+}
+
+/**
+ * Add the members of another JSON object, i.e. a complete object
+ * that was written by a writer.
+ */
+void
+json_add_members(struct json_writer *w, const char *object)
+{
+	size_t len = strlen(object);
+
+	if (len <= 2 || object[0] != '{' || object[len - 1] != '}')
+		return;
+	if (!w->empty)
+		put_char(w, ',');
+	w->empty = false;
+	put(w, &object[1], len - 2);
+	end_member(w);
+}
+
+/**
+ * Finish the object
+ *
+ * @return false if the object was truncated
+ */
+bool
+json_finish(struct json_writer *w)
+{
+	if (w->size < 3)
+		return false;
+
+	w->len = w->complete;
+	w->buf[w->len++] = '}';
+	w->buf[w->len] = '\0';
+	return !w->truncated;
+}
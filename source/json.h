@@ -0,0 +1,35 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ducdef.h"
+
+/*
+ * Writes a JSON object into a caller-supplied buffer. Nothing is
+ * allocated. If the buffer is too small the members that don't fit
+ * are left out, the object is still valid, and json_finish() returns
+ * false.
+ */
+struct json_writer {
+	char	*buf;
+	size_t	 size;
+	size_t	 len;
+	size_t	 complete;	/**< Length up to the last whole member */
+	bool	 empty;
+	bool	 truncated;
+};
+
+__DUC_BEGIN_DECLS
+bool	json_finish(struct json_writer *);
+void	json_add_bool(struct json_writer *, const char *, bool);
+void	json_add_double(struct json_writer *, const char *, double, int);
+void	json_add_members(struct json_writer *, const char *);
+void	json_add_string(struct json_writer *, const char *, const char *);
+void	json_add_uint(struct json_writer *, const char *, uint64_t);
+void	json_init(struct json_writer *, char *, size_t);
+__DUC_END_DECLS
+
+#endif
@@ -0,0 +1,450 @@
+/* Copyright (c) 2026 Markus Uhlin <markus.uhlin@icloud.com>
+   All rights reserved.
+
+   Permission to use, copy, modify, and distribute this software for any
+   purpose with or without fee is hereby granted, provided that the above
+   copyright notice and this permission notice appear in all copies.
+
+   THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+   WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+   AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+   DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR
+   PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+   TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+   PERFORMANCE OF THIS SOFTWARE. */
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+
+#include <netinet/in.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "format.h"
+#include "listener.h"
+#include "log.h"
+#include "sig.h"
+#include "various.h"
+#include "wrapper.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0	/* SIGPIPE is ignored anyway */
+#endif
+
+struct listener {
+	int				 fd;
+	char				 path[sizeof ((struct sockaddr_un *)
+					     0)->sun_path];
+	const struct listener_ops	*ops;
+};
+
+struct client {
+	int				 fd;
+	const struct listener_ops	*ops;
+	char				 req[LISTENER_REQUEST_MAX];
+	size_t				 req_len;
+	struct listener_reply		 reply;
+	size_t				 sent;
+	bool				 replying;
+	uint64_t			 deadline_ns;
+};
+
+static struct listener	listeners[LISTENERS_MAX];
+static size_t		n_listeners = 0;
+static struct client	clients[LISTENER_CLIENTS_MAX];
+static size_t		n_clients = 0;
+static bool		woken = false;
+
+static int
+set_nonblock(int fd)
+{
+	const int flags = fcntl(fd, F_GETFL);
+
+	if (flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1)
+		return -1;
+	return fcntl(fd, F_SETFD, FD_CLOEXEC);
+}
+
+static bool
+is_loopback(const struct sockaddr *sa)
+{
+	if (sa->sa_family == AF_INET) {
+		const struct sockaddr_in *sin = (const struct sockaddr_in *) sa;
+
+		return ((ntohl(sin->sin_addr.s_addr) >> 24) == 127);
+	} else if (sa->sa_family == AF_INET6) {
+		const struct sockaddr_in6 *sin6 =
+		    (const struct sockaddr_in6 *) sa;
+
+		return IN6_IS_ADDR_LOOPBACK(&sin6->sin6_addr);
+	}
+	return false;
+}
+
+static int
+open_unix(const char *path, struct listener *l)
+{
+	struct sockaddr_un	sun = { 0 };
+	struct stat		sb;
+
+	if (strlen(path) >= sizeof sun.sun_path) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	sun.sun_family = AF_UNIX;
+	(void) strlcpy(sun.sun_path, path, sizeof sun.sun_path);
+
+	/* A stale socket from an earlier run */
+	if (lstat(path, &sb) == 0 && S_ISSOCK(sb.st_mode))
+		(void) unlink(path);
+
+	if ((l->fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1)
+		return -1;
+	if (bind(l->fd, (struct sockaddr *) &sun, sizeof sun) == -1)
+		return -1;
+	(void) strlcpy(l->path, path, sizeof l->path);
+	return 0;
+}
+
+/*
+ * Open a TCP listener on a loopback address. 'addr' is either a port,
+ * or a host and a port separated by a colon.
+ */
+static int
+open_tcp(const char *addr, struct listener *l)
+{
+	char			 host[256] = "127.0.0.1";
+	const char		*port = addr;
+	const char		*colon;
+	const int		 on = 1;
+	int			 ret;
+	struct addrinfo		 hints = { 0 };
+	struct addrinfo		*res;
+
+	if ((colon = strrchr(addr, ':')) != NULL) {
+		const size_t len = colon - addr;
+
+		if (len == 0 || len >= sizeof host) {
+			errno = EINVAL;
+			return -1;
+		}
+		(void) memcpy(host, addr, len);
+		host[len] = '\0';
+		if (host[0] == '[' && host[len - 1] == ']') {
+			(void) memmove(host, &host[1], len - 2);
+			host[len - 2] = '\0';
+		}
+		port = colon + 1;
+	}
+	if (!is_numeric(port)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = AI_NUMERICSERV;
+
+	if ((ret = getaddrinfo(host, port, &hints, &res)) != 0) {
+		errno = (ret == EAI_SYSTEM ? errno : EADDRNOTAVAIL);
+		return -1;
+	} else if (!is_loopback(res->ai_addr)) {
+		freeaddrinfo(res);
+		errno = EADDRNOTAVAIL;
+		return -1;
+	}
+
+	if ((l->fd = socket(res->ai_family, res->ai_socktype,
+	    res->ai_protocol)) == -1 ||
+	    setsockopt(l->fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof on) ==
+	    -1 ||
+	    bind(l->fd, res->ai_addr, res->ai_addrlen) == -1) {
+		freeaddrinfo(res);
+		return -1;
+	}
+	freeaddrinfo(res);
+	return 0;
+}
+
+static void
+client_close(struct client *cl)
+{
+	(void) close(cl->fd);
+	free(cl->reply.data);
+	*cl = clients[--n_clients];
+}
+
+static void
+accept_clients(const struct listener *l, uint64_t now)
+{
+	int fd;
+
+	while ((fd = accept(l->fd, NULL, NULL)) != -1) {
+		struct client *cl;
+
+		if (n_clients >= LISTENER_CLIENTS_MAX || set_nonblock(fd) ==
+		    -1) {
+			(void) close(fd);
+			continue;
+		}
+
+		cl = &clients[n_clients++];
+		(void) memset(cl, 0, sizeof *cl);
+		cl->fd = fd;
+		cl->ops = l->ops;
+		cl->deadline_ns = now + LISTENER_TIMEOUT_MS * UINT64_C(1000000);
+	}
+}
+
+/*
+ * Write as much of the reply as the socket takes. Returns false when
+ * the client is done with.
+ */
+static bool
+client_write(struct client *cl)
+{
+	while (cl->sent < cl->reply.len) {
+		const ssize_t n = send(cl->fd, &cl->reply.data[cl->sent],
+		    cl->reply.len - cl->sent, MSG_NOSIGNAL);
+
+		if (n == -1)
+			return (errno == EAGAIN || errno == EINTR);
+		cl->sent += n;
+	}
+	return false;
+}
+
+static void
+client_reply(struct client *cl)
+{
+	cl->req[cl->req_len] = '\0';
+	cl->ops->respond(cl->req, cl->req_len, &cl->reply);
+	cl->replying = true;
+}
+
+/*
+ * Read from a client. Returns false when the client is done with.
+ */
+static bool
+client_read(struct client *cl)
+{
+	const size_t	room = sizeof cl->req - 1 - cl->req_len;
+	ssize_t		n;
+
+	if ((n = recv(cl->fd, &cl->req[cl->req_len], room, 0)) == -1)
+		return (errno == EAGAIN || errno == EINTR);
+
+	cl->req_len += n;
+	cl->req[cl->req_len] = '\0';
+
+	if (n == 0 || cl->req_len == sizeof cl->req - 1 ||
+	    cl->ops->complete(cl->req, cl->req_len)) {
+		client_reply(cl);
+		return client_write(cl);
+	}
+	return true;
+}
+
+/**
+ * Append to a reply
+ */
+void
+reply_write(struct listener_reply *reply, const char *data, size_t len)
+{
+	if (reply->len + len + 1 > reply->size) {
+		size_t size = (reply->size ? reply->size : 4096);
+
+		while (reply->len + len + 1 > size)
+			size *= 2;
+		reply->data = (reply->data ? xrealloc(reply->data, size) :
+		    xmalloc(size));
+		reply->size = size;
+	}
+	(void) memcpy(&reply->data[reply->len], data, len);
+	reply->len += len;
+	reply->data[reply->len] = '\0';
+}
+
+/**
+ * Append formatted text to a reply
+ */
+void
+reply_printf(struct listener_reply *reply, const char *fmt, ...)
+{
+	char		buf[512];
+	int		len;
+	struct fmt_buf	f;
+	va_list		ap;
+
+	fmt_init(&f, buf, sizeof buf, FMT_HEAP, NULL);
+	va_start(ap, fmt);
+	len = fmt_vprintf(&f, fmt, ap);
+	va_end(ap);
+
+	if (len >= 0)
+		reply_write(reply, f.data, f.len);
+	if (f.allocated)
+		free(f.data);
+}
+
+/**
+ * @return true if any listener is open
+ */
+bool
+listener_any(void)
+{
+	return (n_listeners > 0);
+}
+
+/**
+ * Open a listener. It serves its clients while listener_serve() runs.
+ *
+ * @param addr	A UNIX socket path, which must be absolute, or a port on
+ *		the loopback interface: "port" or "host:port"
+ * @param ops	What to do with the clients
+ * @return 0 on success, and -1 on failure (errno is set)
+ */
+int
+listener_open(const char *addr, const struct listener_ops *ops)
+{
+	struct listener	*l;
+	int		 ret;
+
+	if (n_listeners >= LISTENERS_MAX) {
+		errno = EMFILE;
+		return -1;
+	}
+
+	l = &listeners[n_listeners];
+	(void) memset(l, 0, sizeof *l);
+	l->ops = ops;
+	if (addr[0] == '/')
+		ret = open_unix(addr, l);
+	else
+		ret = open_tcp(addr, l);
+
+	if (ret == -1 || listen(l->fd, 8) == -1 || set_nonblock(l->fd) ==
+	    -1) {
+		const int errno_save = errno;
+
+		if (l->fd > 0)
+			(void) close(l->fd);
+		errno = errno_save;
+		return -1;
+	}
+
+	n_listeners++;
+	log_debug("%s: listening on %s", ops->name, addr);
+	return 0;
+}
+
+/**
+ * Close all listeners and clients. UNIX sockets are removed.
+ */
+void
+listener_close_all(void)
+{
+	while (n_clients > 0)
+		client_close(&clients[0]);
+	for (size_t i = 0; i < n_listeners; i++) {
+		(void) close(listeners[i].fd);
+		if (listeners[i].path[0] != '\0')
+			(void) unlink(listeners[i].path);
+	}
+	n_listeners = 0;
+}
+
+/**
+ * Make listener_serve() return as soon as the client that is being
+ * served has been replied to. Called by a reply that the caller of
+ * listener_serve() has to act upon.
+ */
+void
+listener_wakeup(void)
+{
+	woken = true;
+}
+
+/**
+ * Serve the clients of the listeners for a while. Without listeners
+ * this is a sleep. It ends early if a termination signal is deferred.
+ *
+ * @param timeout_ns How long to serve
+ * @return Void
+ */
+void
+listener_serve(uint64_t timeout_ns)
+{
+	const uint64_t deadline = monotonic_ns() + timeout_ns;
+	const int exit_fd = sig_exit_fd();
+
+	woken = false;
+
+	for (;;) {
+		struct pollfd	pfd[LISTENERS_MAX + LISTENER_CLIENTS_MAX + 1];
+		size_t		n_pfd = 0;
+		size_t		n_cl;
+		uint64_t	now = monotonic_ns();
+		uint64_t	wake = deadline;
+
+		if (now >= deadline || woken || sig_exit_pending())
+			break;
+		for (size_t i = n_clients; i > 0; i--) {
+			if (clients[i - 1].deadline_ns <= now)
+				client_close(&clients[i - 1]);
+		}
+
+		for (size_t i = 0; i < n_listeners; i++) {
+			pfd[n_pfd].fd = listeners[i].fd;
+			pfd[n_pfd++].events = POLLIN;
+		}
+		for (size_t i = 0; i < n_clients; i++) {
+			pfd[n_pfd].fd = clients[i].fd;
+			pfd[n_pfd++].events = (clients[i].replying ? POLLOUT :
+			    POLLIN);
+			if (clients[i].deadline_ns < wake)
+				wake = clients[i].deadline_ns;
+		}
+		if (exit_fd != -1) {
+			pfd[n_pfd].fd = exit_fd;
+			pfd[n_pfd++].events = POLLIN;
+		}
+
+		if (poll(pfd, n_pfd, (int) ((wake - now + 999999) / 1000000)) <=
+		    0)
+			continue;
+
+		now = monotonic_ns();
+		n_cl = n_clients;
+		for (size_t i = n_cl; i > 0; i--) {
+			struct client	*cl = &clients[i - 1];
+			const short	 revents = pfd[n_listeners + i - 1].revents;
+			bool		 keep = true;
+
+			if (revents == 0)
+				continue;
+			else if (cl->replying)
+				keep = client_write(cl);
+			else
+				keep = client_read(cl);
+			if (!keep)
+				client_close(cl);
+		}
+		for (size_t i = 0; i < n_listeners; i++) {
+			if (pfd[i].revents & POLLIN)
+				accept_clients(&listeners[i], now);
+		}
+	}
+}
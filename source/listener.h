@@ -0,0 +1,53 @@
+#ifndef LISTENER_H
+#define LISTENER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ducdef.h"
+
+#define LISTENERS_MAX		4
+#define LISTENER_CLIENTS_MAX	16
+#define LISTENER_REQUEST_MAX	4096
+#define LISTENER_TIMEOUT_MS	5000	/* Per client */
+
+struct listener_reply {
+	char	*data;
+	size_t	 len;
+	size_t	 size;
+};
+
+/*
+ * What a listener does with its clients. A client sends a request and
+ * gets a reply, and then the connection is closed.
+ */
+struct listener_ops {
+	const char *name;
+
+	/*
+	 * Returns true if 'req' is a complete request. A request is also
+	 * complete when the client shuts down its side of the connection.
+	 */
+	bool (*complete)(const char *req, size_t len);
+
+	/*
+	 * Writes the reply to a request. 'req' is null terminated.
+	 */
+	void (*respond)(const char *req, size_t len,
+	    struct listener_reply *reply);
+};
+
+__DUC_BEGIN_DECLS
+bool	listener_any(void);
+int	listener_open(const char *, const struct listener_ops *);
+void	listener_close_all(void);
+void	listener_serve(uint64_t);
+void	listener_wakeup(void);
+
+void	reply_printf(struct listener_reply *, const char *, ...)
+	    PRINTFLIKE(2);
+void	reply_write(struct listener_reply *, const char *, size_t);
+__DUC_END_DECLS
+
+#endif
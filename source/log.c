@@ -1,4 +1,4 @@
-/* Copyright (c) 2015, 2018, 2021 Markus Uhlin <markus.uhlin@icloud.com>
+/* Copyright (c) 2015, 2018, 2021, 2026 Markus Uhlin <markus.uhlin@icloud.com>
    All rights reserved.
 
    Permission to use, copy, modify, and distribute this software for any
@@ -14,31 +14,162 @@
    TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
    PERFORMANCE OF THIS SOFTWARE. */
 
+#include <pthread.h>
+#include <signal.h>
 #include <stdarg.h>
+#include <stdatomic.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <syslog.h>
+#include <time.h>
 
+#include "format.h"
+#include "json.h"
 #include "log.h"
+#include "logfile.h"
+#include "sig.h"
+#include "various.h"
+
+#define LOG_RECORD_MAX	2000
+#define LOG_RING_SLOTS	256	/* Must be a power of 2 */
+#define LOG_WAKEUP_MS	50
+#define REPEAT_SLOTS	64	/* Must be a power of 2 */
 
 bool	 g_log_to_syslog = false;
 bool	 g_debug_mode = false;
+bool	 g_log_json = false;
+
+/*
+ * A slot in the ring buffer. 'seq' tells who owns the slot: a producer
+ * may claim it when it equals the enqueue position, and the writer may
+ * consume it when it equals the dequeue position plus one.
+ */
+struct log_record {
+	atomic_size_t	seq;
+	int		priority;
+	bool		event;
+	uint64_t	time_us;
+	char		text[LOG_RECORD_MAX];
+};
+
+static struct log_record	ring[LOG_RING_SLOTS];
+static atomic_size_t		enqueue_pos;
+static size_t			dequeue_pos = 0;
+static atomic_ulong		dropped;
+static unsigned long		dropped_reported = 0;
+
+static atomic_ulong	counts[LOG_LEVEL_COUNT];
+
+/*
+ * A warning that is repeated, i.e. logged again from the same call site
+ * with the same template within the window, is suppressed and counted.
+ * The count is logged as a summary when the window has passed.
+ */
+struct repeat_entry {
+	const char		*file;
+	int			 line;
+	const char		*fmt;
+	uint64_t		 window_start_ns;
+	unsigned long int	 suppressed;
+};
+
+static struct repeat_entry	repeats[REPEAT_SLOTS];
+static pthread_mutex_t		repeat_mtx = PTHREAD_MUTEX_INITIALIZER;
+/*
+ * Off until the config has been read, so that all of its errors are
+ * reported
+ */
+static atomic_uint		repeat_window = 0;
+static atomic_ulong		suppressed_total;
+
+static atomic_bool	async_on;
+static atomic_bool	writer_idle;
+static bool		writer_stop = false;
+static pthread_t	writer;
+static pthread_mutex_t	writer_mtx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	writer_cond = PTHREAD_COND_INITIALIZER;
+static pthread_mutex_t	drain_mtx = PTHREAD_MUTEX_INITIALIZER;
 
 static void
-log_doit(int errCode, int priority, const char *fmt, va_list ap)
+log_format(char *buf, size_t size, int errCode, const char *fmt, va_list ap)
 {
-	char buf[2000] = { '\0' };
+	struct fmt_buf f;
 
-	(void) vsnprintf(buf, sizeof buf, fmt, ap);
+	fmt_init(&f, buf, size, FMT_FIXED, NULL);
+	(void) fmt_vprintf(&f, fmt, ap);
 
 	if (errCode) {
-		(void) snprintf(&buf[strlen(buf)], sizeof buf - strlen(buf),
-		    ": %s", strerror(errCode));
+		const char *msg = strerror(errCode);
+
+		fmt_write(&f, ": ", 2);
+		fmt_write(&f, msg, strlen(msg));
 	}
+}
 
-	if (g_log_to_syslog)
-		syslog(priority, "%s", buf);
+static const char *level_names[LOG_LEVEL_COUNT] = {
+	[LOG_LEVEL_ERR]		= "error",
+	[LOG_LEVEL_WARN]	= "warning",
+	[LOG_LEVEL_INFO]	= "info",
+	[LOG_LEVEL_DEBUG]	= "debug",
+};
+
+static enum log_level
+level_of(int priority)
+{
+	switch (priority) {
+	case LOG_ERR:
+		return LOG_LEVEL_ERR;
+	case LOG_WARNING:
+		return LOG_LEVEL_WARN;
+	case LOG_INFO:
+		return LOG_LEVEL_INFO;
+	default:
+		break;
+	}
+	return LOG_LEVEL_DEBUG;
+}
+
+static uint64_t
+realtime_us(void)
+{
+	struct timespec ts;
+
+	(void) clock_gettime(CLOCK_REALTIME, &ts);
+	return ((uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+}
+
+/*
+ * Write a record to the sink: the log file if one is open, and else
+ * syslog or stdout/stderr. In JSON mode the record is written as a
+ * JSON object on a line of its own: the text of an event record is
+ * already an object whose members are added, and any other text is
+ * added as the member "msg".
+ */
+static void
+log_write(int priority, bool event, uint64_t time_us, const char *text)
+{
+	char json[LOG_RECORD_MAX * 2];
+
+	if (g_log_json) {
+		struct json_writer w;
+
+		json_init(&w, json, sizeof json);
+		json_add_uint(&w, "time_us", time_us);
+		json_add_string(&w, "level", level_names[level_of(priority)]);
+		if (event)
+			json_add_members(&w, text);
+		else
+			json_add_string(&w, "msg", text);
+		(void) json_finish(&w);
+		text = json;
+	}
+
+	if (logfile_is_open())
+		logfile_write(priority, text);
+	else if (g_log_to_syslog)
+		syslog(priority, "%s", text);
 	else {
 		FILE *stream = stderr;
 
@@ -49,11 +180,295 @@ log_doit(int errCode, int priority, const char *fmt, va_list ap)
 			break;
 		}
 
-		(void) fputs(buf, stream);
+		(void) fputs(text, stream);
 		(void) fputc('\n', stream);
 	}
 }
 
+/*
+ * Claim a free slot in the ring buffer. Returns null if the buffer is
+ * full. The slot is published by storing 'pos' + 1 in its 'seq'.
+ */
+static struct log_record *
+ring_claim(size_t *pos)
+{
+	struct log_record	*rec;
+	size_t			 seq;
+
+	*pos = atomic_load_explicit(&enqueue_pos, memory_order_relaxed);
+
+	for (;;) {
+		rec = &ring[*pos & (LOG_RING_SLOTS - 1)];
+		seq = atomic_load_explicit(&rec->seq, memory_order_acquire);
+
+		if (seq == *pos) {
+			if (atomic_compare_exchange_weak_explicit(&enqueue_pos,
+			    pos, *pos + 1, memory_order_relaxed,
+			    memory_order_relaxed))
+				return rec;
+		} else if ((intptr_t) (seq - *pos) < 0) {
+			return NULL;
+		} else {
+			*pos = atomic_load_explicit(&enqueue_pos,
+			    memory_order_relaxed);
+		}
+	}
+}
+
+/*
+ * Write out all published records. Only one thread at a time drains
+ * the buffer.
+ */
+static void
+ring_drain(void)
+{
+	unsigned long n_dropped;
+
+	(void) pthread_mutex_lock(&drain_mtx);
+
+	for (;;) {
+		struct log_record *rec =
+		    &ring[dequeue_pos & (LOG_RING_SLOTS - 1)];
+
+		if (atomic_load_explicit(&rec->seq, memory_order_acquire) !=
+		    dequeue_pos + 1)
+			break;
+		log_write(rec->priority, rec->event, rec->time_us, rec->text);
+		atomic_store_explicit(&rec->seq, dequeue_pos + LOG_RING_SLOTS,
+		    memory_order_release);
+		dequeue_pos++;
+	}
+
+	if ((n_dropped = atomic_load(&dropped)) != dropped_reported) {
+		char buf[100];
+
+		(void) snprintf(buf, sizeof buf, "log: %lu message(s) dropped "
+		    "(buffer full)", n_dropped - dropped_reported);
+		log_write(LOG_WARNING, false, realtime_us(), buf);
+		dropped_reported = n_dropped;
+	}
+
+	(void) pthread_mutex_unlock(&drain_mtx);
+}
+
+static void *
+writer_main(void *arg)
+{
+	(void) arg;
+
+	for (;;) {
+		struct timespec ts;
+
+		ring_drain();
+		logfile_tick();
+
+		(void) pthread_mutex_lock(&writer_mtx);
+		if (writer_stop) {
+			(void) pthread_mutex_unlock(&writer_mtx);
+			break;
+		}
+		atomic_store(&writer_idle, true);
+		(void) clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_nsec += LOG_WAKEUP_MS * 1000000L;
+		if (ts.tv_nsec >= 1000000000L) {
+			ts.tv_sec++;
+			ts.tv_nsec -= 1000000000L;
+		}
+		(void) pthread_cond_timedwait(&writer_cond, &writer_mtx, &ts);
+		atomic_store(&writer_idle, false);
+		(void) pthread_mutex_unlock(&writer_mtx);
+	}
+
+	return NULL;
+}
+
+static void
+log_doit(int errCode, int priority, bool event, const char *fmt, va_list ap)
+{
+	struct log_record	*rec;
+	size_t			 pos;
+	const uint64_t		 time_us = (g_log_json ? realtime_us() : 0);
+
+	(void) atomic_fetch_add_explicit(&counts[level_of(priority)], 1,
+	    memory_order_relaxed);
+
+	if (!atomic_load_explicit(&async_on, memory_order_acquire)) {
+		char buf[LOG_RECORD_MAX] = { '\0' };
+
+		log_format(buf, sizeof buf, errCode, fmt, ap);
+		log_write(priority, event, time_us, buf);
+		return;
+	} else if ((rec = ring_claim(&pos)) == NULL) {
+		(void) atomic_fetch_add(&dropped, 1);
+		return;
+	}
+
+	rec->priority = priority;
+	rec->event = event;
+	rec->time_us = time_us;
+	log_format(rec->text, sizeof rec->text, errCode, fmt, ap);
+	atomic_store_explicit(&rec->seq, pos + 1, memory_order_release);
+
+	if (atomic_load(&writer_idle))
+		(void) pthread_cond_signal(&writer_cond);
+}
+
+static void
+log_summary(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	log_doit(0, LOG_WARNING, false, fmt, ap);
+	va_end(ap);
+}
+
+/**
+ * Start logging asynchronously. Log records are put in a bounded ring
+ * buffer, without locking, and written by a background thread. Thus
+ * the caller never blocks on log I/O. If the buffer is full the record
+ * is dropped and counted.
+ */
+void
+log_async_start(void)
+{
+	sigset_t	all, saved;
+	int		ret;
+
+	if (atomic_load(&async_on))
+		return;
+
+	for (size_t i = 0; i < LOG_RING_SLOTS; i++)
+		atomic_init(&ring[i].seq, i);
+	atomic_init(&enqueue_pos, 0);
+	dequeue_pos = 0;
+	writer_stop = false;
+
+	/*
+	 * Signals are handled by the other threads, since the handler
+	 * flushes the log.
+	 */
+	(void) sigfillset(&all);
+	(void) pthread_sigmask(SIG_SETMASK, &all, &saved);
+	ret = pthread_create(&writer, NULL, writer_main, NULL);
+	(void) pthread_sigmask(SIG_SETMASK, &saved, NULL);
+
+	if (ret != 0) {
+		log_warn(ret, "%s: pthread_create", __func__);
+		return;
+	}
+
+	atomic_store_explicit(&async_on, true, memory_order_release);
+}
+
+/**
+ * Stop logging asynchronously. The records in the ring buffer are
+ * written synchronously, and the log file is flushed, before this
+ * function returns. Later records are written directly.
+ */
+void
+log_async_stop(void)
+{
+	if (!atomic_exchange(&async_on, false))
+		return;
+
+	(void) pthread_mutex_lock(&writer_mtx);
+	writer_stop = true;
+	(void) pthread_cond_signal(&writer_cond);
+	(void) pthread_mutex_unlock(&writer_mtx);
+
+	if (!pthread_equal(pthread_self(), writer))
+		(void) pthread_join(writer, NULL);
+	ring_drain();
+	logfile_flush();
+}
+
+/**
+ * Get the number of records logged at a level since the start of the
+ * program, including dropped records
+ *
+ * @param level Log level
+ * @return The count
+ */
+unsigned long int
+log_count(enum log_level level)
+{
+	if (level < 0 || level >= LOG_LEVEL_COUNT)
+		return 0;
+	return atomic_load_explicit(&counts[level], memory_order_relaxed);
+}
+
+/**
+ * Get the number of log records that have been dropped because the
+ * ring buffer was full
+ */
+unsigned long int
+log_dropped(void)
+{
+	return atomic_load(&dropped);
+}
+
+/**
+ * Log the summaries of the repeated warnings whose window has passed,
+ * and start a new window for them. Should be called periodically, for
+ * example once per cycle, so that warnings that keep repeating are
+ * summarized even if they stop.
+ *
+ * @param all If true, log the summaries of all repeated warnings
+ *            regardless of their window (e.g. at exit)
+ * @return Void
+ */
+void
+log_repeats_flush(bool all)
+{
+	const unsigned int	window = atomic_load(&repeat_window);
+	const uint64_t		now = monotonic_ns();
+
+	for (size_t i = 0; i < REPEAT_SLOTS; i++) {
+		struct repeat_entry	*ent = &repeats[i];
+		const char		*fmt = NULL;
+		unsigned long int	 n = 0;
+
+		(void) pthread_mutex_lock(&repeat_mtx);
+		if (ent->file != NULL && ent->suppressed > 0 && (all ||
+		    now - ent->window_start_ns >= window *
+		    UINT64_C(1000000000))) {
+			fmt = ent->fmt;
+			n = ent->suppressed;
+			ent->suppressed = 0;
+			ent->window_start_ns = now;
+		}
+		(void) pthread_mutex_unlock(&repeat_mtx);
+
+		if (n > 0) {
+			log_summary("log: \"%s\" repeated %lu time(s) in "
+			    "%u seconds", fmt, n, window);
+		}
+	}
+}
+
+/**
+ * Set the window in which repeated warnings are suppressed
+ *
+ * @param seconds Window length. 0 turns suppression off.
+ * @return Void
+ */
+void
+log_set_repeat_window(unsigned int seconds)
+{
+	atomic_store(&repeat_window, seconds);
+}
+
+/**
+ * Get the number of warnings that have been suppressed as repeats
+ * since the start of the program
+ */
+unsigned long int
+log_suppressed(void)
+{
+	return atomic_load(&suppressed_total);
+}
+
 /**
  * Redirect standard IO streams stderr, stdin and stdout to /dev/null.
  *
@@ -75,7 +490,9 @@ redirect_standard_streams(void)
 
 /**
  * Handle fatal errors. This function calls abort(), i.e. it never
- * returns.
+ * returns. Asynchronous logging is stopped, so that all pending log
+ * records are written before the error, and the program is cleaned up
+ * here, since the handler of SIGABRT doesn't do it.
  *
  * @param code	Code passed to strerror()
  * @param fmt	Format control
@@ -85,26 +502,119 @@ fatal(int code, const char *fmt, ...)
 {
 	va_list ap;
 
+	log_async_stop();
+
 	va_start(ap, fmt);
-	log_doit(code, LOG_ERR, fmt, ap);
+	log_doit(code, LOG_ERR, false, fmt, ap);
 	va_end(ap);
 
+	program_clean_up();
 	abort();
 }
 
 /**
- * Log debug-level message
+ * Log debug-level message. Called through the log_debug() macro, which
+ * checks whether debug logging is enabled.
  */
 void
-log_debug(const char *fmt, ...)
+log_debug_write(const char *fmt, ...)
 {
 	va_list ap;
 
-	if (g_debug_mode) {
-		va_start(ap, fmt);
-		log_doit(0, LOG_DEBUG, fmt, ap);
-		va_end(ap);
+	va_start(ap, fmt);
+	log_doit(0, LOG_DEBUG, false, fmt, ap);
+	va_end(ap);
+}
+
+/*
+ * Find the entry of a call site, or add it. The strings are literals,
+ * so they are compared by address. Returns NULL if the table is full.
+ */
+static struct repeat_entry *
+repeat_lookup(const char *file, int line, const char *fmt)
+{
+	const size_t i = (((uintptr_t) file ^ (uintptr_t) fmt) >> 3) +
+	    (size_t) line;
+
+	for (size_t n = 0; n < REPEAT_SLOTS; n++) {
+		struct repeat_entry *ent =
+		    &repeats[(i + n) & (REPEAT_SLOTS - 1)];
+
+		if (ent->file == file && ent->line == line && ent->fmt == fmt)
+			return ent;
+		if (ent->file == NULL) {
+			ent->file = file;
+			ent->line = line;
+			ent->fmt = fmt;
+			return ent;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Decide whether a warning is logged or suppressed as a repeat. When a
+ * new window starts the number of repeats in the previous one is
+ * logged first.
+ */
+static bool
+repeat_admit(const char *file, int line, const char *fmt)
+{
+	const unsigned int	 window = atomic_load(&repeat_window);
+	struct repeat_entry	*ent;
+	uint64_t		 now;
+	unsigned long int	 n = 0;
+
+	if (window == 0 || log_debug_enabled())
+		return true;
+
+	now = monotonic_ns();
+	(void) pthread_mutex_lock(&repeat_mtx);
+	if ((ent = repeat_lookup(file, line, fmt)) == NULL) {
+		(void) pthread_mutex_unlock(&repeat_mtx);
+		return true;
+	} else if (ent->window_start_ns != 0 &&
+	    now - ent->window_start_ns < window * UINT64_C(1000000000)) {
+		ent->suppressed++;
+		(void) pthread_mutex_unlock(&repeat_mtx);
+		(void) atomic_fetch_add(&suppressed_total, 1);
+		return false;
 	}
+	n = ent->suppressed;
+	ent->suppressed = 0;
+	ent->window_start_ns = now;
+	(void) pthread_mutex_unlock(&repeat_mtx);
+
+	if (n > 0) {
+		log_summary("log: \"%s\" repeated %lu time(s) in %u seconds",
+		    fmt, n, window);
+	}
+	return true;
+}
+
+static void
+log_event_doit(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	log_doit(0, LOG_INFO, true, fmt, ap);
+	va_end(ap);
+}
+
+/**
+ * Log an event record, i.e. a JSON object written by a json_writer.
+ * Its members are logged together with the time and the level. Event
+ * records are only logged in JSON mode.
+ *
+ * @param object The object
+ * @return Void
+ */
+void
+log_event(const char *object)
+{
+	if (g_log_json && object != NULL)
+		log_event_doit("%s", object);
 }
 
 /**
@@ -132,22 +642,30 @@ log_msg(const char *fmt, ...)
 	va_list ap;
 
 	va_start(ap, fmt);
-	log_doit(0, LOG_INFO, fmt, ap);
+	log_doit(0, LOG_INFO, false, fmt, ap);
 	va_end(ap);
 }
 
 /**
- * Log warning conditions
+ * Log warning conditions. A warning that is logged again from the same
+ * call site with the same format within the repeat window is
+ * suppressed, and the number of repeats is logged when the window has
+ * passed. Called through the log_warn() macro.
  *
+ * @param file	Source file of the call site
+ * @param line	Line of the call site
  * @param code	Code passed to strerror()
  * @param fmt	Format control
  */
 void
-log_warn(int code, const char *fmt, ...)
+log_warn_at(const char *file, int line, int code, const char *fmt, ...)
 {
 	va_list ap;
 
+	if (!repeat_admit(file, line, fmt))
+		return;
+
 	va_start(ap, fmt);
-	log_doit(code, LOG_WARNING, fmt, ap);
+	log_doit(code, LOG_WARNING, false, fmt, ap);
 	va_end(ap);
 }
@@ -7,6 +7,28 @@
 
 #include "ducdef.h"
 
+/*
+ * Set to 0 to compile out debug logging, for example with:
+ * make CPPFLAGS=-DLOG_DEBUG_COMPILED=0
+ */
+#ifndef LOG_DEBUG_COMPILED
+#define LOG_DEBUG_COMPILED 1
+#endif
+
+/*
+ * The default window, in seconds, in which a warning that is repeated
+ * from the same call site is suppressed
+ */
+#define LOG_REPEAT_WINDOW_DEFAULT 3600
+
+enum log_level {
+	LOG_LEVEL_ERR,
+	LOG_LEVEL_WARN,
+	LOG_LEVEL_INFO,
+	LOG_LEVEL_DEBUG,
+	LOG_LEVEL_COUNT
+};
+
 typedef enum {
 	REDIR_OK,
 	REDIR_STDERR_FAIL,
@@ -17,18 +39,55 @@ typedef enum {
 __DUC_BEGIN_DECLS
 extern bool	 g_log_to_syslog;
 extern bool	 g_debug_mode;
+extern bool	 g_log_json;
 
 /*lint -sem(fatal, r_no) */
 
 redir_res_t	 redirect_standard_streams(void);
 __dead void	 fatal(int, const char *, ...) PRINTFLIKE(2);
 
-void	 log_debug(const char *, ...) PRINTFLIKE(1);
+unsigned long int log_count(enum log_level);
+unsigned long int log_dropped(void);
+unsigned long int log_suppressed(void);
+
+void	 log_async_start(void);
+void	 log_async_stop(void);
+void	 log_debug_write(const char *, ...) PRINTFLIKE(1);
+void	 log_event(const char *);
 void	 log_init(void);
 void	 log_msg(const char *, ...) PRINTFLIKE(1);
-void	 log_warn(int, const char *, ...) PRINTFLIKE(2);
+void	 log_repeats_flush(bool);
+void	 log_set_repeat_window(unsigned int);
+void	 log_warn_at(const char *, int, int, const char *, ...) PRINTFLIKE(4);
 __DUC_END_DECLS
 
+/*
+ * True if debug messages are logged. Work that is only done in order to
+ * log a debug message should be skipped unless this is true.
+ */
+#if LOG_DEBUG_COMPILED
+#define log_debug_enabled()	(g_debug_mode)
+#else
+#define log_debug_enabled()	(false)
+#endif
+
+/*
+ * Log debug-level message. The arguments are only evaluated if debug
+ * logging is enabled.
+ */
+#define log_debug(...)\
+	do {\
+		if (log_debug_enabled())\
+			log_debug_write(__VA_ARGS__);\
+	} while (0)
+
+/*
+ * Log warning conditions. The call site is passed on, since a warning
+ * that is repeated is recognized by its call site and format.
+ */
+#define log_warn(code, ...)\
+	log_warn_at(__FILE__, __LINE__, (code), __VA_ARGS__)
+
 static inline void
 log_assert_arg_nonnull(const char *in_func, const char *arg_name,
 		       const void *arg)
@@ -0,0 +1,336 @@
+/* Copyright (c) 2026 Markus Uhlin <markus.uhlin@icloud.com>
+   All rights reserved.
+
+   Permission to use, copy, modify, and distribute this software for any
+   purpose with or without fee is hereby granted, provided that the above
+   copyright notice and this permission notice appear in all copies.
+
+   THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+   WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+   AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+   DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR
+   PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+   TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+   PERFORMANCE OF THIS SOFTWARE. */
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <syslog.h>
+#include <unistd.h>
+
+#include "logfile.h"
+#include "various.h"
+
+#define FLUSH_NS	(LOGFILE_FLUSH_MS * UINT64_C(1000000))
+
+/*
+ * The log file sink. Records are buffered and written in batches:
+ * when LOGFILE_FLUSH_SIZE bytes are buffered or the oldest buffered
+ * record is LOGFILE_FLUSH_MS old. Warnings and errors are written at
+ * once and synced to disk. Nothing here may log, since the logging
+ * functions call in here.
+ */
+static char		path[1024];
+static int		fd = -1;
+static dev_t		file_dev;
+static ino_t		file_ino;
+static off_t		file_size = 0;
+static bool		broken = false;	/* A write failed */
+
+static char		buf[LOGFILE_BUF_SIZE];
+static size_t		buf_len = 0;
+static uint64_t		oldest_ns = 0;
+static uint64_t		checked_ns = 0;
+
+static size_t		max_size = LOGFILE_MAX_SIZE;
+static int		keep = LOGFILE_KEEP;
+
+static pthread_mutex_t	mtx = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * (Re)open the log file. On failure the file that is open, if any,
+ * stays open.
+ */
+static int
+open_locked(void)
+{
+	struct stat	sb;
+	int		new_fd;
+
+	if ((new_fd = open(path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC,
+	    S_IRUSR | S_IWUSR | S_IRGRP)) == -1)
+		return -1;
+	if (fstat(new_fd, &sb) == -1) {
+		(void) close(new_fd);
+		return -1;
+	}
+	if (fd != -1)
+		(void) close(fd);
+	fd = new_fd;
+	file_dev = sb.st_dev;
+	file_ino = sb.st_ino;
+	file_size = sb.st_size;
+	broken = false;
+	return 0;
+}
+
+static int
+write_all(const char *data, size_t len)
+{
+	while (len > 0) {
+		const ssize_t n = write(fd, data, len);
+
+		if (n == -1) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		data += n;
+		len -= n;
+		file_size += n;
+	}
+	return 0;
+}
+
+/*
+ * Write out the buffer. If the file is broken the buffer is discarded,
+ * until the file is reopened.
+ */
+static void
+flush_locked(void)
+{
+	if (buf_len > 0 && !broken && write_all(buf, buf_len) == -1)
+		broken = true;
+	buf_len = 0;
+}
+
+/*
+ * Rotate: path.N-1 becomes path.N and so on, and the file becomes
+ * path.1. If something fails rotation is turned off, and the reason is
+ * written to the file that is open.
+ */
+static void
+rotate_locked(void)
+{
+	char	from[sizeof path + 16];
+	char	to[sizeof path + 16];
+	char	msg[sizeof path + 100];
+	int	ret;
+
+	flush_locked();
+
+	for (int i = keep - 1; i >= 1; i--) {
+		(void) snprintf(from, sizeof from, "%s.%d", path, i);
+		(void) snprintf(to, sizeof to, "%s.%d", path, i + 1);
+		if (rename(from, to) == -1 && errno != ENOENT)
+			goto fail;
+	}
+
+	if (keep < 1) {
+		if (ftruncate(fd, 0) == -1)
+			goto fail;
+		file_size = 0;
+		return;
+	}
+
+	(void) snprintf(to, sizeof to, "%s.1", path);
+	if (rename(path, to) == -1 || open_locked() == -1)
+		goto fail;
+	return;
+
+  fail:
+	ret = snprintf(msg, sizeof msg, "log: cannot rotate %s: %s "
+	    "(rotation turned off)\n", path, strerror(errno));
+	if (ret > 0 && !broken && write_all(msg, strlen(msg)) == -1)
+		broken = true;
+	max_size = 0;
+}
+
+/**
+ * Open the log file. Later records are logged to it instead of to
+ * syslog or stdout/stderr.
+ *
+ * @param p Absolute path of the log file. The directory must be
+ *          writable by the program after it has dropped its root
+ *          privileges, so that the file can be rotated.
+ * @return 0 on success, and -1 on failure (errno is set)
+ */
+int
+logfile_open(const char *p)
+{
+	int ret;
+
+	if (p == NULL || *p != '/') {
+		errno = EINVAL;
+		return -1;
+	} else if (strlen(p) >= sizeof path) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+
+	(void) pthread_mutex_lock(&mtx);
+	(void) strlcpy(path, p, sizeof path);
+	buf_len = 0;
+	checked_ns = 0;
+	ret = open_locked();
+	(void) pthread_mutex_unlock(&mtx);
+	return ret;
+}
+
+/**
+ * @return true if the log file is open
+ */
+bool
+logfile_is_open(void)
+{
+	return (fd != -1);
+}
+
+/**
+ * Change the owner of the log file, i.e. before root privileges are
+ * dropped
+ */
+int
+logfile_chown(uid_t uid, gid_t gid)
+{
+	int ret = 0;
+
+	(void) pthread_mutex_lock(&mtx);
+	if (fd != -1)
+		ret = fchown(fd, uid, gid);
+	(void) pthread_mutex_unlock(&mtx);
+	return ret;
+}
+
+/**
+ * Flush and close the log file
+ */
+void
+logfile_close(void)
+{
+	(void) pthread_mutex_lock(&mtx);
+	if (fd != -1) {
+		flush_locked();
+		(void) fsync(fd);
+		(void) close(fd);
+		fd = -1;
+	}
+	(void) pthread_mutex_unlock(&mtx);
+}
+
+/**
+ * Write the buffered records to the log file
+ */
+void
+logfile_flush(void)
+{
+	(void) pthread_mutex_lock(&mtx);
+	if (fd != -1)
+		flush_locked();
+	(void) pthread_mutex_unlock(&mtx);
+}
+
+/**
+ * Set when the log file is rotated
+ *
+ * @param size	Rotate when the file would grow past this size. 0
+ *		turns rotation off.
+ * @param count	Number of rotated files to keep. If 0, the file is
+ *		truncated instead.
+ * @return Void
+ */
+void
+logfile_set_rotation(size_t size, int count)
+{
+	(void) pthread_mutex_lock(&mtx);
+	max_size = size;
+	keep = count;
+	(void) pthread_mutex_unlock(&mtx);
+}
+
+/**
+ * Do the periodic work: flush the buffer if the oldest record is due,
+ * and reopen the log file if it has been moved or removed (for example
+ * by an external log rotation) or a write to it failed. Should be
+ * called regularly, e.g. by the log writer thread.
+ */
+void
+logfile_tick(void)
+{
+	const uint64_t	now = monotonic_ns();
+	struct stat	sb;
+
+	(void) pthread_mutex_lock(&mtx);
+	if (fd == -1) {
+		(void) pthread_mutex_unlock(&mtx);
+		return;
+	}
+	if (buf_len > 0 && now - oldest_ns >= FLUSH_NS)
+		flush_locked();
+	if (now - checked_ns >= FLUSH_NS) {
+		checked_ns = now;
+		if (broken || stat(path, &sb) == -1 || sb.st_dev != file_dev ||
+		    sb.st_ino != file_ino) {
+			flush_locked();
+			(void) open_locked();
+		}
+	}
+	(void) pthread_mutex_unlock(&mtx);
+}
+
+/**
+ * Log a record to the log file
+ *
+ * @param priority	Syslog priority. Warnings and errors are written
+ *			and synced at once.
+ * @param text		Record text, without a newline
+ * @return Void
+ */
+void
+logfile_write(int priority, const char *text)
+{
+	const size_t len = strlen(text);
+
+	(void) pthread_mutex_lock(&mtx);
+	if (fd == -1) {
+		(void) pthread_mutex_unlock(&mtx);
+		return;
+	}
+
+	if (max_size > 0 && file_size + buf_len > 0 &&
+	    (size_t) file_size + buf_len + len + 1 > max_size)
+		rotate_locked();
+	if (buf_len + len + 1 > sizeof buf)
+		flush_locked();
+
+	if (len + 1 > sizeof buf) {
+		if (!broken && (write_all(text, len) == -1 ||
+		    write_all("\n", 1) == -1))
+			broken = true;
+	} else {
+		if (buf_len == 0)
+			oldest_ns = monotonic_ns();
+		(void) memcpy(&buf[buf_len], text, len);
+		buf[buf_len + len] = '\n';
+		buf_len += len + 1;
+	}
+
+	if (priority <= LOG_WARNING) {
+		flush_locked();
+		if (!broken)
+			(void) fsync(fd);
+	} else if (buf_len >= LOGFILE_FLUSH_SIZE ||
+	    monotonic_ns() - oldest_ns >= FLUSH_NS) {
+		flush_locked();
+	}
+
+	(void) pthread_mutex_unlock(&mtx);
+}
@@ -0,0 +1,40 @@
+#ifndef LOGFILE_H
+#define LOGFILE_H
+
+#include <sys/types.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "ducdef.h"
+
+/*
+ * The log file is rotated when it would grow past LOGFILE_MAX_SIZE
+ * bytes, and LOGFILE_KEEP rotated files are kept: path.1 (the newest)
+ * to path.LOGFILE_KEEP. Both can be overridden at build time, for
+ * example with: make CPPFLAGS=-DLOGFILE_MAX_SIZE=10485760
+ */
+#ifndef LOGFILE_MAX_SIZE
+#define LOGFILE_MAX_SIZE	(1024 * 1024)
+#endif
+#ifndef LOGFILE_KEEP
+#define LOGFILE_KEEP		5
+#endif
+
+#define LOGFILE_BUF_SIZE	65536
+#define LOGFILE_FLUSH_SIZE	32768	/* Flush when this much is buffered */
+#define LOGFILE_FLUSH_MS	1000	/* ...or when the oldest record is
+					   this old */
+
+__DUC_BEGIN_DECLS
+bool	logfile_is_open(void);
+int	logfile_chown(uid_t, gid_t);
+int	logfile_open(const char *);
+void	logfile_close(void);
+void	logfile_flush(void);
+void	logfile_set_rotation(size_t, int);
+void	logfile_tick(void);
+void	logfile_write(int, const char *);
+__DUC_END_DECLS
+
+#endif
@@ -17,21 +17,37 @@
 #if __OpenBSD__
 #include <sys/param.h>
 #endif
+#include <sys/stat.h>
 #include <sys/types.h>
 
+#include <limits.h>
 #include <locale.h>
+#include <pthread.h>
 #include <pwd.h>
+#include <stdatomic.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include <unistd.h>
 
-#include "base64.h"
+#include "arena.h"
 #include "colors.h"
+#include "confcache.h"
+#include "control.h"
 #include "daemonize.h"
+#include "json.h"
+#include "listener.h"
 #include "log.h"
+#include "logfile.h"
 #include "main.h"
+#include "metrics.h"
+#include "netstats.h"
 #include "network.h"
+#include "pool.h"
+#include "probes.h"
+#include "protocol.h"
 #include "settings.h"
 #include "sig.h"
 #include "terminate.h"
@@ -57,6 +73,19 @@ static const char *help_text[] = {
   "  -o           Don't cycle, i.e. don't periodically check for IP\n",
   "               changes. Only update the hostname(s) once.\n",
   "  -B           Run in the background and act as a daemon\n",
+  "  -p           Use a precompiled binary image of the config file.\n",
+  "               The image is stored next to the config file and\n",
+  "               rebuilt whenever the config file changes.\n",
+  "  -t           Test the config file, report all errors in it and\n",
+  "               exit. No connections are made.\n",
+  "  -j           Log in JSON lines, with a record carrying the result\n",
+  "               and the timing of each update attempt\n",
+  "  -l <path>    Log to a file instead of syslog or stdout/stderr.\n",
+  "               The file is rotated by size.\n",
+  "  -m <address> Serve Prometheus metrics on a UNIX socket (an absolute\n",
+  "               path) or on a loopback TCP port ([host:]port)\n",
+  "  -s <path>    Accept commands on a UNIX socket, e.g. to update now\n",
+  "               or to reload the config file\n",
   "\n",
 };
 
@@ -65,18 +94,67 @@ static bool Cycle = true;
 static const char enhanced_duc_user[] = DUC_USER;
 static const char enhanced_duc_dir[] = DUC_DIR;
 
-static char *hostname_array[DUC_PERMITTED_HOSTS_LIMIT] = { NULL };
+static char	**hostname_array = NULL;
+static size_t	  hostname_count = 0;
+
+/*
+ * The absolute path of the config file, for 'reload'. It's resolved
+ * before the privileges are dropped and the working directory is
+ * changed.
+ */
+static char conf_path[PATH_MAX] = "";
+
+/*
+ * The outcome of the last update attempt of every host that has been
+ * updated. Shown by the control command "state". Written by the update
+ * workers under 'host_states_mtx'.
+ */
+struct host_state {
+	char			*name;
+	const char		*code;
+	time_t			 when;
+	unsigned long int	 attempts;
+	unsigned long int	 failures;
+};
+
+static struct host_state	*host_states = NULL;
+static size_t			 host_states_count = 0;
+static pthread_mutex_t		 host_states_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * The hosts of an update batch. 'retry' is set when the server asks to
+ * retry later, and 'fatal_code' to the first response after which the
+ * program has to exit (CODE_GOOD if none). Then the hosts that haven't
+ * been started are skipped. The workers never exit the program: that's
+ * up to the caller of pool_run().
+ */
+struct update_batch {
+	char		**hosts;
+	const char	 *to_ip;
+	atomic_bool	  retry;
+	atomic_int	  fatal_code;
+};
+
+/*
+ * The schedule of the update cycle. An update requested by a control
+ * client is carried out between the cycles. 'requested_hosts' is NULL
+ * for all hosts, or a list like "|host1|host2|".
+ */
+static uint64_t	 next_cycle_ns = 0;
+static bool	 retry_scheduled = false;
+static bool	 update_requested = false;
+static char	*requested_hosts = NULL;
 
 #define FOREACH_HOSTNAME()\
-	for (char **ar_p = &hostname_array[0];\
-	     ar_p < &hostname_array[nitems(hostname_array)];\
+	for (char **ar_p = hostname_array;\
+	     ar_p < hostname_array + hostname_count;\
 	     ar_p++)
 
 static void
 process_options(int argc, char *argv[], struct program_options *po, char *ar,
 		size_t ar_sz)
 {
-	const char opt_string[] = ":hcx:DoB";
+	const char opt_string[] = ":hcx:DoBptjl:m:s:";
 	enum { MISSING_OPTARG = ':', UNRECOGNIZED_OPTION = '?' };
 	int opt = -1;
 
@@ -110,6 +188,24 @@ process_options(int argc, char *argv[], struct program_options *po, char *ar,
 		case 'B':
 			po->want_daemon = true;
 			break;
+		case 'p':
+			po->want_config_cache = true;
+			break;
+		case 't':
+			po->want_config_test = true;
+			break;
+		case 'j':
+			po->want_json_log = true;
+			break;
+		case 'l':
+			po->log_file = optarg;
+			break;
+		case 'm':
+			po->metrics_addr = optarg;
+			break;
+		case 's':
+			po->control_socket = optarg;
+			break;
 		}
 	}
 }
@@ -138,6 +234,47 @@ usage(void)
 	exit(1);
 }
 
+/*
+ * Test the config file: parse it and validate the settings, report
+ * all errors and how long it took, and exit. Nothing is connected to
+ * and no process is forked.
+ */
+static __dead void
+test_config(const char *path)
+{
+	const char	*name, *custom_val;
+	size_t		 n_hosts = 0;
+	size_t		 n_settings = 0;
+	size_t		 parse_errors, setting_errors;
+	uint64_t	 ns[3];
+
+	ns[0] = monotonic_ns();
+	parse_errors = test_config_file(path);
+	ns[1] = monotonic_ns();
+	setting_errors = validate_settings(&n_hosts);
+	ns[2] = monotonic_ns();
+
+	for (size_t i = 0; setting_by_index(i, &name, &custom_val); i++) {
+		if (custom_val)
+			n_settings++;
+	}
+
+	printf("%s: %zu setting(s), %zu host(s) to update\n", path,
+	    n_settings, n_hosts);
+	printf("parse:    %8.3f ms, %zu error(s)\n", (ns[1] - ns[0]) / 1e6,
+	    parse_errors);
+	printf("validate: %8.3f ms, %zu error(s)\n", (ns[2] - ns[1]) / 1e6,
+	    setting_errors);
+
+	if (parse_errors > 0 || setting_errors > 0) {
+		printf("%s: test failed\n", path);
+		exit(1);
+	}
+
+	printf("%s: test is successful\n", path);
+	exit(0);
+}
+
 static void
 turn_on_debug_mode(void)
 {
@@ -159,6 +296,8 @@ force_priv_drop(void)
 
 	if (pw == NULL)
 		fatal(0, "getpwnam: no such user %s", enhanced_duc_user);
+	else if (logfile_chown(pw->pw_uid, pw->pw_gid) == -1)
+		fatal(errno, "chown log file");
 	else if (!is_directory(enhanced_duc_dir) ||
 		 chdir(enhanced_duc_dir) != 0)
 		fatal(errno, "chdir %s", enhanced_duc_dir);
@@ -179,17 +318,21 @@ force_priv_drop(void)
 static void
 hostname_array_init(void)
 {
-	FOREACH_HOSTNAME() {
-		*ar_p = NULL;
-	}
+	hostname_array = NULL;
+	hostname_count = 0;
 }
 
+/*
+ * Split the hostname setting. The array and the names are in the arena
+ * of the cycle.
+ */
 static void
 hostname_array_assign(void)
 {
-	char *dump = xstrdup(setting("hostname"));
+	char *dump = arena_strdup(&g_arena, setting("hostname"));
 	static const char legal_index[] =
 	    "abcdefghijklmnopqrstuvwxyz-0123456789.ABCDEFGHIJKLMNOPQRSTUVWXYZ|";
+	size_t max_hosts = 1;
 
 	if (strings_match(dump, "")) {
 		fatal(EINVAL, "hostname_array_assign: no hostnames to update"
@@ -201,14 +344,20 @@ hostname_array_assign(void)
 			fatal(0, "hostname_array_assign: "
 			    "invalid chars in setting: "
 			    "first invalid char is '%c'...", *cp);
+		} else if (*cp == '|') {
+			max_hosts++;
 		}
 	}
 
+	hostname_array = arena_calloc(&g_arena, max_hosts,
+	    sizeof *hostname_array);
+
 	for (size_t hosts_assigned = 0;; hosts_assigned++) {
 		char *token = strtok(hosts_assigned == 0 ? dump : NULL, "|");
 
-		if (token && hosts_assigned < nitems(hostname_array)) {
-			hostname_array[hosts_assigned] = xstrdup(token);
+		if (token && hosts_assigned < max_hosts) {
+			hostname_array[hosts_assigned] = token;
+			hostname_count = hosts_assigned + 1;
 		} else if (hosts_assigned == 0) {
 			fatal(0, "hostname_array_assign: fatal: "
 			    "zero assigned hosts!");
@@ -219,17 +368,13 @@ hostname_array_assign(void)
 			break;
 		}
 	}
-
-	free(dump);
 }
 
 static void
 hostname_array_destroy(void)
 {
-	FOREACH_HOSTNAME() {
-		free_not_null(*ar_p);
-		*ar_p = NULL;
-	}
+	hostname_array = NULL;
+	hostname_count = 0;
 }
 
 static void
@@ -243,59 +388,29 @@ static int
 send_update_request(const char *which_host, const char *to_ip)
 {
 	bool	 ok = true;
-	char	*agent = NULL;
-	char	*auth = NULL;
-	char	*s, *host, *unp;
-	char	 buf[500] = { '\0' };
+	char	*req;
 
-	s = host = unp = NULL;
+	USDT_PROBE2(request_start, which_host, to_ip);
 
-	if (strings_match(to_ip, "WAN_address")) {
-		s = strdup_printf("GET %s?hostname=%s HTTP/1.0", UPDATE_SCRIPT,
-		    which_host);
-	} else {
-		s = strdup_printf("GET %s?hostname=%s&myip=%s HTTP/1.0",
-		    UPDATE_SCRIPT, which_host, to_ip);
-	}
-
-	host = strdup_printf("Host: %s", setting("sp_hostname"));
-	unp = strdup_printf("%s:%s", setting("username"), setting("password"));
-
-	if (b64_encode((uint8_t *) unp, strlen(unp), buf, sizeof buf) < 0) {
-		log_warn(EMSGSIZE, "send_update_request: b64_encode");
+	if ((req = update_request(&g_arena, which_host, to_ip)) == NULL) {
+		log_warn(EMSGSIZE, "send_update_request: update_request");
 		ok = false;
-		goto err;
+	} else {
+		log_debug("sending http get request");
+		if (net_send("%s", req) != 0)
+			ok = false;
 	}
 
-	auth = strdup_printf("Authorization: Basic %s", buf);
-	agent = strdup_printf("User-Agent: %s/%s %s", g_programName,
-	    g_programVersion, g_maintainerEmail);
-
-	log_debug("sending http get request");
-
-	if (net_send("%s\r\n%s\r\n%s\r\n%s", s, host, auth, agent) != 0)
-		ok = false;
-
-  err:
-	free_not_null(s);
-	free_not_null(host);
-	free_not_null(unp);
-	free_not_null(auth);
-	free_not_null(agent);
+	USDT_PROBE2(request_done, which_host, (ok ? 0 : -1));
 	return (ok ? 0 : -1);
 }
 
 static int
-store_server_resp_in_buffer(char **buf)
+read_server_response(char **buf)
 {
 	const size_t sz = 2000;
 
-	if (*buf) {
-		free(*buf);
-		*buf = NULL;
-	}
-
-	*buf = xcalloc(sz, 1);
+	*buf = arena_calloc(&g_arena, sz, 1);
 
 	if (net_recv(*buf, sz) == -1)
 		return -1;
@@ -314,93 +429,162 @@ store_server_resp_in_buffer(char **buf)
 	return 0;
 }
 
-static response_code_t
-server_response(const char *buf)
+static int
+store_server_resp_in_buffer(char **buf)
 {
-	char *dump, *cp, *r;
-	static const struct responses_tag {
-		char *str;
-		response_code_t code;
-	} responses[] = {
-		{ "good",     CODE_GOOD       },
-		{ "nochg",    CODE_NOCHG      },
-		{ "nohost",   CODE_NOHOST     },
-		{ "badauth",  CODE_BADAUTH    },
-		{ "badagent", CODE_BADAGENT   },
-		{ "!donator", CODE_NOTDONATOR },
-		{ "abuse",    CODE_ABUSE      },
-		{ "911",      CODE_EMERG      },
-	};
+	int ret;
 
-	dump = cp = r = NULL;
+	USDT_PROBE0(response_start);
+	ret = read_server_response(buf);
+	USDT_PROBE2(response_done, ret, *buf);
+	return ret;
+}
 
-	if (buf == NULL || strings_match(buf, "")) {
-		return CODE_UNKNOWN;
-	} else {
-		char	*buf_copy = xstrdup(buf);
-		char	*buf_ptr = NULL;
+/*
+ * Log a JSON record of an update attempt: its result and the time
+ * spent in each phase. 'code' is NULL if the attempt failed before a
+ * response was received. The record is written into a buffer on the
+ * stack, i.e. nothing is allocated.
+ */
+static void
+log_update_record(const char *which_host, const char *code)
+{
+	char			record[1024];
+	struct json_writer	w;
+	const uint64_t		*phase_us = g_net_timing.phase_us;
 
-		while ((buf_ptr = strpbrk(buf_copy, "\r\n")) != NULL) {
-			if (*buf_ptr == '\r') {
-				*buf_ptr = 'R';
-			} else {
-				*buf_ptr = 'N';
-			}
-		}
+	if (!g_log_json)
+		return;
 
-		log_debug("server_response: the buffer looks like this: %s",
-		    buf_copy);
-		free(buf_copy);
-	}
+	json_init(&w, record, sizeof record);
+	json_add_string(&w, "event", "update");
+	json_add_string(&w, "host", which_host);
+	json_add_string(&w, "account", setting("username"));
+	json_add_string(&w, "addr", g_net_timing.addr);
+	json_add_string(&w, "code", (code ? code : "error"));
+	json_add_bool(&w, "ok", (code && (strings_match(code, "good") ||
+	    strings_match(code, "nochg"))));
+	json_add_uint(&w, "resolve_us", phase_us[NET_PHASE_RESOLVE]);
+	json_add_uint(&w, "connect_us", phase_us[NET_PHASE_CONNECT]);
+	json_add_uint(&w, "tls_us", phase_us[NET_PHASE_TLS_HANDSHAKE]);
+	json_add_uint(&w, "write_us", phase_us[NET_PHASE_WRITE]);
+	json_add_uint(&w, "first_byte_us", phase_us[NET_PHASE_FIRST_BYTE]);
+	json_add_uint(&w, "total_us", g_net_timing.total_us);
+	(void) json_finish(&w);
+
+	log_event(record);
+}
 
-	dump = trim(xstrdup(buf));
-	if ((cp = strrchr(dump, '\n')) == NULL) {
-		free(dump);
-		return CODE_UNKNOWN;
-	}
-	r = strToLower(xstrdup(++cp));
-	free(dump);
-	log_debug("server_response: r = \"%s\"", r);
+/*
+ * An update attempt is done: record its timing, as a request to the
+ * service provider and for the host, and log it
+ */
+static void
+update_done(const char *which_host, const char *code)
+{
+	struct host_state *hs = NULL;
 
-	if (!strncmp(r, "good ", 5)) {
-		free(r);
-		return CODE_GOOD;
-	} else if (!strncmp(r, "nochg ", 6)) {
-		free(r);
-		return CODE_NOCHG;
+	(void) pthread_mutex_lock(&host_states_mtx);
+	for (size_t i = 0; i < host_states_count; i++) {
+		if (strings_match(host_states[i].name, which_host)) {
+			hs = &host_states[i];
+			break;
+		}
 	}
+	if (hs == NULL) {
+		const size_t size = (host_states_count + 1) *
+		    sizeof *host_states;
+
+		host_states = (host_states ? xrealloc(host_states, size) :
+		    xmalloc(size));
+		hs = &host_states[host_states_count++];
+		(void) memset(hs, 0, sizeof *hs);
+		hs->name = xstrdup(which_host);
+	}
+	hs->code = (code ? code : "error");
+	hs->when = time(NULL);
+	hs->attempts++;
+	if (!strings_match(hs->code, "good") &&
+	    !strings_match(hs->code, "nochg"))
+		hs->failures++;
+	(void) pthread_mutex_unlock(&host_states_mtx);
+
+	net_timing_stop();
+	metrics_count_update(code);
+	netstats_record(NETSTATS_PROVIDER, setting("sp_hostname"),
+	    &g_net_timing);
+	netstats_record(NETSTATS_HOST, which_host, &g_net_timing);
+	log_update_record(which_host, code);
+}
 
-	for (const struct responses_tag *ar_p = &responses[0];
-	     ar_p < &responses[nitems(responses)]; ar_p++) {
-		if (strings_match(ar_p->str, r)) {
-			free(r);
-			return ar_p->code;
-		}
+/*
+ * Returns the message of a response after which the program has to
+ * exit, or NULL
+ */
+static const char *
+fatal_response_msg(response_code_t code)
+{
+	switch (code) {
+	case CODE_NOHOST:
+		return "Hostname supplied does not exist under specified "
+		    "account.";
+	case CODE_BADAUTH:
+		return "Invalid username password combination.";
+	case CODE_BADAGENT:
+		return "Bad agent? I don't think so! But the server is "
+		    "always right. Exiting...";
+	case CODE_NOTDONATOR:
+		return "Bad update request. Feature not available.";
+	case CODE_ABUSE:
+		return "Username blocked due to abuse.";
+	default:
+		break;
 	}
 
-	free(r);
-	return CODE_UNKNOWN;
+	return NULL;
 }
 
+/*
+ * Update a host. Runs on a worker of the pool, and reports the
+ * responses that stop the batch in 'batch'.
+ */
 static bool
 update_host(const char *which_host, const char *to_ip,
-	    bool *updateRequestAfter30Min)
+	    struct update_batch *batch)
 {
-	bool	 ok = true;
-	char	*buf = NULL;
+	bool		 ok = true;
+	char		*buf = NULL;
+	response_code_t	 code;
+	struct arena_mark
+			 m = arena_save(&g_arena);
+
+	if (which_host == NULL || to_ip == NULL || batch == NULL) {
+		log_warn(EINVAL, "update_host");
+		return false;
+	}
 
-	if (which_host == NULL || to_ip == NULL ||
-	    updateRequestAfter30Min == NULL)
-		fatal(EINVAL, "update_host");
+	net_timing_start();
 
 	if (net_connect() == -1 ||
 	    send_update_request(which_host, to_ip) == -1 ||
 	    store_server_resp_in_buffer(&buf) == -1) {
+		update_done(which_host, NULL);
 		ok = false;
 		goto err;
 	}
 
-	switch (server_response(buf)) {
+	code = server_response(buf);
+	update_done(which_host, response_code_name(code));
+
+	if (log_debug_enabled()) {
+		struct server_reply reply;
+
+		if (server_replies(buf, &reply, 1) > 0 && reply.addr != NULL)
+			log_debug("the server has %.*s for %s",
+			    (int) reply.addr_len, reply.addr, which_host);
+	}
+
+	switch (code) {
 	case CODE_GOOD:
 		log_msg("dns hostname update successful");
 		break;
@@ -408,29 +592,25 @@ update_host(const char *which_host, const char *to_ip,
 		log_msg("ip address is current");
 		break;
 	case CODE_NOHOST:
-		fatal(0, "Hostname supplied does not exist under specified "
-		    "account.");
-		break;
 	case CODE_BADAUTH:
-		fatal(0, "Invalid username password combination.");
-		break;
 	case CODE_BADAGENT:
-		fatal(0, "Bad agent? I don't think so! But the server is "
-		    "always right. Exiting...");
-		break;
 	case CODE_NOTDONATOR:
-		fatal(0, "Bad update request. Feature not available.");
-		break;
-	case CODE_ABUSE:
-		fatal(0, "Username blocked due to abuse.");
+	case CODE_ABUSE: {
+		int none = CODE_GOOD;
+
+		(void) atomic_compare_exchange_strong(&batch->fatal_code,
+		    &none, (int) code);
+		ok = false;
 		break;
+	}
 	case CODE_EMERG: {
 		if (Cycle)
 			log_warn(0, "fatal error on the server side "
 			    "(will retry update after 30 minutes)");
 		else
 			log_warn(0, "fatal error on the server side");
-		*updateRequestAfter30Min = true;
+		atomic_store(&batch->retry, true);
+		metrics_inc(METRIC_UPDATE_RETRIES);
 		break;
 	}
 	default:
@@ -441,13 +621,325 @@ update_host(const char *which_host, const char *to_ip,
 
   err:
 	net_disconnect();
-	free_not_null(buf);
+	arena_restore(&g_arena, m);
 	return (ok);
 }
 
+/*
+ * Log the number of records that each log level has logged since the
+ * last call, i.e. during the last cycle.
+ */
+static void
+log_cycle_counts(void)
+{
+	static unsigned long int	prev[LOG_LEVEL_COUNT];
+	unsigned long int		cur[LOG_LEVEL_COUNT];
+
+	for (int i = 0; i < LOG_LEVEL_COUNT; i++)
+		cur[i] = log_count(i);
+
+	log_debug("cycle: logged %lu error, %lu warning, %lu info and %lu "
+	    "debug record(s)",
+	    cur[LOG_LEVEL_ERR] - prev[LOG_LEVEL_ERR],
+	    cur[LOG_LEVEL_WARN] - prev[LOG_LEVEL_WARN],
+	    cur[LOG_LEVEL_INFO] - prev[LOG_LEVEL_INFO],
+	    cur[LOG_LEVEL_DEBUG] - prev[LOG_LEVEL_DEBUG]);
+
+	(void) memcpy(prev, cur, sizeof prev);
+}
+
+static void
+set_log_repeat_window(void)
+{
+	struct integer_context ctx = {
+		.setting_name = "log_repeat_window_seconds",
+		.lo_limit     = 0,
+		.hi_limit     = 86400, /* 1 day */
+		.fallback_val = LOG_REPEAT_WINDOW_DEFAULT,
+	};
+
+	log_set_repeat_window(setting_integer(&ctx));
+}
+
+static void
+update_task(size_t i, void *arg)
+{
+	struct update_batch *batch = arg;
+
+	if (atomic_load(&batch->retry) ||
+	    atomic_load(&batch->fatal_code) != CODE_GOOD ||
+	    sig_exit_pending())
+		return;
+
+	log_msg("trying to update %s", batch->hosts[i]);
+
+	if (!update_host(batch->hosts[i], batch->to_ip, batch))
+		log_warn(0, "failed to update hostname");
+}
+
+/*
+ * Update the hosts, or only the hosts in a list like "|host1|host2|".
+ * The hosts are updated by 'update_workers' workers at the same time.
+ * Stops if the server asks to retry later, and exits the program once
+ * the workers are done if a response requires it.
+ */
+static void
+update_hosts(const char *only, bool *updateRequestAfter30Min)
+{
+	int			fatal_code;
+	size_t			count = 0;
+	struct integer_context	ctx = {
+		.setting_name = "update_workers",
+		.lo_limit     = 1,
+		.hi_limit     = POOL_WORKERS_MAX,
+		.fallback_val = 1,
+	};
+	struct update_batch	batch;
+
+	hostname_array_assign();
+	batch.hosts = arena_calloc(&g_arena, hostname_count,
+	    sizeof *batch.hosts);
+	batch.to_ip = setting("ip_addr");
+	atomic_init(&batch.retry, *updateRequestAfter30Min);
+	atomic_init(&batch.fatal_code, CODE_GOOD);
+
+	FOREACH_HOSTNAME() {
+		char *needle;
+
+		if (! (*ar_p))
+			break;
+		if (only) {
+			needle = arena_printf(&g_arena, "|%s|", *ar_p);
+			if (strstr(only, needle) == NULL)
+				continue;
+		}
+		batch.hosts[count++] = *ar_p;
+	}
+
+	pool_run(setting_integer(&ctx), count, update_task, &batch);
+	if ((fatal_code = atomic_load(&batch.fatal_code)) != CODE_GOOD)
+		fatal(0, "%s", fatal_response_msg(fatal_code));
+	*updateRequestAfter30Min = atomic_load(&batch.retry);
+
+	hostname_array_destroy();
+	arena_reset(&g_arena);
+}
+
+/*
+ * Wait until the next cycle is due while the listeners are served. An
+ * update requested by a control client is carried out at once, and
+ * doesn't move the next cycle.
+ */
+static void
+idle(uint64_t duration_ns)
+{
+	uint64_t now;
+
+	USDT_PROBE1(sleep_start, duration_ns);
+	next_cycle_ns = monotonic_ns() + duration_ns;
+
+	while ((now = monotonic_ns()) < next_cycle_ns) {
+		listener_serve(next_cycle_ns - now);
+		sig_exit_if_requested();
+
+		if (update_requested) {
+			char *only = requested_hosts;
+			bool  retry = false;
+
+			update_requested = false;
+			requested_hosts = NULL;
+			log_msg("control: updating %s", (only ? only :
+			    "all hosts"));
+			update_hosts(only, &retry);
+			free_not_null(only);
+			if (retry) {
+				retry_scheduled = true;
+				next_cycle_ns = monotonic_ns() +
+				    UINT64_C(1800) * 1000000000;
+			}
+			log_repeats_flush(false);
+		}
+	}
+	USDT_PROBE0(sleep_done);
+}
+
+/* ----------------------------------------------------------------- */
+
+/*
+ * Returns true if a host is in the setting 'hostname'
+ */
+static bool
+is_configured_host(const char *host)
+{
+	const char *start = setting("hostname");
+
+	while (*start) {
+		const size_t len = strcspn(start, "|");
+
+		if (len == strlen(host) && !strncmp(start, host, len))
+			return true;
+		start += len;
+		if (*start == '|')
+			start++;
+	}
+	return false;
+}
+
+static void
+control_update(int argc, char *argv[], struct listener_reply *reply)
+{
+	char *list;
+
+	for (int i = 0; i < argc; i++) {
+		if (!is_configured_host(argv[i])) {
+			reply_printf(reply, "error: %s: not a configured "
+			    "host\n", argv[i]);
+			return;
+		}
+	}
+
+	if (argc == 0 || (update_requested && requested_hosts == NULL)) {
+		free_not_null(requested_hosts);
+		requested_hosts = NULL;
+	} else {
+		list = (requested_hosts ? requested_hosts : xstrdup("|"));
+		for (int i = 0; i < argc; i++) {
+			char *tmp = strdup_printf("%s%s|", list, argv[i]);
+
+			free(list);
+			list = tmp;
+		}
+		requested_hosts = list;
+	}
+
+	update_requested = true;
+	listener_wakeup();
+	if (requested_hosts)
+		reply_printf(reply, "update scheduled: %s\n", requested_hosts);
+	else
+		reply_printf(reply, "update scheduled: all hosts\n");
+}
+
+static void
+control_state(struct listener_reply *reply)
+{
+	const uint64_t	 now = monotonic_ns();
+	const char	*start = setting("hostname");
+
+	reply_printf(reply, "cycle: %s\n", (Cycle ? "on" : "off"));
+	reply_printf(reply, "debug: %s\n", (g_debug_mode ? "on" : "off"));
+	reply_printf(reply, "ip: %s\n", (g_last_ip_addr[0] ? g_last_ip_addr :
+	    "unknown"));
+	reply_printf(reply, "next check in: %llu seconds%s\n",
+	    (unsigned long long int) (next_cycle_ns > now ? (next_cycle_ns -
+	    now) / 1000000000 : 0), (retry_scheduled ? " (retry after a "
+	    "server error)" : ""));
+	reply_printf(reply, "update pending: %s\n", (!update_requested ?
+	    "no" : (requested_hosts ? requested_hosts : "all hosts")));
+
+	while (*start) {
+		const size_t		 len = strcspn(start, "|");
+		const struct host_state	*hs = NULL;
+
+		for (size_t i = 0; i < host_states_count && len > 0; i++) {
+			if (strlen(host_states[i].name) == len &&
+			    !strncmp(host_states[i].name, start, len)) {
+				hs = &host_states[i];
+				break;
+			}
+		}
+
+		if (len == 0) {
+			/* empty entry */;
+		} else if (hs == NULL) {
+			reply_printf(reply, "host %.*s: not updated yet\n",
+			    (int) len, start);
+		} else {
+			char		when[40] = "";
+			struct tm	tm;
+
+			if (localtime_r(&hs->when, &tm) != NULL)
+				(void) strftime(when, sizeof when,
+				    "%Y-%m-%d %H:%M:%S", &tm);
+			reply_printf(reply, "host %s: %s at %s, %lu attempt(s), "
+			    "%lu failure(s)\n", hs->name, hs->code, when,
+			    hs->attempts, hs->failures);
+		}
+
+		start += len;
+		if (*start == '|')
+			start++;
+	}
+}
+
+static void
+control_reload(struct listener_reply *reply)
+{
+	size_t errors;
+
+	if (access(conf_path, R_OK) != 0) {
+		const int errno_save = errno;
+
+		log_warn(errno_save, "control: reload: %s", conf_path);
+		reply_printf(reply, "error: %s: %s: the config file must be "
+		    "readable by UID %ld\n", conf_path, strerror(errno_save),
+		    (long int) geteuid());
+		return;
+	}
+
+	/* The number of workers may change */
+	pool_stop();
+	net_deinit();
+	/* Report every error of the config file */
+	log_set_repeat_window(0);
+	errors = reload_config_file(conf_path);
+	set_log_repeat_window();
+	net_init();
+
+	if (errors > 0) {
+		log_warn(0, "control: %s: %zu error(s): the settings in use "
+		    "are kept", conf_path, errors);
+		reply_printf(reply, "error: %s: %zu error(s): the settings in "
+		    "use are kept\n", conf_path, errors);
+		return;
+	}
+
+	log_msg("control: reloaded %s", conf_path);
+	reply_printf(reply, "reloaded %s\n", conf_path);
+}
+
+static const struct control_hooks control_hooks = {
+	.update = control_update,
+	.state  = control_state,
+	.reload = control_reload,
+};
+
+#if defined(OpenBSD) && OpenBSD >= 201811
+/*
+ * Get a copy of the directory part of an absolute path
+ */
+static char *
+path_dir(const char *path)
+{
+	char *dir = xstrdup(path);
+	char *cp = strrchr(dir, '/');
+
+	if (cp == dir)
+		cp[1] = '\0';
+	else if (cp)
+		*cp = '\0';
+	return dir;
+}
+#endif
+
 static void
-start_update_cycle(void)
+start_update_cycle(const struct program_options *po)
 {
+#if defined(OpenBSD) && OpenBSD >= 201605
+	const bool unix_socket = ((po->metrics_addr != NULL &&
+	    po->metrics_addr[0] == '/') || po->control_socket != NULL);
+#endif
+
 	hostname_array_init();
 
 #if defined(OpenBSD) && OpenBSD >= 201811
@@ -460,11 +952,32 @@ start_update_cycle(void)
 		const char	*permissions;
 	} whitelist[] = {
 		{ "/etc/ssl/cert.pem", "r" },
+		{ NULL,                "rwc" }, /* log file rotation */
+		{ NULL,                "rwc" }, /* metrics socket removal */
+		{ NULL,                "rwc" }, /* control socket removal */
+		{ NULL,                "r"   }, /* config file reload */
+		{ NULL,                "r"   }, /* tls_ca_file */
+		{ NULL,                "r"   }, /* tls_ca_dir */
 	};
 
+	if (po->log_file)
+		whitelist[1].path = path_dir(po->log_file);
+	if (po->metrics_addr && po->metrics_addr[0] == '/')
+		whitelist[2].path = path_dir(po->metrics_addr);
+	if (po->control_socket) {
+		whitelist[3].path = path_dir(po->control_socket);
+		whitelist[4].path = conf_path;
+	}
+	if (!strings_match(setting("tls_ca_file"), ""))
+		whitelist[5].path = setting("tls_ca_file");
+	if (!strings_match(setting("tls_ca_dir"), ""))
+		whitelist[6].path = setting("tls_ca_dir");
+
 	for (struct whitelist_tag *wl_p = &whitelist[0];
 	    wl_p < &whitelist[nitems(whitelist)];
 	    wl_p++) {
+		if (wl_p->path == NULL)
+			continue;
 		errno = 0;
 
 		if (unveil(wl_p->path, wl_p->permissions) == -1 &&
@@ -477,33 +990,35 @@ start_update_cycle(void)
 #endif
 
 #if defined(OpenBSD) && OpenBSD >= 201605
-	if (pledge("dns inet rpath stdio", NULL) == -1)
+	char promises[100] = "dns inet rpath stdio";
+
+	if (po->log_file || unix_socket)
+		(void) strlcat(promises, " wpath cpath", sizeof promises);
+	if (unix_socket)
+		(void) strlcat(promises, " unix", sizeof promises);
+	if (pledge(promises, NULL) == -1)
 		fatal(errno, "pledge");
 	log_msg("forced into a restricted service operating mode (good)");
 #endif
 
+	sig_defer_exit();
+
 	do {
 		bool updateRequestAfter30Min = false;
 
-		if (!Cycle || net_check_for_ip_change() == IP_HAS_CHANGED) {
-			hostname_array_assign();
-
-			FOREACH_HOSTNAME() {
-				if (! (*ar_p))
-					break;
-				if (updateRequestAfter30Min)
-					break;
-
-				log_msg("trying to update %s", *ar_p);
-
-				if (!update_host(*ar_p, setting("ip_addr"),
-						 &updateRequestAfter30Min)) {
-					log_warn(0, "failed to update "
-					    "hostname");
-				}
-			}
-
-			hostname_array_destroy();
+		metrics_inc(METRIC_CYCLES);
+
+		if (!Cycle || net_check_for_ip_change() == IP_HAS_CHANGED)
+			update_hosts(NULL, &updateRequestAfter30Min);
+		sig_exit_if_requested();
+		retry_scheduled = updateRequestAfter30Min;
+		log_repeats_flush(false);
+		if (log_debug_enabled()) {
+			log_cycle_counts();
+			log_debug("cycle: arena: peak %zu bytes, %zu chunk(s) "
+			    "of %zu bytes", g_arena.peak, g_arena.chunks,
+			    g_arena.size);
+			netstats_dump();
 		}
 		if (Cycle) {
 			struct integer_context ctx = {
@@ -521,7 +1036,7 @@ start_update_cycle(void)
 
 			log_debug("sleeping for %ld seconds",
 			    ((long int) ts.tv_sec));
-			(void) nanosleep(&ts, NULL);
+			idle((uint64_t) ts.tv_sec * 1000000000);
 		}
 	} while (Cycle);
 }
@@ -536,6 +1051,12 @@ main(int argc, char *argv[])
 		.want_debug              = false,
 		.want_update_once        = false,
 		.want_daemon             = false,
+		.want_config_cache       = false,
+		.want_config_test        = false,
+		.want_json_log           = false,
+		.log_file                = NULL,
+		.metrics_addr            = NULL,
+		.control_socket          = NULL,
 	};
 
 	if (sighand_init() == -1)
@@ -547,6 +1068,9 @@ main(int argc, char *argv[])
 
 	(void) setlocale(LC_ALL, "");
 	process_options(argc, argv, &opt, &conf[0], nitems(conf));
+	g_log_json = opt.want_json_log;
+	if (opt.log_file && logfile_open(opt.log_file) == -1)
+		fatal(errno, "-l: cannot open %s", opt.log_file);
 
 	if (opt.want_usage) {
 		usage();
@@ -565,6 +1089,10 @@ main(int argc, char *argv[])
 		free(path);
 		exit(0);
 	}
+	if (opt.want_config_test) {
+		test_config(conf);
+		/* NOTREACHED */
+	}
 	if (opt.want_debug)
 		turn_on_debug_mode();
 	if (opt.want_update_once)
@@ -580,8 +1108,28 @@ main(int argc, char *argv[])
 
 	log_msg("%s %s has started", g_programName, g_programVersion);
 	log_msg("reading %s...", conf);
-	read_config_file(conf);
-	check_some_settings_strictly();
+	if (opt.want_config_cache) {
+		read_config_cache(conf);
+	} else {
+		read_config_file(conf);
+		check_some_settings_strictly();
+	}
+
+	set_log_repeat_window();
+	if (opt.metrics_addr && listener_open(opt.metrics_addr,
+	    &g_metrics_ops) == -1)
+		fatal(errno, "-m: cannot listen on %s", opt.metrics_addr);
+	if (opt.control_socket) {
+		if (opt.control_socket[0] != '/' ||
+		    listener_open(opt.control_socket, &g_control_ops) == -1 ||
+		    chmod(opt.control_socket, S_IRUSR | S_IWUSR) == -1) {
+			fatal((opt.control_socket[0] != '/' ? EINVAL : errno),
+			    "-s: cannot listen on %s", opt.control_socket);
+		}
+		if (realpath(conf, conf_path) == NULL)
+			fatal(errno, "-x: cannot resolve %s", conf);
+		control_set_hooks(&control_hooks);
+	}
 
 	/* Drop root privileges. */
 	if (geteuid() == UID_SUPER_USER) {
@@ -589,8 +1137,10 @@ main(int argc, char *argv[])
 		log_msg("EUID = %ld", (long int) geteuid());
 	}
 
+	log_async_start();
+
 	net_init();
-	start_update_cycle();
+	start_update_cycle(&opt);
 
 	return 0;
 }
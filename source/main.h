@@ -6,7 +6,6 @@
 #include "ducdef.h"
 
 #define DUC_PATH_MAX			500	/* Max bytes in a pathname. */
-#define DUC_PERMITTED_HOSTS_LIMIT	10	/* Qty of hostnames allowed. */
 #define UID_SUPER_USER			0
 
 struct program_options {
@@ -15,20 +14,14 @@ struct program_options {
 	bool want_debug;
 	bool want_update_once;
 	bool want_daemon;
+	bool want_config_cache;
+	bool want_config_test;
+	bool want_json_log;
+	const char *log_file;
+	const char *metrics_addr;
+	const char *control_socket;
 };
 
-typedef enum {
-	CODE_GOOD,
-	CODE_NOCHG,
-	CODE_NOHOST,
-	CODE_BADAUTH,
-	CODE_BADAGENT,
-	CODE_NOTDONATOR,
-	CODE_ABUSE,
-	CODE_EMERG,
-	CODE_UNKNOWN
-} response_code_t;
-
 __DUC_BEGIN_DECLS
 extern const char g_programName[];
 extern const char g_programVersion[];
@@ -0,0 +1,474 @@
+/* Copyright (c) 2026 Markus Uhlin <markus.uhlin@icloud.com>
+   All rights reserved.
+
+   Permission to use, copy, modify, and distribute this software for any
+   purpose with or without fee is hereby granted, provided that the above
+   copyright notice and this permission notice appear in all copies.
+
+   THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+   WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+   AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+   DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR
+   PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+   TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+   PERFORMANCE OF THIS SOFTWARE. */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "histogram.h"
+#include "log.h"
+#include "metrics.h"
+#include "netstats.h"
+#include "various.h"
+
+#define PREFIX "educ_"
+
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+#include <malloc.h>
+#define HAVE_MALLINFO2 1
+#else
+#define HAVE_MALLINFO2 0
+#endif
+
+/*
+ * The counters are incremented by the update workers and rendered by
+ * the listeners, which are served between the updates
+ */
+static atomic_ullong counters[METRIC_COUNT];
+
+/*
+ * The responses of the service provider. "error" is an attempt that
+ * failed before a response was received.
+ */
+static struct {
+	const char	*code;
+	atomic_ullong	 count;
+} updates[] = {
+	{ "good",     0 },
+	{ "nochg",    0 },
+	{ "nohost",   0 },
+	{ "badauth",  0 },
+	{ "badagent", 0 },
+	{ "!donator", 0 },
+	{ "abuse",    0 },
+	{ "911",      0 },
+	{ "unknown",  0 },
+	{ "error",    0 },
+};
+
+/*
+ * The IP lookups per server. The servers that don't fit share the last
+ * entry, named "(other)". Entries are added under the mutex.
+ */
+static struct {
+	char		server[NETSTATS_NAME_MAX];
+	atomic_ullong	ok;
+	atomic_ullong	failed;
+} lookups[METRICS_LOOKUP_SERVERS];
+static size_t		n_lookup_servers = 0;
+static pthread_mutex_t	lookups_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+static const struct {
+	metric_t	 metric;
+	const char	*name;
+	const char	*help;
+} counter_info[] = {
+	{ METRIC_CYCLES, "cycles_total",
+	  "Update cycles, i.e. checks for an IP change" },
+	{ METRIC_IP_CHANGES, "ip_changes_total",
+	  "Changes of the external IP address" },
+	{ METRIC_UPDATE_RETRIES, "update_retries_total",
+	  "Updates that are retried later on request of the server" },
+};
+
+static const char *log_level_names[LOG_LEVEL_COUNT] = {
+	"error", "warning", "info", "debug",
+};
+
+/*
+ * Write a label value. Backslashes, double quotes and newlines are
+ * escaped.
+ */
+static void
+put_label(struct listener_reply *reply, const char *value)
+{
+	const char *run = value;
+
+	for (const char *cp = value; *cp; cp++) {
+		if (*cp != '\\' && *cp != '"' && *cp != '\n')
+			continue;
+		reply_write(reply, run, cp - run);
+		reply_write(reply, (*cp == '\n' ? "\\n" : (*cp == '"' ?
+		    "\\\"" : "\\\\")), 2);
+		run = cp + 1;
+	}
+	reply_write(reply, run, strlen(run));
+}
+
+static void
+put_header(struct listener_reply *reply, const char *name, const char *type,
+	   const char *help)
+{
+	reply_printf(reply, "# HELP " PREFIX "%s %s\n", name, help);
+	reply_printf(reply, "# TYPE " PREFIX "%s %s\n", name, type);
+}
+
+/*
+ * Write the sample of a histogram, 'suffix' is "_bucket", "_sum" or
+ * "_count". The labels identify the series and the phase.
+ */
+static void
+put_series_labels(struct listener_reply *reply, const char *suffix,
+		  const struct netstats_series *s, const char *phase)
+{
+	reply_printf(reply, PREFIX "request_phase_seconds%s{kind=\"%s\","
+	    "target=\"", suffix, netstats_kind_name(s->kind));
+	put_label(reply, s->name);
+	reply_printf(reply, "\",phase=\"%s\"", phase);
+}
+
+/*
+ * A histogram in microseconds is exported in seconds. Only the buckets
+ * that have samples are written, plus the mandatory +Inf bucket.
+ */
+static void
+put_histogram(struct listener_reply *reply, const struct netstats_series *s,
+	      const char *phase, const struct histogram *h)
+{
+	uint64_t cumulative = 0;
+
+	if (h->count == 0)
+		return;
+	for (size_t i = 0; i < HIST_BUCKETS - 1; i++) {
+		if (h->buckets[i] == 0)
+			continue;
+		cumulative += h->buckets[i];
+		put_series_labels(reply, "_bucket", s, phase);
+		reply_printf(reply, ",le=\"%.6f\"} %llu\n",
+		    hist_bucket_upper(i) / 1e6,
+		    (unsigned long long int) cumulative);
+	}
+	put_series_labels(reply, "_bucket", s, phase);
+	reply_printf(reply, ",le=\"+Inf\"} %llu\n",
+	    (unsigned long long int) h->count);
+	put_series_labels(reply, "_sum", s, phase);
+	reply_printf(reply, "} %.6f\n", h->sum / 1e6);
+	put_series_labels(reply, "_count", s, phase);
+	reply_printf(reply, "} %llu\n", (unsigned long long int) h->count);
+}
+
+/*
+ * An HTTP request is complete at the empty line that ends its header.
+ * Anything else is a complete request when the client shuts down its
+ * side of the connection.
+ */
+static bool
+metrics_complete(const char *req, size_t len)
+{
+	(void) len;
+	return (strstr(req, "\r\n\r\n") != NULL || strstr(req, "\n\n") !=
+	    NULL);
+}
+
+/*
+ * Reply to "GET /" and "GET /metrics" with the metrics, and to other
+ * paths with 404. A request that isn't HTTP gets the plain metrics,
+ * e.g. for "nc -U".
+ */
+static void
+metrics_respond(const char *req, size_t len, struct listener_reply *reply)
+{
+	struct listener_reply	body = { 0 };
+	const char		*path;
+	size_t			 path_len;
+
+	(void) len;
+	metrics_render(&body);
+
+	if (strncmp(req, "GET ", 4) != 0) {
+		reply_write(reply, body.data, body.len);
+		free(body.data);
+		return;
+	}
+
+	path = &req[4];
+	path_len = strcspn(path, " \r\n");
+	if ((path_len == 1 && path[0] == '/') ||
+	    (path_len == 8 && !strncmp(path, "/metrics", 8))) {
+		reply_printf(reply, "HTTP/1.0 200 OK\r\n"
+		    "Content-Type: text/plain; version=0.0.4\r\n"
+		    "Content-Length: %zu\r\n\r\n", body.len);
+		reply_write(reply, body.data, body.len);
+	} else {
+		reply_printf(reply, "HTTP/1.0 404 Not Found\r\n"
+		    "Content-Type: text/plain\r\n"
+		    "Content-Length: 10\r\n\r\nnot found\n");
+	}
+	free(body.data);
+}
+
+const struct listener_ops g_metrics_ops = {
+	.name     = "metrics",
+	.complete = metrics_complete,
+	.respond  = metrics_respond,
+};
+
+/**
+ * Get the value of a counter
+ */
+unsigned long long int
+metrics_get(metric_t metric)
+{
+	if (metric < 0 || metric >= METRIC_COUNT)
+		return 0;
+	return counters[metric];
+}
+
+/*
+ * Find the entry of a lookup server, or add it if 'add' is true.
+ * Returns SIZE_MAX if it isn't found.
+ */
+static size_t
+find_lookup_server(const char *server, bool add)
+{
+	size_t i;
+
+	for (i = 0; i < n_lookup_servers; i++) {
+		if (strings_match(lookups[i].server, server))
+			return i;
+	}
+	if (!add)
+		return SIZE_MAX;
+	if (n_lookup_servers >= nitems(lookups) - 1 &&
+	    !strings_match(server, "(other)"))
+		return find_lookup_server("(other)", true);
+
+	(void) strlcpy(lookups[i].server, server, sizeof lookups[i].server);
+	n_lookup_servers++;
+	return i;
+}
+
+/**
+ * Get the number of IP lookups made at a server
+ *
+ * @param server The lookup server
+ * @param ok     Count the successful lookups, or the failed ones
+ * @return The count
+ */
+unsigned long long int
+metrics_lookups(const char *server, bool ok)
+{
+	size_t i;
+
+	(void) pthread_mutex_lock(&lookups_mtx);
+	i = find_lookup_server(server, false);
+	(void) pthread_mutex_unlock(&lookups_mtx);
+
+	if (i == SIZE_MAX)
+		return 0;
+	return (ok ? lookups[i].ok : lookups[i].failed);
+}
+
+/**
+ * Count an IP lookup
+ *
+ * @param server The lookup server
+ * @param ok     Whether an IP address was received
+ * @return Void
+ */
+void
+metrics_count_lookup(const char *server, bool ok)
+{
+	size_t i;
+
+	if (server == NULL)
+		return;
+	(void) pthread_mutex_lock(&lookups_mtx);
+	i = find_lookup_server(server, true);
+	(void) pthread_mutex_unlock(&lookups_mtx);
+
+	(void) atomic_fetch_add_explicit((ok ? &lookups[i].ok :
+	    &lookups[i].failed), 1, memory_order_relaxed);
+}
+
+/**
+ * Get the number of updates that got a response code
+ *
+ * @param code A response code, such as "good", or "error"
+ * @return The count
+ */
+unsigned long long int
+metrics_updates(const char *code)
+{
+	for (size_t i = 0; i < nitems(updates); i++) {
+		if (strings_match(updates[i].code, code))
+			return updates[i].count;
+	}
+	return 0;
+}
+
+/**
+ * Count an update attempt
+ *
+ * @param code The response code, or NULL if the attempt failed before
+ *             a response was received
+ * @return Void
+ */
+void
+metrics_count_update(const char *code)
+{
+	size_t i;
+
+	if (code == NULL)
+		code = "error";
+	for (i = 0; i < nitems(updates); i++) {
+		if (strings_match(updates[i].code, code))
+			break;
+	}
+	if (i == nitems(updates))
+		i = nitems(updates) - 2; /* unknown */
+	(void) atomic_fetch_add_explicit(&updates[i].count, 1,
+	    memory_order_relaxed);
+}
+
+/**
+ * Increment a counter
+ */
+void
+metrics_inc(metric_t metric)
+{
+	if (metric >= 0 && metric < METRIC_COUNT)
+		(void) atomic_fetch_add_explicit(&counters[metric], 1,
+		    memory_order_relaxed);
+}
+
+/**
+ * Render all metrics in the Prometheus text exposition format
+ */
+void
+metrics_render(struct listener_reply *reply)
+{
+	put_header(reply, "updates_total", "counter",
+	    "Update attempts by the response code of the server");
+	for (size_t i = 0; i < nitems(updates); i++) {
+		reply_printf(reply, PREFIX "updates_total{code=\"%s\"} %llu\n",
+		    updates[i].code, updates[i].count);
+	}
+
+	for (size_t i = 0; i < nitems(counter_info); i++) {
+		put_header(reply, counter_info[i].name, "counter",
+		    counter_info[i].help);
+		reply_printf(reply, PREFIX "%s %llu\n", counter_info[i].name,
+		    counters[counter_info[i].metric]);
+	}
+
+	put_header(reply, "tls_handshakes_total", "counter",
+	    "TLS handshakes by result");
+	reply_printf(reply, PREFIX "tls_handshakes_total{result=\"ok\"} "
+	    "%llu\n", counters[METRIC_TLS_HANDSHAKES]);
+	reply_printf(reply, PREFIX "tls_handshakes_total{result=\"failed\"} "
+	    "%llu\n", counters[METRIC_TLS_HANDSHAKE_FAILURES]);
+
+	put_header(reply, "ip_lookups_total", "counter",
+	    "IP lookups by server and result");
+	(void) pthread_mutex_lock(&lookups_mtx);
+	for (size_t i = 0; i < n_lookup_servers; i++) {
+		reply_printf(reply, PREFIX "ip_lookups_total{server=\"");
+		put_label(reply, lookups[i].server);
+		reply_printf(reply, "\",result=\"ok\"} %llu\n", lookups[i].ok);
+		reply_printf(reply, PREFIX "ip_lookups_total{server=\"");
+		put_label(reply, lookups[i].server);
+		reply_printf(reply, "\",result=\"failed\"} %llu\n",
+		    lookups[i].failed);
+	}
+	(void) pthread_mutex_unlock(&lookups_mtx);
+
+	put_header(reply, "log_records_total", "counter",
+	    "Log records by level");
+	for (int i = 0; i < LOG_LEVEL_COUNT; i++) {
+		reply_printf(reply, PREFIX "log_records_total{level=\"%s\"} "
+		    "%lu\n", log_level_names[i], log_count(i));
+	}
+	put_header(reply, "log_dropped_total", "counter",
+	    "Log records dropped because the log queue was full");
+	reply_printf(reply, PREFIX "log_dropped_total %lu\n", log_dropped());
+	put_header(reply, "log_suppressed_total", "counter",
+	    "Repeated warnings that were suppressed");
+	reply_printf(reply, PREFIX "log_suppressed_total %lu\n",
+	    log_suppressed());
+
+	if (netstats_count() == 0)
+		return;
+	put_header(reply, "request_phase_seconds", "histogram",
+	    "Time spent in each phase of the requests to a target");
+	for (size_t i = 0; i < netstats_count(); i++) {
+		const struct netstats_series *s = netstats_get(i);
+
+		for (int p = 0; p < NET_PHASE_COUNT; p++)
+			put_histogram(reply, s, net_phase_name(p), &s->phase[p]);
+		put_histogram(reply, s, "total", &s->total);
+	}
+}
+
+/**
+ * Render a summary of the metrics for humans: the counters, the
+ * percentiles of the total time of the requests to every target, and
+ * the memory of the arena and of the heap
+ */
+void
+metrics_render_summary(struct listener_reply *reply)
+{
+	reply_printf(reply, "updates:");
+	for (size_t i = 0; i < nitems(updates); i++) {
+		if (updates[i].count > 0) {
+			reply_printf(reply, " %s=%llu", updates[i].code,
+			    updates[i].count);
+		}
+	}
+	reply_printf(reply, "\n");
+
+	for (size_t i = 0; i < nitems(counter_info); i++) {
+		reply_printf(reply, "%s: %llu\n", counter_info[i].name,
+		    counters[counter_info[i].metric]);
+	}
+	reply_printf(reply, "tls_handshakes: ok=%llu failed=%llu\n",
+	    counters[METRIC_TLS_HANDSHAKES],
+	    counters[METRIC_TLS_HANDSHAKE_FAILURES]);
+	(void) pthread_mutex_lock(&lookups_mtx);
+	for (size_t i = 0; i < n_lookup_servers; i++) {
+		reply_printf(reply, "ip_lookups %s: ok=%llu failed=%llu\n",
+		    lookups[i].server, lookups[i].ok, lookups[i].failed);
+	}
+	(void) pthread_mutex_unlock(&lookups_mtx);
+
+	for (size_t i = 0; i < netstats_count(); i++) {
+		const struct netstats_series	*s = netstats_get(i);
+		const struct histogram		*h = &s->total;
+
+		reply_printf(reply, "%s %s: n=%llu p50=%lluus p90=%lluus "
+		    "p99=%lluus max=%lluus\n", netstats_kind_name(s->kind),
+		    s->name,
+		    (unsigned long long int) h->count,
+		    (unsigned long long int) hist_quantile(h, 0.5),
+		    (unsigned long long int) hist_quantile(h, 0.9),
+		    (unsigned long long int) hist_quantile(h, 0.99),
+		    (unsigned long long int) h->max);
+	}
+
+	reply_printf(reply, "arena: used=%zu peak=%zu size=%zu chunks=%zu\n",
+	    g_arena.used, g_arena.peak, g_arena.size, g_arena.chunks);
+#if HAVE_MALLINFO2
+	/* Free bytes in the heap are fragmentation: they stay mapped */
+	const struct mallinfo2 mi = mallinfo2();
+
+	reply_printf(reply, "heap: size=%zu in_use=%zu free=%zu "
+	    "free_chunks=%zu mmapped=%zu\n", mi.arena, mi.uordblks,
+	    mi.fordblks, mi.ordblks, mi.hblkhd);
+#endif
+}
@@ -0,0 +1,34 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdbool.h>
+
+#include "ducdef.h"
+#include "listener.h"
+
+#define METRICS_LOOKUP_SERVERS	8
+
+typedef enum {
+	METRIC_CYCLES,
+	METRIC_IP_CHANGES,
+	METRIC_UPDATE_RETRIES,
+	METRIC_TLS_HANDSHAKES,
+	METRIC_TLS_HANDSHAKE_FAILURES,
+	METRIC_COUNT
+} metric_t;
+
+__DUC_BEGIN_DECLS
+extern const struct listener_ops g_metrics_ops;
+
+unsigned long long int metrics_get(metric_t);
+unsigned long long int metrics_lookups(const char *, bool);
+unsigned long long int metrics_updates(const char *);
+
+void	metrics_count_lookup(const char *, bool);
+void	metrics_count_update(const char *);
+void	metrics_inc(metric_t);
+void	metrics_render(struct listener_reply *);
+void	metrics_render_summary(struct listener_reply *);
+__DUC_END_DECLS
+
+#endif
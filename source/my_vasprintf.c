@@ -19,34 +19,44 @@
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include "format.h"
+#include "various.h"
+
+/*
+ * Format into a buffer on the stack in one pass. Only a string that
+ * doesn't fit is formatted on the heap, where the buffer then grows.
+ */
 int
 my_vasprintf(char **ret, const char *format, va_list ap)
 {
-	va_list ap_copy;
-	int sz;
+	char		buf[256];
+	int		sz;
+	struct fmt_buf	f;
 
 	if (ret == NULL || format == NULL) {
 		errno = EINVAL;
 		return -1;
 	}
 
-	va_copy(ap_copy, ap);
-	sz = vsnprintf(NULL, 0, format, ap_copy);
-	va_end(ap_copy);
-
-	if (sz < 0) {
+	fmt_init(&f, buf, sizeof buf, FMT_HEAP, NULL);
+	if ((sz = fmt_vprintf(&f, format, ap)) < 0) {
+		if (f.allocated)
+			free(f.data);
 		*ret = NULL;
 		errno = ENOSYS;
 		return -1;
-	} else {
-		sz += 1; /* +1 for `\0'. */
 	}
 
-	if ((*ret = malloc(sz)) == NULL) {
+	if (f.allocated) {
+		*ret = f.data;
+	} else if ((*ret = malloc(f.len + 1)) == NULL) {
 		errno = ENOMEM;
 		return -1;
+	} else {
+		(void) memcpy(*ret, buf, f.len + 1);
 	}
 
-	return vsnprintf(*ret, sz, format, ap);
+	return sz;
 }
@@ -0,0 +1,191 @@
+/* Copyright (c) 2026 Markus Uhlin <markus.uhlin@icloud.com>
+   All rights reserved.
+
+   Permission to use, copy, modify, and distribute this software for any
+   purpose with or without fee is hereby granted, provided that the above
+   copyright notice and this permission notice appear in all copies.
+
+   THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+   WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+   AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+   DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR
+   PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+   TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+   PERFORMANCE OF THIS SOFTWARE. */
+
+#include <pthread.h>
+#include <string.h>
+
+#include "json.h"
+#include "log.h"
+#include "netstats.h"
+#include "various.h"
+
+static const char other_name[] = "(other)";
+
+/*
+ * Recorded by the update workers, so a record is made under the
+ * mutex, and read between the updates
+ */
+static struct netstats_series	series[NETSTATS_SERIES];
+static size_t			n_series = 0;
+static pthread_mutex_t		series_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Find the series of a target, or add it. A series per kind is kept in
+ * reserve for the targets that don't fit.
+ */
+static struct netstats_series *
+find_series(netstats_kind_t kind, const char *name)
+{
+	struct netstats_series *s;
+
+	for (size_t i = 0; i < n_series; i++) {
+		if (series[i].kind == kind && strings_match(series[i].name,
+		    name))
+			return &series[i];
+	}
+
+	if (n_series >= NETSTATS_SERIES - NETSTATS_KIND_COUNT &&
+	    !strings_match(name, other_name))
+		return find_series(kind, other_name);
+
+	s = &series[n_series++];
+	s->kind = kind;
+	(void) strlcpy(s->name, name, sizeof s->name);
+	return s;
+}
+
+static void
+dump_histogram(const struct netstats_series *s, const char *phase,
+	       const struct histogram *h)
+{
+	static char		record[600];
+	struct json_writer	w;
+
+	if (h->count == 0)
+		return;
+	if (!g_log_json) {
+		log_msg("netstats: %s %s %s: n=%llu p50=%lluus p90=%lluus "
+		    "p99=%lluus max=%lluus", netstats_kind_name(s->kind),
+		    s->name, phase,
+		    (unsigned long long int) h->count,
+		    (unsigned long long int) hist_quantile(h, 0.5),
+		    (unsigned long long int) hist_quantile(h, 0.9),
+		    (unsigned long long int) hist_quantile(h, 0.99),
+		    (unsigned long long int) h->max);
+		return;
+	}
+
+	json_init(&w, record, sizeof record);
+	json_add_string(&w, "event", "netstats");
+	json_add_string(&w, "kind", netstats_kind_name(s->kind));
+	json_add_string(&w, "target", s->name);
+	json_add_string(&w, "phase", phase);
+	json_add_uint(&w, "count", h->count);
+	json_add_uint(&w, "sum_us", h->sum);
+	json_add_uint(&w, "p50_us", hist_quantile(h, 0.5));
+	json_add_uint(&w, "p90_us", hist_quantile(h, 0.9));
+	json_add_uint(&w, "p99_us", hist_quantile(h, 0.99));
+	json_add_uint(&w, "max_us", h->max);
+	(void) json_finish(&w);
+	log_event(record);
+}
+
+/**
+ * Get the name of a kind of target
+ */
+const char *
+netstats_kind_name(netstats_kind_t kind)
+{
+	switch (kind) {
+	case NETSTATS_PROVIDER:
+		return "provider";
+	case NETSTATS_LOOKUP:
+		return "lookup";
+	case NETSTATS_HOST:
+		return "host";
+	case NETSTATS_KIND_COUNT:
+		break;
+	}
+	return "unknown";
+}
+
+/**
+ * Get a series
+ *
+ * @param i Index, less than netstats_count()
+ * @return The series, or NULL if the index is out of range
+ */
+const struct netstats_series *
+netstats_get(size_t i)
+{
+	return (i < n_series ? &series[i] : NULL);
+}
+
+/**
+ * @return The number of series
+ */
+size_t
+netstats_count(void)
+{
+	return n_series;
+}
+
+/**
+ * Log the percentiles of every phase of every series. In JSON mode
+ * they're logged as "netstats" events.
+ */
+void
+netstats_dump(void)
+{
+	for (size_t i = 0; i < n_series; i++) {
+		const struct netstats_series *s = &series[i];
+
+		for (int p = 0; p < NET_PHASE_COUNT; p++)
+			dump_histogram(s, net_phase_name(p), &s->phase[p]);
+		dump_histogram(s, "total", &s->total);
+	}
+}
+
+/**
+ * Record the timing of a request to a target. Nothing is allocated.
+ *
+ * @param kind	Kind of target
+ * @param name	Target name, i.e. a hostname
+ * @param t	Timing of the request. Only the phases that were reached
+ *		are recorded.
+ * @return Void
+ */
+void
+netstats_record(netstats_kind_t kind, const char *name,
+		const struct net_timing *t)
+{
+	struct netstats_series *s;
+
+	if (kind < 0 || kind >= NETSTATS_KIND_COUNT || name == NULL ||
+	    t == NULL)
+		return;
+
+	(void) pthread_mutex_lock(&series_mtx);
+	s = find_series(kind, name);
+	for (int p = 0; p < NET_PHASE_COUNT; p++) {
+		if (t->reached & (1U << p))
+			hist_record(&s->phase[p], t->phase_us[p]);
+	}
+	hist_record(&s->total, t->total_us);
+	(void) pthread_mutex_unlock(&series_mtx);
+}
+
+/**
+ * Forget all series
+ */
+void
+netstats_reset(void)
+{
+	(void) pthread_mutex_lock(&series_mtx);
+	(void) memset(series, 0, sizeof series);
+	n_series = 0;
+	(void) pthread_mutex_unlock(&series_mtx);
+}
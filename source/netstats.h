@@ -0,0 +1,43 @@
+#ifndef NETSTATS_H
+#define NETSTATS_H
+
+#include <stddef.h>
+
+#include "ducdef.h"
+#include "histogram.h"
+#include "network.h"
+
+#define NETSTATS_SERIES		32
+#define NETSTATS_NAME_MAX	256
+
+typedef enum {
+	NETSTATS_PROVIDER,
+	NETSTATS_LOOKUP,
+	NETSTATS_HOST,
+	NETSTATS_KIND_COUNT
+} netstats_kind_t;
+
+/*
+ * The latency histograms, in microseconds, of the requests to a
+ * target: the service provider, a lookup server or a host that is
+ * updated. If there are more targets than series, the targets that
+ * don't fit share a series per kind named "(other)".
+ */
+struct netstats_series {
+	netstats_kind_t		kind;
+	char			name[NETSTATS_NAME_MAX];
+	struct histogram	phase[NET_PHASE_COUNT];
+	struct histogram	total;
+};
+
+__DUC_BEGIN_DECLS
+const char *netstats_kind_name(netstats_kind_t);
+const struct netstats_series *netstats_get(size_t);
+size_t	netstats_count(void);
+void	netstats_dump(void);
+void	netstats_record(netstats_kind_t, const char *,
+	    const struct net_timing *);
+void	netstats_reset(void);
+__DUC_END_DECLS
+
+#endif
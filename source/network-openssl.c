@@ -17,6 +17,7 @@
 #include <sys/select.h>
 
 #include <openssl/err.h>
+#include <openssl/evp.h>
 #include <openssl/opensslv.h>
 #include <openssl/rand.h>
 #include <openssl/ssl.h>
@@ -25,18 +26,55 @@
 #include <openssl/x509v3.h>
 
 #include <limits.h>
+#include <pthread.h>
 #include <string.h>
+#include <time.h>
 
+#include "arena.h"
+#include "base64.h"
+#include "format.h"
 #include "log.h"
+#include "metrics.h"
 #include "network.h"
+#include "probes.h"
+#include "settings.h"
 #include "various.h"
 #include "wrapper.h"
 
-static SSL_CTX	*ssl_ctx = NULL;
-static SSL	*ssl = NULL;
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+#define X509_STORE_CTX_get0_cert(ctx)	((ctx)->cert)
+#define X509_STORE_CTX_get0_chain(ctx)	X509_STORE_CTX_get_chain(ctx)
+#endif
+
+#define CHAIN_CACHE_SIZE	8
+#define CHAIN_CACHE_TTL		86400	/* Seconds */
+
+/*
+ * A certificate chain that has been verified, keyed by the SHA-256
+ * fingerprint of its leaf. It expires when a certificate of the chain
+ * does, or after CHAIN_CACHE_TTL seconds.
+ */
+struct chain_cache_entry {
+	unsigned char	fingerprint[EVP_MAX_MD_SIZE];
+	time_t		expires;
+};
+
+/*
+ * The SSL_CTX and the chain cache are shared by the update workers,
+ * and every worker has an SSL object of its own
+ */
+static SSL_CTX			*ssl_ctx = NULL;
+static pthread_mutex_t		 ssl_ctx_mtx = PTHREAD_MUTEX_INITIALIZER;
+static _Thread_local SSL	*ssl = NULL;
+
+static struct chain_cache_entry	chain_cache[CHAIN_CACHE_SIZE];
+static size_t			chain_cache_next = 0;
+static pthread_mutex_t		chain_cache_mtx = PTHREAD_MUTEX_INITIALIZER;
 
 static const char cipher_list[] = "HIGH:!aNULL";
 
+static void	create_ssl_context(void);
+
 /*lint -sem(get_cert, r_null) */
 static X509 *
 get_cert(void)
@@ -64,6 +102,31 @@ get_cert(void)
 #endif
 }
 
+/*
+ * Compute the pin of a certificate: the base64 encoded SHA-256 hash of
+ * its DER encoded public key, i.e. its SubjectPublicKeyInfo
+ */
+static bool
+spki_pin(X509 *cert, char *pin, size_t size)
+{
+	EVP_PKEY	*pkey;
+	bool		 ok;
+	int		 len;
+	unsigned char	*der = NULL;
+	unsigned char	 hash[EVP_MAX_MD_SIZE];
+	unsigned int	 hash_len = 0;
+
+	if ((pkey = X509_get_pubkey(cert)) == NULL)
+		return false;
+	len = i2d_PUBKEY(pkey, &der);
+	EVP_PKEY_free(pkey);
+	if (len <= 0)
+		return false;
+	ok = EVP_Digest(der, len, hash, &hash_len, EVP_sha256(), NULL);
+	OPENSSL_free(der);
+	return (ok && b64_encode(hash, hash_len, pin, size) == SPKI_PIN_LEN);
+}
+
 chkhost_res_t
 net_ssl_check_hostname(const char *host, unsigned int flags)
 {
@@ -89,6 +152,27 @@ net_ssl_check_hostname(const char *host, unsigned int flags)
 #endif
 }
 
+/**
+ * Get the pin of the public key of the server, in the format of the
+ * setting 'tls_spki_pins'
+ *
+ * @param pin	Receives the pin
+ * @param size	Size of 'pin'. At least SPKI_PIN_LEN + 1.
+ * @return true on success
+ */
+bool
+net_ssl_peer_pin(char *pin, size_t size)
+{
+	X509	*cert;
+	bool	 ok;
+
+	if ((cert = get_cert()) == NULL)
+		return false;
+	ok = spki_pin(cert, pin, size);
+	X509_free(cert);
+	return ok;
+}
+
 /**
  * Write bytes to a TLS/SSL connection
  *
@@ -102,30 +186,31 @@ net_ssl_send(const char *fmt, ...)
 	char		*bufptr = NULL;
 	int		 buflen = 0;
 	int		 n_sent = 0;
-	size_t		 newSize = 0;
+	size_t		 len = 0;
 	static const char
 			 message_terminate[] = "\r\n\r\n";
+	struct arena_mark
+			 m = arena_save(&g_arena);
+	struct fmt_buf	 f;
 	va_list		 ap;
 
 	log_assert_arg_nonnull("net_ssl_send", "fmt", fmt);
 
+	fmt_init(&f, NULL, 0, FMT_ARENA, &g_arena);
 	va_start(ap, fmt);
-	if (my_vasprintf(&buf, fmt, ap) < 0)
-		fatal(errno, "%s: my_vasprintf", __func__);
+	(void) fmt_vprintf(&f, fmt, ap);
 	va_end(ap);
+	fmt_write(&f, message_terminate, sizeof message_terminate - 1);
 
-	newSize = strlen(buf) + nitems(message_terminate);
-	buf = xrealloc(buf, newSize);
-
-	if (strlcat(buf, message_terminate, newSize) >= newSize)
-		fatal(EOVERFLOW, "%s: strlcat", __func__);
-	if (strlen(buf) > INT_MAX) {
-		free(buf);
+	buf = f.data;
+	len = f.len;
+	if (len > INT_MAX) {
+		arena_restore(&g_arena, m);
 		return -1;
 	}
 
 	bufptr = buf;
-	buflen = (int) strlen(buf);
+	buflen = (int) len;
 
 	while (buflen > 0) {
 		if (ssl == NULL || g_socket == -1)
@@ -153,13 +238,16 @@ net_ssl_send(const char *fmt, ...)
 				continue;
 			}
 
-			free(buf);
+			arena_restore(&g_arena, m);
 			return -1;
 		}
 	}
 
-	free(buf);
-	return (n_sent > 0 ? 0 : -1);
+	arena_restore(&g_arena, m);
+	if (n_sent == 0)
+		return -1;
+	net_timing_mark(NET_PHASE_WRITE);
+	return 0;
 }
 
 /**
@@ -205,6 +293,7 @@ net_ssl_recv(char *recvbuf, size_t recvbuf_size)
 	if ((bytes_received = SSL_read(ssl, recvbuf, recvbuf_size)) > 0) {
 		if (BIO_flush(SSL_get_rbio(ssl)) != 1)
 			log_debug("%s: error flushing read bio", __func__);
+		net_timing_mark(NET_PHASE_FIRST_BYTE);
 		return 0;
 	}
 
@@ -231,6 +320,13 @@ net_ssl_begin(void)
 	const char		*err_reason = "";
 	static const int	 VALUE_HANDSHAKE_OK = 1;
 
+	USDT_PROBE0(tls_start);
+
+	(void) pthread_mutex_lock(&ssl_ctx_mtx);
+	if (ssl_ctx == NULL)
+		create_ssl_context();
+	(void) pthread_mutex_unlock(&ssl_ctx_mtx);
+
 	if (ssl != NULL) {
 		err_reason = "the ssl object appears to be non-null";
 		goto err;
@@ -246,14 +342,25 @@ net_ssl_begin(void)
 	SSL_set_connect_state(ssl);
 
 	if (SSL_connect(ssl) != VALUE_HANDSHAKE_OK) {
+		metrics_inc(METRIC_TLS_HANDSHAKE_FAILURES);
 		err_reason = "handshake not ok!";
 		goto err;
 	}
 
+	net_timing_mark(NET_PHASE_TLS_HANDSHAKE);
+	metrics_inc(METRIC_TLS_HANDSHAKES);
+	if (log_debug_enabled()) {
+		char pin[SPKI_PIN_LEN + 1];
+
+		if (net_ssl_peer_pin(pin, sizeof pin))
+			log_debug("public key pin of the server: %s", pin);
+	}
+	USDT_PROBE1(tls_done, 0);
 	return 0;
 
   err:
 	log_warn(0, "%s: %s", __func__, err_reason);
+	USDT_PROBE1(tls_done, -1);
 	return -1;
 }
 
@@ -332,10 +439,12 @@ verify_callback(int ok, X509_STORE_CTX *ctx)
 	const int	 depth = X509_STORE_CTX_get_error_depth(ctx);
 	const int	 err = X509_STORE_CTX_get_error(ctx);
 
-	(void) X509_NAME_oneline(X509_get_issuer_name(cert), issuer,
-	    sizeof issuer);
-	(void) X509_NAME_oneline(X509_get_subject_name(cert), subject,
-	    sizeof subject);
+	if (!ok || log_debug_enabled()) {
+		(void) X509_NAME_oneline(X509_get_issuer_name(cert), issuer,
+		    sizeof issuer);
+		(void) X509_NAME_oneline(X509_get_subject_name(cert), subject,
+		    sizeof subject);
+	}
 
 	if (!ok) {
 		log_warn(0, "Error with certificate at depth: %d", depth);
@@ -350,36 +459,187 @@ verify_callback(int ok, X509_STORE_CTX *ctx)
 	return (ok);
 }
 
-/**
- * Initialize the TLS/SSL library
+static bool
+pin_is_trusted(const char *pin)
+{
+	const char *start = setting("tls_spki_pins");
+
+	while (*start) {
+		const size_t len = strcspn(start, "|");
+
+		if (len == SPKI_PIN_LEN && strncmp(start, pin, len) == 0)
+			return true;
+		start += len;
+		if (*start == '|')
+			start++;
+	}
+	return false;
+}
+
+/*
+ * If 'tls_spki_pins' is set: check that the public key of a
+ * certificate of the verified chain is pinned
  */
-void
-net_ssl_init(void)
+static bool
+chain_is_pinned(STACK_OF(X509) *chain)
 {
-	SSL_load_error_strings();
-	(void) SSL_library_init();
+	char pin[SPKI_PIN_LEN + 1];
+	char pins[5 * (SPKI_PIN_LEN + 1)] = { '\0' }; /* Verify depth 4 */
+
+	if (strings_match(setting("tls_spki_pins"), ""))
+		return true;
+	for (int i = 0; i < sk_X509_num(chain); i++) {
+		if (spki_pin(sk_X509_value(chain, i), pin, sizeof pin) &&
+		    pin_is_trusted(pin)) {
+			log_debug("public key pin matches at depth %d", i);
+			return true;
+		}
+	}
 
-	if (RAND_load_file("/dev/urandom", 1024) <= 0)
-		log_warn(ENOSYS, "%s: error seeding the prng!", __func__);
+	/* In the format of the setting, from the leaf to the root */
+	for (int i = 0; i < sk_X509_num(chain); i++) {
+		if (spki_pin(sk_X509_value(chain, i), pin, sizeof pin)) {
+			if (pins[0] != '\0')
+				(void) strlcat(pins, "|", sizeof pins);
+			(void) strlcat(pins, pin, sizeof pins);
+		}
+	}
+	log_warn(0, "no public key of the certificate chain matches "
+	    "'tls_spki_pins': the chain has: %s", pins);
+	return false;
+}
+
+/*
+ * The time when the first certificate of a chain expires, but at most
+ * CHAIN_CACHE_TTL seconds from now
+ */
+static time_t
+chain_expires(STACK_OF(X509) *chain, time_t now)
+{
+	time_t expires = now + CHAIN_CACHE_TTL;
+
+	for (int i = 0; i < sk_X509_num(chain); i++) {
+		int days = 0, secs = 0;
+
+		if (!ASN1_TIME_diff(&days, &secs, NULL,
+		    X509_get_notAfter(sk_X509_value(chain, i))))
+			return now;
+		if (now + (time_t) days * 86400 + secs < expires)
+			expires = now + (time_t) days * 86400 + secs;
+	}
+	return expires;
+}
+
+/*
+ * Verify the certificate chain of the server. It's called by the
+ * library instead of X509_verify_cert(). A leaf whose chain has been
+ * verified before skips building and verifying the chain again. The
+ * hostname is checked on every connection by net_ssl_check_hostname().
+ */
+static int
+verify_chain(X509_STORE_CTX *ctx, void *arg)
+{
+	STACK_OF(X509)			*chain;
+	X509				*leaf = X509_STORE_CTX_get0_cert(ctx);
+	const time_t			 now = time(NULL);
+	struct chain_cache_entry	*ce;
+	unsigned char			 md[EVP_MAX_MD_SIZE];
+	unsigned int			 md_len = 0;
+
+	(void) arg;
+
+	if (leaf == NULL || !X509_digest(leaf, EVP_sha256(), md, &md_len))
+		return X509_verify_cert(ctx);
+
+	(void) pthread_mutex_lock(&chain_cache_mtx);
+	for (ce = &chain_cache[0]; ce < &chain_cache[CHAIN_CACHE_SIZE]; ce++) {
+		if (ce->expires > now &&
+		    memcmp(ce->fingerprint, md, md_len) == 0) {
+			(void) pthread_mutex_unlock(&chain_cache_mtx);
+			log_debug("Cert verification OK! (cached)");
+			return 1;
+		}
+	}
+	(void) pthread_mutex_unlock(&chain_cache_mtx);
+
+	if (X509_verify_cert(ctx) <= 0)
+		return 0;
+	if ((chain = X509_STORE_CTX_get0_chain(ctx)) == NULL ||
+	    !chain_is_pinned(chain)) {
+		X509_STORE_CTX_set_error(ctx,
+		    X509_V_ERR_APPLICATION_VERIFICATION);
+		return 0;
+	}
+
+	const time_t expires = chain_expires(chain, now);
+
+	(void) pthread_mutex_lock(&chain_cache_mtx);
+	ce = &chain_cache[chain_cache_next++ % CHAIN_CACHE_SIZE];
+	(void) memcpy(ce->fingerprint, md, md_len);
+	ce->expires = expires;
+	(void) pthread_mutex_unlock(&chain_cache_mtx);
+	return 1;
+}
+
+/*
+ * Create the SSL_CTX and load the trust store. Done on the first TLS
+ * connection rather than at startup, so that a process that never
+ * connects, e.g. because the IP address hasn't changed, never pays
+ * for it.
+ */
+static void
+create_ssl_context(void)
+{
+	const char *ca_dir = setting("tls_ca_dir");
+	const char *ca_file = setting("tls_ca_file");
 
 #if OPENSSL_VERSION_NUMBER >= 0x10100000L
+	/*
+	 * Since OpenSSL 1.1.0 the library initializes itself and the
+	 * PRNG seeds itself from the operating system
+	 */
 	create_ssl_context_obj();
 #else
 #pragma message("Consider updating your TLS/SSL library")
+	SSL_load_error_strings();
+	(void) SSL_library_init();
+
+	if (RAND_load_file("/dev/urandom", 1024) <= 0)
+		log_warn(ENOSYS, "%s: error seeding the prng!", __func__);
+
 	create_ssl_context_obj_insecure();
 #endif
 
-	if (!SSL_CTX_set_default_verify_paths(ssl_ctx)) {
+	/*
+	 * A dedicated CA file or directory is much smaller than the
+	 * trust store of the system, which is parsed in full
+	 */
+	if (*ca_file || *ca_dir) {
+		if (!SSL_CTX_load_verify_locations(ssl_ctx,
+		    (*ca_file ? ca_file : NULL), (*ca_dir ? ca_dir : NULL))) {
+			log_warn(0, "%s: error loading tls_ca_file and/or "
+			    "tls_ca_dir", __func__);
+		}
+	} else if (!SSL_CTX_set_default_verify_paths(ssl_ctx)) {
 		log_warn(ENOSYS, "%s: error loading default ca file and/or "
 		    "directory", __func__);
 	}
 
 	SSL_CTX_set_verify(ssl_ctx, SSL_VERIFY_PEER, verify_callback);
 	SSL_CTX_set_verify_depth(ssl_ctx, 4);
+	SSL_CTX_set_cert_verify_callback(ssl_ctx, verify_chain, NULL);
 
 	if (!SSL_CTX_set_cipher_list(ssl_ctx, cipher_list))
 		log_warn(EINVAL, "%s: bogus cipher list", __func__);
+}
 
+/**
+ * Initialize the TLS/SSL library. The SSL_CTX is created on the first
+ * connection.
+ */
+void
+net_ssl_init(void)
+{
 	net_send = net_ssl_send;
 	net_recv = net_ssl_recv;
 
@@ -387,7 +647,7 @@ net_ssl_init(void)
 }
 
 /**
- * Deinitialize the TLS/SSL library
+ * Deinitialize the TLS/SSL library. No update may be running.
  */
 void
 net_ssl_deinit(void)
@@ -398,4 +658,8 @@ net_ssl_deinit(void)
 		SSL_CTX_free(ssl_ctx);
 		ssl_ctx = NULL;
 	}
+
+	/* The trust store and the pins may change on a reload */
+	(void) memset(chain_cache, 0, sizeof chain_cache);
+	chain_cache_next = 0;
 }
@@ -25,9 +25,15 @@
 #include <string.h>
 #include <unistd.h>
 
+#include "arena.h"
+#include "format.h"
 #include "log.h"
 #include "main.h"
+#include "metrics.h"
+#include "netstats.h"
 #include "network.h"
+#include "probes.h"
+#include "protocol.h"
 #include "settings.h"
 #include "various.h"
 #include "wrapper.h"
@@ -35,7 +41,8 @@
 NET_SEND_FUNCPTR	net_send = net_send_plain;
 NET_RECV_FUNCPTR	net_recv = net_recv_plain;
 
-int g_socket = -1;
+_Thread_local int g_socket = -1;
+_Thread_local struct net_timing g_net_timing;
 
 /*lint -sem(net_addr_resolve, r_null) */
 static struct addrinfo *
@@ -67,18 +74,10 @@ ssl_is_enabled(void)
 	return strcmp(setting("port"), "443") == 0;
 }
 
-/**
- * Connect to the service provider with or without TLS/SSL depending
- * on the port number.
- *
- * @return 0 on success, and -1 on failure
- */
-int
-net_connect(void)
+static int
+connect_to_provider(const char *host, const char *port)
 {
 	bool			 connected = false;
-	const char		*host = setting("sp_hostname");
-	const char		*port = setting("port");
 	struct addrinfo		*res, *rp;
 
 	log_debug("connecting to %s (%s)...", host, port);
@@ -88,6 +87,7 @@ net_connect(void)
 		    "bogus hostname?");
 		return -1;
 	} else {
+		net_timing_mark(NET_PHASE_RESOLVE);
 		log_debug("get a list of ip addresses complete");
 	}
 
@@ -98,6 +98,11 @@ net_connect(void)
 		if (g_socket == SOCKET_CREATION_FAILED) {
 			continue;
 		} else if (connect(g_socket, rp->ai_addr, rp->ai_addrlen) == 0) {
+			net_timing_mark(NET_PHASE_CONNECT);
+			if (getnameinfo(rp->ai_addr, rp->ai_addrlen,
+			    g_net_timing.addr, sizeof g_net_timing.addr, NULL,
+			    0, NI_NUMERICHOST) != 0)
+				g_net_timing.addr[0] = '\0';
 			log_debug("connected!");
 			connected = true;
 			break;
@@ -123,6 +128,25 @@ net_connect(void)
 	return 0;
 }
 
+/**
+ * Connect to the service provider with or without TLS/SSL depending
+ * on the port number.
+ *
+ * @return 0 on success, and -1 on failure
+ */
+int
+net_connect(void)
+{
+	const char	*host = setting("sp_hostname");
+	const char	*port = setting("port");
+	int		 ret;
+
+	USDT_PROBE2(connect_start, host, port);
+	ret = connect_to_provider(host, port);
+	USDT_PROBE3(connect_done, host, g_net_timing.addr, ret);
+	return ret;
+}
+
 /**
  * Network disconnect
  */
@@ -148,28 +172,32 @@ net_send_plain(const char *fmt, ...)
 {
 	bool		 ok = true;
 	char		*buf = NULL;
-	size_t		 newSize = 0;
+	size_t		 len = 0;
 	static const char
 			 message_terminate[] = "\r\n\r\n";
+	struct arena_mark
+			 m = arena_save(&g_arena);
+	struct fmt_buf	 f;
 	va_list		 ap;
 
 	log_assert_arg_nonnull("net_send_plain", "fmt", fmt);
 
+	fmt_init(&f, NULL, 0, FMT_ARENA, &g_arena);
 	va_start(ap, fmt);
-	if (errno = 0, my_vasprintf(&buf, fmt, ap) < 0)
-		fatal(errno, "net_send_plain: my_vasprintf");
+	(void) fmt_vprintf(&f, fmt, ap);
 	va_end(ap);
+	fmt_write(&f, message_terminate, sizeof message_terminate - 1);
 
-	newSize = strlen(buf) + nitems(message_terminate);
-	buf = xrealloc(buf, newSize);
+	buf = f.data;
+	len = f.len;
 
-	if (strlcat(buf, message_terminate, newSize) >= newSize)
-		fatal(EOVERFLOW, "net_send_plain: strlcat");
-	if (errno = 0, send(g_socket, buf, strlen(buf), 0) == -1)
+	if (errno = 0, send(g_socket, buf, len, 0) == -1)
 		ok = false;
 	if (!ok)
 		log_warn(errno, "net_send_plain: send");
-	free(buf);
+	else
+		net_timing_mark(NET_PHASE_WRITE);
+	arena_restore(&g_arena, m);
 	return (ok ? 0 : -1);
 }
 
@@ -214,22 +242,26 @@ net_recv_plain(char *recvbuf, size_t recvbuf_size)
 		log_warn(0, "net_recv_plain: fatal: connection lost");
 		return -1;
 	default:
+		net_timing_mark(NET_PHASE_FIRST_BYTE);
 		break;
 	}
 	return 0;
 }
 
-/**
- * Check for IP change. The function may return IP_HAS_CHANGED even
- * though the IP hasn't changed, but that is mainly for error
- * conditions to enforce an update to occur. In the same manner: it
- * might return IP_NO_CHANGE if, for example, the received data
- * contains a bogus ipv4 address.
- *
- * @return IP_HAS_CHANGED or IP_NO_CHANGE
+/*
+ * Record the timing and the result of an IP lookup. It has failed if
+ * no IP address was received.
  */
-ip_chg_t
-net_check_for_ip_change(void)
+static void
+lookup_done(const char *srv, bool ok)
+{
+	net_timing_stop();
+	netstats_record(NETSTATS_LOOKUP, srv, &g_net_timing);
+	metrics_count_lookup(srv, ok);
+}
+
+static ip_chg_t
+check_for_ip_change(void)
 {
 	bool			 address_resolved = false;
 	bool			 connected = false;
@@ -239,11 +271,13 @@ net_check_for_ip_change(void)
 	const char		*port = "80";
 	const char		*primary_srv = setting("primary_ip_lookup_srv");
 	struct addrinfo		*res, *rp;
-	unsigned char		 nw_addr[sizeof(struct in_addr)];
 
 	if (setting_bool("force_update", true))
 		return IP_HAS_CHANGED;
 
+	net_timing_start();
+	(void) strlcpy(srv, primary_srv, sizeof srv);
+
 	if ((res = net_addr_resolve(primary_srv, port)) != NULL) {
 		(void) strlcpy(srv, primary_srv, sizeof srv);
 		address_resolved = true;
@@ -255,8 +289,11 @@ net_check_for_ip_change(void)
 	}
 
   done:
-	if (!address_resolved)
+	if (!address_resolved) {
+		lookup_done(srv, false);
 		return IP_HAS_CHANGED; /* force update */
+	}
+	net_timing_mark(NET_PHASE_RESOLVE);
 
 	for (rp = res; rp; rp = rp->ai_next) {
 		g_socket =
@@ -265,6 +302,7 @@ net_check_for_ip_change(void)
 		if (g_socket == SOCKET_CREATION_FAILED) {
 			continue;
 		} else if (connect(g_socket, rp->ai_addr, rp->ai_addrlen) == 0) {
+			net_timing_mark(NET_PHASE_CONNECT);
 			connected = true;
 			break;
 		} else {
@@ -278,25 +316,24 @@ net_check_for_ip_change(void)
 		if (g_socket >= 0)
 			(void) close(g_socket);
 		g_socket = -1;
+		lookup_done(srv, false);
 		return IP_HAS_CHANGED;
 	}
 
 	(void) net_send_plain("GET /index.html HTTP/1.0\r\nHost: %s\r\n"
 	    "User-Agent: %s/%s %s", srv, g_programName, g_programVersion,
 	    g_maintainerEmail);
-	(void) net_recv_plain(buf, sizeof buf);
+	const bool received = (net_recv_plain(buf, sizeof buf) == 0);
+
 	(void) close(g_socket);
 	g_socket = -1;
 
-	const char *cp = strrchr(trim(buf), '\n');
+	const char *reason = "no reply";
+	const char *cp = (received ? lookup_response(buf, &reason) : NULL);
 
+	lookup_done(srv, cp != NULL);
 	if (!cp) {
-		log_warn(0, "net_check_for_ip_change: warning: "
-		    "cannot locate last occurrance of a newline");
-		return IP_NO_CHANGE;
-	} else if (inet_pton(AF_INET, ++cp, nw_addr) == 0) {
-		log_warn(0, "net_check_for_ip_change: warning: "
-		    "bogus ipv4 address");
+		log_warn(0, "net_check_for_ip_change: warning: %s", reason);
 		return IP_NO_CHANGE;
 	} else if (strings_match(cp, g_last_ip_addr)) {
 		log_debug("not updating (the external ip hasn't changed)");
@@ -305,9 +342,90 @@ net_check_for_ip_change(void)
 
 	(void) strlcpy(g_last_ip_addr, cp, sizeof g_last_ip_addr);
 	log_msg("ip has changed to %s", cp);
+	metrics_inc(METRIC_IP_CHANGES);
 	return IP_HAS_CHANGED;
 }
 
+/**
+ * Check for IP change. The function may return IP_HAS_CHANGED even
+ * though the IP hasn't changed, but that is mainly for error
+ * conditions to enforce an update to occur. In the same manner: it
+ * might return IP_NO_CHANGE if, for example, the received data
+ * contains a bogus ipv4 address.
+ *
+ * @return IP_HAS_CHANGED or IP_NO_CHANGE
+ */
+ip_chg_t
+net_check_for_ip_change(void)
+{
+	ip_chg_t ret;
+
+	USDT_PROBE0(lookup_start);
+	ret = check_for_ip_change();
+	USDT_PROBE2(lookup_done, ret, g_last_ip_addr);
+	return ret;
+}
+
+/**
+ * Start timing a request. The phase timings and the address are reset.
+ */
+void
+net_timing_start(void)
+{
+	(void) memset(&g_net_timing, 0, sizeof g_net_timing);
+	g_net_timing.start_ns = g_net_timing.mark_ns = monotonic_ns();
+}
+
+/**
+ * Mark the end of a phase of a request. Only the first mark of a phase
+ * counts, e.g. the first receive is the one that gets the first byte.
+ *
+ * @param phase The phase that ended
+ * @return Void
+ */
+void
+net_timing_mark(net_phase_t phase)
+{
+	uint64_t now;
+
+	if (phase < 0 || phase >= NET_PHASE_COUNT ||
+	    (g_net_timing.reached & (1U << phase)))
+		return;
+	now = monotonic_ns();
+	g_net_timing.phase_us[phase] = (now - g_net_timing.mark_ns) / 1000;
+	g_net_timing.mark_ns = now;
+	g_net_timing.reached |= (1U << phase);
+}
+
+/**
+ * Stop timing a request, i.e. set its total time
+ */
+void
+net_timing_stop(void)
+{
+	g_net_timing.total_us = (monotonic_ns() - g_net_timing.start_ns) /
+	    1000;
+}
+
+/**
+ * Get the name of a phase
+ */
+const char *
+net_phase_name(net_phase_t phase)
+{
+	static const char *names[NET_PHASE_COUNT] = {
+		[NET_PHASE_RESOLVE]		= "resolve",
+		[NET_PHASE_CONNECT]		= "connect",
+		[NET_PHASE_TLS_HANDSHAKE]	= "tls_handshake",
+		[NET_PHASE_WRITE]		= "write",
+		[NET_PHASE_FIRST_BYTE]		= "first_byte",
+	};
+
+	if (phase < 0 || phase >= NET_PHASE_COUNT)
+		return "unknown";
+	return names[phase];
+}
+
 /**
  * Initialize networking
  */
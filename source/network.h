@@ -3,6 +3,7 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 #include "ducdef.h"
 
@@ -19,6 +20,31 @@ typedef enum {
 	HOSTNAME_MISMATCH
 } chkhost_res_t;
 
+typedef enum {
+	NET_PHASE_RESOLVE,
+	NET_PHASE_CONNECT,
+	NET_PHASE_TLS_HANDSHAKE,
+	NET_PHASE_WRITE,
+	NET_PHASE_FIRST_BYTE,
+	NET_PHASE_COUNT
+} net_phase_t;
+
+/*
+ * Timing of the phases of a request, i.e. an update request or an IP
+ * lookup. The duration of a phase is the time from the end of the
+ * previous phase. Phases that aren't reached, such as the TLS
+ * handshake on a plain connection, are 0 and their bit in 'reached' is
+ * clear.
+ */
+struct net_timing {
+	uint64_t	start_ns;
+	uint64_t	mark_ns;
+	uint64_t	phase_us[NET_PHASE_COUNT];
+	uint64_t	total_us;	/**< Set by net_timing_stop() */
+	unsigned int	reached;	/**< Bit per phase */
+	char		addr[64];	/**< Numeric address connected to */
+};
+
 typedef int (*NET_SEND_FUNCPTR)(const char *, ...) PRINTFLIKE(1);
 typedef int (*NET_RECV_FUNCPTR)(char *, size_t);
 
@@ -26,7 +52,9 @@ __DUC_BEGIN_DECLS
 extern NET_SEND_FUNCPTR net_send;
 extern NET_RECV_FUNCPTR net_recv;
 
-extern int g_socket;
+/* The connection of the thread, i.e. of an update worker */
+extern _Thread_local int g_socket;
+extern _Thread_local struct net_timing g_net_timing;
 
 /* network.c */
 int	 net_connect(void);
@@ -37,11 +65,17 @@ int	 net_recv_plain(char *, size_t);
 
 ip_chg_t net_check_for_ip_change(void);
 
+const char *net_phase_name(net_phase_t);
+void	 net_timing_mark(net_phase_t);
+void	 net_timing_start(void);
+void	 net_timing_stop(void);
+
 void	 net_init(void);
 void	 net_deinit(void);
 
 /* network-openssl.c */
 chkhost_res_t net_ssl_check_hostname(const char *, unsigned int);
+bool	 net_ssl_peer_pin(char *, size_t);
 
 int	 net_ssl_send(const char *, ...) PRINTFLIKE(1);
 int	 net_ssl_recv(char *, size_t);
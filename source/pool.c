@@ -0,0 +1,275 @@
+/* Copyright (c) 2026 Markus Uhlin <markus.uhlin@icloud.com>
+   All rights reserved.
+
+   Permission to use, copy, modify, and distribute this software for any
+   purpose with or without fee is hereby granted, provided that the above
+   copyright notice and this permission notice appear in all copies.
+
+   THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+   WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+   AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+   DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR
+   PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+   TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+   PERFORMANCE OF THIS SOFTWARE. */
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "arena.h"
+#include "log.h"
+#include "pool.h"
+
+/*
+ * The tasks that are left in the queue of a worker: 'head' up to, but
+ * not including, 'tail'. The owner takes from the head and a thief
+ * takes from the tail.
+ */
+struct pool_queue {
+	pthread_mutex_t	mtx;
+	size_t		head;
+	size_t		tail;
+};
+
+static struct pool_queue	 queues[POOL_WORKERS_MAX];
+static bool			 queues_ready = false;
+static pthread_t		 threads[POOL_WORKERS_MAX];
+static size_t			 n_threads = 0; /* Not counting the caller */
+
+/*
+ * The last batch that a worker has seen. Set before its thread is
+ * started, so that a thread started for a batch doesn't take part in
+ * the one before it.
+ */
+static unsigned long int	 seen[POOL_WORKERS_MAX];
+
+static pthread_mutex_t	 mtx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	 work_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t	 done_cond = PTHREAD_COND_INITIALIZER;
+static unsigned long int generation = 0;
+static size_t		 n_busy = 0;
+static size_t		 n_workers = 1; /* Of the batch that runs */
+static bool		 stopping = false;
+
+static POOL_TASK_FUNCPTR task_func = NULL;
+static void		*task_arg = NULL;
+
+static _Thread_local size_t worker_id = 0;
+
+static bool
+take(struct pool_queue *q, size_t *task)
+{
+	bool ok = false;
+
+	(void) pthread_mutex_lock(&q->mtx);
+	if (q->head < q->tail) {
+		*task = q->head++;
+		ok = true;
+	}
+	(void) pthread_mutex_unlock(&q->mtx);
+	return ok;
+}
+
+/*
+ * Move the second half of the tasks of a victim to the queue of a
+ * thief, which is empty. Returns false if the victim has no tasks.
+ */
+static bool
+steal(struct pool_queue *thief, struct pool_queue *victim)
+{
+	size_t head, tail;
+
+	(void) pthread_mutex_lock(&victim->mtx);
+	if (victim->head >= victim->tail) {
+		(void) pthread_mutex_unlock(&victim->mtx);
+		return false;
+	}
+	tail = victim->tail;
+	head = victim->tail -= (victim->tail - victim->head + 1) / 2;
+	(void) pthread_mutex_unlock(&victim->mtx);
+
+	(void) pthread_mutex_lock(&thief->mtx);
+	thief->head = head;
+	thief->tail = tail;
+	(void) pthread_mutex_unlock(&thief->mtx);
+	return true;
+}
+
+/*
+ * Run tasks until every queue is empty
+ */
+static void
+work(size_t id)
+{
+	struct pool_queue	*own = &queues[id];
+	size_t			 task;
+
+	for (;;) {
+		bool stolen = false;
+
+		while (take(own, &task))
+			task_func(task, task_arg);
+		for (size_t i = 1; i < n_workers && !stolen; i++)
+			stolen = steal(own, &queues[(id + i) % n_workers]);
+		if (!stolen)
+			break;
+	}
+}
+
+static void *
+worker_main(void *arg)
+{
+	worker_id = (size_t) arg;
+
+	for (;;) {
+		(void) pthread_mutex_lock(&mtx);
+		while (!stopping && (seen[worker_id] == generation ||
+		    worker_id >= n_workers))
+			(void) pthread_cond_wait(&work_cond, &mtx);
+		if (stopping) {
+			(void) pthread_mutex_unlock(&mtx);
+			break;
+		}
+		seen[worker_id] = generation;
+		(void) pthread_mutex_unlock(&mtx);
+
+		work(worker_id);
+
+		(void) pthread_mutex_lock(&mtx);
+		if (--n_busy == 0)
+			(void) pthread_cond_signal(&done_cond);
+		(void) pthread_mutex_unlock(&mtx);
+	}
+
+	arena_destroy(&g_arena);
+	return NULL;
+}
+
+/*
+ * Start threads until there are 'count', not counting the caller.
+ * Returns the number of threads.
+ */
+static size_t
+start_threads(size_t count)
+{
+	sigset_t all, saved;
+
+	/* Signals are handled by the main thread */
+	(void) sigfillset(&all);
+	(void) pthread_sigmask(SIG_SETMASK, &all, &saved);
+
+	while (n_threads < count) {
+		const size_t	id = n_threads + 1;
+		int		ret;
+
+		seen[id] = generation;
+		if ((ret = pthread_create(&threads[n_threads], NULL,
+		    worker_main, (void *) id)) != 0) {
+			log_warn(ret, "pool: pthread_create");
+			break;
+		}
+		n_threads++;
+	}
+
+	(void) pthread_sigmask(SIG_SETMASK, &saved, NULL);
+	return n_threads;
+}
+
+/**
+ * Run a batch of tasks on a number of workers and wait until every
+ * task has run. The threads are started on the first batch that needs
+ * them and are kept for the next batches. With one worker, or one
+ * task, the tasks run in order on the calling thread.
+ *
+ * Only one thread at a time may run a batch.
+ *
+ * @param workers	The number of workers, the caller included
+ * @param count		The number of tasks
+ * @param func		Called with the number of the task and 'arg'
+ * @param arg		Passed to 'func'
+ * @return Void
+ */
+void
+pool_run(size_t workers, size_t count, POOL_TASK_FUNCPTR func, void *arg)
+{
+	if (func == NULL)
+		fatal(EINVAL, "pool_run");
+	workers = MAX(1, MIN(MIN(workers, POOL_WORKERS_MAX), count));
+	if (workers > 1)
+		workers = start_threads(workers - 1) + 1;
+
+	if (workers == 1) {
+		for (size_t task = 0; task < count; task++)
+			func(task, arg);
+		return;
+	}
+
+	for (size_t id = 0; id < POOL_WORKERS_MAX && !queues_ready; id++)
+		(void) pthread_mutex_init(&queues[id].mtx, NULL);
+	queues_ready = true;
+
+	for (size_t id = 0; id < workers; id++) {
+		queues[id].head = id * count / workers;
+		queues[id].tail = (id + 1) * count / workers;
+	}
+
+	(void) pthread_mutex_lock(&mtx);
+	task_func = func;
+	task_arg = arg;
+	n_workers = workers;
+	n_busy = workers - 1;
+	generation++;
+	(void) pthread_cond_broadcast(&work_cond);
+	(void) pthread_mutex_unlock(&mtx);
+
+	work(0);
+
+	(void) pthread_mutex_lock(&mtx);
+	while (n_busy > 0)
+		(void) pthread_cond_wait(&done_cond, &mtx);
+	(void) pthread_mutex_unlock(&mtx);
+}
+
+/**
+ * @return The number of worker threads that are started, the main
+ *         thread included
+ */
+size_t
+pool_size(void)
+{
+	return n_threads + 1;
+}
+
+/**
+ * @return The number of the worker that calls, 0 for the main thread
+ */
+size_t
+pool_worker_id(void)
+{
+	return worker_id;
+}
+
+/**
+ * Stop the worker threads and free their arenas. A batch must not be
+ * running.
+ */
+void
+pool_stop(void)
+{
+	if (n_threads == 0)
+		return;
+
+	(void) pthread_mutex_lock(&mtx);
+	stopping = true;
+	(void) pthread_cond_broadcast(&work_cond);
+	(void) pthread_mutex_unlock(&mtx);
+
+	for (size_t i = 0; i < n_threads; i++)
+		(void) pthread_join(threads[i], NULL);
+	n_threads = 0;
+	stopping = false;
+}
@@ -0,0 +1,26 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+
+#include "ducdef.h"
+
+#define POOL_WORKERS_MAX	32
+
+/*
+ * A fixed-size pool of worker threads that runs a batch of tasks. The
+ * tasks are numbered from 0 and split evenly between the workers,
+ * every worker has a queue of its own, and a worker whose queue runs
+ * dry steals half of the queue of another. The thread that runs the
+ * batch is one of the workers.
+ */
+typedef void (*POOL_TASK_FUNCPTR)(size_t, void *);
+
+__DUC_BEGIN_DECLS
+size_t	pool_size(void);
+size_t	pool_worker_id(void);
+void	pool_run(size_t, size_t, POOL_TASK_FUNCPTR, void *);
+void	pool_stop(void);
+__DUC_END_DECLS
+
+#endif
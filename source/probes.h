@@ -0,0 +1,84 @@
+#ifndef PROBES_H
+#define PROBES_H
+
+#include <stdint.h>
+
+/*
+ * USDT (user-level statically defined tracing) probes, in the format of
+ * SystemTap's <sys/sdt.h>, so that the update path can be traced with
+ * bpftrace, perf or stap, e.g.:
+ *
+ *   bpftrace -e 'usdt:/usr/local/bin/enhanced-duc:enhanced_duc:*
+ *                { printf("%s\n", probe); }'
+ *
+ * A probe is a single nop instruction, and its location and the
+ * locations of its arguments are recorded in an ELF note, i.e. a probe
+ * costs nothing until a tracer attaches to it. The arguments are
+ * passed as signed 64-bit integers, and strings as pointers.
+ *
+ * Probes are compiled in on x86-64 and AArch64 ELF targets. Set
+ * USDT_PROBES to 0 to compile them out, for example with:
+ * make CPPFLAGS=-DUSDT_PROBES=0
+ */
+#ifndef USDT_PROBES
+#if defined(__ELF__) && (defined(__x86_64__) || defined(__aarch64__)) &&\
+    (defined(__GNUC__) || defined(__clang__))
+#define USDT_PROBES 1
+#else
+#define USDT_PROBES 0
+#endif
+#endif
+
+#define USDT_PROVIDER enhanced_duc
+
+#if USDT_PROBES
+#define USDT_STR_(x)	#x
+#define USDT_STR(x)	USDT_STR_(x)
+#define USDT_ARG(x)	((int64_t) (intptr_t) (x))
+
+#define USDT_NOTE(name, args)\
+	"990:	nop\n"\
+	"	.pushsection .note.stapsdt,\"?\",\"note\"\n"\
+	"	.balign 4\n"\
+	"	.4byte 992f-991f, 994f-993f, 3\n"\
+	"991:	.asciz \"stapsdt\"\n"\
+	"992:	.balign 4\n"\
+	"993:	.8byte 990b\n"\
+	"	.8byte _.stapsdt.base\n"\
+	"	.8byte 0\n"\
+	"	.asciz \"" USDT_STR(USDT_PROVIDER) "\"\n"\
+	"	.asciz \"" #name "\"\n"\
+	"	.asciz \"" args "\"\n"\
+	"994:	.balign 4\n"\
+	"	.popsection\n"\
+	"	.ifndef _.stapsdt.base\n"\
+	"	.pushsection .stapsdt.base,\"aG\",\"progbits\","\
+	".stapsdt.base,comdat\n"\
+	"	.weak _.stapsdt.base\n"\
+	"	.hidden _.stapsdt.base\n"\
+	"_.stapsdt.base:\n"\
+	"	.space 1\n"\
+	"	.size _.stapsdt.base, 1\n"\
+	"	.popsection\n"\
+	"	.endif\n"
+
+#define USDT_PROBE0(name)\
+	__asm__ __volatile__(USDT_NOTE(name, ""))
+#define USDT_PROBE1(name, a1)\
+	__asm__ __volatile__(USDT_NOTE(name, "-8@%[usdt_a1]")\
+	    :: [usdt_a1] "nor" (USDT_ARG(a1)))
+#define USDT_PROBE2(name, a1, a2)\
+	__asm__ __volatile__(USDT_NOTE(name, "-8@%[usdt_a1] -8@%[usdt_a2]")\
+	    :: [usdt_a1] "nor" (USDT_ARG(a1)), [usdt_a2] "nor" (USDT_ARG(a2)))
+#define USDT_PROBE3(name, a1, a2, a3)\
+	__asm__ __volatile__(USDT_NOTE(name, "-8@%[usdt_a1] -8@%[usdt_a2] -8@%[usdt_a3]")\
+	    :: [usdt_a1] "nor" (USDT_ARG(a1)), [usdt_a2] "nor" (USDT_ARG(a2)),\
+	    [usdt_a3] "nor" (USDT_ARG(a3)))
+#else
+#define USDT_PROBE0(name)			((void) 0)
+#define USDT_PROBE1(name, a1)			((void) 0)
+#define USDT_PROBE2(name, a1, a2)		((void) 0)
+#define USDT_PROBE3(name, a1, a2, a3)		((void) 0)
+#endif
+
+#endif
@@ -0,0 +1,328 @@
+/* Copyright (c) 2026 Markus Uhlin <markus.uhlin@icloud.com>
+   All rights reserved.
+
+   Permission to use, copy, modify, and distribute this software for any
+   purpose with or without fee is hereby granted, provided that the above
+   copyright notice and this permission notice appear in all copies.
+
+   THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+   WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+   AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+   DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR
+   PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+   TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+   PERFORMANCE OF THIS SOFTWARE. */
+
+#include <sys/socket.h>
+#include <sys/types.h>
+
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "base64.h"
+#include "log.h"
+#include "main.h"
+#include "probes.h"
+#include "protocol.h"
+#include "settings.h"
+#include "various.h"
+
+#define ASCII_LOWER(c)	((c) >= 'A' && (c) <= 'Z' ? (c) | 0x20 : (c))
+
+/*
+ * A perfect hash of the keywords of the responses: no two keywords
+ * hash to the same slot. The table is laid out by the compiler from
+ * the macro, given the first and the last character of a keyword, so
+ * adding a keyword only needs a check that its slot is free (the tests
+ * classify every keyword).
+ */
+#define KEYWORD_HASH(len, first, last)\
+	(((len) + (first) + 2 * (last)) & (KEYWORD_SLOTS - 1))
+#define KEYWORD_SLOTS	16
+#define KEYWORD(str, first, last, code, addr)\
+	[KEYWORD_HASH(sizeof str - 1, first, last)] =\
+	{ str, sizeof str - 1, code, addr }
+
+static const struct keyword {
+	const char	*str;
+	size_t		 len;
+	response_code_t	 code;
+	bool		 addr;	/**< Can be followed by an address */
+} keywords[KEYWORD_SLOTS] = {
+	KEYWORD("good",     'g', 'd', CODE_GOOD,       true),
+	KEYWORD("nochg",    'n', 'g', CODE_NOCHG,      true),
+	KEYWORD("nohost",   'n', 't', CODE_NOHOST,     false),
+	KEYWORD("badauth",  'b', 'h', CODE_BADAUTH,    false),
+	KEYWORD("badagent", 'b', 't', CODE_BADAGENT,   false),
+	KEYWORD("!donator", '!', 'r', CODE_NOTDONATOR, false),
+	KEYWORD("abuse",    'a', 'e', CODE_ABUSE,      false),
+	KEYWORD("911",      '9', '1', CODE_EMERG,      false),
+};
+
+static bool
+is_space(int c)
+{
+	return (c == ' ' || (c >= '\t' && c <= '\r'));
+}
+
+/*
+ * Classify a line, without its trailing whitespace, in place. The
+ * keyword is compared case-insensitively and must be the whole line,
+ * or for "good" and "nochg" be followed by a space and an address.
+ */
+static void
+classify_line(const char *line, size_t len, struct server_reply *reply)
+{
+	const struct keyword	*kw;
+	size_t			 word_len;
+
+	reply->code = CODE_UNKNOWN;
+	reply->addr = NULL;
+	reply->addr_len = 0;
+
+	for (word_len = 0; word_len < len; word_len++) {
+		if (line[word_len] == ' ')
+			break;
+	}
+	if (word_len == 0)
+		return;
+
+	kw = &keywords[KEYWORD_HASH(word_len, ASCII_LOWER(line[0]),
+	    ASCII_LOWER(line[word_len - 1]))];
+	if (kw->str == NULL || kw->len != word_len)
+		return;
+	for (size_t i = 0; i < word_len; i++) {
+		if (ASCII_LOWER(line[i]) != kw->str[i])
+			return;
+	}
+
+	if (word_len < len) {
+		if (!kw->addr)
+			return;
+		reply->addr = &line[word_len + 1];
+		reply->addr_len = len - word_len - 1;
+	}
+	reply->code = kw->code;
+}
+
+/*
+ * Log the response with its line breaks visible: CR as 'R' and LF as
+ * 'N'. Long responses are truncated.
+ */
+static void
+log_response(const char *buf)
+{
+	char	dump[2000];
+	size_t	i;
+
+	for (i = 0; i < sizeof dump - 1 && buf[i] != '\0'; i++) {
+		if (buf[i] == '\r')
+			dump[i] = 'R';
+		else if (buf[i] == '\n')
+			dump[i] = 'N';
+		else
+			dump[i] = buf[i];
+	}
+	dump[i] = '\0';
+	log_debug("server_response: the buffer looks like this: %s", dump);
+}
+
+static response_code_t
+parse_server_response(const char *buf)
+{
+	struct server_reply	 reply;
+	const char		*line;
+	size_t			 len;
+
+	if (buf == NULL || *buf == '\0')
+		return CODE_UNKNOWN;
+	else if (log_debug_enabled())
+		log_response(buf);
+
+	/* The last line, without trailing whitespace */
+	len = strlen(buf);
+	while (len > 0 && is_space(buf[len - 1]))
+		len--;
+	line = &buf[len];
+	while (line > buf && line[-1] != '\n')
+		line--;
+	if (line == buf)
+		return CODE_UNKNOWN;
+	len -= line - buf;
+
+	log_debug("server_response: r = \"%.*s\"", (int) len, line);
+	classify_line(line, len, &reply);
+	return reply.code;
+}
+
+/**
+ * Classify the response of the server to an update request
+ *
+ * @param buf The response
+ * @return The response code. CODE_UNKNOWN if it isn't recognized.
+ */
+response_code_t
+server_response(const char *buf)
+{
+	response_code_t code;
+
+	USDT_PROBE1(parse_start, buf);
+	code = parse_server_response(buf);
+	USDT_PROBE1(parse_done, code);
+	return code;
+}
+
+/**
+ * Classify every line of the body of the response of the server,
+ * i.e. the lines after the first empty line, without copying it. The
+ * service provider answers with one line per host. Blank lines are
+ * skipped.
+ *
+ * @param buf		The response
+ * @param replies	Receives the replies
+ * @param max		Size of 'replies'
+ * @return The number of lines in the body. If it's greater than 'max',
+ *         only the first 'max' replies are stored.
+ */
+size_t
+server_replies(const char *buf, struct server_reply *replies, size_t max)
+{
+	const char	*cp, *end;
+	size_t		 count = 0;
+
+	if (buf == NULL)
+		return 0;
+
+	/* Skip the headers */
+	for (cp = buf; (cp = strchr(cp, '\n')) != NULL; cp++) {
+		if (cp[1] == '\n') {
+			cp += 2;
+			break;
+		} else if (cp[1] == '\r' && cp[2] == '\n') {
+			cp += 3;
+			break;
+		}
+	}
+	if (cp == NULL)
+		return 0;
+
+	for (; *cp != '\0'; cp = end) {
+		size_t len;
+
+		if ((end = strchr(cp, '\n')) == NULL)
+			end = strchr(cp, '\0');
+		for (len = end - cp; len > 0 && is_space(cp[len - 1]); len--)
+			/* null */;
+		if (*end == '\n')
+			end++;
+		if (len == 0)
+			continue;
+		if (count < max)
+			classify_line(cp, len, &replies[count]);
+		count++;
+	}
+
+	return count;
+}
+
+/**
+ * Get the name of a response code, i.e. the response itself
+ */
+const char *
+response_code_name(response_code_t code)
+{
+	switch (code) {
+	case CODE_GOOD:
+		return "good";
+	case CODE_NOCHG:
+		return "nochg";
+	case CODE_NOHOST:
+		return "nohost";
+	case CODE_BADAUTH:
+		return "badauth";
+	case CODE_BADAGENT:
+		return "badagent";
+	case CODE_NOTDONATOR:
+		return "!donator";
+	case CODE_ABUSE:
+		return "abuse";
+	case CODE_EMERG:
+		return "911";
+	case CODE_UNKNOWN:
+		break;
+	}
+	return "unknown";
+}
+
+/**
+ * Build an update request for a host, without the empty line that
+ * ends it
+ *
+ * @param a		The arena to build it in
+ * @param which_host	Host to update
+ * @param to_ip		The IP address to update to, or "WAN_address"
+ *			for the address that the request comes from
+ * @return The request, or NULL if the credentials are too long
+ */
+char *
+update_request(struct arena *a, const char *which_host, const char *to_ip)
+{
+	char		 auth[500] = { '\0' };
+	char		*unp;
+	int		 ret;
+	struct arena_mark
+			 m = arena_save(a);
+
+	unp = arena_printf(a, "%s:%s", setting("username"),
+	    setting("password"));
+	ret = b64_encode((uint8_t *) unp, strlen(unp), auth, sizeof auth);
+	arena_restore(a, m);
+	if (ret < 0)
+		return NULL;
+
+	if (strings_match(to_ip, "WAN_address")) {
+		return arena_printf(a, "GET %s?hostname=%s HTTP/1.0\r\n"
+		    "Host: %s\r\n"
+		    "Authorization: Basic %s\r\n"
+		    "User-Agent: %s/%s %s",
+		    UPDATE_SCRIPT, which_host, setting("sp_hostname"), auth,
+		    g_programName, g_programVersion, g_maintainerEmail);
+	}
+	return arena_printf(a, "GET %s?hostname=%s&myip=%s HTTP/1.0\r\n"
+	    "Host: %s\r\n"
+	    "Authorization: Basic %s\r\n"
+	    "User-Agent: %s/%s %s",
+	    UPDATE_SCRIPT, which_host, to_ip, setting("sp_hostname"), auth,
+	    g_programName, g_programVersion, g_maintainerEmail);
+}
+
+/**
+ * Get the address in the response of an IP lookup server, i.e. its
+ * last line
+ *
+ * @param buf		The response. Trailing whitespace is deleted.
+ * @param reason	Receives the reason if there's no address
+ * @return The address, or NULL if the last line isn't an IPv4 address
+ */
+const char *
+lookup_response(char *buf, const char **reason)
+{
+	unsigned char	 nw_addr[sizeof(struct in_addr)];
+	const char	*cp;
+
+	if ((cp = strrchr(trim(buf), '\n')) == NULL) {
+		*reason = "cannot locate last occurrance of a newline";
+		return NULL;
+	} else if (inet_pton(AF_INET, ++cp, nw_addr) != 1) {
+		*reason = "bogus ipv4 address";
+		return NULL;
+	}
+	return cp;
+}
@@ -0,0 +1,43 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <stddef.h>
+
+#include "arena.h"
+#include "ducdef.h"
+
+/*
+ * The update protocol of the service provider: the update request
+ * and the response codes. And the response of the IP lookup servers.
+ */
+typedef enum {
+	CODE_GOOD,
+	CODE_NOCHG,
+	CODE_NOHOST,
+	CODE_BADAUTH,
+	CODE_BADAGENT,
+	CODE_NOTDONATOR,
+	CODE_ABUSE,
+	CODE_EMERG,
+	CODE_UNKNOWN
+} response_code_t;
+
+/*
+ * A line of the response of the server. 'addr' points into the
+ * response and isn't null-terminated.
+ */
+struct server_reply {
+	response_code_t	 code;
+	const char	*addr;		/**< NULL if there's none */
+	size_t		 addr_len;
+};
+
+__DUC_BEGIN_DECLS
+char		*update_request(struct arena *, const char *, const char *);
+const char	*lookup_response(char *, const char **);
+const char	*response_code_name(response_code_t);
+response_code_t	 server_response(const char *);
+size_t		 server_replies(const char *, struct server_reply *, size_t);
+__DUC_END_DECLS
+
+#endif
@@ -25,6 +25,7 @@
 #include <stdio.h>
 #include <unistd.h>
 
+#include "base64.h"
 #include "colors.h"
 #include "log.h"
 #include "settings.h"
@@ -73,6 +74,10 @@ static struct config_default_values_tag {
 	  TYPE_INTEGER,
 	  "1800",
 	  NULL, UPDATE_INTERVAL_SECONDS_DESC },
+	{ "update_workers",
+	  TYPE_INTEGER,
+	  "1",
+	  NULL, UPDATE_WORKERS_DESC },
 	{ "primary_ip_lookup_srv",
 	  TYPE_STRING,
 	  "ip1.dynupdate.no-ip.com",
@@ -85,6 +90,22 @@ static struct config_default_values_tag {
 	  TYPE_BOOLEAN,
 	  "YES",
 	  NULL, FORCE_UPDATE_DESC },
+	{ "log_repeat_window_seconds",
+	  TYPE_INTEGER,
+	  "3600",
+	  NULL, LOG_REPEAT_WINDOW_SECONDS_DESC },
+	{ "tls_ca_file",
+	  TYPE_STRING,
+	  "",
+	  NULL, TLS_CA_FILE_DESC },
+	{ "tls_ca_dir",
+	  TYPE_STRING,
+	  "",
+	  NULL, TLS_CA_DIR_DESC },
+	{ "tls_spki_pins",
+	  TYPE_STRING,
+	  "",
+	  NULL, TLS_SPKI_PINS_DESC },
 };
 
 static const size_t CDV_AR_SZ = nitems(config_default_values);
@@ -240,6 +261,25 @@ get_answer(const char *desc, enum setting_type type, const char *defaultAnswer)
 	return answer;
 }
 
+/**
+ * Get the name and the custom value of a setting by its index. The
+ * custom value is null unless the setting has been customized.
+ *
+ * @param idx		Index
+ * @param name		Receives the setting name
+ * @param custom_val	Receives the custom value
+ * @return false if the index is out of range
+ */
+bool
+setting_by_index(size_t idx, const char **name, const char **custom_val)
+{
+	if (idx >= CDV_AR_SZ)
+		return false;
+	*name = config_default_values[idx].setting_name;
+	*custom_val = config_default_values[idx].custom_val;
+	return true;
+}
+
 /**
  * Lookup a setting. If a null pointer is passed, or if a setting
  * isn't found, it returns an empty string.
@@ -322,7 +362,7 @@ is_ip_addr_ok(const char **reason)
 }
 
 static bool
-is_hostname_ok(const char *host, const char **reason)
+is_hostname_ok_n(const char *host, size_t len, const char **reason)
 {
 	const char host_chars[] =
 	    "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
@@ -330,15 +370,15 @@ is_hostname_ok(const char *host, const char **reason)
 	    "0123456789-.:";
 	const size_t host_maxlen = 255;
 
-	if (strings_match(host, "")) {
+	if (len == 0) {
 		*reason = "empty setting";
 		return false;
-	} else if (strlen(host) > host_maxlen) {
+	} else if (len > host_maxlen) {
 		*reason = "name too long";
 		return false;
 	} else {
-		for (const char *cp = host; *cp; cp++) {
-			if (strchr(host_chars, *cp) == NULL) {
+		for (const char *cp = host; cp < &host[len]; cp++) {
+			if (*cp == '\0' || strchr(host_chars, *cp) == NULL) {
 				*reason = "invalid chars found!";
 				return false;
 			}
@@ -349,6 +389,55 @@ is_hostname_ok(const char *host, const char **reason)
 	return true;
 }
 
+static bool
+is_hostname_ok(const char *host, const char **reason)
+{
+	return is_hostname_ok_n(host, strlen(host), reason);
+}
+
+/*
+ * Check every host in the setting 'hostname', i.e. the vertical bar
+ * separated list of hosts to be updated. Empty entries are skipped.
+ * Returns the number of errors and stores the number of hosts in
+ * 'n_hosts'.
+ */
+static size_t
+check_host_list(size_t *n_hosts)
+{
+	const char	*reason = "";
+	const char	*start = setting("hostname");
+	const int	 print_maxlen = 64;
+	size_t		 errors = 0;
+
+	*n_hosts = 0;
+
+	while (*start) {
+		const size_t len = strcspn(start, "|");
+
+		if (len > 0) {
+			*n_hosts += 1;
+
+			if (!is_hostname_ok_n(start, len, &reason)) {
+				log_warn(0, "is_hostname_ok: hostname: "
+				    "host %zu (%.*s): %s", *n_hosts,
+				    (len > (size_t) print_maxlen ? print_maxlen :
+				    (int) len), start, reason);
+				errors++;
+			}
+		}
+
+		start += len;
+		if (*start == '|')
+			start++;
+	}
+
+	if (*n_hosts == 0) {
+		log_warn(0, "error: no hostnames to update");
+		errors++;
+	}
+	return errors;
+}
+
 static bool
 is_port_ok(void)
 {
@@ -363,37 +452,128 @@ is_port_ok(void)
 	return false;
 }
 
+/*
+ * Check the settings of the verification of the service provider: the
+ * CA file and directory must exist, and every pin in the vertical bar
+ * separated list 'tls_spki_pins' must be a base64 encoded SHA-256
+ * hash. Returns the number of errors.
+ */
+static size_t
+check_tls_settings(void)
+{
+	const char	*ca_dir = setting("tls_ca_dir");
+	const char	*ca_file = setting("tls_ca_file");
+	const char	*start = setting("tls_spki_pins");
+	size_t		 errors = 0, n_pins = 0;
+
+	if (!strings_match(ca_file, "") && !is_regularFile(ca_file)) {
+		log_warn(0, "error: tls_ca_file: %s: not a regular file",
+		    ca_file);
+		errors++;
+	}
+	if (!strings_match(ca_dir, "") && !is_directory(ca_dir)) {
+		log_warn(0, "error: tls_ca_dir: %s: not a directory", ca_dir);
+		errors++;
+	}
+
+	while (*start) {
+		const size_t	len = strcspn(start, "|");
+		char		pin[SPKI_PIN_LEN + 1];
+		uint8_t		hash[SPKI_PIN_LEN];
+
+		if (len > 0) {
+			n_pins++;
+			(void) strlcpy(pin, start, (len < sizeof pin ? len + 1 :
+			    sizeof pin));
+
+			if (len != SPKI_PIN_LEN ||
+			    b64_decode(pin, hash, sizeof hash) != 32) {
+				log_warn(0, "error: tls_spki_pins: pin %zu: "
+				    "not a base64 encoded SHA-256 hash",
+				    n_pins);
+				errors++;
+			}
+		}
+
+		start += len;
+		if (*start == '|')
+			start++;
+	}
+	return errors;
+}
+
 /**
- * Check some settings strictly. That is validate that certain
- * settings are OK.
+ * Validate the settings and report every setting that isn't OK.
+ *
+ * @param n_hosts If non-null: receives the number of hosts to update
+ * @return The number of errors
  */
-void
-check_some_settings_strictly(void)
+size_t
+validate_settings(size_t *n_hosts)
 {
 	const char	*reason = "";
 	const char	*password = setting("password");
 	const char	*username = setting("username");
 	const size_t	 password_maxlen = 120;
 	const size_t	 username_maxlen = 50;
+	size_t		 errors, hosts;
 
-	if (strings_match(username, "") || strings_match(password, ""))
-		fatal(0, "error: empty username nor password");
-	else if (strlen(username) > username_maxlen)
-		fatal(0, "error: username too long. max=%zu", username_maxlen);
-	else if (strlen(password) > password_maxlen)
-		fatal(0, "error: password too long. max=%zu", password_maxlen);
-	else if (!is_ip_addr_ok(&reason))
-		fatal(0, "is_ip_addr_ok: error: %s", reason);
-	else if (!is_hostname_ok(setting("sp_hostname"), &reason))
-		fatal(0, "is_hostname_ok: sp_hostname: %s", reason);
-	else if (!is_port_ok())
-		fatal(0, "error: bogus port number");
-	else if (!is_hostname_ok(setting("primary_ip_lookup_srv"), &reason))
-		fatal(0, "is_hostname_ok: primary_ip_lookup_srv: %s", reason);
-	else if (!is_hostname_ok(setting("backup_ip_lookup_srv"), &reason))
-		fatal(0, "is_hostname_ok: backup_ip_lookup_srv: %s", reason);
-	else
-		return;
+	errors = check_host_list(&hosts);
+	if (n_hosts)
+		*n_hosts = hosts;
+
+	if (strings_match(username, "") || strings_match(password, "")) {
+		log_warn(0, "error: empty username nor password");
+		errors++;
+	}
+	if (strlen(username) > username_maxlen) {
+		log_warn(0, "error: username too long. max=%zu",
+		    username_maxlen);
+		errors++;
+	}
+	if (strlen(password) > password_maxlen) {
+		log_warn(0, "error: password too long. max=%zu",
+		    password_maxlen);
+		errors++;
+	}
+	if (!is_ip_addr_ok(&reason)) {
+		log_warn(0, "is_ip_addr_ok: error: %s", reason);
+		errors++;
+	}
+	if (!is_hostname_ok(setting("sp_hostname"), &reason)) {
+		log_warn(0, "is_hostname_ok: sp_hostname: %s", reason);
+		errors++;
+	}
+	if (!is_port_ok()) {
+		log_warn(0, "error: bogus port number");
+		errors++;
+	}
+	if (!is_hostname_ok(setting("primary_ip_lookup_srv"), &reason)) {
+		log_warn(0, "is_hostname_ok: primary_ip_lookup_srv: %s",
+		    reason);
+		errors++;
+	}
+	if (!is_hostname_ok(setting("backup_ip_lookup_srv"), &reason)) {
+		log_warn(0, "is_hostname_ok: backup_ip_lookup_srv: %s",
+		    reason);
+		errors++;
+	}
+	errors += check_tls_settings();
+
+	return errors;
+}
+
+/**
+ * Check some settings strictly. That is validate that certain
+ * settings are OK.
+ */
+void
+check_some_settings_strictly(void)
+{
+	size_t errors;
+
+	if ((errors = validate_settings(NULL)) > 0)
+		fatal(0, "%s: %zu invalid setting(s)", __func__, errors);
 }
 
 /**
@@ -466,7 +646,17 @@ is_recognized_setting(const char *setting_name)
 	return false;
 }
 
-static int
+/**
+ * Install a custom value for a setting. The value is checked against
+ * the type of the setting and copied.
+ *
+ * @param setting_name	Setting name
+ * @param value		Value
+ * @return 0 on success, EBUSY if the setting is already customized,
+ *         EINVAL if the value is invalid, and ENOENT if the setting is
+ *         unrecognized
+ */
+int
 install_setting(const char *setting_name, const char *value)
 {
 	if (setting_name == NULL || value == NULL)
@@ -496,7 +686,7 @@ install_setting(const char *setting_name, const char *value)
 void
 read_config_file(const char *path)
 {
-	FILE *fp = NULL;
+	long int err_line = 0;
 
 	log_assert_arg_nonnull("read_config_file", "path", path);
 
@@ -505,19 +695,71 @@ read_config_file(const char *path)
 	} else if (!is_regularFile(path)) {
 		fatal(0, "%s: either the config file is nonexistent"
 		    "  --  or it isn't a regular file", __func__);
-	} else if ((fp = fopen(path, "r")) == NULL) {
-		fatal(errno, "%s: fopen", __func__);
+	} else if (Interpreter_processAllLines(path, is_recognized_setting,
+	    install_setting, &err_line) != INTERP_OK) {
+		fatal(0, "%s: %s: config file rejected (line %ld)", __func__,
+		    path, err_line);
 	}
 
-	Interpreter_processAllLines(fp, path, is_recognized_setting,
-	    install_setting);
+	g_conf_read = true;
+}
 
-	if (feof(fp))
-		fclose(fp);
-	else if (ferror(fp))
-		fatal(0, "%s: %s", __func__, g_fgets_nullret_err1);
-	else
-		fatal(0, "%s: %s", __func__, g_fgets_nullret_err2);
+/**
+ * Read a configuration file like read_config_file() but report every
+ * error, instead of stopping at the first one, and don't abort.
+ *
+ * @param path Path to the file
+ * @return The number of errors
+ */
+size_t
+test_config_file(const char *path)
+{
+	size_t errors;
 
-	g_conf_read = true;
+	log_assert_arg_nonnull("test_config_file", "path", path);
+
+	Interpreter_setKeepGoing(true);
+	(void) Interpreter_processAllLines(path, is_recognized_setting,
+	    install_setting, NULL);
+	Interpreter_setKeepGoing(false);
+	errors = Interpreter_errorCount();
+
+	return errors;
+}
+
+/**
+ * Reread a configuration file, e.g. on request of a control client.
+ * Every error is reported. If the file has errors, or its settings
+ * don't validate, the settings in use are kept.
+ *
+ * @param path Path to the file
+ * @return The number of errors
+ */
+size_t
+reload_config_file(const char *path)
+{
+	char	*saved[nitems(config_default_values)];
+	size_t	 errors;
+	size_t	 i = 0;
+
+	log_assert_arg_nonnull("reload_config_file", "path", path);
+
+	FOREACH_CDV() {
+		saved[i++] = cdv->custom_val;
+		cdv->custom_val = NULL;
+	}
+
+	if ((errors = test_config_file(path)) == 0)
+		errors = validate_settings(NULL);
+
+	i = 0;
+	if (errors > 0) {
+		destroy_config_custom_values();
+		FOREACH_CDV()
+			cdv->custom_val = saved[i++];
+	} else {
+		FOREACH_CDV()
+			free_not_null(saved[i++]);
+	}
+	return errors;
 }
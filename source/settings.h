@@ -3,6 +3,8 @@
 
 #include "interpreter.h"
 
+#define SPKI_PIN_LEN 44	/* A base64 encoded SHA-256 hash */
+
 struct integer_context {
 	char *setting_name;
 	long int lo_limit;
@@ -14,13 +16,18 @@ __DUC_BEGIN_DECLS
 extern bool g_conf_read;
 
 bool		 setting_bool(const char *, const bool);
+bool		 setting_by_index(size_t, const char **, const char **);
 char		*get_answer(const char *, enum setting_type, const char *);
 const char	*setting(const char *);
+int		 install_setting(const char *, const char *);
 long int	 setting_integer(const struct integer_context *);
+size_t		 test_config_file(const char *);
+size_t		 validate_settings(size_t *);
 void		 check_some_settings_strictly(void);
 void		 create_config_file(const char *);
 void		 destroy_config_custom_values(void);
 void		 read_config_file(const char *);
+size_t		 reload_config_file(const char *);
 __DUC_END_DECLS
 
 #endif
@@ -14,14 +14,22 @@
    TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
    PERFORMANCE OF THIS SOFTWARE. */
 
+#include <errno.h>
+#include <fcntl.h>
 #include <signal.h>
+#include <stdlib.h>
+#include <string.h>
 #include <syslog.h>
 #include <unistd.h>
 
 #include "daemonize.h"
+#include "listener.h"
 #include "log.h"
+#include "logfile.h"
 #include "main.h"
+#include "netstats.h"
 #include "network.h"
+#include "pool.h"
 #include "settings.h"
 #include "sig.h"
 
@@ -49,20 +57,64 @@ static struct sig_message_tag {
 #endif
 };
 
-static void
-handle_signals(int signum)
-{
-	program_clean_up();
+/*
+ * A signal that is deferred is recorded in 'exit_signal', and a byte
+ * is written to 'exit_pipe' in order to wake up a poll(2).
+ */
+static volatile sig_atomic_t	exit_deferred = 0;
+static volatile sig_atomic_t	exit_signal = 0;
+static int			exit_pipe[2] = { -1, -1 };
 
+static struct sig_message_tag *
+sig_lookup(int signum)
+{
 	for (struct sig_message_tag *ssp = &sig_message[0];
 	    ssp < &sig_message[nitems(sig_message)];
 	    ssp++) {
-		if (ssp->num == signum) {
-			log_warn(0, "Received signal %d (%s): %s", ssp->num,
-			    ssp->num_str, ssp->msg);
-		}
+		if (ssp->num == signum)
+			return ssp;
 	}
+	return NULL;
+}
 
+/*
+ * Async-signal-safe
+ */
+static void
+write_stderr(const char *str)
+{
+	(void) write(STDERR_FILENO, str, strlen(str));
+}
+
+/*
+ * Only async-signal-safe functions may be called from here. A
+ * termination signal that arrives while the update cycle runs is
+ * deferred, and the program exits from the main loop, where it can be
+ * cleaned up. Any other signal terminates the program at once.
+ */
+static void
+handle_signals(int signum)
+{
+	const int errno_save = errno;
+	struct sig_message_tag *ssp;
+
+	if ((ssp = sig_lookup(signum)) == NULL) {
+		_exit(1);
+	} else if ((signum == SIGINT || signum == SIGTERM) &&
+	    exit_deferred) {
+		exit_signal = signum;
+		if (exit_pipe[1] != -1)
+			(void) write(exit_pipe[1], "", 1);
+		errno = errno_save;
+		return;
+	}
+
+	write_stderr(g_programName);
+	write_stderr(": Received signal ");
+	write_stderr(ssp->num_str);
+	write_stderr(": ");
+	write_stderr(ssp->msg);
+	write_stderr("\n");
 	_exit(1);
 }
 
@@ -83,20 +135,92 @@ block_signals(void)
 		fatal(errno, "%s: pthread_sigmask", __func__);
 }
 
+/**
+ * Defer the termination signals from now on: see handle_signals().
+ * The main loop has to check for them with sig_exit_if_requested(),
+ * and poll sig_exit_fd() when it waits.
+ */
+void
+sig_defer_exit(void)
+{
+	if (exit_pipe[0] == -1) {
+		if (pipe(exit_pipe) != 0)
+			fatal(errno, "%s: pipe", __func__);
+		for (int i = 0; i < 2; i++) {
+			(void) fcntl(exit_pipe[i], F_SETFD, FD_CLOEXEC);
+			(void) fcntl(exit_pipe[i], F_SETFL, O_NONBLOCK);
+		}
+	}
+	exit_deferred = 1;
+}
+
+/**
+ * @return A descriptor that becomes readable when a termination signal
+ *         has been deferred, or -1
+ */
+int
+sig_exit_fd(void)
+{
+	return exit_pipe[0];
+}
+
+/**
+ * @return True if a termination signal has been deferred
+ */
+bool
+sig_exit_pending(void)
+{
+	return (exit_signal != 0);
+}
+
+/**
+ * Exit if a termination signal has been deferred. The program is then
+ * cleaned up by program_clean_up(), which is registered with atexit().
+ */
+void
+sig_exit_if_requested(void)
+{
+	const struct sig_message_tag *ssp;
+
+	if (exit_signal == 0)
+		return;
+	if ((ssp = sig_lookup(exit_signal)) != NULL) {
+		log_warn(0, "Received signal %d (%s): %s", ssp->num,
+		    ssp->num_str, ssp->msg);
+	}
+	exit(1);
+}
+
 /**
  * This function is called whenever the program exits, no matter if it
- * was an error that caused it, or if the program exited normally.
+ * was an error that caused it, or if the program exited normally. It
+ * runs once and never in a signal handler.
  */
 void
 program_clean_up(void)
 {
+	static bool cleaned_up = false;
+
+	if (cleaned_up)
+		return;
+	cleaned_up = true;
+
+	if (g_conf_read)
+		netstats_dump();
+	log_repeats_flush(true);
+	log_async_stop();
+	/* The workers have connections that use the SSL_CTX */
+	if (pool_worker_id() == 0)
+		pool_stop();
 	net_deinit();
+	listener_close_all();
 	destroy_config_custom_values();
 
 	if (g_conf_read)
 		log_msg("%s %s has exited", g_programName, g_programVersion);
 	if (g_lockfile_fd != -1)
 		close(g_lockfile_fd);
+	logfile_close();
 	if (g_log_to_syslog)
 		closelog();
 }
@@ -7,6 +7,11 @@ __DUC_BEGIN_DECLS
 void	block_signals(void);
 void	program_clean_up(void);
 int	sighand_init(void);
+
+void	sig_defer_exit(void);
+int	sig_exit_fd(void);
+bool	sig_exit_pending(void);
+void	sig_exit_if_requested(void);
 __DUC_END_DECLS
 
 #endif
@@ -20,6 +20,7 @@
 #include <ctype.h>
 #include <stdint.h>
 #include <termios.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "log.h"
@@ -163,6 +164,21 @@ size_product(const size_t elt_count, const size_t elt_size)
 	return (elt_count * elt_size);
 }
 
+/**
+ * Get the time of a monotonic clock
+ *
+ * @return The time in nanoseconds
+ */
+uint64_t
+monotonic_ns(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0)
+		return 0;
+	return ((uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec);
+}
+
 /**
  * Toggle echo ON/OFF.
  *
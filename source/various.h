@@ -3,6 +3,7 @@
 
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <string.h> /* strcmp */
 
 #include "ducdef.h" /* PTR_ARGS_NONNULL etc */
@@ -17,8 +18,10 @@ bool	 is_numeric(const char *);
 bool	 is_regularFile(const char *);
 char	*strToLower(char *);
 char	*trim(char *);
-int	 my_vasprintf(char **ret, const char *format, va_list);
+int	 my_vasprintf(char **ret, const char *format, va_list)
+	    VPRINTFLIKE(2);
 size_t	 size_product(const size_t elt_count, const size_t elt_size);
+uint64_t monotonic_ns(void);
 void	 toggle_echo(on_off_t);
 __DUC_END_DECLS
 
@@ -0,0 +1,109 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <stdint.h>
+#include <string.h>
+
+#include "arena.h"
+
+static void
+allocatesAligned_test(void **state)
+{
+	struct arena	 a = { 0 };
+	char		*p, *q;
+
+	(void) state;
+	p = arena_alloc(&a, 3);
+	q = arena_alloc(&a, 8);
+	assert_true(q > p);
+	assert_int_equal((uintptr_t) p % _Alignof(max_align_t), 0);
+	assert_int_equal((uintptr_t) q % _Alignof(max_align_t), 0);
+	assert_int_equal(a.chunks, 1);
+	assert_string_equal(arena_strdup(&a, "host"), "host");
+	assert_string_equal(arena_printf(&a, "%s=%d", "port", 8245),
+	    "port=8245");
+	assert_int_equal(((char *) arena_calloc(&a, 10, 10))[99], 0);
+	arena_destroy(&a);
+	assert_null(a.first);
+}
+
+static void
+growsLastAllocationInPlace_test(void **state)
+{
+	struct arena	 a = { 0 };
+	char		*p, *q;
+
+	(void) state;
+	p = arena_printf(&a, "GET /");
+	q = arena_realloc(&a, p, 6, 10);
+	assert_true(p == q);
+	assert_string_equal(q, "GET /");
+
+	(void) arena_alloc(&a, 1);
+	q = arena_realloc(&a, p, 10, 20);
+	assert_true(p != q);
+	assert_string_equal(q, "GET /");
+	arena_destroy(&a);
+}
+
+static void
+spillsIntoNewChunks_test(void **state)
+{
+	struct arena	 a = { 0 };
+	char		 big[ARENA_CHUNK_SIZE * 2];
+	char		*str;
+
+	(void) state;
+	(void) memset(big, 'x', sizeof big - 1);
+	big[sizeof big - 1] = '\0';
+
+	(void) arena_alloc(&a, ARENA_CHUNK_SIZE - 10);
+	str = arena_printf(&a, "%s", big);
+	assert_int_equal(strlen(str), sizeof big - 1);
+	assert_int_equal(a.chunks, 2);
+	(void) arena_alloc(&a, ARENA_CHUNK_SIZE);
+	assert_int_equal(a.chunks, 3);
+	arena_destroy(&a);
+}
+
+static void
+reusesChunksAfterReset_test(void **state)
+{
+	struct arena		a = { 0 };
+	struct arena_mark	m;
+	size_t			size;
+	void			*p;
+
+	(void) state;
+	for (int cycle = 0; cycle < 100; cycle++) {
+		p = arena_alloc(&a, 100);
+		m = arena_save(&a);
+		for (int i = 0; i < 50; i++)
+			(void) arena_alloc(&a, 1000);
+		arena_restore(&a, m);
+		assert_true(arena_alloc(&a, 100) ==
+		    (char *) p + 100 + (-100 & (_Alignof(max_align_t) - 1)));
+		arena_reset(&a);
+		assert_int_equal(a.used, 0);
+		if (cycle == 0)
+			size = a.size;
+	}
+	assert_int_equal(a.size, size);
+	assert_true(a.peak >= 50 * 1000);
+	arena_destroy(&a);
+}
+
+int
+main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(allocatesAligned_test),
+		cmocka_unit_test(growsLastAllocationInPlace_test),
+		cmocka_unit_test(spillsIntoNewChunks_test),
+		cmocka_unit_test(reusesChunksAfterReset_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,175 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <stdint.h>
+#include <string.h>
+
+#include "b64_simd.h"
+#include "base64.h"
+
+#define MAX_LEN 300
+
+static const char *vectors[][2] = {
+	{ "",       ""         },
+	{ "f",      "Zg=="     },
+	{ "fo",     "Zm8="     },
+	{ "foo",    "Zm9v"     },
+	{ "foob",   "Zm9vYg==" },
+	{ "fooba",  "Zm9vYmE=" },
+	{ "foobar", "Zm9vYmFy" },
+};
+
+static void
+fill(uint8_t *buf, size_t len, uint32_t seed)
+{
+	for (size_t i = 0; i < len; i++) {
+		seed = seed * 1103515245 + 12345;
+		buf[i] = (uint8_t) (seed >> 16);
+	}
+}
+
+/*
+ * Decode with every supported instruction set and check that the
+ * result is that of the scalar code
+ */
+static void
+assertDecodesLikeScalar(const char *src, size_t targsize)
+{
+	uint8_t	expected[MAX_LEN * 2];
+	uint8_t	out[MAX_LEN * 2];
+	int	ret;
+
+	assert_true(targsize <= sizeof out);
+	ret = b64_decode_isa(B64_ISA_SCALAR, src, expected, targsize);
+
+	for (enum b64_isa isa = B64_ISA_SSSE3; isa <= b64_isa_supported();
+	    isa++) {
+		assert_int_equal(b64_decode_isa(isa, src, out, targsize), ret);
+		if (ret > 0)
+			assert_memory_equal(out, expected, ret);
+	}
+}
+
+static void
+knownVectors_test(void **state)
+{
+	char	encoded[20];
+	uint8_t	decoded[20];
+
+	(void) state;
+
+	for (size_t i = 0; i < sizeof vectors / sizeof vectors[0]; i++) {
+		const size_t len = strlen(vectors[i][0]);
+
+		assert_int_equal(b64_encode((const uint8_t *) vectors[i][0],
+		    len, encoded, sizeof encoded), strlen(vectors[i][1]));
+		assert_string_equal(encoded, vectors[i][1]);
+		assert_int_equal(b64_decode(vectors[i][1], decoded,
+		    sizeof decoded), len);
+		assert_memory_equal(decoded, vectors[i][0], len);
+	}
+}
+
+static void
+encodeMatchesScalar_test(void **state)
+{
+	char	expected[MAX_LEN * 2];
+	char	out[MAX_LEN * 2];
+	uint8_t	src[MAX_LEN];
+
+	(void) state;
+
+	for (size_t len = 0; len <= MAX_LEN; len++) {
+		const size_t needed = (len + 2) / 3 * 4 + 1;
+		const size_t sizes[] = { needed - 1, needed, needed + 1,
+		    needed + 31, needed / 2 };
+
+		fill(src, len, (uint32_t) len);
+		for (size_t i = 0; i < sizeof sizes / sizeof sizes[0]; i++) {
+			const int ret = b64_encode_isa(B64_ISA_SCALAR, src,
+			    len, expected, sizes[i]);
+
+			for (enum b64_isa isa = B64_ISA_SSSE3;
+			    isa <= b64_isa_supported(); isa++) {
+				assert_int_equal(b64_encode_isa(isa, src, len,
+				    out, sizes[i]), ret);
+				if (ret >= 0)
+					assert_string_equal(out, expected);
+			}
+		}
+	}
+}
+
+static void
+decodeMatchesScalar_test(void **state)
+{
+	char	encoded[MAX_LEN * 2];
+	uint8_t	src[MAX_LEN];
+
+	(void) state;
+
+	for (size_t len = 0; len <= MAX_LEN; len++) {
+		fill(src, len, (uint32_t) len + 1);
+		assert_true(b64_encode(src, len, encoded, sizeof encoded) >=
+		    0);
+
+		assertDecodesLikeScalar(encoded, len);
+		assertDecodesLikeScalar(encoded, len + 1);
+		assertDecodesLikeScalar(encoded, len + 2);
+		assertDecodesLikeScalar(encoded, len + 33);
+		assertDecodesLikeScalar(encoded, len / 2);
+	}
+}
+
+/*
+ * A character that isn't in the alphabet, at any position, is left to
+ * the scalar code: whitespace is skipped, and padding, the null and
+ * invalid characters end the decoding
+ */
+static void
+decodeStopsAtNonAlphabet_test(void **state)
+{
+	char		encoded[MAX_LEN * 2];
+	char		modified[MAX_LEN * 2];
+	const char	others[] = { ' ', '\n', '\t', '=', '!', '-', '_', '@',
+			    '\x80', '\xff', '\0' };
+	uint8_t		src[150];
+	size_t		len;
+
+	(void) state;
+
+	fill(src, sizeof src, 42);
+	assert_int_equal(b64_encode(src, sizeof src, encoded,
+	    sizeof encoded), 200);
+	len = strlen(encoded);
+
+	for (size_t pos = 0; pos < len; pos++) {
+		for (size_t i = 0; i < sizeof others; i++) {
+			(void) memcpy(modified, encoded, len + 1);
+			modified[pos] = others[i];
+			assertDecodesLikeScalar(modified, sizeof src + 16);
+		}
+
+		/* Inserted whitespace */
+		(void) memcpy(modified, encoded, pos);
+		modified[pos] = ' ';
+		(void) memcpy(&modified[pos + 1], &encoded[pos],
+		    len - pos + 1);
+		assertDecodesLikeScalar(modified, sizeof src + 16);
+	}
+}
+
+int
+main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(knownVectors_test),
+		cmocka_unit_test(encodeMatchesScalar_test),
+		cmocka_unit_test(decodeMatchesScalar_test),
+		cmocka_unit_test(decodeStopsAtNonAlphabet_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,122 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <sys/stat.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "confcache.h"
+#include "settings.h"
+
+static char tmpdir[] = "/tmp/educ-test.XXXXXX";
+static char conf_path[100];
+static char image_path[120];
+
+static void
+writeConfig(const char *username)
+{
+	FILE *fp;
+
+	assert_non_null(fp = fopen(conf_path, "w"));
+	fprintf(fp, "username = \"%s\";\npassword = \"secret\";\n"
+	    "hostname = \"host.example.com\";\n", username);
+	assert_int_equal(fclose(fp), 0);
+}
+
+static void
+readConfig(void)
+{
+	destroy_config_custom_values();
+	g_conf_read = false;
+	read_config_cache(conf_path);
+}
+
+static void
+createsAndUsesImage_test(void **state)
+{
+	struct stat sb1, sb2;
+
+	(void) state;
+
+	writeConfig("first");
+	readConfig();
+	assert_int_equal(stat(image_path, &sb1), 0);
+	assert_string_equal(setting("username"), "first");
+
+	/* A rebuilt image would have been renamed into place. */
+	readConfig();
+	assert_int_equal(stat(image_path, &sb2), 0);
+	assert_int_equal(sb1.st_ino, sb2.st_ino);
+	assert_string_equal(setting("username"), "first");
+	assert_string_equal(setting("hostname"), "host.example.com");
+}
+
+static void
+rebuildsImageWhenConfigChanges_test(void **state)
+{
+	(void) state;
+
+	writeConfig("first");
+	readConfig();
+	/* Same size and most likely the same mtime: only the hash differs */
+	writeConfig("other");
+	readConfig();
+	assert_string_equal(setting("username"), "other");
+}
+
+static void
+rejectsDamagedImage_test(void **state)
+{
+	FILE *fp;
+
+	(void) state;
+
+	writeConfig("first");
+	readConfig();
+
+	assert_non_null(fp = fopen(image_path, "r+"));
+	assert_int_equal(fseek(fp, -3, SEEK_END), 0);
+	assert_int_equal(fputc('X', fp), 'X');
+	assert_int_equal(fclose(fp), 0);
+
+	readConfig();
+	assert_string_equal(setting("username"), "first");
+}
+
+static int
+setup(void **state)
+{
+	(void) state;
+	if (mkdtemp(tmpdir) == NULL)
+		return -1;
+	(void) snprintf(conf_path, sizeof conf_path, "%s/test.conf", tmpdir);
+	(void) snprintf(image_path, sizeof image_path, "%s%s", conf_path,
+	    CONFCACHE_SUFFIX);
+	return 0;
+}
+
+static int
+teardown(void **state)
+{
+	(void) state;
+	destroy_config_custom_values();
+	(void) unlink(image_path);
+	(void) unlink(conf_path);
+	return rmdir(tmpdir);
+}
+
+int
+main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(createsAndUsesImage_test),
+		cmocka_unit_test(rebuildsImageWhenConfigChanges_test),
+		cmocka_unit_test(rejectsDamagedImage_test),
+	};
+
+	return cmocka_run_group_tests(tests, setup, teardown);
+}
@@ -0,0 +1,158 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "control.h"
+#include "log.h"
+#include "settings.h"
+
+static int	update_argc = -1;
+static char	update_args[100];
+
+static void
+hookUpdate(int argc, char *argv[], struct listener_reply *reply)
+{
+	update_argc = argc;
+	update_args[0] = '\0';
+	for (int i = 0; i < argc; i++) {
+		(void) strcat(update_args, argv[i]);
+		(void) strcat(update_args, ",");
+	}
+	reply_printf(reply, "ok\n");
+}
+
+static const struct control_hooks hooks = {
+	.update = hookUpdate,
+	.state  = NULL,
+	.reload = NULL,
+};
+
+/*
+ * Runs a command and returns the reply, which is freed by the next call
+ */
+static const char *
+command(const char *line)
+{
+	static struct listener_reply reply;
+
+	free(reply.data);
+	(void) memset(&reply, 0, sizeof reply);
+	assert_true(g_control_ops.complete(line, strlen(line)));
+	g_control_ops.respond(line, strlen(line), &reply);
+	assert_non_null(reply.data);
+	return reply.data;
+}
+
+/*
+ * The warnings about the settings that are rejected
+ */
+static void
+silenceStderr(void)
+{
+	int fd;
+
+	if ((fd = open("/dev/null", O_WRONLY)) != -1) {
+		(void) dup2(fd, STDERR_FILENO);
+		(void) close(fd);
+	}
+}
+
+static void
+parsesCommandLines_test(void **state)
+{
+	(void) state;
+	control_set_hooks(&hooks);
+
+	assert_false(g_control_ops.complete("upd", 3));
+	assert_string_equal(command("update\n"), "ok\n");
+	assert_int_equal(update_argc, 0);
+	assert_string_equal(command("update  a.example.com\tb\r\n"), "ok\n");
+	assert_int_equal(update_argc, 2);
+	assert_string_equal(update_args, "a.example.com,b,");
+
+	assert_non_null(strstr(command("help\n"), "reload"));
+	assert_string_equal(command("\n"), "error: no command. try "
+	    "\"help\"\n");
+	assert_string_equal(command("bogus x\n"), "error: unknown command "
+	    "\"bogus\". try \"help\"\n");
+	assert_string_equal(command("state\n"), "error: not available\n");
+	assert_non_null(strstr(command("stats\n"), "cycles_total: 0\n"));
+	assert_non_null(strstr(command("stats\n"), "\narena: used=0 "));
+}
+
+static void
+togglesDebugMode_test(void **state)
+{
+	(void) state;
+	g_debug_mode = false;
+	assert_string_equal(command("debug\n"), "debug mode on\n");
+	assert_true(g_debug_mode);
+	assert_string_equal(command("debug\n"), "debug mode off\n");
+	assert_string_equal(command("debug on\n"), "debug mode on\n");
+	assert_string_equal(command("debug on\n"), "debug mode on\n");
+	assert_string_equal(command("debug off\n"), "debug mode off\n");
+	assert_false(g_debug_mode);
+	assert_string_equal(command("debug maybe\n"), "error: usage: debug "
+	    "[on|off]\n");
+}
+
+static void
+writeConfig(const char *path, const char *host, const char *port)
+{
+	FILE *fp;
+
+	assert_non_null(fp = fopen(path, "w"));
+	fprintf(fp, "username = \"joe\";\npassword = \"secret\";\n"
+	    "hostname = \"%s\";\nport = \"%s\";\n", host, port);
+	assert_int_equal(fclose(fp), 0);
+}
+
+static void
+reloadKeepsSettingsOnError_test(void **state)
+{
+	char path[] = "/tmp/control.XXXXXX";
+	int fd;
+
+	(void) state;
+	assert_true((fd = mkstemp(path)) != -1);
+	(void) close(fd);
+
+	writeConfig(path, "a.example.com", "80");
+	assert_int_equal(reload_config_file(path), 0);
+	assert_string_equal(setting("hostname"), "a.example.com");
+
+	writeConfig(path, "b.example.com", "443");
+	assert_int_equal(reload_config_file(path), 0);
+	assert_string_equal(setting("hostname"), "b.example.com");
+	assert_string_equal(setting("port"), "443");
+
+	writeConfig(path, "c.example.com", "1234");
+	assert_int_equal(reload_config_file(path), 1);
+	assert_string_equal(setting("hostname"), "b.example.com");
+	assert_string_equal(setting("port"), "443");
+
+	assert_int_equal(unlink(path), 0);
+	assert_true(reload_config_file(path) > 0);
+	assert_string_equal(setting("hostname"), "b.example.com");
+	destroy_config_custom_values();
+}
+
+int
+main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(parsesCommandLines_test),
+		cmocka_unit_test(togglesDebugMode_test),
+		cmocka_unit_test(reloadKeepsSettingsOnError_test),
+	};
+
+	silenceStderr();
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
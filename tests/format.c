@@ -0,0 +1,152 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "format.h"
+
+/*
+ * Format with fmt_printf() and snprintf() and compare
+ */
+#define CHECK(format, ...) do {\
+	char		expected[256], out[256];\
+	struct fmt_buf	f;\
+	int		len;\
+\
+	fmt_init(&f, out, sizeof out, FMT_FIXED, NULL);\
+	len = fmt_printf(&f, format, __VA_ARGS__);\
+	assert_int_equal(len, snprintf(expected, sizeof expected, format,\
+	    __VA_ARGS__));\
+	assert_string_equal(out, expected);\
+	assert_int_equal(f.len, strlen(expected));\
+} while (0)
+
+static void
+matchesSnprintf_test(void **state)
+{
+	(void) state;
+	CHECK("%d %d %d", 0, INT_MIN, INT_MAX);
+	CHECK("%i %u %x", -1, UINT_MAX, 0xdeadbeefU);
+	CHECK("%ld %lu %lx", LONG_MIN, ULONG_MAX, 0x7fL);
+	CHECK("%lld %llu", LLONG_MIN, ULLONG_MAX);
+	CHECK("%zu %zd %zx", SIZE_MAX, (ssize_t) -42, (size_t) 255);
+	CHECK("%s|%c|%%|%.*s", "host", 'x', 3, "example");
+	CHECK("%.*s", 10, "short");
+	CHECK("GET /nic/update?hostname=%s&myip=%s HTTP/1.0", "a.example.com",
+	    "192.0.2.1");
+}
+
+static void
+printsNullString_test(void **state)
+{
+	const char	*null = NULL;
+	char		 out[16];
+	struct fmt_buf	 f;
+
+	(void) state;
+	fmt_init(&f, out, sizeof out, FMT_FIXED, NULL);
+	assert_int_equal(fmt_printf(&f, "[%s]", null), 8);
+	assert_string_equal(out, "[(null)]");
+}
+
+static void
+fallsBackToPrintf_test(void **state)
+{
+	(void) state;
+	CHECK("%5d|%-5s|", 42, "ab");
+	CHECK("%.2f", 3.14159);
+	CHECK("%s %d %08x %s", "before", 1, 0xabcU, "after");
+	CHECK("%p", (void *) 0);
+}
+
+static void
+truncatesFixed_test(void **state)
+{
+	char		buf[8];
+	struct fmt_buf	f;
+
+	(void) state;
+	fmt_init(&f, buf, sizeof buf, FMT_FIXED, NULL);
+	assert_int_equal(fmt_printf(&f, "%s=%d", "port", 8245), 9);
+	assert_true(f.truncated);
+	assert_string_equal(buf, "port=82");
+
+	fmt_init(&f, buf, sizeof buf, FMT_FIXED, NULL);
+	assert_int_equal(fmt_printf(&f, "%5.1f", 123456.0), 8);
+	assert_true(f.truncated);
+	assert_string_equal(buf, "123456.");
+
+	fmt_init(&f, buf, sizeof buf, FMT_FIXED, NULL);
+	assert_int_equal(fmt_printf(&f, "%d", 1234567), 7);
+	assert_false(f.truncated);
+	fmt_write(&f, "8", 1);
+	assert_true(f.truncated);
+	assert_string_equal(buf, "1234567");
+}
+
+static void
+growsOnHeap_test(void **state)
+{
+	char		buf[4];
+	char		big[1000];
+	struct fmt_buf	f;
+
+	(void) state;
+	(void) memset(big, 'x', sizeof big - 1);
+	big[sizeof big - 1] = '\0';
+
+	fmt_init(&f, buf, sizeof buf, FMT_HEAP, NULL);
+	assert_int_equal(fmt_printf(&f, "%s", "ab"), 2);
+	assert_false(f.allocated);
+	assert_int_equal(fmt_printf(&f, "%s%d", big, 7), 1000);
+	assert_true(f.allocated);
+	assert_int_equal(fmt_printf(&f, "%3d", 5), 3);
+	assert_false(f.truncated);
+	assert_int_equal(f.len, 1005);
+	assert_int_equal(strncmp(f.data, "abxxx", 5), 0);
+	assert_string_equal(&f.data[1001], "7  5");
+	free(f.data);
+}
+
+static void
+growsInArena_test(void **state)
+{
+	struct arena	a = { 0 };
+	struct fmt_buf	f;
+	char		*first;
+
+	(void) state;
+	fmt_init(&f, NULL, 0, FMT_ARENA, &a);
+	assert_int_equal(fmt_printf(&f, "%s", "GET /"), 5);
+	first = f.data;
+	for (int i = 0; i < 100; i++)
+		(void) fmt_printf(&f, "%d", i % 10);
+	fmt_write(&f, "\r\n\r\n", 4);
+	assert_true(f.data == first);
+	assert_int_equal(f.len, 109);
+	assert_string_equal(&f.data[103], "89\r\n\r\n");
+	assert_int_equal(a.chunks, 1);
+	arena_destroy(&a);
+}
+
+int
+main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(matchesSnprintf_test),
+		cmocka_unit_test(printsNullString_test),
+		cmocka_unit_test(fallsBackToPrintf_test),
+		cmocka_unit_test(truncatesFixed_test),
+		cmocka_unit_test(growsOnHeap_test),
+		cmocka_unit_test(growsInArena_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
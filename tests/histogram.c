@@ -0,0 +1,70 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "histogram.h"
+
+static void
+bucketsAreContiguous_test(void **state)
+{
+	(void) state;
+	assert_int_equal(hist_bucket_lower(0), 0);
+
+	for (size_t i = 0; i < HIST_BUCKETS - 1; i++) {
+		assert_true(hist_bucket_lower(i) <= hist_bucket_upper(i));
+		assert_int_equal(hist_bucket_upper(i) + 1,
+		    hist_bucket_lower(i + 1));
+		assert_int_equal(hist_bucket(hist_bucket_lower(i)), i);
+		assert_int_equal(hist_bucket(hist_bucket_upper(i)), i);
+	}
+	assert_int_equal(hist_bucket(UINT64_MAX), HIST_BUCKETS - 1);
+}
+
+/*
+ * The width of a bucket is at most 1 / HIST_SUB_BUCKETS of its values
+ */
+static void
+bucketErrorIsBounded_test(void **state)
+{
+	(void) state;
+
+	for (size_t i = HIST_SUB_BUCKETS; i < HIST_BUCKETS - 1; i++) {
+		const uint64_t lower = hist_bucket_lower(i);
+		const uint64_t width = hist_bucket_upper(i) - lower + 1;
+
+		assert_true(width * HIST_SUB_BUCKETS <= lower);
+	}
+}
+
+static void
+estimatesQuantiles_test(void **state)
+{
+	struct histogram h = { 0 };
+
+	(void) state;
+	assert_int_equal(hist_quantile(&h, 0.5), 0);
+
+	for (uint64_t v = 1; v <= 1000; v++)
+		hist_record(&h, v);
+
+	assert_int_equal(h.count, 1000);
+	assert_int_equal(h.sum, 500500);
+	assert_int_equal(h.max, 1000);
+	assert_in_range(hist_quantile(&h, 0.5), 500, 500 * 5 / 4);
+	assert_in_range(hist_quantile(&h, 0.99), 990, 1000);
+	assert_int_equal(hist_quantile(&h, 1.0), 1000);
+	assert_int_equal(hist_quantile(&h, 0.0), 1);
+}
+
+int
+main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(bucketsAreContiguous_test),
+		cmocka_unit_test(bucketErrorIsBounded_test),
+		cmocka_unit_test(estimatesQuantiles_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,404 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "interpreter.h"
+
+static int installed = 0;
+static char install_log[200] = "";
+static char *installed_hostname = NULL;
+static char tmpdir[] = "/tmp/educ-test.XXXXXX";
+
+static bool
+validator(const char *id)
+{
+	(void) id;
+	return true;
+}
+
+static int
+installer(const char *id, const char *arg)
+{
+	(void) id;
+	(void) arg;
+	installed++;
+	return 0;
+}
+
+/*
+ * Like install_setting(): the first assignment of an identifier wins
+ * and any later one fails with EBUSY.
+ */
+static int
+strictInstaller(const char *id, const char *arg)
+{
+	char entry[100];
+
+	(void) snprintf(entry, sizeof entry, " %s=", id);
+	if (strstr(install_log, entry) != NULL)
+		return EBUSY;
+	(void) snprintf(entry, sizeof entry, " %s=%s", id, arg);
+	(void) strncat(install_log, entry,
+	    sizeof install_log - strlen(install_log) - 1);
+	return 0;
+}
+
+static int
+hostnameInstaller(const char *id, const char *arg)
+{
+	if (strcmp(id, "hostname") == 0) {
+		free(installed_hostname);
+		installed_hostname = strdup(arg);
+	}
+	return 0;
+}
+
+static void
+writeFile(const char *name, const char *contents)
+{
+	FILE *fp;
+	char path[100];
+
+	(void) snprintf(path, sizeof path, "%s/%s", tmpdir, name);
+	assert_non_null(fp = fopen(path, "w"));
+	assert_true(fputs(contents, fp) >= 0);
+	assert_int_equal(fclose(fp), 0);
+}
+
+static void
+removeFile(const char *name)
+{
+	char path[100];
+
+	(void) snprintf(path, sizeof path, "%s/%s", tmpdir, name);
+	(void) unlink(path);
+}
+
+static void
+expectFailure(const char *path, interp_res_t code, long int line_num)
+{
+	long int err_line = 0;
+
+	assert_int_equal(Interpreter_processAllLines(path, validator,
+	    installer, &err_line), code);
+	assert_int_equal(err_line, line_num);
+}
+
+static void
+rejectsShouldFailFiles_test(void **state)
+{
+	(void) state;
+
+	expectFailure("configfiles/shouldFail1.conf",
+	    INTERP_ERR_NO_ASSIGNMENT, 6);
+	expectFailure("configfiles/shouldFail2.conf",
+	    INTERP_ERR_NO_ARG_BEGIN, 5);
+	expectFailure("configfiles/shouldFail3.conf",
+	    INTERP_ERR_UNTERMINATED_ARG, 5);
+	expectFailure("configfiles/shouldFail4.conf",
+	    INTERP_ERR_NO_TERMINATOR, 5);
+	expectFailure("configfiles/shouldFail5.conf",
+	    INTERP_ERR_NO_TERMINATOR, 5);
+	expectFailure("configfiles/shouldFail6.conf",
+	    INTERP_ERR_IMPLICIT_DATA, 4);
+}
+
+static void
+acceptsTemplate_test(void **state)
+{
+	long int err_line = -1;
+
+	(void) state;
+	installed = 0;
+
+	assert_int_equal(Interpreter_processAllLines("../template.conf",
+	    validator, installer, &err_line), INTERP_OK);
+	assert_int_equal(err_line, 0);
+	assert_int_equal(installed, 15);
+}
+
+static void
+returnsErrOpenIfFileIsNonexistent_test(void **state)
+{
+	(void) state;
+	assert_int_equal(Interpreter_processAllLines("configfiles/nonexistent",
+	    validator, installer, NULL), INTERP_ERR_OPEN);
+}
+
+static void
+includesFilesInSortedOrder_test(void **state)
+{
+	char path[100];
+
+	(void) state;
+	install_log[0] = '\0';
+
+	writeFile("main.conf", "username = \"main\";\n"
+	    "include \"conf.d/*.conf\";\n"
+	    "port = \"443\";\n");
+	writeFile("conf.d/20-b.conf", "# b\npassword = \"b\";\n");
+	writeFile("conf.d/10-a.conf", "hostname = \"a\";\n");
+	writeFile("conf.d/30-c.conf", "ip_addr = \"c\"; # c\n");
+	(void) snprintf(path, sizeof path, "%s/main.conf", tmpdir);
+
+	assert_int_equal(Interpreter_processAllLines(path, validator,
+	    strictInstaller, NULL), INTERP_OK);
+	assert_string_equal(install_log, " username=main hostname=a "
+	    "password=b ip_addr=c port=443");
+
+	removeFile("conf.d/10-a.conf");
+	removeFile("conf.d/20-b.conf");
+	removeFile("conf.d/30-c.conf");
+	removeFile("main.conf");
+}
+
+static void
+duplicateInIncludedFileIsBusy_test(void **state)
+{
+	char path[100];
+	long int err_line = 0;
+
+	(void) state;
+	install_log[0] = '\0';
+
+	writeFile("main.conf", "include \"conf.d/*.conf\";\n");
+	writeFile("conf.d/1.conf", "username = \"first\";\n");
+	writeFile("conf.d/2.conf", "\npassword = \"x\";\n"
+	    "username = \"second\";\n");
+	(void) snprintf(path, sizeof path, "%s/main.conf", tmpdir);
+
+	errno = 0;
+	assert_int_equal(Interpreter_processAllLines(path, validator,
+	    strictInstaller, &err_line), INTERP_ERR_INSTALL);
+	assert_int_equal(errno, EBUSY);
+	assert_int_equal(err_line, 3);
+	assert_string_equal(install_log, " username=first password=x");
+
+	removeFile("conf.d/1.conf");
+	removeFile("conf.d/2.conf");
+	removeFile("main.conf");
+}
+
+static void
+rejectsNestedInclude_test(void **state)
+{
+	char path[100];
+	long int err_line = 0;
+
+	(void) state;
+
+	writeFile("main.conf", "include \"conf.d/*.conf\";\n");
+	writeFile("conf.d/1.conf", "# nested\ninclude \"*.conf\";\n");
+	(void) snprintf(path, sizeof path, "%s/main.conf", tmpdir);
+
+	assert_int_equal(Interpreter_processAllLines(path, validator,
+	    installer, &err_line), INTERP_ERR_NESTED_INCLUDE);
+	assert_int_equal(err_line, 2);
+
+	removeFile("conf.d/1.conf");
+	removeFile("main.conf");
+}
+
+static void
+missingIncludedFileIsError_test(void **state)
+{
+	char path[100];
+	long int err_line = 0;
+
+	(void) state;
+
+	writeFile("main.conf", "include \"conf.d/*.conf\";\n"
+	    "include \"conf.d/missing.conf\";\n");
+	(void) snprintf(path, sizeof path, "%s/main.conf", tmpdir);
+
+	assert_int_equal(Interpreter_processAllLines(path, validator,
+	    installer, &err_line), INTERP_ERR_INCLUDE);
+	assert_int_equal(err_line, 2);
+
+	removeFile("main.conf");
+}
+
+/*
+ * A single hostname value with 50k entries: 10 entries per line and
+ * the lines continued with a backslash.
+ */
+static void
+acceptsVeryLongContinuedArgument_test(void **state)
+{
+	FILE *fp;
+	char *expected, *cp;
+	char path[100];
+	const int n_hosts = 50000;
+	long int err_line = -1;
+
+	(void) state;
+
+	(void) snprintf(path, sizeof path, "%s/hosts.conf", tmpdir);
+	assert_non_null(fp = fopen(path, "w"));
+	assert_non_null(expected = calloc(n_hosts, 32));
+	cp = expected;
+	(void) fputs("# many hosts\nhostname = \"", fp);
+	for (int i = 0; i < n_hosts; i++) {
+		const char *sep = (i + 1 < n_hosts ? "|" : "");
+
+		cp += sprintf(cp, "host%d.example.com%s", i, sep);
+		(void) fprintf(fp, "host%d.example.com%s", i, sep);
+		if (i % 10 == 9 && i + 1 < n_hosts)
+			(void) fputs(" \\\n\t", fp);
+	}
+	(void) fputs("\";\nport = \"443\";\n", fp);
+	assert_int_equal(fclose(fp), 0);
+
+	assert_int_equal(Interpreter_processAllLines(path, validator,
+	    hostnameInstaller, &err_line), INTERP_OK);
+	assert_int_equal(err_line, 0);
+	assert_non_null(installed_hostname);
+	assert_int_equal(strlen(installed_hostname), strlen(expected));
+	assert_string_equal(installed_hostname, expected);
+
+	free(installed_hostname);
+	installed_hostname = NULL;
+	free(expected);
+	removeFile("hosts.conf");
+}
+
+/*
+ * An error in a statement after a continued line is reported with
+ * the right line number.
+ */
+static void
+continuedLineKeepsLineNumbers_test(void **state)
+{
+	char path[100];
+	long int err_line = 0;
+
+	(void) state;
+
+	writeFile("main.conf", "hostname = \"a|\\\n"
+	    "  b|\\\n"
+	    "  c\";\n"
+	    "port = \"443\"\n");
+	(void) snprintf(path, sizeof path, "%s/main.conf", tmpdir);
+
+	assert_int_equal(Interpreter_processAllLines(path, validator,
+	    hostnameInstaller, &err_line), INTERP_ERR_NO_TERMINATOR);
+	assert_int_equal(err_line, 4);
+	assert_string_equal(installed_hostname, "a|b|c");
+
+	free(installed_hostname);
+	installed_hostname = NULL;
+	removeFile("main.conf");
+}
+
+/*
+ * A backslash at the end of a trailing comment doesn't continue the
+ * line.
+ */
+static void
+backslashInCommentIsNotContinuation_test(void **state)
+{
+	char path[100];
+	long int err_line = -1;
+
+	(void) state;
+	install_log[0] = '\0';
+
+	writeFile("main.conf", "password = \"x\"; # C:\\\n"
+	    "username = \"y\"; # \"\\\n"
+	    "hostname = \"a|\\\n"
+	    "  b#c|\\\n"
+	    "  d\";\n");
+	(void) snprintf(path, sizeof path, "%s/main.conf", tmpdir);
+
+	assert_int_equal(Interpreter_processAllLines(path, validator,
+	    strictInstaller, &err_line), INTERP_OK);
+	assert_int_equal(err_line, 0);
+	assert_string_equal(install_log, " password=x username=y "
+	    "hostname=a|b#c|d");
+
+	removeFile("main.conf");
+}
+
+static void
+keepGoingReportsAllErrors_test(void **state)
+{
+	char path[100];
+	long int err_line = 0;
+
+	(void) state;
+	install_log[0] = '\0';
+
+	writeFile("main.conf", "username = \"a\";\n"
+	    "bad line\n"
+	    "include \"conf.d/*.conf\";\n"
+	    "password = \"b\"\n"
+	    "port = \"443\";\n");
+	writeFile("conf.d/1.conf", "username = \"c\";\nhostname = \"d\";\n");
+	(void) snprintf(path, sizeof path, "%s/main.conf", tmpdir);
+
+	Interpreter_setKeepGoing(true);
+	assert_int_equal(Interpreter_processAllLines(path, validator,
+	    strictInstaller, &err_line), INTERP_ERR_NO_ASSIGNMENT);
+	Interpreter_setKeepGoing(false);
+	assert_int_equal(err_line, 2);
+	assert_int_equal(Interpreter_errorCount(), 3);
+	assert_string_equal(install_log, " username=a hostname=d port=443");
+
+	assert_int_equal(Interpreter_processAllLines(path, validator,
+	    installer, NULL), INTERP_ERR_NO_ASSIGNMENT);
+	assert_int_equal(Interpreter_errorCount(), 1);
+
+	removeFile("conf.d/1.conf");
+	removeFile("main.conf");
+}
+
+static int
+setup(void **state)
+{
+	char path[100];
+
+	(void) state;
+	if (mkdtemp(tmpdir) == NULL)
+		return -1;
+	(void) snprintf(path, sizeof path, "%s/conf.d", tmpdir);
+	return mkdir(path, 0700);
+}
+
+static int
+teardown(void **state)
+{
+	char path[100];
+
+	(void) state;
+	(void) snprintf(path, sizeof path, "%s/conf.d", tmpdir);
+	(void) rmdir(path);
+	return rmdir(tmpdir);
+}
+
+int
+main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(rejectsShouldFailFiles_test),
+		cmocka_unit_test(acceptsTemplate_test),
+		cmocka_unit_test(returnsErrOpenIfFileIsNonexistent_test),
+		cmocka_unit_test(includesFilesInSortedOrder_test),
+		cmocka_unit_test(duplicateInIncludedFileIsBusy_test),
+		cmocka_unit_test(rejectsNestedInclude_test),
+		cmocka_unit_test(missingIncludedFileIsError_test),
+		cmocka_unit_test(acceptsVeryLongContinuedArgument_test),
+		cmocka_unit_test(continuedLineKeepsLineNumbers_test),
+		cmocka_unit_test(backslashInCommentIsNotContinuation_test),
+		cmocka_unit_test(keepGoingReportsAllErrors_test),
+	};
+
+	return cmocka_run_group_tests(tests, setup, teardown);
+}
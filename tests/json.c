@@ -0,0 +1,114 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <math.h>
+#include <string.h>
+
+#include "json.h"
+
+static void
+writesMembers_test(void **state)
+{
+	char			buf[200];
+	struct json_writer	w;
+
+	(void) state;
+	json_init(&w, buf, sizeof buf);
+	json_add_string(&w, "host", "example.com");
+	json_add_uint(&w, "zero", 0);
+	json_add_uint(&w, "max", UINT64_MAX);
+	json_add_bool(&w, "ok", true);
+	assert_true(json_finish(&w));
+	assert_string_equal(buf, "{\"host\":\"example.com\",\"zero\":0,"
+	    "\"max\":18446744073709551615,\"ok\":true}");
+}
+
+static void
+writesNumbers_test(void **state)
+{
+	char			buf[200];
+	struct json_writer	w;
+
+	(void) state;
+	json_init(&w, buf, sizeof buf);
+	json_add_double(&w, "ns", 12.3456, 2);
+	json_add_double(&w, "neg", -0.5, 1);
+	json_add_double(&w, "inf", INFINITY, 3);
+	json_add_double(&w, "nan", NAN, 3);
+	assert_true(json_finish(&w));
+	assert_string_equal(buf, "{\"ns\":12.35,\"neg\":-0.5,\"inf\":null,"
+	    "\"nan\":null}");
+}
+
+static void
+escapesStrings_test(void **state)
+{
+	char			buf[200];
+	struct json_writer	w;
+
+	(void) state;
+	json_init(&w, buf, sizeof buf);
+	json_add_string(&w, "msg", "a \"b\" \\ c\n\t\x01");
+	assert_true(json_finish(&w));
+	assert_string_equal(buf,
+	    "{\"msg\":\"a \\\"b\\\" \\\\ c\\n\\t\\u0001\"}");
+}
+
+static void
+addsMembersOfAnotherObject_test(void **state)
+{
+	char			inner[100], outer[200];
+	struct json_writer	w;
+
+	(void) state;
+	json_init(&w, inner, sizeof inner);
+	json_add_string(&w, "event", "update");
+	json_add_uint(&w, "total_us", 42);
+	assert_true(json_finish(&w));
+
+	json_init(&w, outer, sizeof outer);
+	json_add_string(&w, "level", "info");
+	json_add_members(&w, inner);
+	json_add_members(&w, "{}");
+	assert_true(json_finish(&w));
+	assert_string_equal(outer,
+	    "{\"level\":\"info\",\"event\":\"update\",\"total_us\":42}");
+}
+
+/*
+ * Members that don't fit are left out as a whole, so the object that
+ * is written stays valid.
+ */
+static void
+truncationKeepsObjectValid_test(void **state)
+{
+	char			buf[24];
+	struct json_writer	w;
+
+	(void) state;
+	json_init(&w, buf, sizeof buf);
+	json_add_string(&w, "a", "1234");
+	json_add_string(&w, "b", "a string that doesn't fit");
+	json_add_uint(&w, "c", 1);
+	assert_false(json_finish(&w));
+	assert_string_equal(buf, "{\"a\":\"1234\"}");
+
+	json_init(&w, buf, 2);
+	assert_false(json_finish(&w));
+}
+
+int
+main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(writesMembers_test),
+		cmocka_unit_test(writesNumbers_test),
+		cmocka_unit_test(escapesStrings_test),
+		cmocka_unit_test(addsMembersOfAnotherObject_test),
+		cmocka_unit_test(truncationKeepsObjectValid_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
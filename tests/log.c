@@ -0,0 +1,292 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "log.h"
+
+static int saved_stdout = -1;
+static int saved_stderr = -1;
+static int pipe_fd[2] = { -1, -1 };
+static char *output = NULL;
+static size_t output_len = 0;
+
+/*
+ * Reads everything written to the pipe into 'output'
+ */
+static void *
+reader(void *arg)
+{
+	char	buf[4096];
+	ssize_t	n;
+
+	(void) arg;
+
+	while ((n = read(pipe_fd[0], buf, sizeof buf)) > 0) {
+		output = realloc(output, output_len + n + 1);
+		memcpy(&output[output_len], buf, n);
+		output_len += n;
+		output[output_len] = '\0';
+	}
+	return NULL;
+}
+
+static void
+redirectStdout(void)
+{
+	(void) fflush(stdout);
+	assert_int_equal(pipe(pipe_fd), 0);
+	assert_true((saved_stdout = dup(STDOUT_FILENO)) != -1);
+	assert_true(dup2(pipe_fd[1], STDOUT_FILENO) != -1);
+	(void) close(pipe_fd[1]);
+	(void) setvbuf(stdout, NULL, _IOLBF, 0);
+	free(output);
+	output = NULL;
+	output_len = 0;
+}
+
+static void
+restoreStdout(void)
+{
+	(void) fflush(stdout);
+	assert_true(dup2(saved_stdout, STDOUT_FILENO) != -1);
+	(void) close(saved_stdout);
+}
+
+/*
+ * Warnings are written to stderr, so it is sent to the same pipe
+ */
+static void
+redirectStderrToo(void)
+{
+	(void) fflush(stderr);
+	assert_true((saved_stderr = dup(STDERR_FILENO)) != -1);
+	assert_true(dup2(STDOUT_FILENO, STDERR_FILENO) != -1);
+}
+
+static void
+restoreStderr(void)
+{
+	(void) fflush(stderr);
+	assert_true(dup2(saved_stderr, STDERR_FILENO) != -1);
+	(void) close(saved_stderr);
+}
+
+static void
+silenceStdout(void)
+{
+	int fd;
+
+	(void) fflush(stdout);
+	assert_true((saved_stdout = dup(STDOUT_FILENO)) != -1);
+	assert_true((fd = open("/dev/null", O_WRONLY)) != -1);
+	assert_true(dup2(fd, STDOUT_FILENO) != -1);
+	(void) close(fd);
+}
+
+static int evaluated = 0;
+
+static int
+sideEffect(void)
+{
+	return ++evaluated;
+}
+
+static size_t
+countLines(void)
+{
+	size_t lines = 0;
+
+	for (const char *cp = output; cp && *cp; cp++) {
+		if (*cp == '\n')
+			lines++;
+	}
+	return lines;
+}
+
+static void
+writesAllRecordsInOrder_test(void **state)
+{
+	char		 expected[100];
+	const char	*cp;
+	pthread_t	 thr;
+
+	(void) state;
+	redirectStdout();
+	assert_int_equal(pthread_create(&thr, NULL, reader, NULL), 0);
+
+	log_async_start();
+	for (int i = 0; i < 100; i++)
+		log_msg("message %d", i);
+	log_async_stop();
+
+	restoreStdout();
+	assert_int_equal(pthread_join(thr, NULL), 0);
+	(void) close(pipe_fd[0]);
+
+	assert_int_equal(countLines(), 100);
+	cp = output;
+	for (int i = 0; i < 100; i++) {
+		(void) snprintf(expected, sizeof expected, "message %d\n", i);
+		assert_memory_equal(cp, expected, strlen(expected));
+		cp += strlen(expected);
+	}
+	assert_int_equal(log_dropped(), 0);
+}
+
+/*
+ * Nothing reads the pipe until all records have been logged, so the
+ * writer blocks once the pipe is full and the ring buffer overflows.
+ */
+static void
+dropsRecordsWhenFull_test(void **state)
+{
+	char		 padding[1000];
+	const int	 n_records = 1000;
+	pthread_t	 thr;
+
+	(void) state;
+	(void) memset(padding, 'x', sizeof padding - 1);
+	padding[sizeof padding - 1] = '\0';
+	redirectStdout();
+
+	log_async_start();
+	for (int i = 0; i < n_records; i++)
+		log_msg("%d %s", i, padding);
+	assert_int_equal(pthread_create(&thr, NULL, reader, NULL), 0);
+	log_async_stop();
+
+	restoreStdout();
+	assert_int_equal(pthread_join(thr, NULL), 0);
+	(void) close(pipe_fd[0]);
+
+	assert_true(log_dropped() > 0);
+	assert_int_equal(countLines() + log_dropped(), n_records);
+}
+
+static void
+debugArgumentsAreOnlyEvaluatedIfEnabled_test(void **state)
+{
+	(void) state;
+	silenceStdout();
+
+	evaluated = 0;
+	g_debug_mode = false;
+	log_debug("%d", sideEffect());
+	assert_int_equal(evaluated, 0);
+
+	g_debug_mode = true;
+	log_debug("%d", sideEffect());
+	assert_int_equal(evaluated, LOG_DEBUG_COMPILED ? 1 : 0);
+	g_debug_mode = false;
+
+	restoreStdout();
+}
+
+static void
+countsRecordsPerLevel_test(void **state)
+{
+	unsigned long int info, debug;
+
+	(void) state;
+	silenceStdout();
+
+	info = log_count(LOG_LEVEL_INFO);
+	debug = log_count(LOG_LEVEL_DEBUG);
+
+	log_msg("one");
+	log_msg("two");
+	g_debug_mode = true;
+	log_debug("three");
+	g_debug_mode = false;
+	log_debug("not logged");
+
+	assert_int_equal(log_count(LOG_LEVEL_INFO) - info, 2);
+	assert_int_equal(log_count(LOG_LEVEL_DEBUG) - debug,
+	    LOG_DEBUG_COMPILED ? 1 : 0);
+	assert_int_equal(log_count(LOG_LEVEL_COUNT), 0);
+
+	restoreStdout();
+}
+
+static void
+warnTwice(void)
+{
+	log_warn(0, "twice %d", 1);
+	log_warn(0, "twice %d", 2);
+}
+
+static size_t
+countOccurrences(const char *str)
+{
+	size_t n = 0;
+
+	for (const char *cp = output; cp && (cp = strstr(cp, str)) != NULL;
+	    cp++)
+		n++;
+	return n;
+}
+
+/*
+ * A repeat is keyed by call site and format: the two calls in
+ * warnTwice() share the format but not the call site.
+ */
+static void
+suppressesRepeatedWarnings_test(void **state)
+{
+	const unsigned long int suppressed = log_suppressed();
+
+	(void) state;
+	redirectStdout();
+	redirectStderrToo();
+	log_set_repeat_window(60);
+
+	for (int i = 0; i < 5; i++)
+		log_warn(0, "repeated %d", i);
+	warnTwice();
+	warnTwice();
+	log_repeats_flush(false);
+	assert_int_equal(log_suppressed() - suppressed, 6);
+	log_repeats_flush(true);
+
+	log_set_repeat_window(0);
+	log_warn(0, "not suppressed");
+	log_warn(0, "not suppressed");
+
+	restoreStderr();
+	restoreStdout();
+	reader(NULL);
+	(void) close(pipe_fd[0]);
+
+	assert_int_equal(countLines(), 8);
+	assert_int_equal(countOccurrences("repeated 0\n"), 1);
+	assert_int_equal(countOccurrences("twice 1\n"), 1);
+	assert_int_equal(countOccurrences("twice 2\n"), 1);
+	assert_int_equal(countOccurrences("\"repeated %d\" repeated 4 "
+	    "time(s) in 60 seconds"), 1);
+	assert_int_equal(countOccurrences("\"twice %d\" repeated 1 "
+	    "time(s) in 60 seconds"), 2);
+	assert_int_equal(countOccurrences("not suppressed\n"), 2);
+	assert_int_equal(log_suppressed() - suppressed, 6);
+}
+
+int
+main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(writesAllRecordsInOrder_test),
+		cmocka_unit_test(dropsRecordsWhenFull_test),
+		cmocka_unit_test(debugArgumentsAreOnlyEvaluatedIfEnabled_test),
+		cmocka_unit_test(countsRecordsPerLevel_test),
+		cmocka_unit_test(suppressesRepeatedWarnings_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,153 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <sys/stat.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <unistd.h>
+
+#include "logfile.h"
+
+static char tmpdir[] = "/tmp/educ-test.XXXXXX";
+static char log_path[100];
+
+static off_t
+fileSize(const char *path)
+{
+	struct stat sb;
+
+	if (stat(path, &sb) == -1)
+		return -1;
+	return sb.st_size;
+}
+
+static void
+rotatedPath(char *buf, size_t size, int n)
+{
+	(void) snprintf(buf, size, "%s.%d", log_path, n);
+}
+
+static void
+removeLogFiles(void)
+{
+	char path[120];
+
+	(void) unlink(log_path);
+	for (int i = 1; i <= LOGFILE_KEEP + 1; i++) {
+		rotatedPath(path, sizeof path, i);
+		(void) unlink(path);
+	}
+}
+
+static void
+buffersInfoAndWritesWarningsAtOnce_test(void **state)
+{
+	(void) state;
+	removeLogFiles();
+	assert_int_equal(logfile_open(log_path), 0);
+
+	logfile_write(LOG_INFO, "one");
+	assert_int_equal(fileSize(log_path), 0);
+	logfile_flush();
+	assert_int_equal(fileSize(log_path), 4);
+
+	logfile_write(LOG_INFO, "two");
+	logfile_write(LOG_WARNING, "three");
+	assert_int_equal(fileSize(log_path), 14);
+
+	logfile_close();
+	assert_false(logfile_is_open());
+}
+
+static void
+rotatesBySizeAndCount_test(void **state)
+{
+	char path[120];
+
+	(void) state;
+	removeLogFiles();
+	assert_int_equal(logfile_open(log_path), 0);
+	logfile_set_rotation(100, 2);
+
+	/* 24 bytes per record: 4 records per file */
+	for (int i = 0; i < 20; i++)
+		logfile_write(LOG_WARNING, "a record of 23 bytes...");
+
+	assert_int_equal(fileSize(log_path), 96);
+	rotatedPath(path, sizeof path, 1);
+	assert_int_equal(fileSize(path), 96);
+	rotatedPath(path, sizeof path, 2);
+	assert_int_equal(fileSize(path), 96);
+	rotatedPath(path, sizeof path, 3);
+	assert_int_equal(fileSize(path), -1);
+
+	logfile_close();
+	logfile_set_rotation(LOGFILE_MAX_SIZE, LOGFILE_KEEP);
+}
+
+static void
+reopensMovedFile_test(void **state)
+{
+	char path[120];
+
+	(void) state;
+	removeLogFiles();
+	assert_int_equal(logfile_open(log_path), 0);
+	logfile_write(LOG_WARNING, "before");
+
+	rotatedPath(path, sizeof path, 1);
+	assert_int_equal(rename(log_path, path), 0);
+	logfile_tick();
+	logfile_write(LOG_WARNING, "after");
+
+	assert_int_equal(fileSize(path), 7);
+	assert_int_equal(fileSize(log_path), 6);
+	logfile_close();
+}
+
+static void
+rejectsRelativePath_test(void **state)
+{
+	(void) state;
+	errno = 0;
+	assert_int_equal(logfile_open("enhanced-duc.log"), -1);
+	assert_int_equal(errno, EINVAL);
+	assert_false(logfile_is_open());
+}
+
+static int
+setup(void **state)
+{
+	(void) state;
+	if (mkdtemp(tmpdir) == NULL)
+		return -1;
+	(void) snprintf(log_path, sizeof log_path, "%s/duc.log", tmpdir);
+	return 0;
+}
+
+static int
+teardown(void **state)
+{
+	(void) state;
+	removeLogFiles();
+	return rmdir(tmpdir);
+}
+
+int
+main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(buffersInfoAndWritesWarningsAtOnce_test),
+		cmocka_unit_test(rotatesBySizeAndCount_test),
+		cmocka_unit_test(reopensMovedFile_test),
+		cmocka_unit_test(rejectsRelativePath_test),
+	};
+
+	return cmocka_run_group_tests(tests, setup, teardown);
+}
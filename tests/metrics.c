@@ -0,0 +1,179 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "listener.h"
+#include "metrics.h"
+#include "netstats.h"
+
+static char socket_path[100];
+static char client_reply[65536];
+
+static void
+rendersCounters_test(void **state)
+{
+	struct listener_reply	 reply = { 0 };
+	struct net_timing	 t = { 0 };
+
+	(void) state;
+	netstats_reset();
+	metrics_count_update("good");
+	metrics_count_update("good");
+	metrics_count_update(NULL);
+	metrics_count_update("bogus");
+	metrics_inc(METRIC_IP_CHANGES);
+	metrics_count_lookup("ip1.example.com", true);
+	metrics_count_lookup("ip1.example.com", true);
+	metrics_count_lookup("ip1.example.com", false);
+	metrics_count_lookup("ip2.example.com", false);
+
+	t.phase_us[NET_PHASE_CONNECT] = 1500;
+	t.reached = (1U << NET_PHASE_CONNECT);
+	t.total_us = 1500;
+	netstats_record(NETSTATS_HOST, "a\"b.example.com", &t);
+
+	metrics_render(&reply);
+	assert_non_null(reply.data);
+	assert_int_equal(strlen(reply.data), reply.len);
+	assert_int_equal(metrics_updates("good"), 2);
+	assert_non_null(strstr(reply.data,
+	    "educ_updates_total{code=\"good\"} 2\n"));
+	assert_non_null(strstr(reply.data,
+	    "educ_updates_total{code=\"error\"} 1\n"));
+	assert_non_null(strstr(reply.data,
+	    "educ_updates_total{code=\"unknown\"} 1\n"));
+	assert_non_null(strstr(reply.data, "educ_ip_changes_total 1\n"));
+	assert_int_equal(metrics_lookups("ip1.example.com", true), 2);
+	assert_int_equal(metrics_lookups("ip2.example.com", true), 0);
+	assert_int_equal(metrics_lookups("ip3.example.com", false), 0);
+	assert_non_null(strstr(reply.data, "educ_ip_lookups_total"
+	    "{server=\"ip1.example.com\",result=\"ok\"} 2\n"));
+	assert_non_null(strstr(reply.data, "educ_ip_lookups_total"
+	    "{server=\"ip1.example.com\",result=\"failed\"} 1\n"));
+	assert_non_null(strstr(reply.data, "educ_ip_lookups_total"
+	    "{server=\"ip2.example.com\",result=\"failed\"} 1\n"));
+	assert_non_null(strstr(reply.data, "# TYPE educ_request_phase_seconds "
+	    "histogram\n"));
+	assert_non_null(strstr(reply.data, "educ_request_phase_seconds_count"
+	    "{kind=\"host\",target=\"a\\\"b.example.com\",phase=\"connect\"} "
+	    "1\n"));
+	assert_non_null(strstr(reply.data, "phase=\"connect\",le=\"+Inf\"} "
+	    "1\n"));
+	assert_non_null(strstr(reply.data, "phase=\"total\"} 0.001500\n"));
+	free(reply.data);
+}
+
+/*
+ * A client that sends a request and reads the reply until the server
+ * closes the connection
+ */
+static void *
+client(void *arg)
+{
+	const char		*req = arg;
+	int			 fd;
+	size_t			 len = 0;
+	ssize_t			 n;
+	struct sockaddr_un	 sun = { 0 };
+
+	sun.sun_family = AF_UNIX;
+	(void) snprintf(sun.sun_path, sizeof sun.sun_path, "%s", socket_path);
+	if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1)
+		return NULL;
+	if (connect(fd, (struct sockaddr *) &sun, sizeof sun) == 0 &&
+	    write(fd, req, strlen(req)) > 0) {
+		while ((n = read(fd, &client_reply[len], sizeof client_reply -
+		    len - 1)) > 0)
+			len += n;
+	}
+	client_reply[len] = '\0';
+	(void) close(fd);
+	return NULL;
+}
+
+static void
+serve(const char *req)
+{
+	pthread_t thr;
+
+	client_reply[0] = '\0';
+	assert_int_equal(pthread_create(&thr, NULL, client, (void *) req), 0);
+	listener_serve(300 * 1000000);
+	assert_int_equal(pthread_join(thr, NULL), 0);
+}
+
+static void
+servesMetricsOnUnixSocket_test(void **state)
+{
+	char dir[] = "/tmp/metrics.XXXXXX";
+
+	(void) state;
+	assert_non_null(mkdtemp(dir));
+	(void) snprintf(socket_path, sizeof socket_path, "%s/sock", dir);
+	assert_int_equal(listener_open(socket_path, &g_metrics_ops), 0);
+	assert_true(listener_any());
+
+	serve("GET /metrics HTTP/1.0\r\nHost: localhost\r\n\r\n");
+	assert_non_null(strstr(client_reply, "HTTP/1.0 200 OK\r\n"));
+	assert_non_null(strstr(client_reply, "\r\n\r\n# HELP "
+	    "educ_updates_total "));
+
+	serve("GET /other HTTP/1.0\r\n\r\n");
+	assert_non_null(strstr(client_reply, "HTTP/1.0 404 Not Found\r\n"));
+
+	listener_close_all();
+	assert_false(listener_any());
+	assert_int_equal(access(socket_path, F_OK), -1);
+	assert_int_equal(rmdir(dir), 0);
+}
+
+/*
+ * The lookup servers that don't fit share the entry "(other)". Two
+ * entries are taken by rendersCounters_test().
+ */
+static void
+countsLookupsOfManyServers_test(void **state)
+{
+	char server[50];
+
+	(void) state;
+	for (int i = 0; i < METRICS_LOOKUP_SERVERS * 2; i++) {
+		(void) snprintf(server, sizeof server, "many%d.example.com", i);
+		metrics_count_lookup(server, true);
+	}
+	assert_int_equal(metrics_lookups("(other)", true),
+	    METRICS_LOOKUP_SERVERS + 3);
+}
+
+static void
+rejectsNonLoopbackAddresses_test(void **state)
+{
+	(void) state;
+	assert_int_equal(listener_open("192.0.2.1:9100", &g_metrics_ops), -1);
+	assert_int_equal(listener_open("localhost:http", &g_metrics_ops), -1);
+	assert_int_equal(listener_open("relative/path", &g_metrics_ops), -1);
+	assert_false(listener_any());
+}
+
+int
+main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(rendersCounters_test),
+		cmocka_unit_test(servesMetricsOnUnixSocket_test),
+		cmocka_unit_test(countsLookupsOfManyServers_test),
+		cmocka_unit_test(rejectsNonLoopbackAddresses_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
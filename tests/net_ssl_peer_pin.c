@@ -0,0 +1,46 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "network.h"
+#include "settings.h"
+
+/*
+ * openssl x509 -in noip.crt -pubkey -noout |
+ *     openssl pkey -pubin -outform der | openssl dgst -sha256 -binary |
+ *     base64
+ */
+static const char noip_pin[] = "0n08hzq3W4NNm73/NM4N8cPYtwNc6XaspgTsTLxK1tw=";
+
+static void
+computesPin_test(void **state)
+{
+	char pin[SPKI_PIN_LEN + 1];
+
+	(void) state;
+
+	assert_true(net_ssl_peer_pin(pin, sizeof pin));
+	assert_string_equal(pin, noip_pin);
+}
+
+static void
+tooSmallBuffer_test(void **state)
+{
+	char pin[SPKI_PIN_LEN];
+
+	(void) state;
+
+	assert_false(net_ssl_peer_pin(pin, sizeof pin));
+}
+
+int
+main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(computesPin_test),
+		cmocka_unit_test(tooSmallBuffer_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,73 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include "netstats.h"
+
+static void
+recordsReachedPhasesOnly_test(void **state)
+{
+	const struct netstats_series	*s;
+	struct net_timing		 t = { 0 };
+
+	(void) state;
+	netstats_reset();
+
+	t.phase_us[NET_PHASE_RESOLVE] = 10;
+	t.phase_us[NET_PHASE_CONNECT] = 200;
+	t.reached = (1U << NET_PHASE_RESOLVE) | (1U << NET_PHASE_CONNECT);
+	t.total_us = 210;
+	netstats_record(NETSTATS_LOOKUP, "ip1.example.com", &t);
+	netstats_record(NETSTATS_LOOKUP, "ip1.example.com", &t);
+	netstats_record(NETSTATS_HOST, "ip1.example.com", &t);
+
+	assert_int_equal(netstats_count(), 2);
+	assert_non_null(s = netstats_get(0));
+	assert_int_equal(s->kind, NETSTATS_LOOKUP);
+	assert_string_equal(s->name, "ip1.example.com");
+	assert_int_equal(s->phase[NET_PHASE_RESOLVE].count, 2);
+	assert_int_equal(s->phase[NET_PHASE_CONNECT].sum, 400);
+	assert_int_equal(s->phase[NET_PHASE_TLS_HANDSHAKE].count, 0);
+	assert_int_equal(s->total.max, 210);
+	assert_null(netstats_get(2));
+}
+
+static void
+sharesSeriesWhenFull_test(void **state)
+{
+	char			 name[50];
+	struct net_timing	 t = { 0 };
+
+	(void) state;
+	netstats_reset();
+
+	for (int i = 0; i < NETSTATS_SERIES * 2; i++) {
+		(void) snprintf(name, sizeof name, "host%d.example.com", i);
+		netstats_record(NETSTATS_HOST, name, &t);
+	}
+	netstats_record(NETSTATS_PROVIDER, "provider.example.com", &t);
+
+	assert_int_equal(netstats_count(),
+	    NETSTATS_SERIES - NETSTATS_KIND_COUNT + 2);
+	assert_string_equal(netstats_get(netstats_count() - 2)->name,
+	    "(other)");
+	assert_int_equal(netstats_get(netstats_count() - 2)->total.count,
+	    NETSTATS_SERIES + NETSTATS_KIND_COUNT);
+	assert_int_equal(netstats_get(netstats_count() - 1)->kind,
+	    NETSTATS_PROVIDER);
+}
+
+int
+main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(recordsReachedPhasesOnly_test),
+		cmocka_unit_test(sharesSeriesWhenFull_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
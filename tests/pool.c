@@ -0,0 +1,108 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <time.h>
+
+#include "pool.h"
+
+#define TASKS 1000
+
+struct batch {
+	atomic_uint	runs[TASKS];
+	size_t		worker[TASKS];
+	size_t		order[TASKS];
+	atomic_size_t	n_done;
+	pthread_t	caller;
+	size_t		slow;		/* Tasks below this sleep */
+};
+
+static void
+task(size_t i, void *arg)
+{
+	struct batch *b = arg;
+
+	if (i < b->slow) {
+		const struct timespec ts = { 0, 1000000 };
+
+		(void) nanosleep(&ts, NULL);
+	}
+	(void) atomic_fetch_add(&b->runs[i], 1);
+	b->worker[i] = pool_worker_id();
+	b->order[atomic_fetch_add(&b->n_done, 1)] = i;
+}
+
+static void
+runsEveryTaskOnce_test(void **state)
+{
+	static struct batch b;
+
+	(void) state;
+	for (int round = 0; round < 20; round++) {
+		(void) memset(&b, 0, sizeof b);
+		pool_run(4, TASKS, task, &b);
+		assert_int_equal(atomic_load(&b.n_done), TASKS);
+		for (size_t i = 0; i < TASKS; i++)
+			assert_int_equal(atomic_load(&b.runs[i]), 1);
+	}
+	assert_int_equal(pool_size(), 4);
+	pool_stop();
+	assert_int_equal(pool_size(), 1);
+}
+
+static void
+runsInOrderOnOneWorker_test(void **state)
+{
+	static struct batch b;
+
+	(void) state;
+	(void) memset(&b, 0, sizeof b);
+	pool_run(1, TASKS, task, &b);
+	for (size_t i = 0; i < TASKS; i++) {
+		assert_int_equal(b.order[i], i);
+		assert_int_equal(b.worker[i], 0);
+	}
+
+	/* More workers than tasks */
+	(void) memset(&b, 0, sizeof b);
+	pool_run(8, 1, task, &b);
+	assert_int_equal(atomic_load(&b.runs[0]), 1);
+	assert_int_equal(pool_size(), 1);
+	pool_run(8, 0, task, &b);
+}
+
+static void
+stealsFromSlowWorker_test(void **state)
+{
+	static struct batch	b;
+	size_t			stolen = 0;
+
+	(void) state;
+	(void) memset(&b, 0, sizeof b);
+	b.slow = 100;
+	pool_run(4, 400, task, &b);
+	assert_int_equal(atomic_load(&b.n_done), 400);
+	/* Worker 0 owned the slow tasks */
+	for (size_t i = 0; i < b.slow; i++) {
+		if (b.worker[i] != 0)
+			stolen++;
+	}
+	assert_true(stolen > 0);
+	pool_stop();
+}
+
+int
+main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(runsEveryTaskOnce_test),
+		cmocka_unit_test(runsInOrderOnOneWorker_test),
+		cmocka_unit_test(stealsFromSlowWorker_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
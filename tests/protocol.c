@@ -0,0 +1,148 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "protocol.h"
+#include "settings.h"
+
+static void
+classifiesResponses_test(void **state)
+{
+	(void) state;
+	assert_int_equal(server_response("HTTP/1.0 200 OK\r\n\r\n"
+	    "good 1.2.3.4\r\n"), CODE_GOOD);
+	assert_int_equal(server_response("HTTP/1.0 200 OK\r\n\r\n"
+	    "NOCHG 1.2.3.4"), CODE_NOCHG);
+	assert_int_equal(server_response("HTTP/1.0 200 OK\r\n\r\n"
+	    "!donator\r\n"), CODE_NOTDONATOR);
+	assert_int_equal(server_response("HTTP/1.0 500 Error\n\n911"),
+	    CODE_EMERG);
+	assert_int_equal(server_response("good 1.2.3.4"), CODE_UNKNOWN);
+	assert_int_equal(server_response(""), CODE_UNKNOWN);
+	assert_int_equal(server_response(NULL), CODE_UNKNOWN);
+	assert_string_equal(response_code_name(CODE_NOTDONATOR), "!donator");
+	assert_string_equal(response_code_name(CODE_UNKNOWN), "unknown");
+}
+
+static void
+classifiesEveryKeyword_test(void **state)
+{
+	static const struct {
+		const char	*body;
+		response_code_t	 code;
+	} cases[] = {
+		{ "good",         CODE_GOOD       },
+		{ "Good",         CODE_GOOD       },
+		{ "nochg",        CODE_NOCHG      },
+		{ "nohost",       CODE_NOHOST     },
+		{ "NOHOST",       CODE_NOHOST     },
+		{ "badauth",      CODE_BADAUTH    },
+		{ "badagent",     CODE_BADAGENT   },
+		{ "!Donator",     CODE_NOTDONATOR },
+		{ "abuse",        CODE_ABUSE      },
+		{ "911",          CODE_EMERG      },
+		{ "nohost x",     CODE_UNKNOWN    },
+		{ "goo",          CODE_UNKNOWN    },
+		{ "goods",        CODE_UNKNOWN    },
+		{ "gooe",         CODE_UNKNOWN    },
+		{ " good",        CODE_UNKNOWN    },
+		{ "\x80\xff",     CODE_UNKNOWN    },
+	};
+	char buf[100];
+
+	(void) state;
+	for (size_t i = 0; i < sizeof cases / sizeof cases[0]; i++) {
+		(void) snprintf(buf, sizeof buf, "HTTP/1.0 200 OK\r\n\r\n%s\r\n",
+		    cases[i].body);
+		assert_int_equal(server_response(buf), cases[i].code);
+	}
+}
+
+static void
+classifiesEveryLine_test(void **state)
+{
+	static const char	 body[] = "HTTP/1.0 200 OK\r\n"
+	    "Content-Type: text/plain\r\n\r\n"
+	    "good 192.0.2.1\r\n"
+	    "\r\n"
+	    "NOCHG 192.0.2.2  \r\n"
+	    "nohost\n"
+	    "bogus";
+	struct server_reply	 replies[3];
+
+	(void) state;
+	assert_int_equal(server_replies(body, replies, 3), 4);
+	assert_int_equal(replies[0].code, CODE_GOOD);
+	assert_int_equal(replies[0].addr_len, 9);
+	assert_memory_equal(replies[0].addr, "192.0.2.1", 9);
+	assert_int_equal(replies[1].code, CODE_NOCHG);
+	assert_int_equal(replies[1].addr_len, 9);
+	assert_memory_equal(replies[1].addr, "192.0.2.2", 9);
+	assert_int_equal(replies[2].code, CODE_NOHOST);
+	assert_null(replies[2].addr);
+
+	assert_int_equal(server_replies("good 192.0.2.1\r\n", replies, 3), 0);
+	assert_int_equal(server_replies("HTTP/1.0 200 OK\n\n", replies, 3), 0);
+	assert_int_equal(server_replies(NULL, replies, 3), 0);
+}
+
+static void
+buildsUpdateRequests_test(void **state)
+{
+	static const char expected[] = "GET /nic/update?hostname=a.example.com "
+	    "HTTP/1.0\r\nHost: dynupdate.noip.com\r\n"
+	    "Authorization: Basic am9lOnNlY3JldA==\r\nUser-Agent: ";
+	char		*req;
+	struct arena	 a = { 0 };
+
+	(void) state;
+	assert_int_equal(install_setting("username", "joe"), 0);
+	assert_int_equal(install_setting("password", "secret"), 0);
+
+	req = update_request(&a, "a.example.com", "WAN_address");
+	assert_non_null(req);
+	assert_memory_equal(req, expected, sizeof expected - 1);
+
+	req = update_request(&a, "a.example.com", "192.0.2.1");
+	assert_non_null(req);
+	assert_non_null(strstr(req, "?hostname=a.example.com&myip=192.0.2.1 "
+	    "HTTP/1.0\r\n"));
+	arena_destroy(&a);
+	destroy_config_custom_values();
+}
+
+static void
+findsLookupAddresses_test(void **state)
+{
+	char		 ok[] = "HTTP/1.0 200 OK\r\n\r\n198.51.100.7\r\n \n";
+	char		 bogus[] = "HTTP/1.0 200 OK\r\n\r\n198.51.100";
+	char		 no_newline[] = "198.51.100.7";
+	const char	*reason = "";
+
+	(void) state;
+	assert_string_equal(lookup_response(ok, &reason), "198.51.100.7");
+	assert_null(lookup_response(bogus, &reason));
+	assert_string_equal(reason, "bogus ipv4 address");
+	assert_null(lookup_response(no_newline, &reason));
+	assert_string_equal(reason,
+	    "cannot locate last occurrance of a newline");
+}
+
+int
+main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(classifiesResponses_test),
+		cmocka_unit_test(classifiesEveryKeyword_test),
+		cmocka_unit_test(classifiesEveryLine_test),
+		cmocka_unit_test(buildsUpdateRequests_test),
+		cmocka_unit_test(findsLookupAddresses_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -1,5 +1,20 @@
-TESTS = is_numeric.run\
+TESTS = arena.run\
+	base64.run\
+	confcache.run\
+	control.run\
+	format.run\
+	histogram.run\
+	interpreter.run\
+	is_numeric.run\
+	json.run\
+	log.run\
+	logfile.run\
+	metrics.run\
 	net_ssl_check_hostname.run\
+	net_ssl_peer_pin.run\
+	netstats.run\
+	pool.run\
+	protocol.run\
 	size_product.run\
 	strToLower.run\
 	strdup_printf.run\